@@ -0,0 +1,89 @@
+#pragma once
+
+// Encoded zcmtypes resembling what robots publish, for the benchmarks
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "types/example_t.hpp"
+#include "types/point_cloud_t.hpp"
+#include "types/occupancy_grid_t.hpp"
+
+// A pose estimate along a slow circle, the kind of small message published at a high rate
+inline example_t makePose(int64_t utime)
+{
+    double t = utime / 1e6;
+
+    example_t pose;
+    pose.utime = utime;
+    pose.position[0] = 10 * cos(t / 10);
+    pose.position[1] = 10 * sin(t / 10);
+    pose.position[2] = 0;
+    pose.orientation[0] = cos(t / 20);
+    pose.orientation[1] = pose.orientation[2] = 0;
+    pose.orientation[3] = sin(t / 20);
+    pose.num_ranges = 0;
+    pose.name = "pose";
+    pose.enabled = true;
+    return pose;
+}
+
+// One revolution of a 32 beam lidar in a room: ranges vary smoothly with some noise,
+// and beams that hit nothing are all zeros
+inline point_cloud_t makePointCloud(std::mt19937& rng)
+{
+    std::normal_distribution<float> noise(0, 0.01f);
+    std::uniform_int_distribution<int> dropout(0, 9);
+
+    point_cloud_t pc;
+    pc.utime = 0;
+    pc.frame = "lidar";
+    for (int az = 0; az < 2048; az++) {
+        float yaw = az * 2 * M_PI / 2048;
+        for (int beam = 0; beam < 32; beam++) {
+            float pitch = (beam - 16) * 0.02f;
+            bool hit = dropout(rng) != 0;
+            float range = hit ? 5 + 2 * cosf(2 * yaw) + noise(rng) : 0;
+            pc.x.push_back(range * cosf(pitch) * cosf(yaw));
+            pc.y.push_back(range * cosf(pitch) * sinf(yaw));
+            pc.z.push_back(range * sinf(pitch));
+            pc.intensity.push_back(hit ? 40 + beam : 0);
+        }
+    }
+    pc.num_points = pc.x.size();
+    return pc;
+}
+
+// A 1000x1000 map, mostly unknown, with a few explored rooms whose walls are occupied
+inline occupancy_grid_t makeOccupancyGrid(std::mt19937& rng)
+{
+    std::uniform_int_distribution<int> pos(0, 800), size(50, 200);
+
+    occupancy_grid_t grid;
+    grid.utime = 0;
+    grid.frame = "map";
+    grid.resolution = 0.05;
+    grid.origin[0] = grid.origin[1] = -25;
+    grid.width = grid.height = 1000;
+    grid.cells.assign(grid.height, std::vector<int8_t>(grid.width, occupancy_grid_t::UNKNOWN));
+    for (int room = 0; room < 20; room++) {
+        int x0 = pos(rng), y0 = pos(rng), w = size(rng), h = size(rng);
+        for (int y = y0; y < y0 + h; y++) {
+            for (int x = x0; x < x0 + w; x++) {
+                bool wall = y == y0 || y == y0 + h - 1 || x == x0 || x == x0 + w - 1;
+                grid.cells[y][x] = wall ? occupancy_grid_t::OCCUPIED : occupancy_grid_t::FREE;
+            }
+        }
+    }
+    return grid;
+}
+
+template<class T>
+inline std::vector<uint8_t> encode(const T& msg)
+{
+    std::vector<uint8_t> buf(msg.getEncodedSize());
+    msg.encode(buf.data(), 0, buf.size());
+    return buf;
+}
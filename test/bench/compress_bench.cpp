@@ -0,0 +1,79 @@
+// Measures how well, and how fast, the transport codecs (see zcm/transport/codec.h)
+// compress encoded zcmtypes resembling what robots publish: a lidar point cloud and an
+// occupancy grid.
+//
+// Usage: compress-bench [codec] [iterations]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "zcm/zcm.h"
+#include "zcm/transport/codec.h"
+
+#include "bench_msgs.hpp"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+static void runBench(const char* name, const zcm_codec_t* codec,
+                     const vector<uint8_t>& raw, size_t iterations)
+{
+    vector<uint8_t> compressed(codec->bound(raw.size()));
+    vector<uint8_t> out(raw.size());
+    size_t len = 0;
+
+    auto start = Clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        len = compressed.size();
+        if (codec->compress(raw.data(), raw.size(), compressed.data(), &len) != ZCM_EOK) {
+            fprintf(stderr, "%s: failed to compress\n", name);
+            return;
+        }
+    }
+    double compressSecs = chrono::duration<double>(Clock::now() - start).count();
+
+    start = Clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        size_t outlen = out.size();
+        if (codec->decompress(compressed.data(), len, out.data(), &outlen) != ZCM_EOK ||
+            outlen != raw.size()) {
+            fprintf(stderr, "%s: failed to decompress\n", name);
+            return;
+        }
+    }
+    double decompressSecs = chrono::duration<double>(Clock::now() - start).count();
+
+    if (out != raw) {
+        fprintf(stderr, "%s: round trip mismatch\n", name);
+        return;
+    }
+
+    double mb = raw.size() * iterations / 1e6;
+    printf("%-18s %9zu -> %9zu bytes   ratio %6.2f   compress %8.1f MB/s   "
+           "decompress %8.1f MB/s\n",
+           name, raw.size(), len, (double)raw.size() / len,
+           mb / compressSecs, mb / decompressSecs);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* codecName = argc > 1 ? argv[1] : "lz4";
+    size_t iterations     = argc > 2 ? strtoul(argv[2], nullptr, 10) : 50;
+    const zcm_codec_t* codec = zcm_codec_find(codecName);
+    if (!codec || iterations == 0) {
+        fprintf(stderr, "Usage: %s [codec] [iterations > 0]\n", argv[0]);
+        return 1;
+    }
+
+    mt19937 rng(42);
+    printf("codec %s, %zu iterations\n", codecName, iterations);
+    runBench("point_cloud_t", codec, encode(makePointCloud(rng)), iterations);
+    runBench("occupancy_grid_t", codec, encode(makeOccupancyGrid(rng)), iterations);
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+// Measures writing, reading and seeking through an event log stored plainly and in
+// compressed blocks of a few sizes (see zcm_eventlog_write_compressed()). The log is a
+// robot's: poses at 100 Hz, point clouds at 10 Hz and an occupancy grid every second.
+//
+// Usage: eventlog-bench [seconds of log] [codec] [directory]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "zcm/zcm.h"
+#include "zcm/eventlog.h"
+
+#include "bench_msgs.hpp"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+struct Message
+{
+    int64_t utime;
+    const char* channel;
+    const vector<uint8_t>* data;
+};
+
+static double secondsSince(Clock::time_point start)
+{
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+// 'blockSize' 0 writes a plain log
+static void runBench(const string& path, const char* codec, size_t blockSize,
+                     const vector<Message>& msgs, size_t rawBytes)
+{
+    char name[32];
+    if (blockSize) snprintf(name, sizeof(name), "%s %zu KiB", codec, blockSize >> 10);
+    else snprintf(name, sizeof(name), "plain");
+
+    zcm_eventlog_t* l = zcm_eventlog_create(path.c_str(), "w");
+    if (!l || (blockSize && zcm_eventlog_write_compressed(l, codec, blockSize) != 0)) {
+        fprintf(stderr, "%s: failed to create %s\n", name, path.c_str());
+        if (l) zcm_eventlog_destroy(l);
+        return;
+    }
+    auto start = Clock::now();
+    for (auto& m : msgs) {
+        zcm_eventlog_event_t le;
+        le.timestamp = m.utime;
+        le.channellen = strlen(m.channel);
+        le.datalen = m.data->size();
+        le.channel = (char*)m.channel;
+        le.data = (uint8_t*)m.data->data();
+        if (zcm_eventlog_write_event(l, &le) != 0) {
+            fprintf(stderr, "%s: failed to write\n", name);
+            zcm_eventlog_destroy(l);
+            return;
+        }
+    }
+    zcm_eventlog_destroy(l);
+    double writeSecs = secondsSince(start);
+
+    FILE* f = fopen(path.c_str(), "rb");
+    fseeko(f, 0, SEEK_END);
+    off_t fileBytes = ftello(f);
+    fclose(f);
+
+    l = zcm_eventlog_create(path.c_str(), "r");
+    start = Clock::now();
+    size_t nread = 0;
+    zcm_eventlog_event_t le;
+    while (zcm_eventlog_read_next_event_view(l, &le) == 0) nread++;
+    double readSecs = secondsSince(start);
+    if (nread != msgs.size()) {
+        fprintf(stderr, "%s: read %zu of %zu events\n", name, nread, msgs.size());
+        zcm_eventlog_destroy(l);
+        return;
+    }
+
+    // Seek to random times and read the event there, as a log player scrubbing would
+    mt19937 rng(7);
+    uniform_int_distribution<size_t> pick(0, msgs.size() - 1);
+    const size_t nseeks = 1000;
+    start = Clock::now();
+    for (size_t i = 0; i < nseeks; i++) {
+        if (zcm_eventlog_seek_to_timestamp(l, msgs[pick(rng)].utime) != 0 ||
+            zcm_eventlog_read_next_event_view(l, &le) != 0) {
+            fprintf(stderr, "%s: failed to seek\n", name);
+            zcm_eventlog_destroy(l);
+            return;
+        }
+    }
+    double seekSecs = secondsSince(start);
+    zcm_eventlog_destroy(l);
+    unlink(path.c_str());
+
+    double mb = rawBytes / 1e6;
+    printf("%-16s %11lld bytes   ratio %5.2f   write %7.1f MB/s   read %7.1f MB/s   "
+           "seek %8.1f us\n",
+           name, (long long)fileBytes, (double)rawBytes / fileBytes,
+           mb / writeSecs, mb / readSecs, seekSecs / nseeks * 1e6);
+}
+
+int main(int argc, char* argv[])
+{
+    int seconds       = argc > 1 ? atoi(argv[1]) : 10;
+    const char* codec = argc > 2 ? argv[2] : "lz4";
+    string dir        = argc > 3 ? argv[3] : "/tmp";
+    if (seconds <= 0) {
+        fprintf(stderr, "Usage: %s [seconds of log > 0] [codec] [directory]\n", argv[0]);
+        return 1;
+    }
+
+    mt19937 rng(42);
+    vector<vector<uint8_t>> clouds, poses;
+    for (int i = 0; i < 4; i++) clouds.push_back(encode(makePointCloud(rng)));
+    vector<uint8_t> grid = encode(makeOccupancyGrid(rng));
+    for (int64_t t = 0; t < seconds * 1000000LL; t += 10000)
+        poses.push_back(encode(makePose(t)));
+
+    vector<Message> msgs;
+    size_t rawBytes = 0;
+    for (size_t i = 0; i < poses.size(); i++) {
+        int64_t utime = i * 10000;
+        msgs.push_back({ utime, "POSE", &poses[i] });
+        if (i % 10 == 0) msgs.push_back({ utime, "LIDAR", &clouds[i / 10 % clouds.size()] });
+        if (i % 100 == 0) msgs.push_back({ utime, "MAP", &grid });
+    }
+    for (auto& m : msgs) rawBytes += m.data->size();
+
+    string path = dir + "/eventlog-bench-" + to_string(getpid()) + ".log";
+    printf("%zu events, %.1f MB of messages\n", msgs.size(), rawBytes / 1e6);
+    runBench(path, codec, 0, msgs, rawBytes);
+    for (size_t blockSize : { 64 << 10, 256 << 10, 1 << 20 })
+        runBench(path, codec, blockSize, msgs, rawBytes);
+
+    return 0;
+}
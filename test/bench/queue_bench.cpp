@@ -0,0 +1,70 @@
+// Compares the handoff cost of ThreadsafeQueue and SerialProducerQueue between one producer
+// and one consumer thread, as zcm_blocking uses them for its send and recv queues.
+//
+// Usage: queue-bench [num-msgs] [queue-size]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "zcm/util/threadsafe_queue.hpp"
+#include "zcm/util/serial_producer_queue.hpp"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+struct Item
+{
+    Clock::time_point pushed;
+    Item(Clock::time_point t) : pushed(t) {}
+};
+
+template<class Q>
+static void runBench(const char* name, size_t numMsgs, size_t queueSize)
+{
+    Q q(queueSize);
+    vector<uint64_t> latencyNs(numMsgs);
+
+    auto start = Clock::now();
+
+    thread consumer([&](){
+        for (size_t i = 0; i < numMsgs; ++i) {
+            Item* it = q.top();
+            latencyNs[i] = chrono::duration_cast<chrono::nanoseconds>(
+                               Clock::now() - it->pushed).count();
+            q.pop();
+        }
+    });
+
+    for (size_t i = 0; i < numMsgs; ++i) q.push(Clock::now());
+    consumer.join();
+
+    double secs = chrono::duration<double>(Clock::now() - start).count();
+
+    sort(latencyNs.begin(), latencyNs.end());
+    printf("%-16s %12.0f msgs/s   p50 %8lu ns   p99 %8lu ns   max %10lu ns\n",
+           name, numMsgs / secs,
+           (unsigned long) latencyNs[numMsgs / 2],
+           (unsigned long) latencyNs[numMsgs * 99 / 100],
+           (unsigned long) latencyNs[numMsgs - 1]);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t numMsgs   = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    size_t queueSize = argc > 2 ? strtoul(argv[2], nullptr, 10) : 16;
+    if (numMsgs == 0 || queueSize < 2) {
+        fprintf(stderr, "Usage: %s [num-msgs] [queue-size >= 2]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%zu messages through a queue of size %zu\n", numMsgs, queueSize);
+    runBench<ThreadsafeQueue<Item>>("ThreadsafeQueue", numMsgs, queueSize);
+    runBench<SerialProducerQueue<Item>>("SerialProducerQueue", numMsgs, queueSize);
+
+    return 0;
+}
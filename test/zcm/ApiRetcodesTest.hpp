@@ -8,6 +8,8 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <atomic>
+
 #include "cxxtest/TestSuite.h"
 
 using namespace std;
@@ -172,6 +174,43 @@ class ApiRetcodesTest : public CxxTest::TestSuite
         zcm_cleanup(&zcm);
     }
 
+    void testPublishLoan(void)
+    {
+        zcm_t zcm;
+        zcm_init(&zcm, "test-generic");
+        zcm_start(&zcm);
+
+        uint8_t *buf = nullptr;
+
+        /* loan size passed the limit */
+        TS_ASSERT_EQUALS(ZCM_EINVALID, zcm_publish_loan(&zcm, GENERIC_MTU+1, &buf));
+        TS_ASSERT_EQUALS(nullptr, buf);
+
+        /* loan and commit at limit */
+        TS_ASSERT_EQUALS(ZCM_EOK, zcm_publish_loan(&zcm, GENERIC_MTU, &buf));
+        TS_ASSERT(buf != nullptr);
+        memset(buf, 'A', GENERIC_MTU);
+        TS_ASSERT_EQUALS(ZCM_EOK, zcm_publish_commit(&zcm, "FOO", buf, GENERIC_MTU));
+
+        /* committing more than was loaned */
+        TS_ASSERT_EQUALS(ZCM_EOK, zcm_publish_loan(&zcm, 1, &buf));
+        TS_ASSERT_EQUALS(ZCM_EINVALID, zcm_publish_commit(&zcm, "FOO", buf, GENERIC_MTU+1));
+
+        /* channel size 1 passed the limit */
+        char channel[ZCM_CHANNEL_MAXLEN+2];
+        memset(channel, 'A', ZCM_CHANNEL_MAXLEN+1);
+        channel[ZCM_CHANNEL_MAXLEN+1] = '\0';
+        TS_ASSERT_EQUALS(ZCM_EOK, zcm_publish_loan(&zcm, 1, &buf));
+        TS_ASSERT_EQUALS(ZCM_EINVALID, zcm_publish_commit(&zcm, channel, buf, 1));
+
+        /* returning a loan without publishing */
+        TS_ASSERT_EQUALS(ZCM_EOK, zcm_publish_loan(&zcm, 1, &buf));
+        zcm_publish_cancel(&zcm, buf);
+
+        zcm_stop(&zcm);
+        zcm_cleanup(&zcm);
+    }
+
     void testPublishMsgdrop(void)
     {
         zcm_t zcm;
@@ -195,6 +234,41 @@ class ApiRetcodesTest : public CxxTest::TestSuite
         zcm_cleanup(&zcm);
     }
 
+    static void blockingHandler(const zcm_recv_buf_t *rbuf, const char *channel, void *usr)
+    {
+        std::atomic<int>* state = (std::atomic<int>*) usr;
+        if (state->load() == 0) state->store(1);
+        while (state->load() == 1) usleep(1000);
+    }
+
+    void testSetQueueSizeWithFullRecvQueue(void)
+    {
+        zcm_t zcm;
+        zcm_init(&zcm, "block-inproc");
+        std::atomic<int> state {0};
+        zcm_subscribe(&zcm, "FULL", blockingHandler, &state);
+        zcm_start(&zcm);
+
+        // The handler holds the dispatcher up, so the recv thread ends up waiting to
+        // push into a full recvQueue
+        uint8_t data = 'a';
+        for (int i = 0; i < 64; i++) {
+            zcm_publish(&zcm, "FULL", &data, 1);
+            usleep(1000);
+        }
+        while (state.load() != 1) usleep(1000);
+        usleep(100000);
+
+        // Resizing needs the dispatcher, so trying must give up rather than block
+        TS_ASSERT_EQUALS(ZCM_EAGAIN, zcm_try_set_queue_size(&zcm, 32));
+
+        state.store(2);
+        zcm_set_queue_size(&zcm, 32);
+
+        zcm_stop(&zcm);
+        zcm_cleanup(&zcm);
+    }
+
     void testSub(void)
     {
         zcm_t zcm;
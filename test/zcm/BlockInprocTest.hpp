@@ -0,0 +1,203 @@
+#ifndef BLOCKINPROCTEST_HPP
+#define BLOCKINPROCTEST_HPP
+
+#include "zcm/zcm.h"
+#include "zcm/transport_registrar.h"
+#include "cxxtest/TestSuite.h"
+#include "TransUtil.hpp"
+
+#include "util/TimeUtil.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+class BlockInprocTest : public CxxTest::TestSuite
+{
+    static int send(zcm_trans_t* zt, const char* channel, uint32_t seq)
+    {
+        zcm_msg_t msg;
+        msg.utime = 0;
+        msg.channel = channel;
+        msg.len = sizeof(seq);
+        msg.buf = (uint8_t*) &seq;
+        return zcm_trans_sendmsg(zt, msg);
+    }
+
+  public:
+    void setUp() override {}
+    void tearDown() override {}
+
+    void testNamedBusFansOutOneCopy()
+    {
+        zcm_trans_t* a = makeTrans("block-inproc://fanout");
+        zcm_trans_t* b = makeTrans("block-inproc://fanout");
+        zcm_trans_t* other = makeTrans("block-inproc");
+        TS_ASSERT(a && b && other);
+        if (!a || !b || !other) return;
+
+        TS_ASSERT_EQUALS(send(a, "FAN", 7), ZCM_EOK);
+
+        zcm_msg_t ma, mb, mo;
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(a, &ma, 100), ZCM_EOK);
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(b, &mb, 100), ZCM_EOK);
+        TS_ASSERT_EQUALS(string(mb.channel), "FAN");
+        TS_ASSERT_EQUALS(mb.len, sizeof(uint32_t));
+        // Both subscribers are handed the same buffer
+        TS_ASSERT_EQUALS(ma.buf, mb.buf);
+
+        // An unnamed instance is a bus of its own
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(other, &mo, 10), ZCM_EAGAIN);
+
+        zcm_trans_destroy(other);
+        zcm_trans_destroy(b);
+        zcm_trans_destroy(a);
+    }
+
+    void testSlowSubscriberHoldsPublisherBack()
+    {
+        zcm_trans_t* pub = makeTrans("block-inproc://slow?queue_size=16");
+        zcm_trans_t* sub = makeTrans("block-inproc://slow");
+        TS_ASSERT(pub && sub);
+        if (!pub || !sub) return;
+
+        // Only subscribers that are actively receiving hold publishers back
+        zcm_msg_t msg;
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(sub, &msg, 0), ZCM_EAGAIN);
+
+        const uint32_t NUM = 2000;
+        uint32_t received = 0, outOfOrder = 0;
+        thread reader([&]() {
+            while (received < NUM && zcm_trans_recvmsg(sub, &msg, 500) == ZCM_EOK) {
+                uint32_t seq;
+                memcpy(&seq, msg.buf, sizeof(seq));
+                if (seq != received) outOfOrder++;
+                received++;
+            }
+        });
+        for (uint32_t i = 0; i < NUM; ++i)
+            send(pub, "SLOW", i);
+        reader.join();
+
+        TS_ASSERT_EQUALS(received, NUM);
+        TS_ASSERT_EQUALS(outOfOrder, 0u);
+
+        zcm_trans_destroy(sub);
+        zcm_trans_destroy(pub);
+    }
+
+    void testReceivingSubscriberIsNeverLapped()
+    {
+        zcm_trans_t* pub = makeTrans("block-inproc://busy?queue_size=4");
+        zcm_trans_t* sub = makeTrans("block-inproc://busy");
+        TS_ASSERT(pub && sub);
+        if (!pub || !sub) return;
+
+        zcm_msg_t msg;
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(sub, &msg, 0), ZCM_EAGAIN);
+
+        // However long the subscriber takes, nothing it was due is overwritten
+        const uint32_t NUM = 12;
+        thread writer([&]() {
+            for (uint32_t i = 0; i < NUM; ++i)
+                send(pub, "BUSY", i);
+        });
+        this_thread::sleep_for(chrono::milliseconds(400));
+        for (uint32_t i = 0; i < NUM; ++i) {
+            TS_ASSERT_EQUALS(zcm_trans_recvmsg(sub, &msg, 100), ZCM_EOK);
+            uint32_t seq;
+            memcpy(&seq, msg.buf, sizeof(seq));
+            TS_ASSERT_EQUALS(seq, i);
+        }
+        writer.join();
+
+        zcm_trans_destroy(sub);
+        zcm_trans_destroy(pub);
+    }
+
+    void testStoppedSubscriberIsLapped()
+    {
+        zcm_trans_t* pub = makeTrans("block-inproc://stopped?queue_size=4");
+        zcm_trans_t* sub = makeTrans("block-inproc://stopped");
+        TS_ASSERT(pub && sub);
+        if (!pub || !sub) return;
+
+        zcm_msg_t msg;
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(sub, &msg, 0), ZCM_EAGAIN);
+        TS_ASSERT_EQUALS(zcm_trans_set_receiving(sub, false), ZCM_EOK);
+
+        for (uint32_t i = 0; i < 12; ++i)
+            TS_ASSERT_EQUALS(send(pub, "STOPPED", i), ZCM_EOK);
+
+        // Once receiving again, it picks up from the oldest message left
+        TS_ASSERT_EQUALS(zcm_trans_set_receiving(sub, true), ZCM_EOK);
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(sub, &msg, 100), ZCM_EOK);
+        uint32_t seq;
+        memcpy(&seq, msg.buf, sizeof(seq));
+        TS_ASSERT_EQUALS(seq, 8u);
+
+        zcm_trans_destroy(sub);
+        zcm_trans_destroy(pub);
+    }
+
+    void testPayloadsAreFreedOnceReceivingSubscribersAreDone()
+    {
+        zcm_trans_t* sub = makeTrans("block-inproc://trim?queue_size=8&retain_max=0");
+        zcm_trans_t* idle = makeTrans("block-inproc://trim");
+        TS_ASSERT(sub && idle);
+        if (!sub || !idle) return;
+
+        zcm_msg_t msg;
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(sub, &msg, 0), ZCM_EAGAIN);
+
+        uint64_t before = TimeUtil::utime();
+        TS_ASSERT_EQUALS(send(sub, "TRIM", 1), ZCM_EOK);
+        uint64_t after = TimeUtil::utime();
+        this_thread::sleep_for(chrono::milliseconds(10));
+
+        // Stamped when it was published, not when it was received
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(sub, &msg, 100), ZCM_EOK);
+        TS_ASSERT(msg.utime >= before && msg.utime <= after);
+
+        // An instance that never received isn't waited for, so the payload is
+        // already gone by the time it looks
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(idle, &msg, 10), ZCM_EAGAIN);
+
+        zcm_trans_destroy(idle);
+        zcm_trans_destroy(sub);
+    }
+
+    void testLargePayloadsAreReused()
+    {
+        zcm_trans_t* zt = makeTrans("block-inproc://large?queue_size=2");
+        TS_ASSERT(zt);
+        if (!zt) return;
+
+        vector<uint8_t> big(1 << 20);
+        zcm_msg_t msg;
+        vector<uint8_t*> bufs;
+        for (uint8_t i = 0; i < 6; ++i) {
+            big[0] = i;
+            msg.utime = 0;
+            msg.channel = "LARGE";
+            msg.len = big.size();
+            msg.buf = big.data();
+            TS_ASSERT_EQUALS(zcm_trans_sendmsg(zt, msg), ZCM_EOK);
+            TS_ASSERT_EQUALS(zcm_trans_recvmsg(zt, &msg, 100), ZCM_EOK);
+            TS_ASSERT_EQUALS(msg.len, big.size());
+            TS_ASSERT_EQUALS(msg.buf[0], i);
+            bufs.push_back(msg.buf);
+        }
+        // Each slot keeps publishing into the buffer it started with
+        for (size_t i = 2; i < bufs.size(); ++i)
+            TS_ASSERT_EQUALS(bufs[i], bufs[i - 2]);
+
+        zcm_trans_destroy(zt);
+    }
+};
+
+#endif /* BLOCKINPROCTEST_HPP */
@@ -0,0 +1,179 @@
+#ifndef DISPATCHTHREADSTEST_HPP
+#define DISPATCHTHREADSTEST_HPP
+
+#include "zcm/zcm.h"
+#include "cxxtest/TestSuite.h"
+
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+#define URL "block-inproc"
+#define NUM_CHANNELS 4
+#define NUM_MSGS_PER_CHANNEL 500
+
+struct OrderState
+{
+    atomic<uint32_t> next {0};
+    atomic<int> outOfOrder {0};
+    atomic<int> inside {0};
+    atomic<int> concurrent {0};
+    useconds_t delay {0};
+};
+
+// Each message carries its per-channel sequence number. Any subscription must see
+// them in order and must never be called concurrently with itself
+static void order_handler(const zcm_recv_buf_t* rbuf, const char* channel, void* usr)
+{
+    OrderState* s = (OrderState*) usr;
+    if (s->inside++ != 0) s->concurrent++;
+
+    uint32_t seq;
+    memcpy(&seq, rbuf->data, sizeof(seq));
+    if (seq != s->next) s->outOfOrder++;
+    s->next = seq + 1;
+
+    if (s->delay) usleep(s->delay);
+    s->inside--;
+}
+
+static atomic<bool> slowRunning {false};
+static atomic<int>  fastWhileSlow {0};
+static void slow_handler(const zcm_recv_buf_t* rbuf, const char* channel, void* usr)
+{
+    slowRunning = true;
+    usleep(200000);
+    slowRunning = false;
+}
+
+static void fast_handler(const zcm_recv_buf_t* rbuf, const char* channel, void* usr)
+{
+    if (slowRunning) fastWhileSlow++;
+}
+
+class DispatchThreadsTest : public CxxTest::TestSuite
+{
+    static void publishAll(zcm_t* zcm, const char* channel, uint32_t seq)
+    {
+        while (zcm_publish(zcm, channel, (const uint8_t*) &seq, sizeof(seq)) != ZCM_EOK)
+            usleep(100);
+    }
+
+  public:
+    void setUp() override {}
+    void tearDown() override {}
+
+    void testOrderingUnderLoad()
+    {
+        zcm_t* zcm = zcm_create(URL);
+        TS_ASSERT(zcm);
+        if (!zcm) return;
+
+        TS_ASSERT_EQUALS(zcm_set_dispatch_threads(zcm, 3), ZCM_EOK);
+
+        OrderState exact[NUM_CHANNELS];
+        OrderState regex[NUM_CHANNELS];
+        for (size_t i = 0; i < NUM_CHANNELS; ++i) {
+            string ch = "CHAN" + to_string(i);
+            exact[i].delay = i * 50;
+            TS_ASSERT(zcm_subscribe(zcm, ch.c_str(), order_handler, &exact[i]));
+            // A second subscription on the same channel gets its own strand
+            TS_ASSERT(zcm_subscribe(zcm, (ch + ".*").c_str(), order_handler, &regex[i]));
+        }
+
+        zcm_start(zcm);
+        TS_ASSERT_EQUALS(zcm_set_dispatch_threads(zcm, 2), ZCM_EAGAIN);
+
+        for (uint32_t seq = 0; seq < NUM_MSGS_PER_CHANNEL; ++seq) {
+            for (size_t i = 0; i < NUM_CHANNELS; ++i) {
+                string ch = "CHAN" + to_string(i);
+                publishAll(zcm, ch.c_str(), seq);
+            }
+        }
+
+        for (int i = 0; i < 1000; ++i) {
+            bool done = true;
+            for (size_t j = 0; j < NUM_CHANNELS; ++j)
+                if (exact[j].next != NUM_MSGS_PER_CHANNEL ||
+                    regex[j].next != NUM_MSGS_PER_CHANNEL) done = false;
+            if (done) break;
+            usleep(10000);
+        }
+        zcm_stop(zcm);
+
+        for (size_t i = 0; i < NUM_CHANNELS; ++i) {
+            TS_ASSERT_EQUALS(exact[i].next, NUM_MSGS_PER_CHANNEL);
+            TS_ASSERT_EQUALS(exact[i].outOfOrder, 0);
+            TS_ASSERT_EQUALS(exact[i].concurrent, 0);
+            TS_ASSERT_EQUALS(regex[i].next, NUM_MSGS_PER_CHANNEL);
+            TS_ASSERT_EQUALS(regex[i].outOfOrder, 0);
+            TS_ASSERT_EQUALS(regex[i].concurrent, 0);
+        }
+
+        // Back to a single dispatch thread once stopped
+        TS_ASSERT_EQUALS(zcm_set_dispatch_threads(zcm, 1), ZCM_EOK);
+
+        zcm_destroy(zcm);
+    }
+
+    void testSlowCallbackDoesNotStallOthers()
+    {
+        zcm_t* zcm = zcm_create(URL);
+        TS_ASSERT(zcm);
+        if (!zcm) return;
+
+        TS_ASSERT_EQUALS(zcm_set_dispatch_threads(zcm, 2), ZCM_EOK);
+        TS_ASSERT(zcm_subscribe(zcm, "SLOW", slow_handler, NULL));
+        TS_ASSERT(zcm_subscribe(zcm, "FAST", fast_handler, NULL));
+
+        zcm_start(zcm);
+
+        publishAll(zcm, "SLOW", 0);
+        for (int i = 0; i < 100 && !slowRunning; ++i) usleep(1000);
+        for (uint32_t seq = 0; seq < 10; ++seq) publishAll(zcm, "FAST", seq);
+        usleep(300000);
+
+        zcm_stop(zcm);
+
+        TS_ASSERT_EQUALS(fastWhileSlow, 10);
+
+        zcm_destroy(zcm);
+    }
+
+    void testFlushWhilePaused()
+    {
+        zcm_t* zcm = zcm_create(URL);
+        TS_ASSERT(zcm);
+        if (!zcm) return;
+
+        OrderState s;
+        TS_ASSERT_EQUALS(zcm_set_dispatch_threads(zcm, 2), ZCM_EOK);
+        TS_ASSERT(zcm_subscribe(zcm, "FLUSH", order_handler, &s));
+
+        zcm_start(zcm);
+        zcm_pause(zcm);
+
+        for (uint32_t seq = 0; seq < 8; ++seq) publishAll(zcm, "FLUSH", seq);
+        zcm_flush(zcm);
+        for (int i = 0; i < 100 && s.next != 8; ++i) {
+            usleep(10000);
+            zcm_flush(zcm);
+        }
+
+        TS_ASSERT_EQUALS(s.next, 8);
+        TS_ASSERT_EQUALS(s.outOfOrder, 0);
+
+        zcm_resume(zcm);
+        zcm_stop(zcm);
+        zcm_destroy(zcm);
+    }
+};
+
+#undef NUM_MSGS_PER_CHANNEL
+#undef NUM_CHANNELS
+#undef URL
+
+#endif /* DISPATCHTHREADSTEST_HPP */
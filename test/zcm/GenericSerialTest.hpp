@@ -0,0 +1,142 @@
+#ifndef GENERICSERIALTEST_HPP
+#define GENERICSERIALTEST_HPP
+
+#include "zcm/zcm.h"
+#include "zcm/transport/generic_serial_transport.h"
+#include "cxxtest/TestSuite.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// A serial line looped back onto itself, read back a few bytes at a time
+struct Loopback
+{
+    vector<uint8_t> wire;
+    size_t readPos = 0;
+    size_t chunk = 0;  // the most bytes a read returns, 0 for no limit
+
+    static size_t put(const uint8_t* data, size_t nData, void* usr)
+    {
+        Loopback* me = (Loopback*)usr;
+        me->wire.insert(me->wire.end(), data, data + nData);
+        return nData;
+    }
+
+    static size_t get(uint8_t* data, size_t nData, void* usr)
+    {
+        Loopback* me = (Loopback*)usr;
+        size_t n = min(nData, me->wire.size() - me->readPos);
+        if (me->chunk) n = min(n, me->chunk);
+        memcpy(data, me->wire.data() + me->readPos, n);
+        me->readPos += n;
+        return n;
+    }
+
+    static uint64_t now(void* usr) { return 0; }
+};
+
+class GenericSerialTest : public CxxTest::TestSuite
+{
+    static zcm_trans_t* makeSerial(Loopback& lb, size_t mtu, size_t bufSize)
+    {
+        return zcm_trans_generic_serial_create(&Loopback::get, &Loopback::put, &lb,
+                                               &Loopback::now, NULL, mtu, bufSize);
+    }
+
+  public:
+    void setUp() override {}
+    void tearDown() override {}
+
+    void testWireFormat()
+    {
+        Loopback lb;
+        zcm_trans_t* zt = makeSerial(lb, 100, 1000);
+        TS_ASSERT(zt);
+        if (!zt) return;
+
+        uint8_t data[] = { 0xcc, 0x01, 0x02, 0xff, 0xcc };
+        zcm_msg_t msg = { 0, "A\xcc", sizeof(data), data };
+        TS_ASSERT_EQUALS(zcm_trans_sendmsg(zt, msg), ZCM_EOK);
+        serial_update_tx(zt);
+
+        // escape chars doubled, followed by the fletcher checksum of the unescaped bytes
+        const uint8_t expected[] = { 0xcc, 0x00, 0x02, 0x00, 0x00, 0x00, 0x05,
+                                     0x41, 0xcc, 0xcc,
+                                     0xcc, 0xcc, 0x01, 0x02, 0xff, 0xcc, 0xcc,
+                                     0x6c, 0xaa };
+        TS_ASSERT_EQUALS(lb.wire, vector<uint8_t>(expected, expected + sizeof(expected)));
+
+        zcm_trans_generic_serial_destroy(zt);
+    }
+
+    void testRoundTripsInPieces()
+    {
+        Loopback lb;
+        lb.chunk = 37;
+        zcm_trans_t* zt = makeSerial(lb, 1 << 12, 1 << 14);
+        TS_ASSERT(zt);
+        if (!zt) return;
+
+        // messages from no escape chars at all to nothing else
+        vector<vector<uint8_t>> sent;
+        for (int density = 0; density <= 4; density++) {
+            vector<uint8_t> data(1000 + rand() % 3000);
+            for (auto& b : data)
+                b = rand() % 4 < density ? 0xcc : rand() % 0xcc;
+            sent.push_back(data);
+        }
+
+        vector<vector<uint8_t>> received;
+        for (auto& data : sent) {
+            zcm_msg_t msg = { 0, "SERIAL", data.size(), data.data() };
+            TS_ASSERT_EQUALS(zcm_trans_sendmsg(zt, msg), ZCM_EOK);
+            serial_update_tx(zt);
+
+            // a frame cut short by garbage is skipped
+            if (received.empty()) {
+                const uint8_t junk[] = { 0xcc, 0x00, 0x01, 0x00, 0x00, 0x00, 0x04, 'J', 0xcc, 0x01 };
+                Loopback::put(junk, sizeof(junk), &lb);
+            }
+
+            while (lb.readPos < lb.wire.size()) {
+                serial_update_rx(zt);
+                zcm_msg_t rmsg;
+                while (zcm_trans_recvmsg(zt, &rmsg, 0) == ZCM_EOK) {
+                    TS_ASSERT_EQUALS(string(rmsg.channel), "SERIAL");
+                    received.emplace_back(rmsg.buf, rmsg.buf + rmsg.len);
+                }
+            }
+        }
+        TS_ASSERT(received == sent);
+
+        zcm_trans_generic_serial_destroy(zt);
+    }
+
+    void testDoesNotPushFramesThatDontFit()
+    {
+        Loopback lb;
+        zcm_trans_t* zt = makeSerial(lb, 100, 120);
+        TS_ASSERT(zt);
+        if (!zt) return;
+
+        // fits the buffer before escaping, but not after
+        vector<uint8_t> escapes(60, 0xcc);
+        zcm_msg_t msg = { 0, "E", escapes.size(), escapes.data() };
+        TS_ASSERT_EQUALS(zcm_trans_sendmsg(zt, msg), ZCM_EAGAIN);
+
+        // ... and nothing of it is left behind
+        vector<uint8_t> plain(100, 0x01);
+        msg = { 0, "P", plain.size(), plain.data() };
+        TS_ASSERT_EQUALS(zcm_trans_sendmsg(zt, msg), ZCM_EOK);
+        serial_update_tx(zt);
+        TS_ASSERT_EQUALS(lb.wire.size(), 9u + 1 + 100);
+
+        zcm_trans_generic_serial_destroy(zt);
+    }
+};
+
+#endif /* GENERICSERIALTEST_HPP */
@@ -5,6 +5,11 @@
 #include "zcm/eventlog.h"
 #include "cxxtest/TestSuite.h"
 
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
 using namespace std;
 
 class LogTest : public CxxTest::TestSuite
@@ -94,6 +99,418 @@ class LogTest : public CxxTest::TestSuite
         int ret = system("rm testlog.log");
         (void) ret;
     }
+
+    void testMappedViews() {
+        std::string testChannel = "chan";
+        std::vector<uint8_t> testData(5000);
+        zcm_eventlog_event_t event;
+        event.timestamp  = 1;
+        event.channellen = testChannel.length();
+        event.channel    = (char*) testChannel.c_str();
+        event.datalen    = testData.size();
+        event.data       = testData.data();
+
+        zcm_eventlog_t *w = zcm_eventlog_create("testlog_mapped.log", "w");
+        TSM_ASSERT("Failed to open log for writing", w);
+        for (size_t i = 0; i < 100; ++i) {
+            testData[i] = i;
+            TS_ASSERT_EQUALS(zcm_eventlog_write_event(w, &event), 0);
+            event.timestamp++;
+        }
+        fflush(zcm_eventlog_get_fileptr(w));
+
+        zcm_eventlog_t *l = zcm_eventlog_create("testlog_mapped.log", "r");
+        TSM_ASSERT("Failed to read in log", l);
+        TSM_ASSERT_EQUALS("Failed to map log", zcm_eventlog_map(l), 0);
+
+        zcm_eventlog_event_t view;
+        off_t tenth = 0;
+        for (int64_t i = 0; i < 100; ++i) {
+            if (i == 10) tenth = zcm_eventlog_tell(l);
+            TS_ASSERT_EQUALS(zcm_eventlog_read_next_event_view(l, &view), 0);
+            TS_ASSERT_EQUALS(view.eventnum, i);
+            TS_ASSERT_EQUALS(view.timestamp, i + 1);
+            TS_ASSERT_EQUALS(std::string(view.channel, view.channellen), testChannel);
+            TS_ASSERT_EQUALS(view.datalen, (int32_t) testData.size());
+            TS_ASSERT_EQUALS(view.data[i], i);
+        }
+
+        // The view points into the mapping rather than a copy
+        TS_ASSERT_EQUALS(zcm_eventlog_read_prev_event_view(l, &view), 0);
+        TS_ASSERT_EQUALS(view.eventnum, 99);
+        TS_ASSERT_EQUALS((const uint8_t*) view.channel,
+                         l->map + zcm_eventlog_tell(l) + 4 + 24);
+
+        // Positions move between the mapping and the FILE* and back
+        fseeko(zcm_eventlog_get_fileptr(l), tenth, SEEK_SET);
+        TS_ASSERT_EQUALS(zcm_eventlog_read_next_event_view(l, &view), 0);
+        TS_ASSERT_EQUALS(view.eventnum, 10);
+        TS_ASSERT_EQUALS(ftello(zcm_eventlog_get_fileptr(l)), zcm_eventlog_tell(l));
+        zcm_eventlog_event_t *le = zcm_eventlog_read_next_event(l);
+        TS_ASSERT(le);
+        TS_ASSERT_EQUALS(le->eventnum, 11);
+        TS_ASSERT_EQUALS(le->channel[le->channellen], '\0');
+        zcm_eventlog_free_event(le);
+        TS_ASSERT_EQUALS(zcm_eventlog_read_event_at_offset_view(l, tenth + 1, &view), 0);
+        TS_ASSERT_EQUALS(view.eventnum, 11);
+
+        // Events written after the log was mapped are still read
+        TS_ASSERT_EQUALS(zcm_eventlog_seek(l, tenth), 0);
+        for (int64_t i = 10; i < 100; ++i)
+            TS_ASSERT_EQUALS(zcm_eventlog_read_next_event_view(l, &view), 0);
+        TS_ASSERT_DIFFERS(zcm_eventlog_read_next_event_view(l, &view), 0);
+        TS_ASSERT_EQUALS(zcm_eventlog_write_event(w, &event), 0);
+        zcm_eventlog_destroy(w);
+        TS_ASSERT_EQUALS(zcm_eventlog_read_next_event_view(l, &view), 0);
+        TS_ASSERT_EQUALS(view.eventnum, 100);
+        TS_ASSERT_DIFFERS(zcm_eventlog_read_next_event_view(l, &view), 0);
+
+        zcm_eventlog_destroy(l);
+
+        int ret = system("rm testlog_mapped.log");
+        (void) ret;
+    }
+
+    void testMappedViewsOfPaddedLog() {
+        std::string testChannel = "chan";
+        std::vector<uint8_t> testData(100, 7);
+        zcm_eventlog_event_t event;
+        event.timestamp  = 1;
+        event.channellen = testChannel.length();
+        event.channel    = (char*) testChannel.c_str();
+        event.datalen    = testData.size();
+        event.data       = testData.data();
+
+        zcm_eventlog_t *w = zcm_eventlog_create("testlog_padded.log", "w");
+        TSM_ASSERT("Failed to open log for writing", w);
+        for (size_t i = 0; i < 3; ++i)
+            TS_ASSERT_EQUALS(zcm_eventlog_write_event(w, &event), 0);
+        // Zeros after the last event, as an O_DIRECT writer leaves them mid-write
+        std::vector<char> zeros(4096 - 3 * (4 + 24 + 4 + 100), 0);
+        fwrite(zeros.data(), 1, zeros.size(), zcm_eventlog_get_fileptr(w));
+        zcm_eventlog_destroy(w);
+
+        zcm_eventlog_t *l = zcm_eventlog_create("testlog_padded.log", "r");
+        TSM_ASSERT("Failed to read in log", l);
+        TSM_ASSERT_EQUALS("Failed to map log", zcm_eventlog_map(l), 0);
+
+        zcm_eventlog_event_t view;
+        for (int64_t i = 0; i < 3; ++i) {
+            TS_ASSERT_EQUALS(zcm_eventlog_read_next_event_view(l, &view), 0);
+            TS_ASSERT_EQUALS(view.eventnum, i);
+            // Views may be patched in place without touching the file
+            view.data[0] = 42;
+        }
+        TS_ASSERT_DIFFERS(zcm_eventlog_read_next_event_view(l, &view), 0);
+        zcm_eventlog_destroy(l);
+
+        l = zcm_eventlog_create("testlog_padded.log", "r");
+        TSM_ASSERT("Failed to read in log", l);
+        for (int64_t i = 0; i < 3; ++i) {
+            zcm_eventlog_event_t *le = zcm_eventlog_read_next_event(l);
+            TS_ASSERT(le);
+            if (!le) break;
+            TS_ASSERT_EQUALS(le->data[0], 7);
+            zcm_eventlog_free_event(le);
+        }
+        zcm_eventlog_destroy(l);
+
+        int ret = system("rm testlog_padded.log");
+        (void) ret;
+    }
+
+    static std::string slurp(const std::string& path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    void testSeekIndex() {
+        const char* channels[] = { "FAST", "SLOW", "RARE" };
+        std::vector<int64_t> timestamps;
+        std::vector<int> chans;
+
+        zcm_eventlog_t *w = zcm_eventlog_create("testlog_index.log", "w");
+        TSM_ASSERT("Failed to open log for writing", w);
+        TS_ASSERT_EQUALS(zcm_eventlog_write_index(w, "testlog_index.log.idx", 8), 0);
+
+        // Timestamps that mostly increase but jump back now and then
+        uint8_t data[16] = {};
+        for (int i = 0; i < 1000; ++i) {
+            int chan = i % 100 == 50 ? 2 : i % 7 == 0 ? 1 : 0;
+            zcm_eventlog_event_t event;
+            event.timestamp  = i * 10 - (i % 37 == 0 ? 500 : 0);
+            event.channellen = strlen(channels[chan]);
+            event.channel    = (char*) channels[chan];
+            event.datalen    = 1 + i % sizeof(data);
+            event.data       = data;
+            TS_ASSERT_EQUALS(zcm_eventlog_write_event(w, &event), 0);
+            timestamps.push_back(event.timestamp);
+            chans.push_back(chan);
+        }
+        zcm_eventlog_destroy(w);
+
+        for (int mapped = 0; mapped < 2; ++mapped) {
+            zcm_eventlog_t *l = zcm_eventlog_create("testlog_index.log", "r");
+            if (mapped) TS_ASSERT_EQUALS(zcm_eventlog_map(l), 0);
+            TS_ASSERT_EQUALS(zcm_eventlog_load_index(l, "testlog_index.log.idx"), 0);
+
+            zcm_eventlog_event_t view;
+            for (int64_t t = -600; t < 10100; t += 7) {
+                for (int chan = -1; chan < 3; ++chan) {
+                    int expected = -1;
+                    for (size_t i = 0; i < timestamps.size() && expected < 0; ++i)
+                        if (timestamps[i] >= t && (chan < 0 || chans[i] == chan))
+                            expected = i;
+
+                    int ret = chan < 0 ? zcm_eventlog_seek_to_timestamp(l, t) :
+                                         zcm_eventlog_seek_to_channel(l, channels[chan], t);
+                    TS_ASSERT_EQUALS(ret, expected < 0 ? -1 : 0);
+                    if (expected < 0) continue;
+                    TS_ASSERT_EQUALS(zcm_eventlog_read_next_event_view(l, &view), 0);
+                    TS_ASSERT_EQUALS(view.eventnum, expected);
+                }
+            }
+
+            for (int64_t n = 0; n < 1000; n += 13) {
+                TS_ASSERT_EQUALS(zcm_eventlog_seek_to_eventnum(l, n), 0);
+                TS_ASSERT_EQUALS(zcm_eventlog_read_next_event_view(l, &view), 0);
+                TS_ASSERT_EQUALS(view.eventnum, n);
+            }
+            TS_ASSERT_EQUALS(zcm_eventlog_seek_to_eventnum(l, 1000), -1);
+            TS_ASSERT_EQUALS(zcm_eventlog_seek_to_channel(l, "NONE", 0), -1);
+
+            // An index built afterwards is the same as the one written with the log
+            TS_ASSERT_EQUALS(zcm_eventlog_build_index(l, "testlog_built.log.idx", 8), 0);
+            TS_ASSERT_EQUALS(slurp("testlog_built.log.idx"), slurp("testlog_index.log.idx"));
+
+            zcm_eventlog_destroy(l);
+        }
+
+        // An index for another log is rejected
+        zcm_eventlog_t *other = zcm_eventlog_create("testlog_other.log", "w");
+        zcm_eventlog_event_t event = { 0, 5, 4, 1, (char*) "RARE", data };
+        TS_ASSERT_EQUALS(zcm_eventlog_write_event(other, &event), 0);
+        zcm_eventlog_destroy(other);
+        other = zcm_eventlog_create("testlog_other.log", "r");
+        TS_ASSERT_EQUALS(zcm_eventlog_load_index(other, "testlog_index.log.idx"), -1);
+        zcm_eventlog_destroy(other);
+
+        int ret = system("rm testlog_index.log testlog_index.log.idx testlog_built.log.idx "
+                         "testlog_other.log");
+        (void) ret;
+    }
+
+    void testAsyncWrite() {
+        for (int backend = 0; backend < 4; ++backend) {
+            zcm_eventlog_async_opts_t opts;
+            memset(&opts, 0, sizeof(opts));
+            opts.buffer_size = 8192;
+            opts.num_buffers = 3;
+            opts.num_threads = 2;
+            opts.no_io_uring = backend & 1;
+            opts.direct      = backend & 2;
+            opts.sync_bytes  = 32768;
+
+            zcm_eventlog_t *w = zcm_eventlog_create("testlog_async.log", "w");
+            TSM_ASSERT("Failed to open log for writing", w);
+            TS_ASSERT_EQUALS(zcm_eventlog_write_index(w, "testlog_async.log.idx", 16), 0);
+            TS_ASSERT_EQUALS(zcm_eventlog_write_async(w, &opts), 0);
+
+            // Events smaller and larger than the buffers, flushed at odd sizes
+            std::vector<std::vector<uint8_t>> sent;
+            size_t expectedSize = 0;
+            for (int i = 0; i < 500; ++i) {
+                std::vector<uint8_t> data(rand() % (i % 50 == 0 ? 30000 : 300));
+                for (auto& b : data) b = rand();
+                zcm_eventlog_event_t event;
+                event.timestamp  = i;
+                event.channellen = 5;
+                event.channel    = (char*) "ASYNC";
+                event.datalen    = data.size();
+                event.data       = data.data();
+                TS_ASSERT_EQUALS(zcm_eventlog_write_event(w, &event), 0);
+                expectedSize += 4 + 24 + 5 + data.size();
+                sent.push_back(std::move(data));
+                if (i % 97 == 0) TS_ASSERT_EQUALS(zcm_eventlog_flush(w, i % 2), 0);
+            }
+            zcm_eventlog_destroy(w);
+
+            zcm_eventlog_t *l = zcm_eventlog_create("testlog_async.log", "r");
+            TS_ASSERT_EQUALS(zcm_eventlog_map(l), 0);
+            TSM_ASSERT_EQUALS("O_DIRECT padding left in the log", l->maplen, expectedSize);
+            zcm_eventlog_event_t view;
+            for (size_t i = 0; i < sent.size(); ++i) {
+                TS_ASSERT_EQUALS(zcm_eventlog_read_next_event_view(l, &view), 0);
+                TS_ASSERT_EQUALS(view.eventnum, (int64_t) i);
+                TS_ASSERT(std::vector<uint8_t>(view.data, view.data + view.datalen) == sent[i]);
+            }
+            TS_ASSERT_DIFFERS(zcm_eventlog_read_next_event_view(l, &view), 0);
+
+            TS_ASSERT_EQUALS(zcm_eventlog_load_index(l, "testlog_async.log.idx"), 0);
+            TS_ASSERT_EQUALS(zcm_eventlog_seek_to_timestamp(l, 321), 0);
+            TS_ASSERT_EQUALS(zcm_eventlog_read_next_event_view(l, &view), 0);
+            TS_ASSERT_EQUALS(view.eventnum, 321);
+            zcm_eventlog_destroy(l);
+        }
+
+        int ret = system("rm testlog_async.log testlog_async.log.idx");
+        (void) ret;
+    }
+
+    void testAsyncWriteAppend() {
+        zcm_eventlog_async_opts_t opts;
+        memset(&opts, 0, sizeof(opts));
+        opts.direct = 1;
+
+        // Opened for appending, as zcm-logger does with --rotate, and twice so the
+        // second writer starts part way into a block
+        std::vector<std::vector<uint8_t>> sent;
+        for (int pass = 0; pass < 2; ++pass) {
+            zcm_eventlog_t *w = zcm_eventlog_create("testlog_append.log", "a");
+            TSM_ASSERT("Failed to open log for appending", w);
+            TS_ASSERT_EQUALS(zcm_eventlog_write_async(w, &opts), 0);
+            for (int i = 0; i < 20; ++i) {
+                std::vector<uint8_t> data(100 + rand() % 100);
+                for (auto& b : data) b = rand();
+                zcm_eventlog_event_t event;
+                event.timestamp  = sent.size();
+                event.channellen = 6;
+                event.channel    = (char*) "APPEND";
+                event.datalen    = data.size();
+                event.data       = data.data();
+                TS_ASSERT_EQUALS(zcm_eventlog_write_event(w, &event), 0);
+                TS_ASSERT_EQUALS(zcm_eventlog_flush(w, false), 0);
+                sent.push_back(std::move(data));
+            }
+            zcm_eventlog_destroy(w);
+        }
+
+        zcm_eventlog_t *l = zcm_eventlog_create("testlog_append.log", "r");
+        zcm_eventlog_event_t *le;
+        size_t nread = 0;
+        while ((le = zcm_eventlog_read_next_event(l)) != NULL) {
+            TS_ASSERT(nread < sent.size());
+            if (nread < sent.size())
+                TS_ASSERT(std::vector<uint8_t>(le->data, le->data + le->datalen) == sent[nread]);
+            zcm_eventlog_free_event(le);
+            nread++;
+        }
+        TS_ASSERT_EQUALS(nread, sent.size());
+        zcm_eventlog_destroy(l);
+
+        int ret = system("rm testlog_append.log");
+        (void) ret;
+    }
+
+    void testCompressedBlocks() {
+        const char* channels[] = { "POSE", "IMAGE" };
+        std::vector<std::vector<uint8_t>> sent;
+        std::vector<int64_t> timestamps;
+        std::vector<int> chans;
+
+        // The same events in a plain log and in an indexed, block compressed one
+        zcm_eventlog_t *plain = zcm_eventlog_create("testlog_plain.log", "w");
+        zcm_eventlog_t *w = zcm_eventlog_create("testlog_blocks.log", "w");
+        TSM_ASSERT("Failed to open log for writing", plain && w);
+        TS_ASSERT_EQUALS(zcm_eventlog_write_compressed(w, "nope", 0), -1);
+        TS_ASSERT_EQUALS(zcm_eventlog_write_compressed(w, "lz4", 4096), 0);
+        TS_ASSERT_EQUALS(zcm_eventlog_write_index(w, "testlog_blocks.log.idx", 16), 0);
+
+        for (int i = 0; i < 600; ++i) {
+            // Compressible data, now and then bigger than a block
+            int chan = i % 10 == 0 ? 1 : 0;
+            std::vector<uint8_t> data(chan ? 100 + (i * 97) % 9000 : 40);
+            for (size_t j = 0; j < data.size(); ++j) data[j] = (j / 16 + i) % 7;
+            zcm_eventlog_event_t event;
+            event.timestamp  = i * 10 - (i % 37 == 0 ? 500 : 0);
+            event.channellen = strlen(channels[chan]);
+            event.channel    = (char*) channels[chan];
+            event.datalen    = data.size();
+            event.data       = data.data();
+            TS_ASSERT_EQUALS(zcm_eventlog_write_event(plain, &event), 0);
+            TS_ASSERT_EQUALS(zcm_eventlog_write_event(w, &event), 0);
+            if (i == 100) TS_ASSERT_EQUALS(zcm_eventlog_flush(w, 0), 0);
+            sent.push_back(std::move(data));
+            timestamps.push_back(event.timestamp);
+            chans.push_back(chan);
+        }
+        zcm_eventlog_destroy(plain);
+        zcm_eventlog_destroy(w);
+
+        std::string blocks = slurp("testlog_blocks.log");
+        TS_ASSERT_LESS_THAN(blocks.size() * 4, slurp("testlog_plain.log").size());
+        TS_ASSERT(zcm_eventlog_create("testlog_blocks.log", "a") == nullptr);
+
+        // Events are where they are in the plain log, whichever way they are read
+        zcm_eventlog_t *p = zcm_eventlog_create("testlog_plain.log", "r");
+        zcm_eventlog_t *l = zcm_eventlog_create("testlog_blocks.log", "r");
+        TSM_ASSERT("Failed to open block compressed log", l);
+        TS_ASSERT_EQUALS(zcm_eventlog_length(l), zcm_eventlog_length(p));
+        zcm_eventlog_event_t view, pview;
+        for (size_t i = 0; i < sent.size(); ++i) {
+            TS_ASSERT_EQUALS(zcm_eventlog_tell(l), zcm_eventlog_tell(p));
+            TS_ASSERT_EQUALS(zcm_eventlog_read_next_event_view(p, &pview), 0);
+            TS_ASSERT_EQUALS(zcm_eventlog_read_next_event_view(l, &view), 0);
+            TS_ASSERT_EQUALS(view.eventnum, (int64_t) i);
+            TS_ASSERT_EQUALS(view.timestamp, timestamps[i]);
+            TS_ASSERT_EQUALS(std::string(view.channel, view.channellen), channels[chans[i]]);
+            TS_ASSERT(std::vector<uint8_t>(view.data, view.data + view.datalen) == sent[i]);
+        }
+        TS_ASSERT_DIFFERS(zcm_eventlog_read_next_event_view(l, &view), 0);
+        for (size_t i = sent.size(); i-- > 0;) {
+            zcm_eventlog_event_t *le = zcm_eventlog_read_prev_event(l);
+            TS_ASSERT(le);
+            if (!le) break;
+            TS_ASSERT_EQUALS(le->eventnum, (int64_t) i);
+            zcm_eventlog_free_event(le);
+        }
+        TS_ASSERT(zcm_eventlog_read_prev_event(l) == nullptr);
+        zcm_eventlog_destroy(p);
+
+        // Seeks are exact through the blocks' own index as well as the sidecar one
+        for (int indexed = 0; indexed < 2; ++indexed) {
+            if (indexed)
+                TS_ASSERT_EQUALS(zcm_eventlog_load_index(l, "testlog_blocks.log.idx"), 0);
+            for (int64_t t = -600; t < 6100; t += 11) {
+                for (int chan = -1; chan < 2; ++chan) {
+                    int expected = -1;
+                    for (size_t i = 0; i < timestamps.size() && expected < 0; ++i)
+                        if (timestamps[i] >= t && (chan < 0 || chans[i] == chan))
+                            expected = i;
+
+                    int ret = chan < 0 ? zcm_eventlog_seek_to_timestamp(l, t) :
+                                         zcm_eventlog_seek_to_channel(l, channels[chan], t);
+                    TS_ASSERT_EQUALS(ret, expected < 0 ? -1 : 0);
+                    if (expected < 0) continue;
+                    TS_ASSERT_EQUALS(zcm_eventlog_read_next_event_view(l, &view), 0);
+                    TS_ASSERT_EQUALS(view.eventnum, expected);
+                }
+            }
+            for (int64_t n = 0; n < 600; n += 13) {
+                TS_ASSERT_EQUALS(zcm_eventlog_seek_to_eventnum(l, n), 0);
+                TS_ASSERT_EQUALS(zcm_eventlog_read_next_event_view(l, &view), 0);
+                TS_ASSERT_EQUALS(view.eventnum, n);
+            }
+        }
+        zcm_eventlog_destroy(l);
+
+        // A log that was never finished is read up to its last whole block
+        std::ofstream("testlog_cut.log", std::ios::binary) << blocks.substr(0, blocks.size() / 2);
+        l = zcm_eventlog_create("testlog_cut.log", "r");
+        TSM_ASSERT("Failed to open unfinished block compressed log", l);
+        int64_t n = 0;
+        while (zcm_eventlog_read_next_event_view(l, &view) == 0)
+            TS_ASSERT_EQUALS(view.eventnum, n++);
+        TS_ASSERT(n > 0 && n < (int64_t) sent.size());
+        TS_ASSERT_EQUALS(zcm_eventlog_seek_to_eventnum(l, n - 1), 0);
+        TS_ASSERT_EQUALS(zcm_eventlog_seek_to_eventnum(l, n), -1);
+        zcm_eventlog_destroy(l);
+
+        int ret = system("rm testlog_plain.log testlog_blocks.log testlog_blocks.log.idx "
+                         "testlog_cut.log");
+        (void) ret;
+    }
 };
 
 #endif
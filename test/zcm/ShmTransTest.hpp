@@ -0,0 +1,208 @@
+#ifndef SHMTRANSTEST_HPP
+#define SHMTRANSTEST_HPP
+
+#include "zcm/zcm.h"
+#include "zcm/transport_registrar.h"
+#include "cxxtest/TestSuite.h"
+#include "TransUtil.hpp"
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+class ShmTransTest : public CxxTest::TestSuite
+{
+    string name;
+
+    zcm_trans_t* makeShm(const string& opts = "")
+    {
+        return makeTrans("shm://" + name + opts);
+    }
+
+    static int send(zcm_trans_t* zt, const char* channel, vector<uint8_t>& data)
+    {
+        zcm_msg_t msg;
+        msg.utime = 1234;
+        msg.channel = channel;
+        msg.len = data.size();
+        msg.buf = data.data();
+        return zcm_trans_sendmsg(zt, msg);
+    }
+
+  public:
+    void setUp() override
+    {
+        name = "test-" + to_string(getpid());
+    }
+
+    void tearDown() override
+    {
+        unlink(("/dev/shm/zcm-shm-" + name).c_str());
+    }
+
+    void testRoundTrip()
+    {
+        zcm_trans_t* pub = makeShm();
+        zcm_trans_t* sub = makeShm();
+        TS_ASSERT(pub && sub);
+        if (!pub || !sub) return;
+
+        zcm_msg_t msg;
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg_enable(sub, NULL, true), ZCM_EOK);
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(sub, &msg, 0), ZCM_EAGAIN);
+
+        vector<uint8_t> data(1000);
+        for (size_t i = 0; i < data.size(); ++i) data[i] = i;
+        TS_ASSERT_EQUALS(send(pub, "SHM", data), ZCM_EOK);
+
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(sub, &msg, 100), ZCM_EOK);
+        TS_ASSERT_EQUALS(string(msg.channel), "SHM");
+        TS_ASSERT_EQUALS(msg.utime, 1234u);
+        TS_ASSERT_EQUALS(msg.len, data.size());
+        TS_ASSERT(memcmp(msg.buf, data.data(), data.size()) == 0);
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(sub, &msg, 0), ZCM_EAGAIN);
+
+        // Nothing past the mtu gets in
+        vector<uint8_t> big(zcm_trans_get_mtu(pub) + 1);
+        TS_ASSERT_EQUALS(send(pub, "SHM", big), ZCM_EINVALID);
+
+        zcm_trans_destroy(sub);
+        zcm_trans_destroy(pub);
+    }
+
+    void testChannelFiltering()
+    {
+        zcm_trans_t* pub = makeShm();
+        zcm_trans_t* sub = makeShm();
+        TS_ASSERT(pub && sub);
+        if (!pub || !sub) return;
+
+        zcm_trans_recvmsg_enable(sub, "A", true);
+        vector<uint8_t> data(10, 'x');
+        send(pub, "A", data);
+        send(pub, "B", data);
+        send(pub, "A", data);
+
+        zcm_msg_t msg;
+        int received = 0;
+        while (zcm_trans_recvmsg(sub, &msg, 0) == ZCM_EOK) {
+            TS_ASSERT_EQUALS(string(msg.channel), "A");
+            received++;
+        }
+        TS_ASSERT_EQUALS(received, 2);
+
+        // Disabling every channel leaves the explicit ones alone
+        zcm_trans_recvmsg_enable(sub, NULL, true);
+        zcm_trans_recvmsg_enable(sub, NULL, false);
+        send(pub, "B", data);
+        send(pub, "A", data);
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(sub, &msg, 0), ZCM_EOK);
+        TS_ASSERT_EQUALS(string(msg.channel), "A");
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(sub, &msg, 0), ZCM_EAGAIN);
+
+        zcm_trans_destroy(sub);
+        zcm_trans_destroy(pub);
+    }
+
+    void testSlowReaderIsLapped()
+    {
+        zcm_trans_t* pub = makeShm("?size=65536");
+        zcm_trans_t* sub = makeShm();
+        TS_ASSERT(pub && sub);
+        if (!pub || !sub) return;
+        zcm_trans_recvmsg_enable(sub, NULL, true);
+
+        // Publish several times the ring's size before the reader looks
+        const int NUM = 100;
+        vector<uint8_t> data(4000);
+        for (int i = 0; i < NUM; ++i) {
+            memset(data.data(), i, data.size());
+            TS_ASSERT_EQUALS(send(pub, "LAP", data), ZCM_EOK);
+        }
+
+        zcm_msg_t msg;
+        int received = 0;
+        int last = -1;
+        while (zcm_trans_recvmsg(sub, &msg, 0) == ZCM_EOK) {
+            TS_ASSERT_EQUALS(msg.len, data.size());
+            int id = msg.buf[0];
+            TS_ASSERT(id > last);
+            for (size_t i = 0; i < msg.len; ++i)
+                if (msg.buf[i] != id) { TS_FAIL("torn message"); break; }
+            last = id;
+            received++;
+        }
+        TS_ASSERT(received > 0);
+        TS_ASSERT(received < NUM);
+        TS_ASSERT_EQUALS(last, NUM - 1);
+
+        zcm_trans_destroy(sub);
+        zcm_trans_destroy(pub);
+    }
+
+    void testPublisherDyingMidWrite()
+    {
+        zcm_trans_t* pub = makeShm("?size=65536");
+        zcm_trans_t* sub = makeShm();
+        TS_ASSERT(pub && sub);
+        if (!pub || !sub) return;
+        zcm_trans_recvmsg_enable(sub, NULL, true);
+
+        vector<uint8_t> data(8000);
+        for (int i = 0; i < 7; ++i) {
+            memset(data.data(), i, data.size());
+            TS_ASSERT_EQUALS(send(pub, "OLD", data), ZCM_EOK);
+        }
+
+        // The child wraps over the reader's oldest records and dies copying a
+        // payload that runs into an unmapped page, still holding the write lock
+        pid_t pid = fork();
+        if (pid == 0) {
+            long page = sysconf(_SC_PAGESIZE);
+            uint8_t *buf = (uint8_t*) mmap(NULL, 2 * page, PROT_READ | PROT_WRITE,
+                                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            munmap(buf + page, page);
+            zcm_msg_t msg;
+            msg.utime = 0;
+            msg.channel = "DEAD";
+            msg.len = 16000;
+            msg.buf = buf;
+            zcm_trans_sendmsg(pub, msg);
+            _exit(0);
+        }
+        int status;
+        waitpid(pid, &status, 0);
+        TS_ASSERT(WIFSIGNALED(status));
+
+        // The next publisher recovers the lock; the reader must neither stall nor
+        // mistake what the child half-wrote for a message
+        vector<uint8_t> after(10, 'a');
+        TS_ASSERT_EQUALS(send(pub, "AFTER", after), ZCM_EOK);
+
+        zcm_msg_t msg;
+        int received = 0;
+        string last;
+        while (zcm_trans_recvmsg(sub, &msg, 0) == ZCM_EOK) {
+            last = msg.channel;
+            TS_ASSERT_DIFFERS(last, "DEAD");
+            if (last == "OLD") {
+                TS_ASSERT_EQUALS(msg.len, data.size());
+                for (size_t i = 1; i < msg.len; ++i)
+                    if (msg.buf[i] != msg.buf[0]) { TS_FAIL("torn message"); break; }
+            }
+            received++;
+        }
+        TS_ASSERT(received > 1);
+        TS_ASSERT_EQUALS(last, "AFTER");
+
+        zcm_trans_destroy(sub);
+        zcm_trans_destroy(pub);
+    }
+};
+
+#endif /* SHMTRANSTEST_HPP */
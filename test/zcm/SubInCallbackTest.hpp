@@ -0,0 +1,132 @@
+#ifndef SUBINCALLBACKTEST_HPP
+#define SUBINCALLBACKTEST_HPP
+
+#include "zcm/zcm.h"
+#include "cxxtest/TestSuite.h"
+
+#include <atomic>
+#include <unistd.h>
+
+using namespace std;
+
+#define URL "block-inproc"
+
+struct SubInCallbackState
+{
+    zcm_t*     zcm;
+    zcm_sub_t* victim;
+    zcm_sub_t* added;
+    atomic<int> numOwner  {0};
+    atomic<int> numVictim {0};
+    atomic<int> numAdded  {0};
+};
+
+static void added_handler(const zcm_recv_buf_t* rbuf, const char* channel, void* usr)
+{
+    ((SubInCallbackState*) usr)->numAdded++;
+}
+
+static void victim_handler(const zcm_recv_buf_t* rbuf, const char* channel, void* usr)
+{
+    ((SubInCallbackState*) usr)->numVictim++;
+}
+
+// Unsubscribes the victim (which would otherwise be dispatched right after us for
+// this very message) and subscribes to a new channel
+static void owner_handler(const zcm_recv_buf_t* rbuf, const char* channel, void* usr)
+{
+    SubInCallbackState* s = (SubInCallbackState*) usr;
+    if (s->numOwner++ == 0) {
+        zcm_unsubscribe(s->zcm, s->victim);
+        s->added = zcm_subscribe(s->zcm, "BAR", added_handler, s);
+    }
+}
+
+static atomic<bool> slowInside {false};
+static atomic<int>  slowCalls  {0};
+static void slow_handler(const zcm_recv_buf_t* rbuf, const char* channel, void* usr)
+{
+    slowInside = true;
+    slowCalls++;
+    usleep(100000);
+    slowInside = false;
+}
+
+class SubInCallbackTest : public CxxTest::TestSuite
+{
+    template<class F>
+    static bool waitFor(F f)
+    {
+        for (int i = 0; i < 200; ++i) {
+            if (f()) return true;
+            usleep(10000);
+        }
+        return false;
+    }
+
+  public:
+    void setUp() override {}
+    void tearDown() override {}
+
+    void testSubscribeFromCallback()
+    {
+        SubInCallbackState s;
+        s.zcm = zcm_create(URL);
+        TS_ASSERT(s.zcm);
+        if (!s.zcm) return;
+
+        uint8_t data = 'a';
+        TS_ASSERT(zcm_subscribe(s.zcm, "FOO", owner_handler, &s));
+        s.victim = zcm_subscribe(s.zcm, "FOO", victim_handler, &s);
+        TS_ASSERT(s.victim);
+
+        zcm_start(s.zcm);
+
+        TS_ASSERT_EQUALS(zcm_publish(s.zcm, "FOO", &data, 1), ZCM_EOK);
+        TS_ASSERT(waitFor([&](){ return s.numOwner == 1; }));
+        TS_ASSERT(s.added);
+
+        TS_ASSERT_EQUALS(zcm_publish(s.zcm, "BAR", &data, 1), ZCM_EOK);
+        TS_ASSERT_EQUALS(zcm_publish(s.zcm, "FOO", &data, 1), ZCM_EOK);
+        TS_ASSERT(waitFor([&](){ return s.numOwner == 2 && s.numAdded == 1; }));
+
+        zcm_stop(s.zcm);
+
+        TS_ASSERT_EQUALS(s.numVictim, 0);
+        TS_ASSERT_EQUALS(s.numAdded, 1);
+        TS_ASSERT_EQUALS(s.numOwner, 2);
+
+        zcm_destroy(s.zcm);
+    }
+
+    void testUnsubscribeWaitsForCallback()
+    {
+        zcm_t* zcm = zcm_create(URL);
+        TS_ASSERT(zcm);
+        if (!zcm) return;
+
+        uint8_t data = 'a';
+        zcm_sub_t* sub = zcm_subscribe(zcm, "SLOW", slow_handler, NULL);
+        TS_ASSERT(sub);
+
+        zcm_start(zcm);
+
+        TS_ASSERT_EQUALS(zcm_publish(zcm, "SLOW", &data, 1), ZCM_EOK);
+        TS_ASSERT(waitFor([&](){ return slowInside.load(); }));
+
+        // Must not return while the callback is still running
+        TS_ASSERT_EQUALS(zcm_unsubscribe(zcm, sub), ZCM_EOK);
+        TS_ASSERT(!slowInside);
+
+        TS_ASSERT_EQUALS(zcm_publish(zcm, "SLOW", &data, 1), ZCM_EOK);
+        usleep(100000);
+        TS_ASSERT_EQUALS(slowCalls, 1);
+
+        zcm_stop(zcm);
+        zcm_destroy(zcm);
+    }
+};
+
+#undef URL
+
+#endif /* SUBINCALLBACKTEST_HPP */
@@ -0,0 +1,58 @@
+#ifndef TRANSUTIL_HPP
+#define TRANSUTIL_HPP
+
+#include <cstring>
+#include <string>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "zcm/transport_registrar.h"
+
+// Helpers shared by the transport suites
+
+// Returns the transport for 'url', or NULL if it can't be created
+static inline zcm_trans_t* makeTrans(const std::string& url)
+{
+    zcm_url_t* u = zcm_url_create(url.c_str());
+    zcm_trans_create_func* creator = zcm_transport_find(zcm_url_protocol(u));
+    zcm_trans_t* zt = creator ? creator(u) : NULL;
+    zcm_url_destroy(u);
+    return zt;
+}
+
+// As makeTrans(), optionally subscribed to every channel
+static inline zcm_trans_t* makeUdpm(const std::string& url, bool enableAll = false)
+{
+    zcm_trans_t* zt = makeTrans(url);
+    if (zt && enableAll) zcm_trans_recvmsg_enable(zt, NULL, true);
+    return zt;
+}
+
+// Receives until nothing arrives for 50ms, returning how many messages did
+static inline int drain(zcm_trans_t* zt)
+{
+    int n = 0;
+    zcm_msg_t msg;
+    while (zcm_trans_recvmsg(zt, &msg, 50) == ZCM_EOK) n++;
+    return n;
+}
+
+// Sends a short udpm message with the given magic and seqno to ip:port from 'fd'
+static inline void sendRaw(int fd, const char* ip, uint16_t port,
+                           uint32_t magic, uint32_t seqno)
+{
+    char pkt[16];
+    uint32_t hdr[2] = { htonl(magic), htonl(seqno) };
+    memcpy(pkt, hdr, sizeof(hdr));
+    memcpy(pkt + sizeof(hdr), "RAW\0data", 8);
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_aton(ip, &addr.sin_addr);
+    sendto(fd, pkt, sizeof(pkt), 0, (struct sockaddr*)&addr, sizeof(addr));
+}
+
+#endif /* TRANSUTIL_HPP */
@@ -0,0 +1,52 @@
+#ifndef UDPMBUFSIZETEST_HPP
+#define UDPMBUFSIZETEST_HPP
+
+#include "zcm/zcm.h"
+#include "zcm/transport_registrar.h"
+#include "cxxtest/TestSuite.h"
+#include "TransUtil.hpp"
+
+#include <vector>
+
+using namespace std;
+
+#define URL "udpm://239.255.76.82:7672?ttl=0"
+
+class UdpmBufSizeTest : public CxxTest::TestSuite
+{
+  public:
+    void setUp() override {}
+    void tearDown() override {}
+
+    void testKernelBufferSizes()
+    {
+        // Small enough for any system limit, so there's no clamp warning
+        zcm_trans_t* zt = makeUdpm(URL "&recv_buf_size=200000&send_buf_size=100000");
+        TS_ASSERT(zt);
+        if (!zt) return;
+        zcm_trans_recvmsg_enable(zt, NULL, true);
+
+        vector<uint8_t> big(150000, 'x');
+        zcm_msg_t msg;
+        msg.utime = 0;
+        msg.channel = "SIZED";
+        msg.buf = big.data();
+        msg.len = big.size();
+        TS_ASSERT_EQUALS(zcm_trans_sendmsg(zt, msg), ZCM_EOK);
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(zt, &msg, 200), ZCM_EOK);
+        TS_ASSERT_EQUALS(msg.len, big.size());
+
+        zcm_trans_destroy(zt);
+    }
+
+    void testRejectsSizesTheKernelCantTake()
+    {
+        TS_ASSERT(!makeUdpm(URL "&recv_buf_size=3000000000"));
+        TS_ASSERT(!makeUdpm(URL "&send_buf_size=3000000000"));
+        TS_ASSERT(!makeUdpm(URL "&recv_buf_size=-1"));
+    }
+};
+
+#undef URL
+
+#endif /* UDPMBUFSIZETEST_HPP */
@@ -0,0 +1,91 @@
+#ifndef UDPMCOALESCETEST_HPP
+#define UDPMCOALESCETEST_HPP
+
+#include "zcm/zcm.h"
+#include "zcm/transport_registrar.h"
+#include "zcm/transport/udpm/udpm_stats.h"
+#include "cxxtest/TestSuite.h"
+#include "TransUtil.hpp"
+
+#include <vector>
+
+using namespace std;
+
+#define URL "udpm://239.255.76.85:7675?ttl=0"
+
+class UdpmCoalesceTest : public CxxTest::TestSuite
+{
+  public:
+    void setUp() override {}
+    void tearDown() override {}
+
+    void testCoalescesShortMessages()
+    {
+        zcm_trans_t* zt = makeUdpm(URL "&coalesce=true&coalesce_size=256"
+                                   "&coalesce_delay_us=1000000", true);
+        TS_ASSERT(zt);
+        if (!zt) return;
+
+        // 20 records of 11 bytes, which all fit in one batch
+        zcm_msg_t msg;
+        msg.utime = 0;
+        msg.channel = "TINY";
+        for (uint32_t i = 0; i < 20; i++) {
+            msg.buf = (uint8_t*)&i;
+            msg.len = sizeof(i);
+            TS_ASSERT_EQUALS(zcm_trans_sendmsg(zt, msg), ZCM_EOK);
+        }
+
+        // nothing leaves before the deadline, unless flushed
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(zt, &msg, 50), ZCM_EAGAIN);
+        TS_ASSERT_EQUALS(zcm_trans_flush(zt), ZCM_EOK);
+
+        // a message too big for a batch doesn't overtake the ones waiting
+        vector<uint8_t> big(1000, 'x');
+        uint32_t last = 20;
+        msg.buf = (uint8_t*)&last;
+        msg.len = sizeof(last);
+        zcm_trans_sendmsg(zt, msg);
+        msg.buf = big.data();
+        msg.len = big.size();
+        zcm_trans_sendmsg(zt, msg);
+
+        uint32_t expected = 0;
+        while (zcm_trans_recvmsg(zt, &msg, 50) == ZCM_EOK) {
+            if (expected <= 20) {
+                TS_ASSERT_EQUALS(msg.len, sizeof(uint32_t));
+                TS_ASSERT_EQUALS(*(uint32_t*)msg.buf, expected);
+            } else {
+                TS_ASSERT_EQUALS(msg.len, big.size());
+            }
+            expected++;
+        }
+        TS_ASSERT_EQUALS(expected, 22u);
+
+        zcm_udpm_stats_t stats;
+        TS_ASSERT_EQUALS(zcm_trans_udpm_get_stats(zt, &stats), ZCM_EOK);
+        TS_ASSERT_EQUALS(stats.coalesced_messages, 21u);
+        TS_ASSERT_EQUALS(stats.coalesced_packets, 2u);
+        TS_ASSERT_EQUALS(stats.packets, 3u);
+        TS_ASSERT_EQUALS(stats.messages, 22u);
+        TS_ASSERT_EQUALS(stats.seq_gaps, 0u);
+
+        zcm_trans_destroy(zt);
+
+        // a batch left alone goes out on its deadline
+        zt = makeUdpm(URL "&coalesce=true&coalesce_delay_us=20000", true);
+        TS_ASSERT(zt);
+        if (!zt) return;
+        msg.buf = (uint8_t*)&last;
+        msg.len = sizeof(last);
+        zcm_trans_sendmsg(zt, msg);
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(zt, &msg, 200), ZCM_EOK);
+        zcm_trans_destroy(zt);
+
+        TS_ASSERT(!makeUdpm(URL "&coalesce=true&coalesce_size=10"));
+    }
+};
+
+#undef URL
+
+#endif /* UDPMCOALESCETEST_HPP */
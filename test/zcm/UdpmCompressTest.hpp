@@ -0,0 +1,82 @@
+#ifndef UDPMCOMPRESSTEST_HPP
+#define UDPMCOMPRESSTEST_HPP
+
+#include "zcm/zcm.h"
+#include "zcm/transport_registrar.h"
+#include "zcm/transport/udpm/udpm_stats.h"
+#include "cxxtest/TestSuite.h"
+#include "TransUtil.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <unistd.h>
+#include <sys/socket.h>
+
+using namespace std;
+
+#define IP   "239.255.76.86"
+#define PORT 7676
+#define URL  "udpm://239.255.76.86:7676?ttl=0"
+
+class UdpmCompressTest : public CxxTest::TestSuite
+{
+  public:
+    void setUp() override {}
+    void tearDown() override {}
+
+    void testCompressesLargeMessages()
+    {
+        zcm_trans_t* zt = makeUdpm(URL "&compress=lz4&compress_threshold=1000", true);
+        TS_ASSERT(zt);
+        if (!zt) return;
+
+        // a grid that is mostly empty, something random, and something too small
+        vector<vector<uint8_t>> sent(3);
+        sent[0].assign(200000, 0);
+        for (size_t i = 0; i < sent[0].size(); i += 97) sent[0][i] = 100;
+        for (int i = 0; i < 5000; i++) sent[1].push_back(rand());
+        sent[2].assign(500, 0);
+
+        zcm_msg_t msg;
+        msg.utime = 0;
+        msg.channel = "GRID";
+        vector<vector<uint8_t>> received;
+        for (auto& data : sent) {
+            msg.buf = data.data();
+            msg.len = data.size();
+            TS_ASSERT_EQUALS(zcm_trans_sendmsg(zt, msg), ZCM_EOK);
+            while (zcm_trans_recvmsg(zt, &msg, 50) == ZCM_EOK)
+                received.emplace_back(msg.buf, msg.buf + msg.len);
+        }
+        TS_ASSERT(received == sent);
+
+        zcm_udpm_stats_t stats;
+        TS_ASSERT_EQUALS(zcm_trans_udpm_get_stats(zt, &stats), ZCM_EOK);
+        TS_ASSERT_EQUALS(stats.compressed_messages, 1u);
+        TS_ASSERT_EQUALS(stats.compressed_raw_bytes, 200000u);
+        TS_ASSERT(stats.compressed_bytes < 20000u);
+        // the grid fit in a single datagram
+        TS_ASSERT_EQUALS(stats.packets, 3u);
+
+        // a codec this receiver doesn't know
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        unsigned char ttl = 0;
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        sendRaw(fd, IP, PORT, 0x4c433032 | 0x80, 0);
+        TS_ASSERT_EQUALS(drain(zt), 0);
+        close(fd);
+        zcm_trans_udpm_get_stats(zt, &stats);
+        TS_ASSERT_EQUALS(stats.decompress_errors, 1u);
+
+        zcm_trans_destroy(zt);
+
+        TS_ASSERT(!makeUdpm(URL "&compress=snappy"));
+    }
+};
+
+#undef URL
+#undef PORT
+#undef IP
+
+#endif /* UDPMCOMPRESSTEST_HPP */
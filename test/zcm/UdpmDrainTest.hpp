@@ -0,0 +1,76 @@
+#ifndef UDPMDRAINTEST_HPP
+#define UDPMDRAINTEST_HPP
+
+#include "zcm/zcm.h"
+#include "zcm/transport_registrar.h"
+#include "zcm/transport/udpm/udpm_stats.h"
+#include "cxxtest/TestSuite.h"
+#include "TransUtil.hpp"
+
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace std;
+
+#define URL "udpm://239.255.76.84:7674?ttl=0"
+
+class UdpmDrainTest : public CxxTest::TestSuite
+{
+    // Sends 6 messages on 'channel' to a transport whose drain thread queues at most 4,
+    // and returns the payloads of the ones kept
+    static vector<uint8_t> overflowDrainQueue(const char* channel)
+    {
+        vector<uint8_t> kept;
+        zcm_trans_t* zt = makeUdpm(URL "&drain_thread=true&drain_queue=4"
+                                   "&drop_policy=newest,LATEST:oldest", true);
+        TS_ASSERT(zt);
+        if (!zt) return kept;
+
+        zcm_msg_t msg;
+        msg.utime = 0;
+        msg.channel = channel;
+        for (uint8_t i = 0; i < 6; i++) {
+            msg.buf = &i;
+            msg.len = 1;
+            zcm_trans_sendmsg(zt, msg);
+        }
+
+        // nobody calls recvmsg, but the drain thread keeps reading
+        zcm_udpm_stats_t stats;
+        for (int i = 0; i < 100; i++) {
+            zcm_trans_udpm_get_stats(zt, &stats);
+            if (stats.messages == 6) break;
+            usleep(10000);
+        }
+        zcm_trans_udpm_get_stats(zt, &stats);
+        TS_ASSERT_EQUALS(stats.drain_dropped, 2u);
+        TS_ASSERT_EQUALS(stats.drain_queued, 4u);
+        TS_ASSERT_EQUALS(stats.drain_queued_max, 4u);
+
+        zcm_udpm_drop_stats_t drops[2];
+        TS_ASSERT_EQUALS(zcm_trans_udpm_get_drop_stats(zt, drops, 2), 1);
+        TS_ASSERT_EQUALS(string(drops[0].channel), channel);
+        TS_ASSERT_EQUALS(drops[0].dropped, 2u);
+
+        while (zcm_trans_recvmsg(zt, &msg, 50) == ZCM_EOK)
+            kept.push_back(msg.buf[0]);
+        zcm_trans_destroy(zt);
+        return kept;
+    }
+
+  public:
+    void setUp() override {}
+    void tearDown() override {}
+
+    void testDrainThreadDropPolicies()
+    {
+        TS_ASSERT_EQUALS(overflowDrainQueue("FIRST"), vector<uint8_t>({0, 1, 2, 3}));
+        TS_ASSERT_EQUALS(overflowDrainQueue("LATEST"), vector<uint8_t>({2, 3, 4, 5}));
+        TS_ASSERT(!makeUdpm(URL "&drop_policy=sometimes"));
+    }
+};
+
+#undef URL
+
+#endif /* UDPMDRAINTEST_HPP */
@@ -0,0 +1,88 @@
+#ifndef UDPMGROUPSTEST_HPP
+#define UDPMGROUPSTEST_HPP
+
+#include "zcm/zcm.h"
+#include "zcm/transport_registrar.h"
+#include "zcm/transport/udpm/udpm_stats.h"
+#include "cxxtest/TestSuite.h"
+#include "TransUtil.hpp"
+
+#include <string>
+
+using namespace std;
+
+#define URL "udpm://239.255.76.80:7670?ttl=0&groups=4&group_map=CAM*:1,LIDAR:2"
+
+class UdpmGroupsTest : public CxxTest::TestSuite
+{
+    static void send(zcm_trans_t* zt, const char* channel)
+    {
+        uint8_t data[8] = {};
+        zcm_msg_t msg;
+        msg.utime = 0;
+        msg.channel = channel;
+        msg.len = sizeof(data);
+        msg.buf = data;
+        zcm_trans_sendmsg(zt, msg);
+    }
+
+    // Channels that the map sends to different groups (the rest hash anywhere)
+    static void sendAll(zcm_trans_t* zt)
+    {
+        send(zt, "CAM_FRONT");
+        send(zt, "CAM_REAR");
+        send(zt, "LIDAR");
+        send(zt, "LIDAR_RAW");
+    }
+
+  public:
+    void setUp() override {}
+    void tearDown() override {}
+
+    void testOnlyEnabledGroupsAreJoined()
+    {
+        zcm_trans_t* pub = makeUdpm(URL);
+        zcm_trans_t* sub = makeUdpm(URL);
+        TS_ASSERT(pub && sub);
+        if (!pub || !sub) return;
+
+        zcm_trans_recvmsg_enable(sub, "CAM_FRONT", true);
+        sendAll(pub);
+        TS_ASSERT_EQUALS(drain(sub), 1);
+
+        // Both cameras share group 1, so the other one does reach the socket,
+        // but the LIDAR group never does
+        zcm_udpm_stats_t stats;
+        zcm_trans_udpm_get_stats(sub, &stats);
+        TS_ASSERT_EQUALS(stats.packets, 2u);
+        TS_ASSERT_EQUALS(stats.filtered, 1u);
+
+        // Enabling every channel joins every group
+        zcm_trans_recvmsg_enable(sub, NULL, true);
+        sendAll(pub);
+        TS_ASSERT_EQUALS(drain(sub), 4);
+
+        // ... and leaving them again stops the traffic of the other groups
+        zcm_trans_recvmsg_enable(sub, NULL, false);
+        zcm_trans_recvmsg_enable(sub, "CAM_FRONT", false);
+        zcm_trans_recvmsg_enable(sub, "LIDAR", true);
+        sendAll(pub);
+        TS_ASSERT_EQUALS(drain(sub), 1);
+        zcm_trans_udpm_get_stats(sub, &stats);
+        TS_ASSERT_EQUALS(stats.packets, 2u + 4u + 1u);
+
+        zcm_trans_destroy(sub);
+        zcm_trans_destroy(pub);
+    }
+
+    void testRejectsBadGroupOptions()
+    {
+        TS_ASSERT(!makeUdpm("udpm://239.255.76.80:7670?groups=0"));
+        TS_ASSERT(!makeUdpm("udpm://239.255.76.80:7670?groups=4&group_map=CAM*:4"));
+        TS_ASSERT(!makeUdpm("udpm://239.255.255.254:7670?groups=4"));
+    }
+};
+
+#undef URL
+
+#endif /* UDPMGROUPSTEST_HPP */
@@ -0,0 +1,128 @@
+#ifndef UDPMMEMPOOLTEST_HPP
+#define UDPMMEMPOOLTEST_HPP
+
+#include "zcm/transport/udpm/mempool.hpp"
+#include "cxxtest/TestSuite.h"
+
+#include <cstring>
+
+class UdpmMemPoolTest : public CxxTest::TestSuite
+{
+    static size_t slot(size_t shift) { return shift - MemPool::MIN_SHIFT; }
+
+  public:
+    void setUp() override {}
+    void tearDown() override {}
+
+    void testReusesBlocksOfTheSameClass()
+    {
+        MemPool pool;
+
+        char *buf = pool.alloc(70000);
+        TS_ASSERT(buf);
+        pool.free(buf, 70000);
+        char *buf2 = pool.alloc(1<<17);
+        TS_ASSERT_EQUALS(buf, buf2);
+        pool.free(buf2, 1<<17);
+
+        char *buf3 = pool.alloc(1<<18);
+        TS_ASSERT(buf3);
+        TS_ASSERT_DIFFERS(buf3, buf);
+        pool.free(buf3, 1<<18);
+
+        char *buf4 = pool.alloc(1<<28);
+        TS_ASSERT(buf4);
+        pool.free(buf4, 1<<28);
+
+        MemPool::Stats stats = pool.getStats();
+        TS_ASSERT_EQUALS(stats.classes[slot(17)].hits, 1u);
+        TS_ASSERT_EQUALS(stats.classes[slot(17)].misses, 1u);
+        TS_ASSERT_EQUALS(stats.classes[slot(17)].cached, 1u);
+        TS_ASSERT_EQUALS(stats.classes[slot(28)].size, (size_t)1<<28);
+        // 256 MB is more than the default watermark allows
+        TS_ASSERT_EQUALS(stats.classes[slot(28)].cached, 0u);
+        TS_ASSERT_EQUALS(stats.classes[slot(28)].trimmed, 1u);
+        TS_ASSERT_EQUALS(stats.bytesCached, (size_t)(1<<17) + (1<<18));
+    }
+
+    void testSmallClasses()
+    {
+        MemPool pool;
+
+        char *small = pool.alloc(40);
+        TS_ASSERT(small);
+        pool.free(small, 40);
+        TS_ASSERT_EQUALS(pool.alloc(200), small);
+        pool.free(small, 200);
+
+        char *other = pool.alloc(300);
+        TS_ASSERT_DIFFERS(other, small);
+        pool.free(other, 300);
+
+        MemPool::Stats stats = pool.getStats();
+        TS_ASSERT_EQUALS(stats.classes[0].size, (size_t)1 << MemPool::MIN_SHIFT);
+        TS_ASSERT_EQUALS(stats.classes[0].hits, 1u);
+        TS_ASSERT_EQUALS(stats.classes[0].misses, 1u);
+        TS_ASSERT_EQUALS(stats.classes[1].misses, 1u);
+        TS_ASSERT_EQUALS(stats.bytesCached, 256u + 512u);
+    }
+
+    void testHighWatermark()
+    {
+        MemPool pool;
+        char *bufs[4];
+        for (auto& b : bufs) b = pool.alloc(1<<16);
+        char *big = pool.alloc(1<<18);
+        for (auto& b : bufs) pool.free(b, 1<<16);
+        pool.free(big, 1<<18);
+        TS_ASSERT_EQUALS(pool.getStats().bytesCached, (size_t)(4<<16) + (1<<18));
+
+        // lowering it trims the largest classes first
+        pool.setHighWatermark(1<<17);
+        MemPool::Stats stats = pool.getStats();
+        TS_ASSERT_EQUALS(stats.highWatermark, (size_t)1<<17);
+        TS_ASSERT_EQUALS(stats.bytesCached, (size_t)1<<17);
+        TS_ASSERT_EQUALS(stats.classes[slot(18)].cached, 0u);
+        TS_ASSERT_EQUALS(stats.classes[slot(18)].trimmed, 1u);
+        TS_ASSERT_EQUALS(stats.classes[slot(16)].cached, 2u);
+        TS_ASSERT_EQUALS(stats.classes[slot(16)].trimmed, 2u);
+
+        // and nothing freed beyond it is kept
+        char *buf5 = pool.alloc(1<<18);
+        pool.free(buf5, 1<<18);
+        stats = pool.getStats();
+        TS_ASSERT_EQUALS(stats.classes[slot(18)].cached, 0u);
+        TS_ASSERT_EQUALS(stats.classes[slot(18)].trimmed, 2u);
+        TS_ASSERT_EQUALS(stats.bytesCached, (size_t)1<<17);
+    }
+
+    void testHugePages()
+    {
+        // Falls back to regular pages where the OS has no huge pages, either way the
+        // blocks must be usable and cached like any other
+        MemPool pool;
+        pool.setHugePages(true);
+        TS_ASSERT(pool.getStats().hugePages);
+
+        size_t sz = 2 * MemPool::HUGE_PAGE_SIZE;
+        char *buf = pool.alloc(sz);
+        TS_ASSERT(buf);
+        memset(buf, 0xab, sz);
+        TS_ASSERT_EQUALS((unsigned char)buf[sz - 1], 0xab);
+        pool.free(buf, sz);
+        TS_ASSERT_EQUALS(pool.alloc(sz), buf);
+        pool.free(buf, sz);
+
+        // smaller classes still come from the heap
+        char *small = pool.alloc(1000);
+        TS_ASSERT(small);
+        pool.free(small, 1000);
+
+        MemPool::Stats stats = pool.getStats();
+        TS_ASSERT_EQUALS(stats.classes[slot(22)].hits, 1u);
+        TS_ASSERT_EQUALS(stats.classes[slot(22)].misses, 1u);
+        TS_ASSERT_EQUALS(stats.bytesCached, sz + 1024);
+    }
+};
+
+#endif /* UDPMMEMPOOLTEST_HPP */
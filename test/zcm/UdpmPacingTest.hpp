@@ -0,0 +1,79 @@
+#ifndef UDPMPACINGTEST_HPP
+#define UDPMPACINGTEST_HPP
+
+#include "zcm/zcm.h"
+#include "zcm/transport_registrar.h"
+#include "zcm/transport/udpm/udpm_stats.h"
+#include "zcm/transport/udpm/pacer.hpp"
+#include "util/TimeUtil.hpp"
+#include "cxxtest/TestSuite.h"
+#include "TransUtil.hpp"
+
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#define URL "udpm://239.255.76.83:7673?ttl=0"
+
+class UdpmPacingTest : public CxxTest::TestSuite
+{
+  public:
+    void setUp() override {}
+    void tearDown() override {}
+
+    void testPacesLargeMessages()
+    {
+        // 10 MB/s, with the default 256 kB burst
+        zcm_trans_t* zt = makeUdpm(URL "&pace_rate=10000000");
+        TS_ASSERT(zt);
+        if (!zt) return;
+
+        vector<uint8_t> big(1 << 20, 'x');
+        zcm_msg_t msg;
+        msg.utime = 0;
+        msg.channel = "PACED";
+        msg.buf = big.data();
+        msg.len = big.size();
+
+        uint64_t start = TimeUtil::utime();
+        TS_ASSERT_EQUALS(zcm_trans_sendmsg(zt, msg), ZCM_EOK);
+        TS_ASSERT_EQUALS(zcm_trans_sendmsg(zt, msg), ZCM_EOK);
+        uint64_t elapsed = TimeUtil::utime() - start;
+        // 2 MB minus the burst can't go out much faster than 180ms
+        TS_ASSERT(elapsed > 150000);
+
+        zcm_udpm_stats_t stats;
+        TS_ASSERT_EQUALS(zcm_trans_udpm_get_stats(zt, &stats), ZCM_EOK);
+        TS_ASSERT(stats.paced_sends > 0u);
+        TS_ASSERT(stats.pacing_delay_ns > 100000000u);
+        TS_ASSERT(stats.pacing_delay_max_ns <= stats.pacing_delay_ns);
+
+        zcm_trans_destroy(zt);
+    }
+
+    void testThreadsShareTheRate()
+    {
+        // Sends and retransmissions come from different threads through one bucket
+        Pacer pacer;
+        pacer.configure(10000000, 65536);
+
+        uint64_t start = TimeUtil::utime();
+        auto send = [&]() {
+            for (int i = 0; i < 16; i++) pacer.pace(65536);
+        };
+        thread other(send);
+        send();
+        other.join();
+        uint64_t elapsed = TimeUtil::utime() - start;
+
+        // 2 MB minus the burst at 10 MB/s, where separate buckets would take half that
+        TS_ASSERT(elapsed > 180000);
+        TS_ASSERT(pacer.delayedSends > 0u);
+        TS_ASSERT(pacer.maxDelayNs <= pacer.totalDelayNs);
+    }
+};
+
+#undef URL
+
+#endif /* UDPMPACINGTEST_HPP */
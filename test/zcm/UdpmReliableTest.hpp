@@ -0,0 +1,252 @@
+#ifndef UDPMRELIABLETEST_HPP
+#define UDPMRELIABLETEST_HPP
+
+#include "zcm/zcm.h"
+#include "zcm/transport_registrar.h"
+#include "zcm/transport/udpm/udpm_stats.h"
+#include "cxxtest/TestSuite.h"
+#include "TransUtil.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#define MC_ADDR "239.255.76.81"
+#define MC_PORT 7671
+#define URL "udpm://239.255.76.81:7671?ttl=0&reliable=true"
+
+// Wire format of the udpm transport, as seen by a hand-rolled sender
+#define MAGIC_LONG 0x4c433033
+#define MAGIC_NACK 0x4c43304e
+#define FRAGMENT_PAYLOAD 65487
+
+#define CHANNEL "MAP"
+#define DATALEN (2 * FRAGMENT_PAYLOAD + 1000)
+
+class UdpmReliableTest : public CxxTest::TestSuite
+{
+    static int openSocket()
+    {
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        unsigned char ttl = 0;
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        return fd;
+    }
+
+    static vector<uint8_t> payload()
+    {
+        vector<uint8_t> data(DATALEN);
+        for (size_t i = 0; i < data.size(); i++) data[i] = (uint8_t)(i * 7);
+        return data;
+    }
+
+    // Sends fragment 'fragNo' of a three fragment message on CHANNEL, the way a
+    // udpm publisher would
+    static void sendFragment(int fd, uint32_t seqno, uint16_t fragNo)
+    {
+        vector<uint8_t> data = payload();
+        size_t chanlen = strlen(CHANNEL) + 1;
+        size_t first = FRAGMENT_PAYLOAD - chanlen;
+        size_t offset = fragNo == 0 ? 0 : first + (fragNo - 1) * FRAGMENT_PAYLOAD;
+        size_t len = fragNo == 0 ? first : min((size_t)FRAGMENT_PAYLOAD, data.size() - offset);
+
+        vector<uint8_t> pkt(20);
+        uint32_t* hdr = (uint32_t*)pkt.data();
+        hdr[0] = htonl(MAGIC_LONG);
+        hdr[1] = htonl(seqno);
+        hdr[2] = htonl(DATALEN);
+        hdr[3] = htonl(offset);
+        ((uint16_t*)&hdr[4])[0] = htons(fragNo);
+        ((uint16_t*)&hdr[4])[1] = htons(3);
+        if (fragNo == 0) pkt.insert(pkt.end(), CHANNEL, CHANNEL + chanlen);
+        pkt.insert(pkt.end(), data.begin() + offset, data.begin() + offset + len);
+
+        struct sockaddr_in dest = {};
+        dest.sin_family = AF_INET;
+        dest.sin_port = htons(MC_PORT);
+        inet_aton(MC_ADDR, &dest.sin_addr);
+        sendto(fd, pkt.data(), pkt.size(), 0, (struct sockaddr*)&dest, sizeof(dest));
+    }
+
+    // Returns the fragments asked for by a NACK waiting on 'fd', if any
+    static vector<uint16_t> recvNack(int fd, uint32_t seqno)
+    {
+        vector<uint16_t> frags;
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(fd, &fds);
+        struct timeval tm = {0, 0};
+        if (select(fd + 1, &fds, 0, 0, &tm) <= 0) return frags;
+
+        uint8_t buf[65536];
+        ssize_t sz = recv(fd, buf, sizeof(buf), 0);
+        uint32_t* hdr = (uint32_t*)buf;
+        if (sz < 12 || ntohl(hdr[0]) != MAGIC_NACK || ntohl(hdr[1]) != seqno) return frags;
+        uint16_t n = ntohs(((uint16_t*)&hdr[2])[0]);
+        for (uint16_t i = 0; i < n && 12 + 2 * (i + 1) <= sz; i++)
+            frags.push_back(ntohs(((uint16_t*)(buf + 12))[i]));
+        return frags;
+    }
+
+    static void sendNack(int fd, const zcm_udpm_sender_stats_t& to,
+                         uint32_t seqno, uint16_t fragNo)
+    {
+        uint32_t pkt[4];
+        pkt[0] = htonl(MAGIC_NACK);
+        pkt[1] = htonl(seqno);
+        ((uint16_t*)&pkt[2])[0] = htons(1);
+        ((uint16_t*)&pkt[2])[1] = 0;
+        ((uint16_t*)&pkt[3])[0] = htons(fragNo);
+
+        struct sockaddr_in dest = {};
+        dest.sin_family = AF_INET;
+        dest.sin_port = to.port;
+        dest.sin_addr.s_addr = to.addr;
+        sendto(fd, pkt, 14, 0, (struct sockaddr*)&dest, sizeof(dest));
+    }
+
+  public:
+    void setUp() override {}
+    void tearDown() override {}
+
+    void testRecoversMissingFragments()
+    {
+        zcm_trans_t* sub = makeUdpm(URL);
+        TS_ASSERT(sub);
+        if (!sub) return;
+        zcm_trans_recvmsg_enable(sub, NULL, true);
+
+        int fd = openSocket();
+        sendFragment(fd, 0, 0);
+        sendFragment(fd, 0, 2);
+
+        zcm_msg_t msg;
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(sub, &msg, 50), ZCM_EAGAIN);
+        vector<uint16_t> frags = recvNack(fd, 0);
+        TS_ASSERT_EQUALS(frags.size(), 1u);
+        if (frags.size() == 1) TS_ASSERT_EQUALS(frags[0], 1);
+
+        sendFragment(fd, 0, 1);
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(sub, &msg, 100), ZCM_EOK);
+        TS_ASSERT_EQUALS(string(msg.channel), CHANNEL);
+        TS_ASSERT_EQUALS(msg.len, (size_t)DATALEN);
+        TS_ASSERT(msg.len == DATALEN && memcmp(msg.buf, payload().data(), DATALEN) == 0);
+
+        // A late retransmission doesn't deliver the message again
+        sendFragment(fd, 0, 2);
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(sub, &msg, 50), ZCM_EAGAIN);
+        TS_ASSERT(recvNack(fd, 0).empty());
+
+        zcm_udpm_stats_t stats;
+        zcm_trans_udpm_get_stats(sub, &stats);
+        TS_ASSERT_EQUALS(stats.nacks_sent, 1u);
+        TS_ASSERT_EQUALS(stats.messages, 1u);
+
+        close(fd);
+        zcm_trans_destroy(sub);
+    }
+
+    void testGivesUpOnUnansweredNacks()
+    {
+        zcm_trans_t* sub = makeUdpm(URL);
+        TS_ASSERT(sub);
+        if (!sub) return;
+        zcm_trans_recvmsg_enable(sub, NULL, true);
+
+        // Only the first fragment ever arrives, so the rest is asked for every
+        // time the message has been quiet for a while
+        int fd = openSocket();
+        sendFragment(fd, 7, 0);
+
+        zcm_msg_t msg;
+        int nacks = 0;
+        for (int i = 0; i < 20; i++) {
+            TS_ASSERT_EQUALS(zcm_trans_recvmsg(sub, &msg, 50), ZCM_EAGAIN);
+            vector<uint16_t> frags = recvNack(fd, 7);
+            if (!frags.empty()) {
+                nacks++;
+                TS_ASSERT_EQUALS(frags.size(), 2u);
+            }
+        }
+
+        zcm_udpm_stats_t stats;
+        zcm_trans_udpm_get_stats(sub, &stats);
+        TS_ASSERT_EQUALS(nacks, 5);
+        TS_ASSERT_EQUALS(stats.nacks_sent, 5u);
+        TS_ASSERT_EQUALS(stats.frag_incomplete, 1u);
+
+        close(fd);
+        zcm_trans_destroy(sub);
+    }
+
+    void testRetransmitsFromWindow()
+    {
+        zcm_trans_t* pub = makeUdpm(URL);
+        zcm_trans_t* sub = makeUdpm(URL);
+        TS_ASSERT(pub && sub);
+        if (!pub || !sub) return;
+        zcm_trans_recvmsg_enable(sub, NULL, true);
+
+        vector<uint8_t> data = payload();
+        zcm_msg_t msg;
+        msg.utime = 0;
+        msg.channel = CHANNEL;
+        msg.len = data.size();
+        msg.buf = data.data();
+        TS_ASSERT_EQUALS(zcm_trans_sendmsg(pub, msg), ZCM_EOK);
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(sub, &msg, 100), ZCM_EOK);
+
+        zcm_udpm_sender_stats_t sender;
+        TS_ASSERT_EQUALS(zcm_trans_udpm_get_sender_stats(sub, &sender, 1), 1);
+
+        // The subscriber may already have NACKed fragments its socket dropped
+        zcm_udpm_stats_t before, stats;
+        zcm_trans_udpm_get_stats(pub, &before);
+        zcm_trans_udpm_get_stats(sub, &stats);
+        uint64_t packets = stats.packets;
+
+        // Ask for a fragment of the message just sent, and of one never sent
+        int fd = openSocket();
+        sendNack(fd, sender, sender.last_seqno, 2);
+        sendNack(fd, sender, sender.last_seqno + 100, 0);
+
+        for (int i = 0; i < 100; i++) {
+            zcm_trans_udpm_get_stats(pub, &stats);
+            if (stats.nacks_received == before.nacks_received + 2) break;
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+        TS_ASSERT_EQUALS(stats.nacks_received, before.nacks_received + 2);
+        TS_ASSERT_EQUALS(stats.nacks_expired, 1u);
+        TS_ASSERT_EQUALS(stats.retransmits, before.retransmits + 1);
+
+        // The subscriber hears the retransmission, but already has the message
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(sub, &msg, 50), ZCM_EAGAIN);
+        zcm_trans_udpm_get_stats(sub, &stats);
+        TS_ASSERT_EQUALS(stats.packets, packets + 1);
+        TS_ASSERT_EQUALS(stats.messages, 1u);
+
+        close(fd);
+        zcm_trans_destroy(sub);
+        zcm_trans_destroy(pub);
+    }
+};
+
+#undef URL
+#undef MC_ADDR
+#undef MC_PORT
+#undef MAGIC_LONG
+#undef MAGIC_NACK
+#undef FRAGMENT_PAYLOAD
+#undef CHANNEL
+#undef DATALEN
+
+#endif /* UDPMRELIABLETEST_HPP */
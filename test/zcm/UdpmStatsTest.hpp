@@ -0,0 +1,273 @@
+#ifndef UDPMSTATSTEST_HPP
+#define UDPMSTATSTEST_HPP
+
+#include "zcm/zcm.h"
+#include "zcm/transport_registrar.h"
+#include "zcm/transport/udpm/udpm_stats.h"
+#include "cxxtest/TestSuite.h"
+#include "TransUtil.hpp"
+
+#include <cstring>
+#include <vector>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+using namespace std;
+
+#define IP   "239.255.76.67"
+#define PORT 7669
+#define URL  "udpm://239.255.76.67:7669?ttl=0"
+
+class UdpmStatsTest : public CxxTest::TestSuite
+{
+    // Sends fragment 'fragNo' of a two fragment, 100 byte message on "FRAG"
+    static void sendFragment(int fd, uint32_t seqno, uint16_t fragNo)
+    {
+        vector<uint8_t> pkt(20);
+        uint32_t* hdr = (uint32_t*)pkt.data();
+        hdr[0] = htonl(0x4c433033);
+        hdr[1] = htonl(seqno);
+        hdr[2] = htonl(100);
+        hdr[3] = htonl(fragNo * 50);
+        ((uint16_t*)&hdr[4])[0] = htons(fragNo);
+        ((uint16_t*)&hdr[4])[1] = htons(2);
+        if (fragNo == 0) pkt.insert(pkt.end(), "FRAG", "FRAG" + 5);
+        pkt.insert(pkt.end(), 50, (uint8_t)seqno);
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(PORT);
+        inet_aton(IP, &addr.sin_addr);
+        sendto(fd, pkt.data(), pkt.size(), 0, (struct sockaddr*)&addr, sizeof(addr));
+    }
+
+  public:
+    void setUp() override {}
+    void tearDown() override {}
+
+    void testCountsOwnTraffic()
+    {
+        zcm_trans_t* zt = makeUdpm(URL, true);
+        TS_ASSERT(zt);
+        if (!zt) return;
+
+        vector<uint8_t> big(100000, 'x');
+        zcm_msg_t msg;
+        msg.utime = 0;
+        msg.channel = "STATS";
+        // Receive as we go: the default kernel buffer can't hold many big messages
+        int received = 0;
+        for (int i = 0; i < 5; ++i) {
+            msg.buf = big.data();
+            msg.len = i % 2 ? big.size() : 10;
+            zcm_trans_sendmsg(zt, msg);
+            received += drain(zt);
+        }
+        TS_ASSERT_EQUALS(received, 5);
+
+        zcm_udpm_stats_t stats;
+        TS_ASSERT_EQUALS(zcm_trans_udpm_get_stats(zt, &stats), ZCM_EOK);
+        TS_ASSERT_EQUALS(stats.messages, 5u);
+        TS_ASSERT(stats.packets > 5u);
+        TS_ASSERT_EQUALS(stats.bad_packets, 0u);
+        TS_ASSERT_EQUALS(stats.seq_gaps, 0u);
+        TS_ASSERT_EQUALS(stats.seq_reorders, 0u);
+        TS_ASSERT_EQUALS(stats.num_senders, 1u);
+
+        zcm_udpm_sender_stats_t sender;
+        TS_ASSERT_EQUALS(zcm_trans_udpm_get_sender_stats(zt, &sender, 1), 1);
+        TS_ASSERT_EQUALS(sender.last_seqno, 4u);
+        TS_ASSERT_EQUALS(sender.packets, stats.packets);
+
+        zcm_trans_destroy(zt);
+    }
+
+    void testReportsMemPoolUsage()
+    {
+        zcm_trans_t* zt = makeUdpm(URL "&mempool_max=1000000", true);
+        TS_ASSERT(zt);
+        if (!zt) return;
+
+        vector<uint8_t> big(100000, 'x');
+        zcm_msg_t msg;
+        msg.utime = 0;
+        msg.channel = "POOL";
+        msg.buf = big.data();
+        msg.len = big.size();
+        for (int i = 0; i < 3; ++i) {
+            zcm_trans_sendmsg(zt, msg);
+            TS_ASSERT_EQUALS(drain(zt), 1);
+        }
+
+        zcm_udpm_stats_t stats;
+        TS_ASSERT_EQUALS(zcm_trans_udpm_get_stats(zt, &stats), ZCM_EOK);
+        TS_ASSERT_EQUALS(stats.mempool_high_watermark, 1000000u);
+        TS_ASSERT(stats.mempool_bytes_cached > 0u);
+        TS_ASSERT(stats.mempool_bytes_cached <= 1000000u);
+        // the later messages reassemble in the buffers of the first
+        TS_ASSERT(stats.mempool_misses > 0u);
+        TS_ASSERT(stats.mempool_hits > 0u);
+
+        zcm_udpm_mempool_stats_t classes[32];
+        int n = zcm_trans_udpm_get_mempool_stats(zt, classes, 32);
+        TS_ASSERT(n > 0 && n < 32);
+        uint64_t hits = 0, misses = 0, cached = 0;
+        for (int i = 0; i < n; ++i) {
+            if (i > 0) TS_ASSERT_EQUALS(classes[i].size, 2 * classes[i - 1].size);
+            hits += classes[i].hits;
+            misses += classes[i].misses;
+            cached += classes[i].cached * classes[i].size;
+        }
+        TS_ASSERT_EQUALS(hits, stats.mempool_hits);
+        TS_ASSERT_EQUALS(misses, stats.mempool_misses);
+        TS_ASSERT_EQUALS(cached, stats.mempool_bytes_cached);
+
+        zcm_trans_destroy(zt);
+    }
+
+    void testIdleReceiverKeepsFewBuffers()
+    {
+        zcm_trans_t* zt = makeUdpm(URL, true);
+        TS_ASSERT(zt);
+        if (!zt) return;
+
+        uint32_t data = 0;
+        zcm_msg_t msg;
+        msg.utime = 0;
+        msg.channel = "IDLE";
+        msg.buf = (uint8_t*)&data;
+        msg.len = sizeof(data);
+        for (int i = 0; i < 10; ++i) {
+            zcm_trans_sendmsg(zt, msg);
+            TS_ASSERT_EQUALS(drain(zt), 1);
+        }
+
+        // A message at a time never fills a batch, so the receive buffers don't
+        // grow to the full 32
+        zcm_udpm_mempool_stats_t classes[32];
+        int n = zcm_trans_udpm_get_mempool_stats(zt, classes, 32);
+        for (int i = 0; i < n; ++i)
+            if (classes[i].size == 65536) TS_ASSERT(classes[i].misses <= 4u);
+
+        zcm_trans_destroy(zt);
+    }
+
+    void testGapsReordersAndBadPackets()
+    {
+        zcm_trans_t* zt = makeUdpm(URL, true);
+        TS_ASSERT(zt);
+        if (!zt) return;
+
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        unsigned char ttl = 0;
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+
+        const uint32_t SHORT = 0x4c433032;
+        sendRaw(fd, IP, PORT, SHORT, 10);
+        sendRaw(fd, IP, PORT, SHORT, 14);      // skips 11, 12 and 13
+        sendRaw(fd, IP, PORT, SHORT, 12);      // ... but 12 was only late
+        sendRaw(fd, IP, PORT, 0xdeadbeef, 15); // bad magic
+        TS_ASSERT_EQUALS(drain(zt), 3);
+        close(fd);
+
+        zcm_udpm_stats_t stats;
+        TS_ASSERT_EQUALS(zcm_trans_udpm_get_stats(zt, &stats), ZCM_EOK);
+        TS_ASSERT_EQUALS(stats.packets, 4u);
+        TS_ASSERT_EQUALS(stats.messages, 3u);
+        TS_ASSERT_EQUALS(stats.bad_packets, 1u);
+        TS_ASSERT_EQUALS(stats.seq_gaps, 2u);
+        TS_ASSERT_EQUALS(stats.seq_reorders, 1u);
+
+        zcm_trans_destroy(zt);
+    }
+
+    void testDropsAbandonedPartials()
+    {
+        zcm_trans_t* zt = makeUdpm(URL, true);
+        TS_ASSERT(zt);
+        if (!zt) return;
+
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        unsigned char ttl = 0;
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+
+        sendFragment(fd, 5, 0);  // never finished
+        sendFragment(fd, 6, 0);
+        sendFragment(fd, 4, 0);  // late, and older than what's in progress
+        sendFragment(fd, 6, 1);
+        zcm_msg_t msg;
+        TS_ASSERT_EQUALS(zcm_trans_recvmsg(zt, &msg, 200), ZCM_EOK);
+        TS_ASSERT_EQUALS(msg.len, 100u);
+        TS_ASSERT_EQUALS(msg.buf[0], 6);
+        TS_ASSERT_EQUALS(drain(zt), 0);
+        close(fd);
+
+        zcm_udpm_stats_t stats;
+        TS_ASSERT_EQUALS(zcm_trans_udpm_get_stats(zt, &stats), ZCM_EOK);
+        TS_ASSERT_EQUALS(stats.messages, 1u);
+        TS_ASSERT_EQUALS(stats.frag_incomplete, 1u);
+        TS_ASSERT_EQUALS(stats.frag_evicted, 0u);
+
+        zcm_trans_destroy(zt);
+    }
+
+    void testFiltersDisabledChannels()
+    {
+        zcm_trans_t* zt = makeUdpm(URL);
+        TS_ASSERT(zt);
+        if (!zt) return;
+        zcm_trans_recvmsg_enable(zt, "WANTED", true);
+
+        vector<uint8_t> big(100000, 'x');
+        zcm_msg_t msg;
+        msg.utime = 0;
+        const char* channels[] = { "WANTED", "UNWANTED" };
+        int received = 0;
+        for (int i = 0; i < 4; ++i) {
+            msg.channel = channels[i % 2];
+            msg.buf = big.data();
+            msg.len = i < 2 ? 10 : big.size();
+            zcm_trans_sendmsg(zt, msg);
+            zcm_msg_t rmsg;
+            while (zcm_trans_recvmsg(zt, &rmsg, 50) == ZCM_EOK) {
+                TS_ASSERT_EQUALS(string(rmsg.channel), "WANTED");
+                received++;
+            }
+        }
+        TS_ASSERT_EQUALS(received, 2);
+
+        zcm_udpm_stats_t stats;
+        TS_ASSERT_EQUALS(zcm_trans_udpm_get_stats(zt, &stats), ZCM_EOK);
+        TS_ASSERT_EQUALS(stats.messages, 2u);
+        TS_ASSERT_EQUALS(stats.filtered, 2u);
+        TS_ASSERT_EQUALS(stats.seq_gaps, 0u);
+        TS_ASSERT_EQUALS(stats.frag_incomplete, 0u);
+
+        zcm_trans_destroy(zt);
+    }
+
+    void testRejectsOtherTransports()
+    {
+        zcm_url_t* u = zcm_url_create("block-inproc");
+        zcm_trans_t* zt = zcm_transport_find("block-inproc")(u);
+        zcm_url_destroy(u);
+        TS_ASSERT(zt);
+        if (!zt) return;
+
+        zcm_udpm_stats_t stats;
+        TS_ASSERT_EQUALS(zcm_trans_udpm_get_stats(zt, &stats), ZCM_EINVALID);
+        TS_ASSERT_EQUALS(zcm_trans_udpm_get_sender_stats(zt, NULL, 0), -1);
+        TS_ASSERT_EQUALS(zcm_trans_udpm_get_drop_stats(zt, NULL, 0), -1);
+        TS_ASSERT_EQUALS(zcm_trans_udpm_get_mempool_stats(zt, NULL, 0), -1);
+
+        zcm_trans_destroy(zt);
+    }
+};
+
+#undef URL
+#undef PORT
+#undef IP
+
+#endif /* UDPMSTATSTEST_HPP */
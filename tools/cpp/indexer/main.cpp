@@ -23,6 +23,7 @@ struct Args
     bool readable      = false;
     bool debug         = false;
     bool useDefault    = false;
+    uint32_t sidecar   = 0;
 
     bool parse(int argc, char *argv[])
     {
@@ -36,6 +37,7 @@ struct Args
             { "readable",    no_argument,       0, 'r' },
             { "use-default", no_argument,       0, 'd' },
             { "debug",       no_argument,       0,  0  },
+            { "sidecar",     optional_argument, 0,  0  },
             { "help",        no_argument,       0, 'h' },
             { 0, 0, 0, 0 }
         };
@@ -52,6 +54,14 @@ struct Args
                 case 'd': useDefault  = true;           break;
                 case  0:
                     if (string(long_opts[option_index].name) == "debug") debug = true;
+                    if (string(long_opts[option_index].name) == "sidecar") {
+                        int stride = optarg ? atoi(optarg) : ZCM_EVENTLOG_INDEX_DEFAULT_STRIDE;
+                        if (stride <= 0) {
+                            cerr << "Sidecar stride must be positive" << endl;
+                            return false;
+                        }
+                        sidecar = stride;
+                    }
                     break;
                 case 'h': default: usage(); return false;
             };
@@ -63,6 +73,7 @@ struct Args
         }
 
         if (output  == "") {
+            if (sidecar) return true;
             cerr << "Please specify index file output" << endl;
             return false;
         }
@@ -107,6 +118,10 @@ struct Args
              << "                          Leave it human readable" << endl
              << "  -d, --use-default       Run with the default timestamp indexer" << endl
              << "      --debug             Run a dry run to ensure proper indexer setup" << endl
+             << "      --sidecar[=N]       Also write the sidecar seek index of every Nth event" << endl
+             << "                          (default: " << ZCM_EVENTLOG_INDEX_DEFAULT_STRIDE
+             << ") to logfile" << ZCM_EVENTLOG_INDEX_SUFFIX << ", used by" << endl
+             << "                          zcm::LogFile to seek. Without -o, only does that" << endl
              << endl << endl;
     }
 };
@@ -121,9 +136,19 @@ int main(int argc, char* argv[])
         cerr << "Unable to open logfile: " << args.logfile << endl;
         return 1;
     }
-    fseeko(log.getFilePtr(), 0, SEEK_END);
+
+    if (args.sidecar) {
+        string sidecarPath = args.logfile + ZCM_EVENTLOG_INDEX_SUFFIX;
+        if (log.buildIndex(sidecarPath, args.sidecar) != 0) {
+            cerr << "Unable to write sidecar index: " << sidecarPath << endl;
+            return 1;
+        }
+        cout << "Wrote sidecar index: " << sidecarPath << endl;
+        if (args.output == "") return 0;
+    }
+
     // TODO: Look into handling large logfiles
-    off_t logSize = ftello(log.getFilePtr());
+    off_t logSize = log.getLength();
 
     ofstream output;
     output.open(args.output);
@@ -248,15 +273,15 @@ int main(int argc, char* argv[])
     for (size_t i = 0; i < pluginGroups.size(); ++i) {
         if (pluginGroups.size() != 1) cout << "Plugin group " << (i + 1) << endl;
         off_t offset = 0;
-        fseeko(log.getFilePtr(), 0, SEEK_SET);
+        log.seekToOffset(0);
 
         for (auto& p : pluginGroups[i])
             p.runThroughLog = p.plugin->setUp(index, index[p.plugin->name()], log);
 
-        fseeko(log.getFilePtr(), 0, SEEK_SET);
+        log.seekToOffset(0);
 
         while (1) {
-            offset = ftello(log.getFilePtr());
+            offset = log.getOffset();
 
             static int lastPrintPercent = 0;
             int percent = (100.0 * offset / logSize) * 100;
@@ -291,7 +316,7 @@ int main(int argc, char* argv[])
         cout << endl;
 
         for (auto& p : pluginGroups[i]) {
-            fseeko(log.getFilePtr(), 0, SEEK_SET);
+            log.seekToOffset(0);
             p.plugin->tearDown(index, index[p.plugin->name()], log);
         }
     }
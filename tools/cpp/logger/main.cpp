@@ -7,10 +7,11 @@
 #include <regex>
 #include <atomic>
 #include <mutex>
-#include <condition_variable>
 #include <thread>
-#include <queue>
+#include <memory>
 #include <vector>
+#include <deque>
+#include <unordered_map>
 #include <signal.h>
 #include <string>
 
@@ -20,6 +21,7 @@
 
 #include "zcm/zcm-cpp.hpp"
 #include "zcm/util/debug.h"
+#include "zcm/util/byte_ring.hpp"
 #include "zcm/zcm_coretypes.h"
 
 #include "util/TranscoderPluginDb.hpp"
@@ -34,6 +36,17 @@ using namespace std;
 
 static atomic_int done {0};
 
+// Size of the capture ring when --max-target-memory doesn't set it
+static const i64 DEFAULT_RING_SIZE = 100 << 20;
+
+enum {
+    OPT_SIDECAR = 256,
+    OPT_ASYNC,
+    OPT_DIRECT_IO,
+    OPT_SYNC_MB,
+    OPT_COMPRESS,
+};
+
 struct Args
 {
     double auto_split_mb      = 0.0;
@@ -41,7 +54,7 @@ struct Args
     string chan               = ".*";
     bool   auto_increment     = false;
     bool   use_strftime       = false;
-    string zcmurl             = "";
+    vector<string> zcmurls;
     bool   quiet              = false;
     bool   invert_channels    = false;
     int    rotate             = -1;
@@ -49,6 +62,11 @@ struct Args
     i64    max_target_memory  = 0;
     string plugin_path        = "";
     bool   debug              = false;
+    u32    sidecar_stride     = 0;
+    bool   async_write        = false;
+    bool   direct_io          = false;
+    double sync_mb            = 0.0;
+    string compress_codec     = "";
 
     string input_fname;
 
@@ -71,6 +89,11 @@ struct Args
             { "max-target-memory", required_argument, 0, 'm' },
             { "plugin-path",       required_argument, 0, 'p' },
             { "debug",             no_argument,       0, 'd' },
+            { "sidecar",           optional_argument, 0, OPT_SIDECAR },
+            { "async",             no_argument,       0, OPT_ASYNC },
+            { "direct-io",         no_argument,       0, OPT_DIRECT_IO },
+            { "sync-mb",           required_argument, 0, OPT_SYNC_MB },
+            { "compress",          optional_argument, 0, OPT_COMPRESS },
 
             { 0, 0, 0, 0 }
         };
@@ -98,7 +121,7 @@ struct Args
                     use_strftime = true;
                     break;
                 case 'u':
-                    zcmurl = optarg;
+                    zcmurls.push_back(optarg);
                     break;
                 case 'q':
                     quiet = true;
@@ -123,6 +146,10 @@ struct Args
                     break;
                 case 'm':
                     max_target_memory = atoll(optarg);
+                    if (max_target_memory <= 0) {
+                        cerr << "Please specify a max target memory greater than 0 bytes" << endl;
+                        return false;
+                    }
                     break;
                 case 'p':
                     plugin_path = string(optarg);
@@ -130,6 +157,30 @@ struct Args
                 case 'd':
                     debug = true;
                     break;
+                case OPT_SIDECAR: {
+                    int stride = optarg ? atoi(optarg) : ZCM_EVENTLOG_INDEX_DEFAULT_STRIDE;
+                    if (stride <= 0) {
+                        cerr << "Please specify a sidecar stride greater than 0" << endl;
+                        return false;
+                    }
+                    sidecar_stride = stride;
+                } break;
+                case OPT_ASYNC:
+                    async_write = true;
+                    break;
+                case OPT_DIRECT_IO:
+                    direct_io = true;
+                    break;
+                case OPT_SYNC_MB:
+                    sync_mb = strtod(optarg, NULL);
+                    if (sync_mb <= 0) {
+                        cerr << "Please specify a sync size greater than 0 MB" << endl;
+                        return false;
+                    }
+                    break;
+                case OPT_COMPRESS:
+                    compress_codec = optarg ? string(optarg) : "lz4";
+                    break;
                 case 'h': default: usage(); return false;
             };
         }
@@ -154,6 +205,11 @@ struct Args
             return false;
         }
 
+        if ((direct_io || sync_mb > 0) && !async_write) {
+            cerr << "ERROR.  --direct-io and --sync-mb require --async" << endl;
+            return false;
+        }
+
         return true;
     }
 
@@ -171,17 +227,17 @@ struct Args
              << "  -c, --channel=CHAN         Channel string to pass to zcm_subscribe." << endl
              << "                             (default: \".*\")" << endl
              << "  -l, --flush-interval=MS    Flush the log file to disk every MS milliseconds." << endl
-             << "                             (default: 100)" << endl
+             << "                             (default: 100). Not done with --async, which" << endl
+             << "                             leaves it to --sync-mb, and only for the blocks" << endl
+             << "                             already written with --compress." << endl
              << "  -f, --force                Overwrite existing files" << endl
              << "  -h, --help                 Shows this help text and exits" << endl
              << "  -i, --increment            Automatically append a suffix to FILE" << endl
              << "                             such that the resulting filename does not" << endl
              << "                             already exist.  This option precludes -f and" << endl
              << "                             --rotate" << endl
-             << "  -u, --zcm-url=URL          Log messages on the specified ZCM URL" << endl
-             << "  -m, --max-unwritten-mb=SZ  Maximum size of received but unwritten" << endl
-             << "                             messages to store in memory before dropping" << endl
-             << "                             messages.  (default: 100 MB)" << endl
+             << "  -u, --zcm-url=URL          Log messages on the specified ZCM URL. Repeat to" << endl
+             << "                             log several transports into the same file." << endl
              << "  -r, --rotate=NUM           When creating a new log file, rename existing files" << endl
              << "                             out of the way and always write to FILE.0.  If" << endl
              << "                             FILE.0 already exists, it is renamed to FILE.1.  If" << endl
@@ -196,12 +252,29 @@ struct Args
              << "  -s, --strftime             Format FILE with strftime." << endl
              << "  -v, --invert-channels      Invert channels.  Log everything that CHAN" << endl
              << "                             does not match." << endl
-             << "  -m, --max-target-memory    Attempt to limit the total buffer usage to this" << endl
-             << "                             amount of memory. If specified, ensure that this" << endl
-             << "                             number is at least as large as the maximum message" << endl
-             << "                             size you expect to receive. This argument is" << endl
-             << "                             specified in bytes. Suffixes are not yet supported." << endl
+             << "  -m, --max-target-memory=SZ Size of the buffer holding received but unwritten" << endl
+             << "                             messages, allocated up front. Messages arriving" << endl
+             << "                             while it is full are dropped and reported per" << endl
+             << "                             channel. Ensure that this number is at least twice" << endl
+             << "                             the largest message you expect to receive. This" << endl
+             << "                             argument is specified in bytes. Suffixes are not" << endl
+             << "                             yet supported. (default: unlimited: messages that" << endl
+             << "                             don't fit in a 100 MB buffer are queued on the" << endl
+             << "                             heap rather than dropped)" << endl
              << "  -p, --plugin-path=path     Path to shared library containing transcoder plugins" << endl
+             << "      --sidecar[=N]          Write a sidecar seek index of every Nth event" << endl
+             << "                             (default: " << ZCM_EVENTLOG_INDEX_DEFAULT_STRIDE
+             << ") next to each log file as" << endl
+             << "                             FILE" << ZCM_EVENTLOG_INDEX_SUFFIX
+             << ", used by zcm::LogFile to seek." << endl
+             << "      --async                Serialize events into large buffers that are" << endl
+             << "                             written out in the background, through io_uring" << endl
+             << "                             where available. For sustained high data rates." << endl
+             << "      --direct-io            With --async, bypass the page cache (O_DIRECT)." << endl
+             << "      --sync-mb=N            With --async, also fdatasync every N MB written." << endl
+             << "      --compress[=codec]     Write the log in independently compressed blocks" << endl
+             << "                             (default codec: lz4). Each flush ends a block, so" << endl
+             << "                             a longer --flush-interval compresses better." << endl
              << endl
              << "Rotating / splitting log files" << endl
              << "==============================" << endl
@@ -218,17 +291,13 @@ struct Args
     }
 };
 
-static zcm::LogEvent* cloneLogEvent(const zcm::LogEvent* evt)
+// How each event is laid out in the capture ring, followed by its channel and data
+struct CapturedEvent
 {
-    zcm::LogEvent* ret = new zcm::LogEvent;
-    ret->eventnum  = evt->eventnum;
-    ret->timestamp = evt->timestamp;
-    ret->channel   = evt->channel;
-    ret->datalen   = evt->datalen;
-    ret->data      = new uint8_t[evt->datalen];
-    memcpy(ret->data, evt->data, evt->datalen * sizeof(uint8_t));
-    return ret;
-}
+    i64 timestamp;
+    i32 channellen;
+    i32 datalen;
+};
 
 struct Logger
 {
@@ -253,21 +322,31 @@ struct Logger
     u64    time0                    = TimeUtil::utime();
     u64    last_fflush_time         = 0;
 
-    size_t dropped_packets_count    = 0;
     u64    last_drop_report_utime   = 0;
     size_t last_drop_report_count   = 0;
+    unordered_map<string, size_t> drops_reported;
 
     int    num_splits               = 0;
+    bool   writing_async            = false;
 
-    i64    totalMemoryUsage         = 0;
+    // Received events waiting to be written, filled by the handler of every ZCM instance
+    unique_ptr<ByteRing> ring;
 
-    mutex lk;
-    condition_variable newEventCond;
+    // Without a --max-target-memory, events the ring has no room for are queued here
+    // instead of being dropped, as is every event after them until the writer catches up.
+    // Each holds a record laid out as in the ring.
+    mutex overflowLk;
+    deque<vector<uint8_t>> overflow;
+    atomic<bool> overflowing {false};
 
-    queue<zcm::LogEvent*> q;
+    // Events that didn't fit in the ring, by channel. Only touched when dropping.
+    mutex dropLk;
+    size_t dropped_packets_count    = 0;
+    unordered_map<string, size_t> drops;
 
     TranscoderPluginDb* pluginDb = nullptr;
     vector<zcm::TranscoderPlugin*> plugins;
+    mutex pluginLk;
 
     Logger() {}
 
@@ -275,12 +354,6 @@ struct Logger
     {
         if (pluginDb) { delete pluginDb; pluginDb = nullptr; }
         if (log)      { log->close(); delete log; }
-
-        while (!q.empty()) {
-            delete[] q.front()->data;
-            delete q.front();
-            q.pop();
-        }
     }
 
     bool init(int argc, char *argv[])
@@ -288,6 +361,9 @@ struct Logger
         if (!args.parse(argc, argv))
             return false;
 
+        ring.reset(new ByteRing(args.max_target_memory ? args.max_target_memory
+                                                       : DEFAULT_RING_SIZE));
+
         if (!openLogfile())
             return false;
 
@@ -327,18 +403,23 @@ struct Logger
         if (!args.quiet) cout << "Rotating log files" << endl;
 
         // delete log files that have fallen off the end of the rotation
-        string tomove = fname_prefix + "." + to_string(args.rotate-1);
-        if (FileUtil::exists(tomove))
-            if (0 != FileUtil::remove(tomove))
-                cerr << "ERROR! Unable to delete [" << tomove << "]" << endl;
+        // along with their sidecar indexes
+        for (string suffix : { "", ZCM_EVENTLOG_INDEX_SUFFIX }) {
+            string tomove = fname_prefix + "." + to_string(args.rotate-1) + suffix;
+            if (FileUtil::exists(tomove))
+                if (0 != FileUtil::remove(tomove))
+                    cerr << "ERROR! Unable to delete [" << tomove << "]" << endl;
+        }
 
         // Rotate away any existing log files
         for (int file_num = args.rotate-1; file_num >= 0; file_num--) {
-            string newname = fname_prefix + "." + to_string(file_num);
-            string tomove  = fname_prefix + "." + to_string(file_num-1);
-            if (FileUtil::exists(tomove))
-                if (0 != FileUtil::rename(tomove, newname))
-                    cerr << "ERROR!  Unable to rotate [" << tomove << "]" << endl;
+            for (string suffix : { "", ZCM_EVENTLOG_INDEX_SUFFIX }) {
+                string newname = fname_prefix + "." + to_string(file_num) + suffix;
+                string tomove  = fname_prefix + "." + to_string(file_num-1) + suffix;
+                if (FileUtil::exists(tomove))
+                    if (0 != FileUtil::rename(tomove, newname))
+                        cerr << "ERROR!  Unable to rotate [" << tomove << "]" << endl;
+            }
         }
     }
 
@@ -399,6 +480,27 @@ struct Logger
             delete log;
             return false;
         }
+        if (args.compress_codec != "" &&
+            log->writeCompressed(args.compress_codec) != 0) {
+            cerr << "Unable to write \"" << filename << "\" compressed with "
+                 << args.compress_codec << endl;
+            delete log;
+            return false;
+        }
+        if (args.sidecar_stride) {
+            string sidecar = filename + ZCM_EVENTLOG_INDEX_SUFFIX;
+            if (log->writeIndex(sidecar, args.sidecar_stride) != 0)
+                cerr << "Unable to write sidecar index \"" << sidecar << "\"" << endl;
+        }
+        writing_async = false;
+        if (args.async_write) {
+            zcm_eventlog_async_opts_t opts = {};
+            opts.direct = args.direct_io;
+            opts.sync_bytes = args.sync_mb * (1 << 20);
+            writing_async = log->writeAsync(&opts) == 0;
+            if (!writing_async)
+                cerr << "Unable to write asynchronously, writing through stdio" << endl;
+        }
         return true;
     }
 
@@ -410,89 +512,116 @@ struct Logger
             if (match.size() > 0) return;
         }
 
-        vector<zcm::LogEvent*> evts;
-
-        zcm::LogEvent* le = new zcm::LogEvent;
-        le->timestamp = rbuf->recv_utime;
-        le->channel   = channel;
-        le->datalen   = rbuf->data_size;
-
-        if (!plugins.empty()) {
-            le->data = rbuf->data;
-
-            int64_t msg_hash;
-            __int64_t_decode_array(le->data, 0, 8, &msg_hash, 1);
-
-            for (auto& p : plugins) {
-                vector<const zcm::LogEvent*> pevts =
-                    p->transcodeEvent((uint64_t) msg_hash, le);
-                for (auto* evt : pevts)
-                    if (evt) evts.emplace_back(cloneLogEvent(evt));
-                    else     evts.emplace_back(nullptr);
-            }
+        if (plugins.empty()) {
+            capture(channel, rbuf->recv_utime, rbuf->data, rbuf->data_size);
+            return;
         }
 
-        if (evts.empty()) {
-            le->data = new uint8_t[rbuf->data_size];
-            memcpy(le->data, rbuf->data, sizeof(uint8_t) * rbuf->data_size);
-            evts.push_back(le);
-        } else {
-            delete le;
+        zcm::LogEvent le;
+        le.timestamp = rbuf->recv_utime;
+        le.channel   = channel;
+        le.datalen   = rbuf->data_size;
+        le.data      = rbuf->data;
+
+        int64_t msg_hash;
+        __int64_t_decode_array(le.data, 0, 8, &msg_hash, 1);
+
+        // Plugins aren't expected to cope with several ZCM instances calling them at once
+        unique_lock<mutex> lock{pluginLk};
+        bool transcoded = false;
+        for (auto& p : plugins) {
+            vector<const zcm::LogEvent*> pevts = p->transcodeEvent((uint64_t) msg_hash, &le);
+            for (auto* evt : pevts) {
+                transcoded = true;
+                if (evt) capture(evt->channel, evt->timestamp, evt->data, evt->datalen);
+            }
         }
+        if (!transcoded) capture(channel, le.timestamp, le.data, le.datalen);
+    }
 
-        bool stillRoom = true;
-        {
-            unique_lock<mutex> lock{lk};
-            while (!evts.empty()) {
-                if (stillRoom) {
-                    zcm::LogEvent* le = evts.back();
-                    if (!le) {
-                        evts.pop_back();
-                        continue;
-                    }
-                    q.push(le);
-                    totalMemoryUsage += le->datalen + le->channel.size() + sizeof(*le);
-                    stillRoom = (args.max_target_memory == 0) ? true :
-                        (totalMemoryUsage + rbuf->data_size < args.max_target_memory);
-                    evts.pop_back();
-                } else {
-                    ZCM_DEBUG("Dropping message due to enforced memory constraints");
-                    ZCM_DEBUG("Current memory estimations are at %" PRId64 " bytes",
-                              totalMemoryUsage);
-                    while (!evts.empty()) {
-                        delete[] evts.back()->data;
-                        delete evts.back();
-                        evts.pop_back();
-                    }
-                    break;
-                }
+    // Copies an event into the ring for the writer, or counts it as dropped if the ring
+    // is full
+    void capture(const string& channel, i64 timestamp, const uint8_t* data, u32 datalen)
+    {
+        size_t len = sizeof(CapturedEvent) + channel.size() + datalen;
+        ByteRing::Reservation r;
+        if (!overflowing.load(memory_order_acquire)) r = ring->reserve(len);
+        if (!r.data && args.max_target_memory == 0) {
+            vector<uint8_t> rec(len);
+            fillEvent(rec.data(), channel, timestamp, data, datalen);
+            {
+                unique_lock<mutex> lock{overflowLk};
+                overflow.push_back(move(rec));
+                overflowing.store(true, memory_order_release);
             }
+            ring->wakeup();
+            return;
         }
-        newEventCond.notify_all();
+        if (!r.data) {
+            ZCM_DEBUG("Dropping message due to enforced memory constraints");
+            ZCM_DEBUG("Current memory estimations are at %zu bytes", ring->bytesUsed());
+            unique_lock<mutex> lock{dropLk};
+            dropped_packets_count++;
+            drops[channel]++;
+            return;
+        }
+
+        fillEvent(r.data, channel, timestamp, data, datalen);
+        ring->commit(r);
+    }
+
+    static void fillEvent(uint8_t* rec, const string& channel, i64 timestamp,
+                          const uint8_t* data, u32 datalen)
+    {
+        CapturedEvent* ce = (CapturedEvent*) rec;
+        ce->timestamp  = timestamp;
+        ce->channellen = channel.size();
+        ce->datalen    = datalen;
+        memcpy(rec + sizeof(*ce), channel.data(), channel.size());
+        memcpy(rec + sizeof(*ce) + channel.size(), data, datalen);
+    }
+
+    void writeRecord(const uint8_t* rec, i64 memUsed)
+    {
+        const CapturedEvent* ce = (const CapturedEvent*) rec;
+        zcm_eventlog_event_t le;
+        le.timestamp  = ce->timestamp;
+        le.channellen = ce->channellen;
+        le.datalen    = ce->datalen;
+        le.channel    = (char*) rec + sizeof(*ce);
+        le.data       = (uint8_t*) rec + sizeof(*ce) + ce->channellen;
+        writeEvent(&le, memUsed);
     }
 
     void flushWhenReady()
     {
-        zcm::LogEvent *le = nullptr;
-        size_t qSize = 0;
-        i64 memUsed = 0;
-        {
-            unique_lock<mutex> lock{lk};
-
-            while (q.empty()) {
-                if (done) return;
-                newEventCond.wait(lock);
+        i64 memUsed = ring->bytesUsed(); // want to capture the max mem used, not post flush
+
+        // Events are written straight out of the ring. Freeing them a MB at a time
+        // rather than after the whole backlog keeps room for the handler meanwhile.
+        size_t n = ring->drain([&](const uint8_t* rec, size_t len) {
+            writeRecord(rec, memUsed);
+        }, 1 << 20);
+        if (n > 1) ZCM_DEBUG("Wrote %zu events in one batch\n", n);
+        if (n > 0) return;
+
+        // Only once the ring is empty, as the overflow holds the events after it
+        if (overflowing.load(memory_order_acquire)) {
+            deque<vector<uint8_t>> recs;
+            {
+                unique_lock<mutex> lock{overflowLk};
+                recs.swap(overflow);
+                overflowing.store(false, memory_order_release);
             }
-            if (done) return;
-
-            le = q.front();
-            q.pop();
-            qSize = q.size();
-            memUsed = totalMemoryUsage; // want to capture the max mem used, not post flush
-            totalMemoryUsage -= (le->datalen + le->channel.size() + sizeof(*le));
+            for (auto& rec : recs) writeRecord(rec.data(), memUsed);
+            return;
         }
-        if (qSize != 0) ZCM_DEBUG("Queue size = %zu\n", qSize);
 
+        if (!done) ring->wait();
+    }
+
+    void writeEvent(const zcm_eventlog_event_t* le, i64 memUsed)
+    {
         // Is it time to start a new logfile?
         if (args.auto_split_mb) {
             double logsize_mb = (double)logsize / (1 << 20);
@@ -518,22 +647,19 @@ struct Logger
             }
             if (errno == ENOSPC)
                 exit(1);
-
-            delete[] le->data;
-            delete le;
             return;
         }
 
         if (args.fflush_interval_ms >= 0 &&
             (le->timestamp - last_fflush_time) > (u64)args.fflush_interval_ms * 1000) {
-            Platform::fflush(log->getFilePtr());
+            syncWritten();
             last_fflush_time = le->timestamp;
         }
 
-        // bookkeeping, cleanup
+        // bookkeeping
         nevents++;
         events_since_last_report++;
-        logsize += 4 + 8 + 8 + 4 + le->channel.size() + 4 + le->datalen;
+        logsize += 4 + 8 + 8 + 4 + le->channellen + 4 + le->datalen;
 
         i64 offset_utime = le->timestamp - time0;
         if (!args.quiet && (offset_utime - last_report_time > 1000000)) {
@@ -552,14 +678,47 @@ struct Logger
             last_report_logsize = logsize;
         }
 
-        delete[] le->data;
-        delete le;
+        if (offset_utime - last_drop_report_utime > 1000000) {
+            reportDrops("since the last report");
+            last_drop_report_utime = offset_utime;
+        }
+    }
+
+    // Makes what has been written to the log so far durable. Asynchronous logs are
+    // left alone: they write whole buffers as they fill and sync every --sync-mb.
+    // Nor does this end the block being compressed, only what was written before it.
+    void syncWritten()
+    {
+        if (writing_async) return;
+        FILE* f = log->getFilePtr();
+        fflush(f);
+#ifndef WIN32
+        fdatasync(fileno(f));
+#endif
+    }
+
+    // Prints how many messages were dropped on each channel since the last report, or
+    // since the start with 'total'
+    void reportDrops(const char* when, bool total = false)
+    {
+        unique_lock<mutex> lock{dropLk};
+        size_t count = dropped_packets_count - (total ? 0 : last_drop_report_count);
+        if (count == 0) return;
+
+        string perChannel;
+        for (auto& d : drops) {
+            size_t n = d.second - (total ? 0 : drops_reported[d.first]);
+            if (n) perChannel += "  " + d.first + ": " + to_string(n);
+            drops_reported[d.first] = d.second;
+        }
+        fprintf(stderr, "Dropped %zu messages %s for lack of buffer space:%s\n",
+                count, when, perChannel.c_str());
+        last_drop_report_count = dropped_packets_count;
     }
 
     void wakeup()
     {
-        unique_lock<mutex> lock(lk);
-        newEventCond.notify_all();
+        ring->wakeup();
     }
 };
 
@@ -579,33 +738,41 @@ int main(int argc, char *argv[])
     if (!logger.init(argc, argv)) return 1;
 
     // begin logging
-    zcm::ZCM zcmLocal(logger.args.zcmurl);
-    if (!zcmLocal.good()) {
-        cerr << "Couldn't initialize ZCM!" << endl;
-        if (logger.args.zcmurl != "") {
-            cerr << "Unable to parse url: " << logger.args.zcmurl << endl;
-            cerr << "Try running with ZCM_DEBUG=1 for more info" << endl;
-        } else {
-            cerr << "Please provide a valid zcm url either with the ZCM_DEFAULT_URL" << endl
-                 << "environment variable, or with the '-u' command line argument." << endl;
+    vector<string> urls = logger.args.zcmurls;
+    if (urls.empty()) urls.push_back("");
+
+    vector<unique_ptr<zcm::ZCM>> zcms;
+    for (auto& url : urls) {
+        zcms.emplace_back(new zcm::ZCM(url));
+        if (!zcms.back()->good()) {
+            cerr << "Couldn't initialize ZCM!" << endl;
+            if (url != "") {
+                cerr << "Unable to parse url: " << url << endl;
+                cerr << "Try running with ZCM_DEBUG=1 for more info" << endl;
+            } else {
+                cerr << "Please provide a valid zcm url either with the ZCM_DEFAULT_URL" << endl
+                     << "environment variable, or with the '-u' command line argument." << endl;
+            }
+            return 1;
         }
-        return 1;
+        zcms.back()->subscribe(logger.getSubChannel(), &Logger::handler, &logger);
     }
 
-    zcmLocal.subscribe(logger.getSubChannel(), &Logger::handler, &logger);
-
     // Register signal handlers
     signal(SIGINT,  sighandler);
     signal(SIGQUIT, sighandler);
     signal(SIGTERM, sighandler);
 
-    zcmLocal.start();
+    for (auto& z : zcms) z->start();
 
     while (!done) logger.flushWhenReady();
 
-    zcmLocal.stop();
-    zcmLocal.flush();
+    for (auto& z : zcms) {
+        z->stop();
+        z->flush();
+    }
 
+    logger.reportDrops("in total", true);
     cerr << "Logger exiting" << endl;
 
     return 0;
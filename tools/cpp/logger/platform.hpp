@@ -13,15 +13,6 @@
 
 struct Platform
 {
-    static inline void fflush(FILE *fp)
-    {
-        ::fflush(fp);
-#ifndef WIN32
-        // Perform a full fsync operation after flush
-        fdatasync(fileno(fp));
-#endif
-    }
-
     static inline void setstreambuf()
     {
 #ifndef WIN32
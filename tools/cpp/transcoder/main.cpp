@@ -13,11 +13,18 @@
 
 using namespace std;
 
+enum {
+    OPT_COMPRESS = 256,
+    OPT_BLOCK_SIZE,
+};
+
 struct Args
 {
     string inlog       = "";
     string outlog      = "";
     string plugin_path = "";
+    string codec       = "";
+    size_t block_size  = 0;
     bool debug         = false;
 
     bool parse(int argc, char *argv[])
@@ -28,6 +35,8 @@ struct Args
             { "log",         required_argument, 0, 'l' },
             { "output",      required_argument, 0, 'o' },
             { "plugin-path", required_argument, 0, 'p' },
+            { "compress",    optional_argument, 0, OPT_COMPRESS },
+            { "block-size",  required_argument, 0, OPT_BLOCK_SIZE },
             { "debug",       no_argument,       0, 'd' },
             { "help",        no_argument,       0, 'h' },
             { 0, 0, 0, 0 }
@@ -40,6 +49,17 @@ struct Args
                 case 'o': outlog      = string(optarg); break;
                 case 'p': plugin_path = string(optarg); break;
                 case 'd': debug       = true;           break;
+                case OPT_COMPRESS:
+                    codec = optarg ? string(optarg) : "lz4";
+                    break;
+                case OPT_BLOCK_SIZE: {
+                    long size = atol(optarg);
+                    if (size <= 0) {
+                        cerr << "Please specify a block size greater than 0" << endl;
+                        return false;
+                    }
+                    block_size = size;
+                } break;
                 case 'h': default: usage(); return false;
             };
         }
@@ -54,13 +74,15 @@ struct Args
             return false;
         }
 
-        const char* plugin_path_env = getenv("ZCM_LOG_TRANSCODER_PLUGINS_PATH");
-        if (plugin_path == "" && plugin_path_env) plugin_path = plugin_path_env;
-        if (plugin_path == "") {
-            cerr << "No plugin specified. Nothing to do" << endl;
+        if (block_size && codec == "") {
+            cerr << "--block-size requires --compress" << endl;
             return false;
         }
 
+        // Without plugins, events are copied as they are, which converts between formats
+        const char* plugin_path_env = getenv("ZCM_LOG_TRANSCODER_PLUGINS_PATH");
+        if (plugin_path == "" && plugin_path_env) plugin_path = plugin_path_env;
+
         return true;
     }
 
@@ -68,10 +90,14 @@ struct Args
     {
         cout << "usage: zcm-log-transcoder [options]" << endl
              << "" << endl
-             << "    Convert messages in one log file from one zcm type to another" << endl
+             << "    Convert messages in one log file from one zcm type to another," << endl
+             << "    and/or convert the log between the plain and block compressed formats." << endl
+             << "    Logs in either format are read the same." << endl
              << "" << endl
-             << "Example:" << endl
+             << "Examples:" << endl
              << "    zcm-log-transcoder -l zcm.log -o zcmout.log -p path/to/plugin.so" << endl
+             << "    zcm-log-transcoder -l zcm.log -o zcm.lz4.log --compress" << endl
+             << "    zcm-log-transcoder -l zcm.lz4.log -o zcm.log" << endl
              << "" << endl
              << "Options:" << endl
              << "" << endl
@@ -81,6 +107,10 @@ struct Args
              << "  -p, --plugin-path=path  Path to shared library containing transcoder plugins" << endl
              << "                          Can also be specified via the environment variable" << endl
              << "                          ZCM_LOG_TRANSCODER_PLUGINS_PATH" << endl
+             << "                          Without plugins, events are copied unchanged" << endl
+             << "      --compress[=codec]  Write the output in independently compressed" << endl
+             << "                          blocks, with the given codec (default: lz4)" << endl
+             << "      --block-size=bytes  Uncompressed size of the blocks (default: 256 KiB)" << endl
              << "  -d, --debug             Run a dry run to ensure proper transcoder setup" << endl
              << endl << endl;
     }
@@ -96,21 +126,23 @@ int main(int argc, char* argv[])
         cerr << "Unable to open input zcm log: " << args.inlog << endl;
         return 1;
     }
-    fseeko(inlog.getFilePtr(), 0, SEEK_END);
-    off64_t logSize = ftello(inlog.getFilePtr());
-    fseeko(inlog.getFilePtr(), 0, SEEK_SET);
+    off64_t logSize = inlog.getLength();
 
     zcm::LogFile outlog(args.outlog, "w");
     if (!outlog.good()) {
         cerr << "Unable to open output zcm log: " << args.inlog << endl;
         return 1;
     }
+    if (args.codec != "" && outlog.writeCompressed(args.codec, args.block_size) != 0) {
+        cerr << "Unable to compress with codec: " << args.codec << endl;
+        return 1;
+    }
 
 
     vector<zcm::TranscoderPlugin*> plugins;
     TranscoderPluginDb pluginDb(args.plugin_path, args.debug);
     vector<const zcm::TranscoderPlugin*> dbPlugins = pluginDb.getPlugins();
-    if (dbPlugins.empty()) {
+    if (args.plugin_path != "" && dbPlugins.empty()) {
         cerr << "Couldn't find any plugins. Aborting." << endl;
         return 1;
     }
@@ -127,7 +159,7 @@ int main(int argc, char* argv[])
     off64_t offset;
 
     while (1) {
-        offset = ftello(inlog.getFilePtr());
+        offset = inlog.getOffset();
 
         static int lastPrintPercent = 0;
         int percent = (100.0 * offset / (logSize == 0 ? 1 : logSize)) * 100;
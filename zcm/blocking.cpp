@@ -2,7 +2,12 @@
 #include "zcm/zcm_private.h"
 #include "zcm/blocking.h"
 #include "zcm/transport.h"
-#include "zcm/util/threadsafe_queue.hpp"
+#include "zcm/transport_registrar.h"
+#include "zcm/util/serial_producer_queue.hpp"
+#include "zcm/util/slab_allocator.hpp"
+#include "zcm/util/channel_matcher.hpp"
+#include "zcm/util/rcu.hpp"
+#include "zcm/util/strand_pool.hpp"
 #include "zcm/util/debug.h"
 
 #include "util/TimeUtil.hpp"
@@ -12,6 +17,7 @@
 #include <cstring>
 
 #include <unordered_map>
+#include <memory>
 #include <vector>
 #include <string>
 #include <iostream>
@@ -38,33 +44,60 @@ using namespace std;
 #endif
 
 // A C++ class that manages a zcm_msg_t*
+// Note: the payload lives in memory owned by a SlabAllocator and the channel is stored
+//       inline so that queueing a message never has to touch the system allocator
 struct Msg
 {
     zcm_msg_t msg;
+    char channel[ZCM_CHANNEL_MAXLEN + 1];
+    SlabAllocator* slab;
+
+    // Tag to select the constructor that takes ownership of a buffer from 'slab'
+    struct Adopt {};
 
     // NOTE: copy the provided data into this object
-    Msg(uint64_t utime, const char* channel, size_t len, const uint8_t* buf)
+    Msg(SlabAllocator& slab, uint64_t utime, const char* channel, size_t len, const uint8_t* buf)
+        : Msg(slab, Adopt{}, utime, channel, len, slab.alloc(len))
+    {
+        ZCM_ASSERT(msg.buf);
+        memcpy(msg.buf, buf, len);
+    }
+
+    Msg(SlabAllocator& slab, zcm_msg_t* msg)
+        : Msg(slab, msg->utime, msg->channel, msg->len, msg->buf) {}
+
+    // NOTE: take ownership of 'buf', which must have been allocated by 'slab'
+    Msg(SlabAllocator& slab, Adopt, uint64_t utime, const char* channel, size_t len, uint8_t* buf)
+        : slab(&slab)
     {
         msg.utime = utime;
-        msg.channel = strdup(channel);
+        size_t chanLen = strnlen(channel, ZCM_CHANNEL_MAXLEN);
+        memcpy(this->channel, channel, chanLen);
+        this->channel[chanLen] = '\0';
+        msg.channel = nullptr;
         msg.len = len;
-        msg.buf = (uint8_t*)malloc(len);
-        memcpy(msg.buf, buf, len);
+        msg.buf = buf;
     }
 
-    Msg(zcm_msg_t* msg) : Msg(msg->utime, msg->channel, msg->len, msg->buf) {}
+    // Gives up ownership of the payload, which the caller must return to 'slab'
+    uint8_t* release()
+    {
+        uint8_t* buf = msg.buf;
+        msg.buf = nullptr;
+        return buf;
+    }
 
     ~Msg()
     {
-        if (msg.channel)
-            free((void*)msg.channel);
-        if (msg.buf)
-            free((void*)msg.buf);
+        slab->free(msg.buf);
         memset(&msg, 0, sizeof(msg));
     }
 
     zcm_msg_t* get()
     {
+        // Queue relocates its elements bitwise, so the channel pointer must be
+        // refreshed every time rather than captured at construction
+        msg.channel = channel;
         return &msg;
     }
 
@@ -76,28 +109,8 @@ struct Msg
     Msg& operator=(Msg&& other) = delete;
 };
 
-static bool isRegexChannel(const string& channel)
-{
-    // These chars are considered regex
-    auto isRegexChar = [](char c) {
-        return c == '(' || c == ')' || c == '|' ||
-        c == '.' || c == '*' || c == '+';
-    };
-
-    for (auto& c : channel)
-        if (isRegexChar(c))
-            return true;
-
-    return false;
-}
-
 struct zcm_blocking
 {
-  private:
-    // XXX If we change this to a linked list implementation, we can probably
-    //     support subscribing/unsubscribing from within subscription callback handlers
-    using SubList = vector<zcm_sub_t*>;
-
   public:
     zcm_blocking(zcm_t* z, zcm_trans_t* zt_);
     ~zcm_blocking();
@@ -111,18 +124,25 @@ struct zcm_blocking
     void resume();
 
     int publish(const string& channel, const uint8_t* data, uint32_t len);
+    int publishLoan(uint32_t len, uint8_t** buf);
+    int publishCommit(const string& channel, uint8_t* buf, uint32_t len);
+    void publishCancel(uint8_t* buf);
     zcm_sub_t* subscribe(const string& channel, zcm_msg_handler_t cb, void* usr, bool block);
     int unsubscribe(zcm_sub_t* sub, bool block);
     int flush(bool block);
 
     int setQueueSize(uint32_t numMsgs, bool block);
+    int setDispatchThreads(uint32_t numThreads);
 
   private:
+    void startSendThread();
     void sendThreadFunc();
     void recvThreadFunc();
     void hndlThreadFunc();
+    void setReceiving(bool* flag, bool value);
 
     void dispatchMsg(zcm_msg_t* msg);
+    void distributeMsg(Msg* m);
     bool dispatchOneMessage(bool returnIfPaused);
     bool sendOneMessage(bool returnIfPaused);
 
@@ -130,24 +150,77 @@ struct zcm_blocking
     mutex dispOneMutex;
     mutex sendOneMutex;
 
-    bool deleteSubEntry(zcm_sub_t* sub, size_t nentriesleft);
-    bool deleteFromSubList(SubList& slist, zcm_sub_t* sub);
+    static void deleteSub(zcm_sub_t* sub);
 
     zcm_t* z;
     zcm_trans_t* zt;
-    unordered_map<string, SubList> subs;
-    SubList subRegex;
     size_t mtu;
 
-    // These 2 mutexes used to implement a read-write style infrastructure on the subscription
-    // lists. Both the recvThread and the message dispatch may read the subscriptions
-    // concurrently, but subscribe() and unsubscribe() need both locks in order to write to it.
-    mutex subDispMutex;
-    mutex subRecvMutex;
+    // An immutable view of every subscription. subscribe() and unsubscribe() publish
+    // a modified copy, so the recv thread and message dispatch never take a lock
+    // to read it, and callbacks are free to (un)subscribe.
+    struct SubSnapshot
+    {
+        ChannelMatcher matcher;
+        // Subscriptions are freed once no snapshot (or pending unsubscribe) refers to them
+        unordered_map<zcm_sub_t*, shared_ptr<zcm_sub_t>> owned;
+    };
+    Rcu<SubSnapshot> subs {make_shared<SubSnapshot>()};
+
+    // Serializes subscribe() and unsubscribe()
+    mutex subWriteMutex;
+
+    // Subscriptions that have been removed from 'subs' but may still have a callback
+    // in flight, along with the version of the snapshot that removed them.
+    // Guarded by subWriteMutex
+    struct PendingUnsub
+    {
+        uint64_t version;
+        shared_ptr<zcm_sub_t> sub;
+    };
+    unordered_map<zcm_sub_t*, PendingUnsub> pendingUnsubs;
+
+    // The recv thread only filters on the snapshot, dispatch runs callbacks inside it
+    Rcu<SubSnapshot>::Reader recvSubs {subs};
+    Rcu<SubSnapshot>::Reader dispSubs {subs};
+
+    // Per-reader memo of which subscriptions match a channel, so the regex and prefix
+    // matching only runs the first time a channel is seen after a (un)subscribe.
+    // Only touched by the recv thread and under dispOneMutex respectively.
+    ChannelMatchCache recvMatchCache;
+    ChannelMatchCache dispMatchCache;
 
     static constexpr size_t QUEUE_SIZE = 16;
-    ThreadsafeQueue<Msg> sendQueue {QUEUE_SIZE};
-    ThreadsafeQueue<Msg> recvQueue {QUEUE_SIZE};
+
+    // Backs the payloads of every Msg in the queues below. Must be declared before
+    // the queues so that it outlives any messages still queued at destruction.
+    // Each size class keeps enough free blocks to refill both queues.
+    SlabAllocator slab {2 * QUEUE_SIZE};
+
+    // Optional dispatch thread pool (see zcm_set_dispatch_threads()). Every
+    // subscription gets its own strand, so each subscription sees its messages in
+    // order and never runs concurrently with itself, while different subscriptions
+    // are dispatched in parallel. The handler thread only hands messages out.
+    struct DispStrand
+    {
+        shared_ptr<zcm_sub_t> sub;
+    };
+    using DispPool = StrandPool<DispStrand, shared_ptr<Msg>>;
+    void runDispTask(size_t worker, DispStrand& strand, shared_ptr<Msg>& m);
+    DispPool dispPool {[this](size_t worker, DispStrand& strand, shared_ptr<Msg>& m) {
+                           runDispTask(worker, strand, m);
+                       }, QUEUE_SIZE};
+    // One snapshot reader per worker; drain() runs under dispOneMutex and uses dispSubs
+    vector<unique_ptr<Rcu<SubSnapshot>::Reader>> workerSubs;
+    // Strand of each subscription, rebuilt as subscriptions change (under dispOneMutex)
+    unordered_map<zcm_sub_t*, shared_ptr<DispPool::Strand>> dispStrands;
+    uint64_t dispStrandsGen = 0;
+
+    // Both queues have a single consumer (the ...OneMutex holder). The recvQueue has a
+    // single producer (the recv thread); the sendQueue is pushed to by any publisher,
+    // which the queue serializes.
+    SerialProducerQueue<Msg> sendQueue {QUEUE_SIZE};
+    SerialProducerQueue<Msg> recvQueue {QUEUE_SIZE};
 
     typedef enum {
         RECV_MODE_NONE = 0,
@@ -187,6 +260,12 @@ struct zcm_blocking
     bool               paused {false};
     condition_variable sendPauseCond;
     condition_variable hndlPauseCond;
+
+    // Whether messages are being taken from the transport, which it is told
+    // of: from start() to stop(), while not paused
+    mutex receivingMutex;
+    bool  recvStarted {false};
+    bool  recvPaused {false};
 };
 
 zcm_blocking_t::zcm_blocking(zcm_t* z, zcm_trans_t* zt_)
@@ -194,6 +273,7 @@ zcm_blocking_t::zcm_blocking(zcm_t* z, zcm_trans_t* zt_)
     ZCM_ASSERT(z->type == ZCM_BLOCKING);
     zt = zt_;
     mtu = zcm_trans_get_mtu(zt);
+    zcm_trans_set_receiving(zt, false);
 }
 
 zcm_blocking_t::~zcm_blocking()
@@ -204,16 +284,7 @@ zcm_blocking_t::~zcm_blocking()
     // Destroy the transport
     zcm_trans_destroy(zt);
 
-    // Need to delete all subs
-    for (auto& it : subs) {
-        for (auto& sub : it.second) {
-            delete sub;
-        }
-    }
-    for (auto& sub : subRegex) {
-        delete (regex*) sub->regexobj;
-        delete sub;
-    }
+    // Subscriptions are freed along with the last snapshot holding them
 }
 
 void zcm_blocking_t::run()
@@ -232,6 +303,7 @@ void zcm_blocking_t::run()
         hndlThreadState = THREAD_STATE_RUNNING;
         recvQueue.enable();
     }
+    setReceiving(&recvStarted, true);
     hndlThreadFunc();
 
     // Restore the "non-running" state
@@ -248,6 +320,7 @@ void zcm_blocking_t::start()
         return;
     }
     recvMode = RECV_MODE_SPAWN;
+    setReceiving(&recvStarted, true);
 
     unique_lock<mutex> lk2(hndlStateMutex);
     lk1.unlock();
@@ -260,6 +333,7 @@ void zcm_blocking_t::start()
 int zcm_blocking_t::stop(bool block)
 {
     unique_lock<mutex> lk1(recvModeMutex);
+    setReceiving(&recvStarted, false);
 
     // Shutdown recv and hndl threads
     if (recvMode == RECV_MODE_RUN || recvMode == RECV_MODE_SPAWN) {
@@ -357,6 +431,7 @@ int zcm_blocking_t::handle()
         // If this is the first time handle() is called, we need to start the recv thread
         if (recvMode == RECV_MODE_NONE) {
             recvMode = RECV_MODE_HANDLE;
+            setReceiving(&recvStarted, true);
 
             unique_lock<mutex> lk2(recvStateMutex);
             lk1.unlock();
@@ -376,6 +451,8 @@ void zcm_blocking_t::pause()
     unique_lock<mutex> lk1(sendStateMutex);
     unique_lock<mutex> lk2(hndlStateMutex);
     paused = true;
+    dispPool.pause();
+    setReceiving(&recvPaused, true);
 }
 
 void zcm_blocking_t::resume()
@@ -383,6 +460,8 @@ void zcm_blocking_t::resume()
     unique_lock<mutex> lk1(sendStateMutex);
     unique_lock<mutex> lk2(hndlStateMutex);
     paused = false;
+    dispPool.resume();
+    setReceiving(&recvPaused, false);
     lk2.unlock();
     lk1.unlock();
     sendPauseCond.notify_all();
@@ -398,40 +477,73 @@ int zcm_blocking_t::publish(const string& channel, const uint8_t* data, uint32_t
     if (len > mtu) return ZCM_EINVALID;
     if (channel.size() > ZCM_CHANNEL_MAXLEN) return ZCM_EINVALID;
 
-    // If needed: spawn the send thread
-    {
-        unique_lock<mutex> lk(sendStateMutex);
-        if (sendThreadState == THREAD_STATE_STOPPED) {
-            sendThreadState = THREAD_STATE_RUNNING;
-            sendThread = thread{&zcm_blocking::sendThreadFunc, this};
-        }
-    }
+    startSendThread();
 
-    bool success = sendQueue.pushIfRoom(TimeUtil::utime(), channel.c_str(), len, data);
+    bool success = sendQueue.pushIfRoom(slab, TimeUtil::utime(), channel.c_str(), len, data);
     if (!success) ZCM_DEBUG("sendQueue has no free space");
     return success ? ZCM_EOK : ZCM_EAGAIN;
 }
 
-// Note: We use a lock on subscribe() to make sure it can be
-// called concurrently. Without the lock, there is a race
-// on modifying and reading the 'subs' and 'subRegex' containers
+int zcm_blocking_t::publishLoan(uint32_t len, uint8_t** buf)
+{
+    *buf = nullptr;
+    if (len > mtu) return ZCM_EINVALID;
+    *buf = slab.alloc(len);
+    if (!*buf) {
+        ZCM_DEBUG("failed to allocate a %u byte loan", len);
+        return ZCM_EMEMORY;
+    }
+    return ZCM_EOK;
+}
+
+// Note: ownership of 'buf' returns to us whether or not the commit succeeds
+int zcm_blocking_t::publishCommit(const string& channel, uint8_t* buf, uint32_t len)
+{
+    if (!buf) return ZCM_EINVALID;
+
+    // Check the validity of the request
+    if (len > mtu || len > SlabAllocator::capacity(buf) ||
+        channel.size() > ZCM_CHANNEL_MAXLEN) {
+        slab.free(buf);
+        return ZCM_EINVALID;
+    }
+
+    startSendThread();
+
+    bool success = sendQueue.pushIfRoom(slab, Msg::Adopt{}, TimeUtil::utime(),
+                                        channel.c_str(), len, buf);
+    if (!success) {
+        ZCM_DEBUG("sendQueue has no free space");
+        slab.free(buf);
+    }
+    return success ? ZCM_EOK : ZCM_EAGAIN;
+}
+
+void zcm_blocking_t::publishCancel(uint8_t* buf)
+{
+    slab.free(buf);
+}
+
+// Note: subscribe() and unsubscribe() publish a new snapshot of the subscriptions
+// under subWriteMutex, so they may be called concurrently (including from within
+// a callback) without ever blocking message dispatch
 zcm_sub_t* zcm_blocking_t::subscribe(const string& channel,
                                      zcm_msg_handler_t cb, void* usr,
                                      bool block)
 {
-    unique_lock<mutex> lk1(subDispMutex, std::defer_lock);
-    unique_lock<mutex> lk2(subRecvMutex, std::defer_lock);
+    unique_lock<mutex> lk(subWriteMutex, std::defer_lock);
     if (block) {
-        lk1.lock();
-        lk2.lock();
-    } else if (!lk1.try_lock() || !lk2.try_lock()) {
+        lk.lock();
+    } else if (!lk.try_lock()) {
         return nullptr;
     }
     int rc;
 
-    bool regex = isRegexChannel(channel);
+    shared_ptr<const SubSnapshot> cur = subs.load();
+
+    bool regex = ChannelMatcher::isRegexChannel(channel);
     if (regex) {
-        if (subRegex.size() == 0) {
+        if (cur->matcher.numRegex() == 0) {
             rc = zcm_trans_recvmsg_enable(zt, NULL, true);
         } else {
             rc = ZCM_EOK;
@@ -456,48 +568,72 @@ zcm_sub_t* zcm_blocking_t::subscribe(const string& channel,
     if (regex) {
         sub->regexobj = (void*) new std::regex(sub->channel);
         ZCM_ASSERT(sub->regexobj);
-        subRegex.push_back(sub);
-    } else {
-        subs[channel].push_back(sub);
     }
 
+    auto next = make_shared<SubSnapshot>(*cur);
+    next->matcher.add(sub);
+    next->owned.emplace(sub, shared_ptr<zcm_sub_t>(sub, deleteSub));
+    subs.publish(move(next));
+
     return sub;
 }
 
-// Note: We use a lock on unsubscribe() to make sure it can be
-// called concurrently. Without the lock, there is a race
-// on modifying and reading the 'subs' and 'subRegex' containers
+// Note: Once this returns ZCM_EOK, the subscription's callback will not be called
+// again and is not running in any other thread, so its 'usr' data may be freed.
+// The non-blocking variant returns ZCM_EAGAIN (having already unsubscribed) while
+// a callback may still be in flight; call it again until it succeeds.
+// When called from within a callback, this does not wait for other callbacks.
 int zcm_blocking_t::unsubscribe(zcm_sub_t* sub, bool block)
 {
-    unique_lock<mutex> lk1(subDispMutex, std::defer_lock);
-    unique_lock<mutex> lk2(subRecvMutex, std::defer_lock);
+    unique_lock<mutex> lk(subWriteMutex, std::defer_lock);
     if (block) {
-        lk1.lock();
-        lk2.lock();
-    } else if (!lk1.try_lock() || !lk2.try_lock()) {
+        lk.lock();
+    } else if (!lk.try_lock()) {
         return ZCM_EAGAIN;
     }
 
-    bool success = true;
-    if (sub->regex) {
-        success = deleteFromSubList(subRegex, sub);
-    } else {
-        auto it = subs.find(sub->channel);
-        if (it == subs.end()) {
-            ZCM_DEBUG("failed to find the subscription channel in unsubscribe()");
+    int ret = ZCM_EOK;
+
+    auto pending = pendingUnsubs.find(sub);
+    if (pending == pendingUnsubs.end()) {
+        shared_ptr<const SubSnapshot> cur = subs.load();
+        auto owned = cur->owned.find(sub);
+        if (owned == cur->owned.end()) {
+            ZCM_DEBUG("failed to find the subscription entry in unsubscribe()");
             return ZCM_EINVALID;
         }
 
-        SubList& slist = it->second;
-        success = deleteFromSubList(slist, sub);
+        auto next = make_shared<SubSnapshot>(*cur);
+        size_t nentriesleft = 0;
+        bool removed = next->matcher.remove(sub, nentriesleft);
+        ZCM_ASSERT(removed);
+        (void) removed;
+        next->owned.erase(sub);
+
+        if (nentriesleft == 0) {
+            int rc = zcm_trans_recvmsg_enable(zt, sub->regex ? NULL : sub->channel, false);
+            if (rc != ZCM_EOK) {
+                ZCM_DEBUG("failed to disable the transport channel in unsubscribe()");
+                ret = ZCM_EINVALID;
+            }
+        }
+
+        uint64_t version = subs.publish(move(next));
+        pending = pendingUnsubs.emplace(sub, PendingUnsub{version, owned->second}).first;
     }
 
-    if (!success) {
-        ZCM_DEBUG("failed to find the subscription entry in unsubscribe()");
-        return ZCM_EINVALID;
+    // Wait out any dispatch that started before the subscription was removed.
+    // The lock is dropped meanwhile so that those callbacks may (un)subscribe too.
+    uint64_t version = pending->second.version;
+    if (!subs.quiescent(version)) {
+        if (!block) return ZCM_EAGAIN;
+        lk.unlock();
+        while (!subs.quiescent(version)) this_thread::sleep_for(chrono::microseconds(100));
+        lk.lock();
     }
+    pendingUnsubs.erase(sub);
 
-    return 0;
+    return ret;
 }
 
 int zcm_blocking_t::flush(bool block)
@@ -518,6 +654,9 @@ int zcm_blocking_t::flush(bool block)
         sendQueue.enable();
         n = sendQueue.numMessages();
         for (size_t i = 0; i < n; ++i) sendOneMessage(false);
+
+        // ... including whatever the transport is holding on to
+        zcm_trans_flush(zt);
     }
 
     {
@@ -534,6 +673,9 @@ int zcm_blocking_t::flush(bool block)
         recvQueue.enable();
         n = recvQueue.numMessages();
         for (size_t i = 0; i < n; ++i) dispatchOneMessage(false);
+
+        // Anything handed to the dispatch threads must be done as well
+        dispPool.drain();
     }
 
     return ZCM_EOK;
@@ -553,7 +695,11 @@ int zcm_blocking_t::setQueueSize(uint32_t numMsgs, bool block)
             return ZCM_EAGAIN;
         }
 
-        sendQueue.setCapacity(numMsgs);
+        if (!sendQueue.setCapacity(numMsgs, block)) {
+            sendQueue.enable();
+            return ZCM_EAGAIN;
+        }
+        slab.setMaxFreePerClass(2 * numMsgs);
         sendQueue.enable();
     }
 
@@ -569,13 +715,53 @@ int zcm_blocking_t::setQueueSize(uint32_t numMsgs, bool block)
             return ZCM_EAGAIN;
         }
 
-        recvQueue.setCapacity(numMsgs);
+        if (!recvQueue.setCapacity(numMsgs, block)) {
+            recvQueue.enable();
+            return ZCM_EAGAIN;
+        }
+        dispPool.setCapacity(numMsgs);
         recvQueue.enable();
     }
 
     return ZCM_EOK;
 }
 
+int zcm_blocking_t::setDispatchThreads(uint32_t numThreads)
+{
+    unique_lock<mutex> lk1(recvModeMutex);
+    if (recvMode != RECV_MODE_NONE) {
+        ZCM_DEBUG("Err: call to setDispatchThreads() when 'recvMode != RECV_MODE_NONE'");
+        return ZCM_EAGAIN;
+    }
+
+    unique_lock<mutex> lk2(dispOneMutex);
+
+    // A single dispatch thread is just the handler thread itself
+    size_t numWorkers = numThreads > 1 ? numThreads : 0;
+    if (dispPool.getNumWorkers() == numWorkers) return ZCM_EOK;
+
+    if (!dispPool.setNumWorkers(numWorkers)) {
+        ZCM_DEBUG("Err: messages from a previous run are still waiting to be dispatched");
+        return ZCM_EAGAIN;
+    }
+
+    dispStrands.clear();
+    workerSubs.clear();
+    for (size_t i = 0; i < numWorkers; ++i)
+        workerSubs.emplace_back(new Rcu<SubSnapshot>::Reader(subs));
+
+    return ZCM_EOK;
+}
+
+void zcm_blocking_t::startSendThread()
+{
+    unique_lock<mutex> lk(sendStateMutex);
+    if (sendThreadState == THREAD_STATE_STOPPED) {
+        sendThreadState = THREAD_STATE_RUNNING;
+        sendThread = thread{&zcm_blocking::sendThreadFunc, this};
+    }
+}
+
 void zcm_blocking_t::sendThreadFunc()
 {
     // Name the send thread
@@ -610,36 +796,27 @@ void zcm_blocking_t::recvThreadFunc()
         zcm_msg_t msg;
         int rc = zcm_trans_recvmsg(zt, &msg, RECV_TIMEOUT);
         if (rc == ZCM_EOK) {
-            {
-                unique_lock<mutex> lk(subRecvMutex);
-
-                // Check if message matches a non regex channel
-                auto it = subs.find(msg.channel);
-                if (it == subs.end()) {
-                    // Check if message matches a regex channel
-                    bool foundRegex = false;
-                    for (zcm_sub_t* sub : subRegex) {
-                        regex* r = (regex*)sub->regexobj;
-                        if (regex_match(msg.channel, *r)) {
-                            foundRegex = true;
-                            break;
-                        }
-                    }
-                    // No subscription actually wants the message
-                    if (!foundRegex) continue;
-                }
-            }
+            // No subscription actually wants the message
+            const SubSnapshot& snap = recvSubs.peek();
+            if (recvMatchCache.lookup(snap.matcher, msg.channel).empty()) continue;
 
             // Note: After this returns, you have either successfully pushed a message
             //       into the queue, or the queue was disabled and you will quit out of
             //       this loop when you re-check the running condition
-            recvQueue.push(&msg);
+            recvQueue.push(slab, &msg);
         }
     }
     unique_lock<mutex> lk(recvStateMutex);
     recvThreadState = THREAD_STATE_HALTED;
 }
 
+void zcm_blocking_t::setReceiving(bool* flag, bool value)
+{
+    unique_lock<mutex> lk(receivingMutex);
+    *flag = value;
+    zcm_trans_set_receiving(zt, recvStarted && !recvPaused);
+}
+
 void zcm_blocking_t::hndlThreadFunc()
 {
     // Name the handle thread
@@ -652,6 +829,16 @@ void zcm_blocking_t::hndlThreadFunc()
         recvThread = thread{&zcm_blocking::recvThreadFunc, this};
     }
 
+    // Spawn the dispatch threads, if any
+    {
+        unique_lock<mutex> lk(dispOneMutex);
+        dispPool.start([](size_t i) {
+            char name[16];
+            snprintf(name, sizeof(name), "ZeroCM_disp%zu", i);
+            SET_THREAD_NAME(name);
+        });
+    }
+
     // Become the handle thread
     while (true) {
         {
@@ -665,6 +852,12 @@ void zcm_blocking_t::hndlThreadFunc()
         dispatchOneMessage(true);
     }
 
+    {
+        // Shutdown the dispatch threads
+        unique_lock<mutex> lk(dispOneMutex);
+        dispPool.stop();
+    }
+
     {
         // Shutdown recv thread
         unique_lock<mutex> lk(recvStateMutex);
@@ -686,29 +879,19 @@ void zcm_blocking_t::dispatchMsg(zcm_msg_t* msg)
     rbuf.data = msg->buf;
     rbuf.data_size = msg->len;
 
-    // Note: We use a lock on dispatch to ensure there is not
-    // a race on modifying and reading the 'subs' container.
-    // This means users cannot call zcm_subscribe or
-    // zcm_unsubscribe from a callback without deadlocking.
-    {
-        unique_lock<mutex> lk(subDispMutex);
-
-        // dispatch to a non regex channel
-        auto it = subs.find(msg->channel);
-        if (it != subs.end()) {
-            for (zcm_sub_t* sub : it->second) {
-                sub->callback(&rbuf, msg->channel, sub->usr);
-            }
-        }
+    // Note: The snapshot cannot change underneath us, but a callback (or another
+    // thread) may unsubscribe one of the subscriptions we are about to call. Once
+    // the version moves on, check each remaining one is still current.
+    const SubSnapshot& snap = dispSubs.enter();
+    uint64_t version = dispSubs.version();
 
-        // dispatch to any regex channels
-        for (zcm_sub_t* sub : subRegex) {
-            regex* r = (regex*)sub->regexobj;
-            if (regex_match(msg->channel, *r)) {
-                sub->callback(&rbuf, msg->channel, sub->usr);
-            }
-        }
+    // dispatch to non regex channels first, then to any matching regex channels
+    for (zcm_sub_t* sub : dispMatchCache.lookup(snap.matcher, msg->channel)) {
+        if (subs.version() != version && subs.load()->owned.count(sub) == 0) continue;
+        sub->callback(&rbuf, msg->channel, sub->usr);
     }
+
+    dispSubs.exit();
 }
 
 bool zcm_blocking_t::dispatchOneMessage(bool returnIfPaused)
@@ -723,11 +906,68 @@ bool zcm_blocking_t::dispatchOneMessage(bool returnIfPaused)
         if (paused || hndlThreadState == THREAD_STATE_HALTING) return false;
     }
 
-    dispatchMsg(m->get());
+    if (dispPool.isRunning()) {
+        distributeMsg(m);
+    } else {
+        dispatchMsg(m->get());
+    }
     recvQueue.pop();
     return true;
 }
 
+// Note: must be called under dispOneMutex
+void zcm_blocking_t::distributeMsg(Msg* m)
+{
+    const SubSnapshot& snap = dispSubs.peek();
+    const ChannelMatcher::SubList& matched = dispMatchCache.lookup(snap.matcher, m->channel);
+    if (matched.empty()) return;
+
+    // Forget the strands of subscriptions that are gone
+    if (dispStrandsGen != snap.matcher.generation()) {
+        for (auto it = dispStrands.begin(); it != dispStrands.end();) {
+            if (snap.owned.count(it->first) == 0) it = dispStrands.erase(it);
+            else ++it;
+        }
+        dispStrandsGen = snap.matcher.generation();
+    }
+
+    // Move the payload out of the queue so every subscription can share it
+    zcm_msg_t* msg = m->get();
+    auto shared = make_shared<Msg>(slab, Msg::Adopt{}, msg->utime, m->channel,
+                                   msg->len, m->release());
+    shared->get();
+
+    for (zcm_sub_t* sub : matched) {
+        auto& strand = dispStrands[sub];
+        if (!strand) {
+            strand = dispPool.makeStrand(DispStrand{snap.owned.at(sub)},
+                                         std::hash<string>()(sub->channel));
+        }
+        dispPool.push(strand, shared);
+    }
+}
+
+void zcm_blocking_t::runDispTask(size_t worker, DispStrand& strand, shared_ptr<Msg>& m)
+{
+    // drain() only ever runs under dispOneMutex, so it may borrow dispSubs
+    Rcu<SubSnapshot>::Reader& reader =
+        worker < workerSubs.size() ? *workerSubs[worker] : dispSubs;
+
+    // Unsubscribing waits for this section, so checking membership inside it
+    // guarantees we never call a subscription after its unsubscribe() returned
+    const SubSnapshot& snap = reader.enter();
+    zcm_sub_t* sub = strand.sub.get();
+    if (snap.owned.count(sub) != 0) {
+        zcm_recv_buf_t rbuf;
+        rbuf.recv_utime = m->msg.utime;
+        rbuf.zcm = z;
+        rbuf.data = m->msg.buf;
+        rbuf.data_size = m->msg.len;
+        sub->callback(&rbuf, m->msg.channel, sub->usr);
+    }
+    reader.exit();
+}
+
 bool zcm_blocking_t::sendOneMessage(bool returnIfPaused)
 {
     Msg* m = sendQueue.top();
@@ -747,36 +987,10 @@ bool zcm_blocking_t::sendOneMessage(bool returnIfPaused)
     return true;
 }
 
-bool zcm_blocking_t::deleteSubEntry(zcm_sub_t* sub, size_t nentriesleft)
+void zcm_blocking_t::deleteSub(zcm_sub_t* sub)
 {
-    int rc = ZCM_EOK;
-    if (sub->regex) {
-        delete (std::regex*) sub->regexobj;
-        if (nentriesleft == 0) {
-            rc = zcm_trans_recvmsg_enable(zt, NULL, false);
-        }
-    } else {
-        if (nentriesleft == 0) {
-            rc = zcm_trans_recvmsg_enable(zt, sub->channel, false);
-        }
-    }
+    if (sub->regex) delete (std::regex*) sub->regexobj;
     delete sub;
-    return rc == ZCM_EOK;
-}
-
-bool zcm_blocking_t::deleteFromSubList(SubList& slist, zcm_sub_t* sub)
-{
-    for (size_t i = 0; i < slist.size(); i++) {
-        if (slist[i] == sub) {
-            // shrink the array by moving the last element
-            size_t last = slist.size() - 1;
-            slist[i] = slist[last];
-            slist.resize(last);
-            // delete the element
-            return deleteSubEntry(sub, slist.size());
-        }
-    }
-    return false;
 }
 
 /////////////// C Interface Functions ////////////////
@@ -813,6 +1027,22 @@ int zcm_blocking_unsubscribe(zcm_blocking_t* zcm, zcm_sub_t* sub)
     return zcm->unsubscribe(sub, true);
 }
 
+int zcm_blocking_publish_loan(zcm_blocking_t* zcm, uint32_t len, uint8_t** buf)
+{
+    return zcm->publishLoan(len, buf);
+}
+
+int zcm_blocking_publish_commit(zcm_blocking_t* zcm, const char* channel,
+                                uint8_t* buf, uint32_t len)
+{
+    return zcm->publishCommit(channel, buf, len);
+}
+
+void zcm_blocking_publish_cancel(zcm_blocking_t* zcm, uint8_t* buf)
+{
+    zcm->publishCancel(buf);
+}
+
 void zcm_blocking_flush(zcm_blocking_t* zcm)
 {
     zcm->flush(true);
@@ -848,6 +1078,11 @@ int zcm_blocking_handle(zcm_blocking_t* zcm)
     return zcm->handle();
 }
 
+int zcm_blocking_set_dispatch_threads(zcm_blocking_t* zcm, uint32_t numThreads)
+{
+    return zcm->setDispatchThreads(numThreads);
+}
+
 void zcm_blocking_set_queue_size(zcm_blocking_t* zcm, uint32_t sz)
 {
     zcm->setQueueSize(sz, true);
@@ -15,6 +15,10 @@ void zcm_blocking_destroy(zcm_blocking_t* zcm);
 
 int zcm_blocking_publish(zcm_blocking_t* zcm, const char* channel,
                          const uint8_t* data, uint32_t len);
+int zcm_blocking_publish_loan(zcm_blocking_t* zcm, uint32_t len, uint8_t** buf);
+int zcm_blocking_publish_commit(zcm_blocking_t* zcm, const char* channel,
+                                uint8_t* buf, uint32_t len);
+void zcm_blocking_publish_cancel(zcm_blocking_t* zcm, uint8_t* buf);
 
 zcm_sub_t* zcm_blocking_subscribe(zcm_blocking_t* zcm, const char* channel,
                                   zcm_msg_handler_t cb, void* usr);
@@ -30,6 +34,7 @@ void zcm_blocking_pause(zcm_blocking_t* zcm);
 void zcm_blocking_resume(zcm_blocking_t* zcm);
 int  zcm_blocking_handle(zcm_blocking_t* zcm);
 void zcm_blocking_set_queue_size(zcm_blocking_t* zcm, uint32_t numMsgs);
+int  zcm_blocking_set_dispatch_threads(zcm_blocking_t* zcm, uint32_t numThreads);
 
 
 
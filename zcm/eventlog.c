@@ -1,10 +1,94 @@
 #include "zcm/eventlog.h"
+#include "zcm/zcm.h"
+#include "zcm/transport/codec.h"
 #include "zcm/util/ioutils.h"
+#include "zcm/util/aio_writer.h"
 #include <assert.h>
 #include <string.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #define MAGIC ((int32_t) 0xEDA1DA01L)
 
+// Bytes of an event between its magic and its channel
+#define HEADER_SIZE (sizeof(int64_t) * 2 + sizeof(int32_t) * 2)
+#define EVENT_SIZE(le) (sizeof(int32_t) + HEADER_SIZE + (le)->channellen + (le)->datalen)
+
+// How far ahead of a mapped reader the kernel is asked to read
+#define READAHEAD_SIZE ((size_t) 8 << 20)
+
+/**** Block compressed logs ****/
+// A block compressed log is a header, blocks and a footer, big endian like the rest:
+//   header:  u32 magic, u32 version, u32 block size, u32 codec name length, codec name
+//   block:   u32 magic, u32 flags, u32 raw length, u32 stored length, stored bytes
+//   footer:  u32 magic, u32 block count, then for each block
+//              u64 file offset, u64 raw offset, i64 max eventnum, i64 max timestamp,
+//              u32 raw length, u32 stored length
+//   trailer: u64 footer offset, u32 magic
+// Uncompressed, each block is a run of whole events in the plain format, and the raw
+// offset of a block is where its first event would be in a plain log. A block that
+// doesn't compress is stored as is. A log whose writer didn't finish it has no footer,
+// so readers walk the blocks instead.
+#define BLOCKS_MAGIC ((int32_t) 0xEDA1DB10L)
+#define BLOCKS_VERSION 1
+#define BLOCKS_DEFAULT_SIZE ((size_t) 256 << 10)
+#define BLOCK_MAGIC ((int32_t) 0xEDA1DB11L)
+#define BLOCK_HEADER_SIZE (sizeof(int32_t) * 4)
+#define BLOCK_STORED 0x1
+#define FOOTER_MAGIC ((int32_t) 0xEDA1DB12L)
+#define FOOTER_ENTRY_SIZE (sizeof(int64_t) * 4 + sizeof(int32_t) * 2)
+#define TRAILER_SIZE (sizeof(int64_t) + sizeof(int32_t))
+#define NO_BLOCK ((size_t) -1)
+
+typedef struct
+{
+    uint64_t fileoff;
+    uint64_t rawoff;
+    int64_t  maxevent;   /* the latest in the block, or in it and every block before it */
+    int64_t  maxts;      /* once the footer is loaded */
+    uint32_t rawlen;
+    uint32_t storedlen;
+} block_entry_t;
+
+struct _zcm_eventlog_blocks_t
+{
+    const zcm_codec_t* codec;
+    uint32_t blocksize;
+
+    block_entry_t* entries;
+    size_t nentries;
+
+    uint8_t* raw;        /* the block being filled, or the last one read */
+    size_t rawcap;
+    uint8_t* stored;
+    size_t storedcap;
+
+    /* when writing */
+    int writing;
+    uint64_t fileoff;    /* of the next block */
+    block_entry_t next;  /* the block in raw */
+
+    /* when reading */
+    size_t cur;          /* the block in raw, or NO_BLOCK */
+    uint64_t pos;        /* read position */
+};
+
+static zcm_eventlog_blocks_t *blocks_open(FILE *f);
+static int blocks_finish(zcm_eventlog_t *l);
+static void blocks_free(zcm_eventlog_blocks_t *b);
+
+// Returns 1 if the file holds a block compressed log, leaving it at the start
+static int is_block_compressed(FILE *f)
+{
+    int32_t magic;
+    int ret = 0 == fread32(f, &magic) && magic == BLOCKS_MAGIC;
+    fseeko(f, 0, SEEK_SET);
+    return ret;
+}
+
 zcm_eventlog_t *zcm_eventlog_create(const char *path, const char *mode)
 {
     assert(!strcmp(mode, "r") || !strcmp(mode, "w") || !strcmp(mode, "a"));
@@ -19,6 +103,18 @@ zcm_eventlog_t *zcm_eventlog_create(const char *path, const char *mode)
 
     zcm_eventlog_t *l = (zcm_eventlog_t*) calloc(1, sizeof(zcm_eventlog_t));
 
+    // Events appended to a block compressed log would be lost after its footer
+    if (*mode == 'a') {
+        FILE *f = fopen(path, "rb");
+        int compressed = f && is_block_compressed(f);
+        if (f) fclose(f);
+        if (compressed) {
+            fprintf(stderr, "Can't append to block compressed log %s\n", path);
+            free(l);
+            return NULL;
+        }
+    }
+
     l->f = fopen(path, mode);
     if (!l->f) {
         free (l);
@@ -27,21 +123,106 @@ zcm_eventlog_t *zcm_eventlog_create(const char *path, const char *mode)
 
     l->eventcount = 0;
 
+    if (*mode == 'r' && is_block_compressed(l->f)) {
+        l->blocks = blocks_open(l->f);
+        if (!l->blocks) {
+            fclose(l->f);
+            free(l);
+            return NULL;
+        }
+    }
+
     return l;
 }
 
+static void index_free(zcm_eventlog_index_t *idx);
+
+static void unmap(zcm_eventlog_t *l)
+{
+#ifndef WIN32
+    if (l->map) munmap((void*) l->map, l->maplen);
+#endif
+    l->map = NULL;
+    l->maplen = 0;
+}
+
 void zcm_eventlog_destroy(zcm_eventlog_t *l)
 {
+    unmap(l);
+    free(l->viewbuf);
+    if (l->index) index_free(l->index);
+    if (l->blocks) {
+        if (l->blocks->writing && blocks_finish(l) != 0)
+            fprintf(stderr, "Failed to finish writing block compressed log\n");
+        blocks_free(l->blocks);
+    }
+    if (l->aio) zcm_aio_writer_destroy(l->aio);
     fflush(l->f);
     fclose(l->f);
     free(l);
 }
 
+// The mapping and the FILE* share one read position. Whoever doesn't own it picks it up
+// from the other before moving it.
+static void give_position_to_file(zcm_eventlog_t *l)
+{
+    if (l->map && !l->fileowned) {
+        fseeko(l->f, (off_t) l->mapoff, SEEK_SET);
+        l->fileowned = 1;
+    }
+}
+
+static void take_position_from_file(zcm_eventlog_t *l)
+{
+    if (l->fileowned) {
+        off_t off = ftello(l->f);
+        l->mapoff = off < 0 ? 0 : (size_t) off;
+        l->fileowned = 0;
+    }
+}
+
 FILE *zcm_eventlog_get_fileptr(zcm_eventlog_t *l)
 {
+    give_position_to_file(l);
     return l->f;
 }
 
+off_t zcm_eventlog_tell(zcm_eventlog_t *l)
+{
+    if (l->blocks && !l->blocks->writing) return (off_t) l->blocks->pos;
+    if (l->map && !l->fileowned) return (off_t) l->mapoff;
+    return ftello(l->f);
+}
+
+int zcm_eventlog_seek(zcm_eventlog_t *l, off_t offset)
+{
+    if (offset < 0) return -1;
+    if (l->blocks && !l->blocks->writing) {
+        l->blocks->pos = (uint64_t) offset;
+        return 0;
+    }
+    if (!l->map) return fseeko(l->f, offset, SEEK_SET);
+    l->mapoff = (size_t) offset;
+    l->fileowned = 0;
+    return 0;
+}
+
+off_t zcm_eventlog_length(zcm_eventlog_t *l)
+{
+    if (l->blocks && !l->blocks->writing) {
+        const zcm_eventlog_blocks_t *b = l->blocks;
+        if (b->nentries == 0) return 0;
+        const block_entry_t *e = &b->entries[b->nentries - 1];
+        return (off_t)(e->rawoff + e->rawlen);
+    }
+    if (l->map) return (off_t) l->maplen;
+    off_t pos = ftello(l->f);
+    if (pos < 0 || fseeko(l->f, 0, SEEK_END) != 0) return -1;
+    off_t len = ftello(l->f);
+    fseeko(l->f, pos, SEEK_SET);
+    return len;
+}
+
 // Returns 0 on success -1 on failure
 static int sync_stream(zcm_eventlog_t *l)
 {
@@ -70,7 +251,7 @@ static int sync_stream_backwards(zcm_eventlog_t *l)
     return 0;
 }
 
-static int64_t get_next_event_time(zcm_eventlog_t *l)
+static int64_t get_next_event_key(zcm_eventlog_t *l, int byEventnum)
 {
     if (sync_stream(l)) return -1;
 
@@ -82,11 +263,14 @@ static int64_t get_next_event_time(zcm_eventlog_t *l)
 
     l->eventcount = event_num;
 
-    return timestamp;
+    return byEventnum ? event_num : timestamp;
 }
 
-int zcm_eventlog_seek_to_timestamp(zcm_eventlog_t *l, int64_t timestamp)
+// Bisects the file by byte fraction for an event with the given timestamp or eventnum
+static int bisect(zcm_eventlog_t *l, int64_t timestamp, int byEventnum)
 {
+    give_position_to_file(l);
+
     fseeko (l->f, 0, SEEK_END);
     off_t file_len = ftello(l->f);
 
@@ -100,7 +284,7 @@ int zcm_eventlog_seek_to_timestamp(zcm_eventlog_t *l, int64_t timestamp)
         frac = 0.5*(frac1+frac2);
         off_t offset = (off_t)(frac*file_len);
         fseeko (l->f, offset, SEEK_SET);
-        cur_time = get_next_event_time (l);
+        cur_time = get_next_event_key (l, byEventnum);
         if (cur_time < 0)
             return -1;
 
@@ -127,55 +311,65 @@ int zcm_eventlog_seek_to_timestamp(zcm_eventlog_t *l, int64_t timestamp)
     return 0;
 }
 
-static zcm_eventlog_event_t *zcm_event_read_helper(zcm_eventlog_t *l, int rewindWhenDone)
+// Reads the event following a magic through the FILE*. Events read as views share one
+// buffer that only ever grows, otherwise each event gets its own allocations.
+static int zcm_event_read_helper(zcm_eventlog_t *l, zcm_eventlog_event_t *le,
+                                 int rewindWhenDone, int view)
 {
-    zcm_eventlog_event_t *le =
-        (zcm_eventlog_event_t*) calloc(1, sizeof(zcm_eventlog_event_t));
-
     if (0 != fread64(l->f, &le->eventnum) ||
         0 != fread64(l->f, &le->timestamp) ||
         0 != fread32(l->f, &le->channellen) ||
         0 != fread32(l->f, &le->datalen)) {
-        free(le);
-        return NULL;
+        return -1;
     }
 
     // Sanity check the channel length and data length
     if (le->channellen <= 0 || le->channellen >= 1000) {
         fprintf(stderr, "Log event has invalid channel length: %d\n", le->channellen);
-        free(le);
-        return NULL;
+        return -1;
     }
     if (le->datalen < 0) {
         fprintf(stderr, "Log event has invalid data length: %d\n", le->datalen);
-        free(le);
-        return NULL;
+        return -1;
     }
 
-    le->channel = (char *) calloc(1, le->channellen+1);
-    if (fread(le->channel, 1, le->channellen, l->f) != (size_t) le->channellen) {
-        free(le->channel);
-        free(le);
-        return NULL;
+    if (view) {
+        size_t needed = (size_t) le->channellen + 1 + (size_t) le->datalen + 1;
+        if (needed > l->viewbuflen) {
+            uint8_t *buf = (uint8_t*) realloc(l->viewbuf, needed);
+            if (!buf) return -1;
+            l->viewbuf = buf;
+            l->viewbuflen = needed;
+        }
+        le->channel = (char*) l->viewbuf;
+        le->data = l->viewbuf + le->channellen + 1;
+        le->channel[le->channellen] = '\0';
+        le->data[le->datalen] = 0;
+    } else {
+        le->channel = (char *) calloc(1, le->channellen+1);
+        le->data = calloc(1, le->datalen+1);
     }
 
-    le->data = calloc(1, le->datalen+1);
-    if (fread(le->data, 1, le->datalen, l->f) != (size_t) le->datalen) {
-        free(le->channel);
-        free(le->data);
-        free(le);
-        return NULL;
+    if (fread(le->channel, 1, le->channellen, l->f) != (size_t) le->channellen ||
+        fread(le->data, 1, le->datalen, l->f) != (size_t) le->datalen) {
+        if (!view) {
+            free(le->channel);
+            free(le->data);
+        }
+        return -1;
     }
 
-    // Check that there's a valid event or the EOF after this event.
+    // Check that there's a valid event or the EOF (or O_DIRECT padding, see
+    // parse_event()) after this event.
     int32_t next_magic;
     if (0 == fread32(l->f, &next_magic)) {
-        if (next_magic != MAGIC) {
+        if (next_magic != MAGIC && next_magic != 0) {
             fprintf(stderr, "Invalid header after log data\n");
-            free(le->channel);
-            free(le->data);
-            free(le);
-            return NULL;
+            if (!view) {
+                free(le->channel);
+                free(le->data);
+            }
+            return -1;
         }
         fseeko (l->f, -4, SEEK_CUR);
     }
@@ -183,26 +377,1110 @@ static zcm_eventlog_event_t *zcm_event_read_helper(zcm_eventlog_t *l, int rewind
         fseeko (l->f, -(off_t)(sizeof(int64_t) * 2 + sizeof(int32_t) * 3 +
                                le->datalen + le->channellen), SEEK_CUR);
     }
+    return 0;
+}
+
+static inline int32_t get32(const uint8_t *p)
+{
+    return (int32_t)(((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) |
+                     ((uint32_t) p[2] << 8)  |  (uint32_t) p[3]);
+}
+
+static inline int64_t get64(const uint8_t *p)
+{
+    return (int64_t)(((uint64_t)(uint32_t) get32(p) << 32) | (uint32_t) get32(p + 4));
+}
+
+static inline void put32(uint8_t *p, int32_t v)
+{
+    p[0] = (uint32_t) v >> 24;
+    p[1] = (uint32_t) v >> 16;
+    p[2] = (uint32_t) v >> 8;
+    p[3] = (uint32_t) v;
+}
+
+static inline void put64(uint8_t *p, int64_t v)
+{
+    put32(p, (int32_t)((uint64_t) v >> 32));
+    put32(p + 4, (int32_t) v);
+}
+
+// The magic and header of an event, as written before its channel and data
+static void put_event_header(uint8_t *p, int64_t eventnum, const zcm_eventlog_event_t *le)
+{
+    put32(p, MAGIC);
+    put64(p + 4, eventnum);
+    put64(p + 12, le->timestamp);
+    put32(p + 20, le->channellen);
+    put32(p + 24, le->datalen);
+}
+
+// Picks up data appended since the file was mapped. Returns 1 if the mapping grew.
+static int remap_if_grown(zcm_eventlog_t *l)
+{
+#ifndef WIN32
+    struct stat st;
+    if (fstat(fileno(l->f), &st) != 0 || (uint64_t) st.st_size <= l->maplen ||
+        (uint64_t) st.st_size > SIZE_MAX)
+        return 0;
+
+    // Writable but private, so that callers may patch the events they're handed in
+    // place without it ever reaching the file
+    void *map = mmap(NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                     fileno(l->f), 0);
+    if (map == MAP_FAILED) return 0;
+    madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+
+    unmap(l);
+    l->map = (const uint8_t*) map;
+    l->maplen = (size_t) st.st_size;
+    l->readahead = 0;
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+int zcm_eventlog_map(zcm_eventlog_t *l)
+{
+    if (l->blocks) return -1;
+    if (l->map) return 0;
+    if (!remap_if_grown(l)) return -1;
+    l->fileowned = 1;
+    return 0;
+}
+
+static void read_ahead(zcm_eventlog_t *l)
+{
+#ifndef WIN32
+    if (l->mapoff + READAHEAD_SIZE / 2 <= l->readahead) return;
+
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t start = (l->mapoff > l->readahead ? l->mapoff : l->readahead) & ~(page - 1);
+    size_t end = l->mapoff + READAHEAD_SIZE;
+    if (end > l->maplen) end = l->maplen;
+    if (start < end) madvise((void*)(l->map + start), end - start, MADV_WILLNEED);
+    l->readahead = end;
+#endif
+}
+
+static const uint8_t magic_bytes[4] = { 0xED, 0xA1, 0xDA, 0x01 };
+
+// Returns the offset of the first magic at or after off in buf, or len if there is none
+static size_t find_magic(const uint8_t *buf, size_t len, size_t off)
+{
+    while (off + sizeof(magic_bytes) <= len) {
+        const uint8_t *p = (const uint8_t*) memchr(buf + off, magic_bytes[0],
+                                                   len - off - (sizeof(magic_bytes) - 1));
+        if (!p) break;
+        off = p - buf;
+        if (memcmp(p, magic_bytes, sizeof(magic_bytes)) == 0) return off;
+        off++;
+    }
+    return len;
+}
+
+// Returns the offset of the last magic starting at or before off in buf, or -1
+static int64_t find_magic_backwards(const uint8_t *buf, size_t len, size_t off)
+{
+    if (len < sizeof(magic_bytes)) return -1;
+    if (off > len - sizeof(magic_bytes)) off = len - sizeof(magic_bytes);
+    while (memcmp(buf + off, magic_bytes, sizeof(magic_bytes)) != 0) {
+        if (off == 0) return -1;
+        off--;
+    }
+    return (int64_t) off;
+}
+
+// Moves the read position past the next magic. Returns 0 on success -1 on failure
+static int sync_map(zcm_eventlog_t *l)
+{
+    size_t off = find_magic(l->map, l->maplen, l->mapoff);
+    if (off == l->maplen) return -1;
+    l->mapoff = off + sizeof(magic_bytes);
+    return 0;
+}
+
+enum { PARSE_OK = 0, PARSE_INVALID = -1, PARSE_TRUNCATED = -2 };
+
+// Parses the event following the magic that ends at off, pointing the event into buf
+static int parse_event(const uint8_t *buf, size_t len, size_t off, zcm_eventlog_event_t *le,
+                       size_t *end)
+{
+    if (len - off < HEADER_SIZE) return PARSE_TRUNCATED;
+
+    const uint8_t *p = buf + off;
+    le->eventnum   = get64(p);
+    le->timestamp  = get64(p + 8);
+    le->channellen = get32(p + 16);
+    le->datalen    = get32(p + 20);
+    off += HEADER_SIZE;
+
+    // Sanity check the channel length and data length
+    if (le->channellen <= 0 || le->channellen >= 1000) {
+        fprintf(stderr, "Log event has invalid channel length: %d\n", le->channellen);
+        return PARSE_INVALID;
+    }
+    if (le->datalen < 0) {
+        fprintf(stderr, "Log event has invalid data length: %d\n", le->datalen);
+        return PARSE_INVALID;
+    }
+    if ((uint64_t)(len - off) < (uint64_t) le->channellen + (uint64_t) le->datalen)
+        return PARSE_TRUNCATED;
+
+    le->channel = (char*) buf + off;
+    le->data = (uint8_t*) buf + off + le->channellen;
+    off += le->channellen + le->datalen;
+
+    // Check that there's a valid event or the EOF after this event. Zeros are taken
+    // for the EOF too: an O_DIRECT writer pads the file with them until it writes the
+    // next event over them.
+    if (len - off >= sizeof(int32_t) && get32(buf + off) != MAGIC && get32(buf + off) != 0) {
+        fprintf(stderr, "Invalid header after log data\n");
+        return PARSE_INVALID;
+    }
+
+    *end = off;
+    return PARSE_OK;
+}
+
+static int read_next_mapped(zcm_eventlog_t *l, zcm_eventlog_event_t *le)
+{
+    take_position_from_file(l);
+
+    int grown = 0;
+    while (1) {
+        size_t start = l->mapoff;
+        if (start <= l->maplen && sync_map(l) == 0) {
+            size_t end;
+            int ret = parse_event(l->map, l->maplen, l->mapoff, le, &end);
+            if (ret == PARSE_OK) {
+                l->mapoff = end;
+                read_ahead(l);
+                return 0;
+            }
+            if (ret == PARSE_INVALID) return -1;
+            // Leave a truncated event to be read again once the rest of it is written
+            l->mapoff = start;
+        }
+        if (grown || !remap_if_grown(l)) return -1;
+        grown = 1;
+    }
+}
+
+static int read_prev_mapped(zcm_eventlog_t *l, zcm_eventlog_event_t *le)
+{
+    take_position_from_file(l);
+
+    // Mirrors sync_stream_backwards(): the closest magic starting 5 bytes or more before
+    // the read position, which leaves the read position at the start of that event
+    if (l->mapoff < 5) return -1;
+    int64_t off = find_magic_backwards(l->map, l->maplen, l->mapoff - 5);
+    if (off < 0) return -1;
+
+    size_t end;
+    l->mapoff = (size_t) off;
+    return parse_event(l->map, l->maplen, (size_t) off + sizeof(magic_bytes), le, &end) ==
+           PARSE_OK ? 0 : -1;
+}
+
+/**** Block compressed logs ****/
+
+// Doubles the capacity of an array whenever its length reaches a power of two
+static int grow(void **arr, size_t len, size_t elemsize)
+{
+    if (len != 0 && (len & (len - 1)) != 0) return 0;
+    void *tmp = realloc(*arr, (len ? len * 2 : 1) * elemsize);
+    if (!tmp) return -1;
+    *arr = tmp;
+    return 0;
+}
+
+// Makes room for len bytes in a buffer that only ever grows
+static int reserve(uint8_t **buf, size_t *cap, size_t len)
+{
+    if (len <= *cap) return 0;
+    uint8_t *tmp = (uint8_t*) realloc(*buf, len);
+    if (!tmp) return -1;
+    *buf = tmp;
+    *cap = len;
+    return 0;
+}
+
+static void blocks_free(zcm_eventlog_blocks_t *b)
+{
+    free(b->entries);
+    free(b->raw);
+    free(b->stored);
+    free(b);
+}
+
+// Adds a block if it follows on from the last one and ends by end. Returns 0 if it does.
+static int blocks_add(zcm_eventlog_blocks_t *b, const block_entry_t *e, uint64_t end)
+{
+    const block_entry_t *prev = b->nentries ? &b->entries[b->nentries - 1] : NULL;
+    if (e->fileoff != b->fileoff || e->rawlen == 0 ||
+        e->rawoff != (prev ? prev->rawoff + prev->rawlen : 0) ||
+        e->fileoff > end || end - e->fileoff < BLOCK_HEADER_SIZE + (uint64_t) e->storedlen)
+        return -1;
+    if (grow((void**) &b->entries, b->nentries, sizeof(block_entry_t)) != 0) return -1;
+    b->entries[b->nentries++] = *e;
+    b->fileoff += BLOCK_HEADER_SIZE + e->storedlen;
+    return 0;
+}
+
+// Reads block i into raw. Returns 0 on success -1 on failure
+static int blocks_load(zcm_eventlog_blocks_t *b, FILE *f, size_t i)
+{
+    if (b->cur == i) return 0;
+    b->cur = NO_BLOCK;
+
+    const block_entry_t *e = &b->entries[i];
+    uint8_t header[BLOCK_HEADER_SIZE];
+    int ok = fseeko(f, (off_t) e->fileoff, SEEK_SET) == 0 &&
+             fread(header, 1, sizeof(header), f) == sizeof(header) &&
+             get32(header) == BLOCK_MAGIC &&
+             (uint32_t) get32(header + 8) == e->rawlen &&
+             (uint32_t) get32(header + 12) == e->storedlen &&
+             reserve(&b->raw, &b->rawcap, e->rawlen) == 0;
+    if (ok && (get32(header + 4) & BLOCK_STORED)) {
+        ok = e->storedlen == e->rawlen && fread(b->raw, 1, e->rawlen, f) == e->rawlen;
+    } else if (ok) {
+        size_t len = e->rawlen;
+        ok = reserve(&b->stored, &b->storedcap, e->storedlen) == 0 &&
+             fread(b->stored, 1, e->storedlen, f) == e->storedlen &&
+             b->codec->decompress(b->stored, e->storedlen, b->raw, &len) == ZCM_EOK &&
+             len == e->rawlen;
+    }
+    if (!ok) {
+        fprintf(stderr, "Failed to read block %zu of block compressed log\n", i);
+        return -1;
+    }
+    b->cur = i;
+    return 0;
+}
+
+// Sets the maxima of the block in raw from its events
+static int block_maxima(const zcm_eventlog_blocks_t *b, block_entry_t *e)
+{
+    e->maxevent = e->maxts = INT64_MIN;
+    size_t off = 0, end;
+    while ((off = find_magic(b->raw, e->rawlen, off)) != e->rawlen) {
+        zcm_eventlog_event_t le;
+        if (parse_event(b->raw, e->rawlen, off + sizeof(magic_bytes), &le, &end) != PARSE_OK)
+            return -1;
+        if (le.eventnum > e->maxevent) e->maxevent = le.eventnum;
+        if (le.timestamp > e->maxts) e->maxts = le.timestamp;
+        off = end;
+    }
+    return 0;
+}
+
+static int read_footer(zcm_eventlog_blocks_t *b, FILE *f, uint64_t filelen)
+{
+    uint8_t trailer[TRAILER_SIZE];
+    if (filelen < b->fileoff + TRAILER_SIZE ||
+        fseeko(f, (off_t)(filelen - TRAILER_SIZE), SEEK_SET) != 0 ||
+        fread(trailer, 1, sizeof(trailer), f) != sizeof(trailer) ||
+        get32(trailer + 8) != FOOTER_MAGIC)
+        return -1;
+
+    uint64_t footeroff = (uint64_t) get64(trailer);
+    int32_t magic, count;
+    if (footeroff < b->fileoff || footeroff > filelen - TRAILER_SIZE - 2 * sizeof(int32_t) ||
+        fseeko(f, (off_t) footeroff, SEEK_SET) != 0 ||
+        0 != fread32(f, &magic) || magic != FOOTER_MAGIC ||
+        0 != fread32(f, &count) || count < 0 ||
+        (uint64_t) count * FOOTER_ENTRY_SIZE !=
+            filelen - TRAILER_SIZE - footeroff - 2 * sizeof(int32_t))
+        return -1;
+
+    int32_t i;
+    for (i = 0; i < count; ++i) {
+        block_entry_t e;
+        int32_t rawlen, storedlen;
+        if (0 != fread64(f, (int64_t*) &e.fileoff) ||
+            0 != fread64(f, (int64_t*) &e.rawoff) ||
+            0 != fread64(f, &e.maxevent) ||
+            0 != fread64(f, &e.maxts) ||
+            0 != fread32(f, &rawlen) ||
+            0 != fread32(f, &storedlen))
+            return -1;
+        e.rawlen = (uint32_t) rawlen;
+        e.storedlen = (uint32_t) storedlen;
+        if (blocks_add(b, &e, footeroff) != 0) return -1;
+    }
+    return b->fileoff == footeroff ? 0 : -1;
+}
+
+// Indexes the blocks of a log that has no footer by walking through them, up to the
+// first one that is cut short
+static void walk_blocks(zcm_eventlog_blocks_t *b, FILE *f, uint64_t filelen)
+{
+    while (1) {
+        block_entry_t e;
+        uint8_t header[BLOCK_HEADER_SIZE];
+        memset(&e, 0, sizeof(e));
+        e.fileoff = b->fileoff;
+        if (fseeko(f, (off_t) e.fileoff, SEEK_SET) != 0 ||
+            fread(header, 1, sizeof(header), f) != sizeof(header) ||
+            get32(header) != BLOCK_MAGIC)
+            return;
+        e.rawlen = (uint32_t) get32(header + 8);
+        e.storedlen = (uint32_t) get32(header + 12);
+        if (b->nentries)
+            e.rawoff = b->entries[b->nentries - 1].rawoff + b->entries[b->nentries - 1].rawlen;
+        if (blocks_add(b, &e, filelen) != 0) return;
+
+        size_t i = b->nentries - 1;
+        if (blocks_load(b, f, i) != 0 || block_maxima(b, &b->entries[i]) != 0) {
+            b->nentries--;
+            b->fileoff = e.fileoff;
+            b->cur = NO_BLOCK;
+            return;
+        }
+    }
+}
+
+static zcm_eventlog_blocks_t *blocks_open(FILE *f)
+{
+    int32_t magic, version, blocksize, namelen;
+    char name[256];
+    if (fseeko(f, 0, SEEK_END) != 0) return NULL;
+    off_t filelen = ftello(f);
+    if (filelen < 0 || fseeko(f, 0, SEEK_SET) != 0) return NULL;
+
+    if (0 != fread32(f, &magic) || magic != BLOCKS_MAGIC ||
+        0 != fread32(f, &version) || 0 != fread32(f, &blocksize) ||
+        0 != fread32(f, &namelen) || namelen <= 0 || namelen >= (int32_t) sizeof(name) ||
+        fread(name, 1, namelen, f) != (size_t) namelen) {
+        fprintf(stderr, "Block compressed log has an invalid header\n");
+        return NULL;
+    }
+    if (version != BLOCKS_VERSION) {
+        fprintf(stderr, "Block compressed log has unsupported version %d\n", version);
+        return NULL;
+    }
+    name[namelen] = '\0';
+    const zcm_codec_t *codec = zcm_codec_find(name);
+    if (!codec) {
+        fprintf(stderr, "Block compressed log uses unknown codec \"%s\"\n", name);
+        return NULL;
+    }
+
+    zcm_eventlog_blocks_t *b =
+        (zcm_eventlog_blocks_t*) calloc(1, sizeof(zcm_eventlog_blocks_t));
+    b->codec = codec;
+    b->blocksize = (uint32_t) blocksize;
+    b->cur = NO_BLOCK;
+    b->fileoff = 4 * sizeof(int32_t) + namelen;
+
+    uint64_t datastart = b->fileoff;
+    if (read_footer(b, f, (uint64_t) filelen) != 0) {
+        b->nentries = 0;
+        b->fileoff = datastart;
+        walk_blocks(b, f, (uint64_t) filelen);
+    }
+
+    // Turn the maxima of each block into those of all the blocks up to it for seeking
+    size_t i;
+    for (i = 1; i < b->nentries; ++i) {
+        block_entry_t *e = &b->entries[i];
+        if (e->maxevent < e[-1].maxevent) e->maxevent = e[-1].maxevent;
+        if (e->maxts < e[-1].maxts) e->maxts = e[-1].maxts;
+    }
+    return b;
+}
+
+// The block holding offset pos, or the last one if it is past the end
+static size_t blocks_find(const zcm_eventlog_blocks_t *b, uint64_t pos)
+{
+    if (b->nentries == 0) return 0;
+    if (b->cur != NO_BLOCK && pos >= b->entries[b->cur].rawoff &&
+        pos - b->entries[b->cur].rawoff < b->entries[b->cur].rawlen)
+        return b->cur;
+
+    // Blocks follow on from each other, and the first starts at 0
+    size_t lo = 1, hi = b->nentries;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (b->entries[mid].rawoff <= pos) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo - 1;
+}
+
+static int blocks_read_next(zcm_eventlog_t *l, zcm_eventlog_event_t *le)
+{
+    zcm_eventlog_blocks_t *b = l->blocks;
+    size_t i;
+    for (i = blocks_find(b, b->pos); i < b->nentries; ++i) {
+        const block_entry_t *e = &b->entries[i];
+        size_t off = b->pos > e->rawoff ? (size_t)(b->pos - e->rawoff) : 0;
+        if (off >= e->rawlen) continue;
+        if (blocks_load(b, l->f, i) != 0) return -1;
+        off = find_magic(b->raw, e->rawlen, off);
+        if (off == e->rawlen) continue;
+
+        size_t end;
+        if (parse_event(b->raw, e->rawlen, off + sizeof(magic_bytes), le, &end) != PARSE_OK)
+            return -1;
+        b->pos = e->rawoff + end;
+        return 0;
+    }
+    return -1;
+}
+
+static int blocks_read_prev(zcm_eventlog_t *l, zcm_eventlog_event_t *le)
+{
+    // Like read_prev_mapped(), the closest magic starting 5 bytes or more before the read
+    // position, in whichever block that is
+    zcm_eventlog_blocks_t *b = l->blocks;
+    if (b->pos < 5) return -1;
+    uint64_t last = b->pos - 5;
+
+    size_t i;
+    for (i = blocks_find(b, last); i < b->nentries; --i) {
+        const block_entry_t *e = &b->entries[i];
+        if (blocks_load(b, l->f, i) != 0) return -1;
+        uint64_t from = last - e->rawoff;
+        int64_t off = find_magic_backwards(b->raw, e->rawlen,
+                                           from < e->rawlen ? (size_t) from : e->rawlen);
+        if (off < 0) continue;
+
+        size_t end;
+        b->pos = e->rawoff + (uint64_t) off;
+        return parse_event(b->raw, e->rawlen, (size_t) off + sizeof(magic_bytes), le, &end) ==
+               PARSE_OK ? 0 : -1;
+    }
+    return -1;
+}
+
+// Leaves the read position at the first event at or after the target, which the running
+// maxima of the blocks lead straight to. Returns 0 if there is one, -1 if there isn't.
+static int blocks_seek(zcm_eventlog_t *l, int64_t target, int byEventnum)
+{
+    zcm_eventlog_blocks_t *b = l->blocks;
+    size_t lo = 0, hi = b->nentries;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const block_entry_t *e = &b->entries[mid];
+        if ((byEventnum ? e->maxevent : e->maxts) < target) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == b->nentries) return -1;
+
+    uint64_t start = b->pos;
+    b->pos = b->entries[lo].rawoff;
+    while (1) {
+        uint64_t pos = b->pos;
+        zcm_eventlog_event_t le;
+        if (blocks_read_next(l, &le) != 0) {
+            b->pos = start;
+            return -1;
+        }
+        if ((byEventnum ? le.eventnum : le.timestamp) >= target) {
+            b->pos = pos;
+            return 0;
+        }
+    }
+}
+
+static int write_bytes(zcm_eventlog_t *l, const void *data, size_t len)
+{
+    if (l->aio) return zcm_aio_writer_write(l->aio, data, len);
+    return fwrite(data, 1, len, l->f) == len ? 0 : -1;
+}
+
+// Writes out the block being filled, compressed unless that doesn't make it smaller
+static int blocks_emit(zcm_eventlog_t *l)
+{
+    zcm_eventlog_blocks_t *b = l->blocks;
+    block_entry_t *e = &b->next;
+    if (e->rawlen == 0) return 0;
+
+    size_t storedlen = b->codec->bound(e->rawlen);
+    if (0 != reserve(&b->stored, &b->storedcap, storedlen)) return -1;
+    const uint8_t *stored = b->stored;
+    int32_t flags = 0;
+    if (b->codec->compress(b->raw, e->rawlen, b->stored, &storedlen) != ZCM_EOK ||
+        storedlen >= e->rawlen) {
+        stored = b->raw;
+        storedlen = e->rawlen;
+        flags = BLOCK_STORED;
+    }
+
+    uint8_t header[BLOCK_HEADER_SIZE];
+    put32(header, BLOCK_MAGIC);
+    put32(header + 4, flags);
+    put32(header + 8, (int32_t) e->rawlen);
+    put32(header + 12, (int32_t) storedlen);
+    e->fileoff = b->fileoff;
+    e->storedlen = (uint32_t) storedlen;
+    if (0 != write_bytes(l, header, sizeof(header)) ||
+        0 != write_bytes(l, stored, storedlen) ||
+        0 != blocks_add(b, e, UINT64_MAX))
+        return -1;
+
+    e->rawoff += e->rawlen;
+    e->rawlen = 0;
+    e->maxevent = e->maxts = INT64_MIN;
+    return 0;
+}
+
+static int write_event_blocks(zcm_eventlog_t *l, const zcm_eventlog_event_t *le)
+{
+    zcm_eventlog_blocks_t *b = l->blocks;
+    block_entry_t *e = &b->next;
+
+    // Events bigger than a block get one of their own
+    size_t size = EVENT_SIZE(le);
+    if (e->rawlen && e->rawlen + size > b->blocksize && 0 != blocks_emit(l)) return -1;
+    if (0 != reserve(&b->raw, &b->rawcap, e->rawlen + size)) return -1;
+
+    uint8_t *p = b->raw + e->rawlen;
+    put_event_header(p, l->eventcount, le);
+    p += sizeof(int32_t) + HEADER_SIZE;
+    memcpy(p, le->channel, le->channellen);
+    memcpy(p + le->channellen, le->data, le->datalen);
+
+    e->rawlen += size;
+    if (l->eventcount > e->maxevent) e->maxevent = l->eventcount;
+    if (le->timestamp > e->maxts) e->maxts = le->timestamp;
+    return e->rawlen >= b->blocksize ? blocks_emit(l) : 0;
+}
+
+// Writes out the last block and the footer
+static int blocks_finish(zcm_eventlog_t *l)
+{
+    zcm_eventlog_blocks_t *b = l->blocks;
+    if (0 != blocks_emit(l)) return -1;
+
+    size_t len = 2 * sizeof(int32_t) + b->nentries * FOOTER_ENTRY_SIZE + TRAILER_SIZE;
+    uint8_t *footer = (uint8_t*) malloc(len);
+    if (!footer) return -1;
+
+    uint8_t *p = footer;
+    put32(p, FOOTER_MAGIC);
+    put32(p + 4, (int32_t) b->nentries);
+    p += 2 * sizeof(int32_t);
+    size_t i;
+    for (i = 0; i < b->nentries; ++i, p += FOOTER_ENTRY_SIZE) {
+        const block_entry_t *e = &b->entries[i];
+        put64(p, (int64_t) e->fileoff);
+        put64(p + 8, (int64_t) e->rawoff);
+        put64(p + 16, e->maxevent);
+        put64(p + 24, e->maxts);
+        put32(p + 32, (int32_t) e->rawlen);
+        put32(p + 36, (int32_t) e->storedlen);
+    }
+    put64(p, (int64_t) b->fileoff);
+    put32(p + 8, FOOTER_MAGIC);
+
+    int ret = write_bytes(l, footer, len);
+    free(footer);
+    return ret;
+}
+
+int zcm_eventlog_write_compressed(zcm_eventlog_t *l, const char *codec, size_t block_size)
+{
+    const zcm_codec_t *c = zcm_codec_find(codec);
+    size_t namelen = c ? strlen(c->name) : 0;
+    if (block_size == 0) block_size = BLOCKS_DEFAULT_SIZE;
+
+    // Events already in the log would be outside of any block
+    if (!c || namelen == 0 || namelen >= 256 || block_size > INT32_MAX || l->blocks ||
+        l->eventcount != 0 || fseeko(l->f, 0, SEEK_END) != 0 || ftello(l->f) != 0)
+        return -1;
+
+    zcm_eventlog_blocks_t *b =
+        (zcm_eventlog_blocks_t*) calloc(1, sizeof(zcm_eventlog_blocks_t));
+    b->codec = c;
+    b->blocksize = (uint32_t) block_size;
+    b->writing = 1;
+    b->cur = NO_BLOCK;
+    b->fileoff = 4 * sizeof(int32_t) + namelen;
+    b->next.maxevent = b->next.maxts = INT64_MIN;
+
+    uint8_t header[4 * sizeof(int32_t)];
+    put32(header, BLOCKS_MAGIC);
+    put32(header + 4, BLOCKS_VERSION);
+    put32(header + 8, (int32_t) block_size);
+    put32(header + 12, (int32_t) namelen);
+    if (0 != reserve(&b->raw, &b->rawcap, block_size) ||
+        0 != write_bytes(l, header, sizeof(header)) ||
+        0 != write_bytes(l, c->name, namelen)) {
+        blocks_free(b);
+        return -1;
+    }
+    l->blocks = b;
+    return 0;
+}
+
+static zcm_eventlog_event_t *copy_event(const zcm_eventlog_event_t *view)
+{
+    zcm_eventlog_event_t *le =
+        (zcm_eventlog_event_t*) calloc(1, sizeof(zcm_eventlog_event_t));
+    *le = *view;
+    le->channel = (char *) calloc(1, le->channellen+1);
+    memcpy(le->channel, view->channel, le->channellen);
+    le->data = calloc(1, le->datalen+1);
+    memcpy(le->data, view->data, le->datalen);
+    return le;
+}
+
+int zcm_eventlog_read_next_event_view(zcm_eventlog_t *l, zcm_eventlog_event_t *le)
+{
+    if (l->blocks) return blocks_read_next(l, le);
+    if (l->map) return read_next_mapped(l, le);
+    if (sync_stream(l)) return -1;
+    return zcm_event_read_helper(l, le, 0, 1);
+}
+
+int zcm_eventlog_read_prev_event_view(zcm_eventlog_t *l, zcm_eventlog_event_t *le)
+{
+    if (l->blocks) return blocks_read_prev(l, le);
+    if (l->map) return read_prev_mapped(l, le);
+    if (sync_stream_backwards(l) < 0) return -1;
+    return zcm_event_read_helper(l, le, 1, 1);
+}
+
+int zcm_eventlog_read_event_at_offset_view(zcm_eventlog_t *l, off_t offset,
+                                           zcm_eventlog_event_t *le)
+{
+    if (zcm_eventlog_seek(l, offset) != 0) return -1;
+    return zcm_eventlog_read_next_event_view(l, le);
+}
+
+static zcm_eventlog_event_t *read_event_copy(zcm_eventlog_t *l, int prev)
+{
+    zcm_eventlog_event_t view;
+    if (l->blocks || l->map) {
+        int ret = prev ? zcm_eventlog_read_prev_event_view(l, &view) :
+                         zcm_eventlog_read_next_event_view(l, &view);
+        return ret == 0 ? copy_event(&view) : NULL;
+    }
+
+    if (prev ? sync_stream_backwards(l) < 0 : sync_stream(l) != 0) return NULL;
+    zcm_eventlog_event_t *le =
+        (zcm_eventlog_event_t*) calloc(1, sizeof(zcm_eventlog_event_t));
+    if (zcm_event_read_helper(l, le, prev, 0) != 0) {
+        free(le);
+        return NULL;
+    }
     return le;
 }
 
 zcm_eventlog_event_t *zcm_eventlog_read_next_event(zcm_eventlog_t *l)
 {
-    if (sync_stream(l)) return NULL;
-    return zcm_event_read_helper(l, 0);
+    return read_event_copy(l, 0);
 }
 
 zcm_eventlog_event_t *zcm_eventlog_read_prev_event(zcm_eventlog_t *l)
 {
-    if (sync_stream_backwards(l) < 0) return NULL;
-    return zcm_event_read_helper(l, 1);
+    return read_event_copy(l, 1);
 }
 
 zcm_eventlog_event_t *zcm_eventlog_read_event_at_offset(zcm_eventlog_t *l, off_t offset)
 {
-    fseeko(l->f, offset, SEEK_SET);
-    if (sync_stream(l)) return NULL;
-    return zcm_event_read_helper(l, 0);
+    if (zcm_eventlog_seek(l, offset) != 0) return NULL;
+    return read_event_copy(l, 0);
+}
+
+/**** Sidecar seek index ****/
+// An index file is a header followed by records, big endian like the log itself:
+//   header:  u32 magic, u32 version, u32 stride
+//   channel: u8 'C', u32 id, u32 length, the channel name
+//   entry:   u8 'E', u64 offset, i64 eventnum, i64 timestamp, i64 maxts, i64 chanmaxts,
+//            u32 channel id
+// where maxts and chanmaxts are the latest timestamps of all events before the entry's
+// event, and of those on its channel. Ids count up from 0 and each channel is defined
+// before its first entry. Records are only appended, so an index cut short by a crash
+// just stops covering the end of the log, where seeks scan instead.
+#define INDEX_MAGIC ((int32_t) 0x5A494458L)
+#define INDEX_VERSION 1
+
+typedef struct
+{
+    uint64_t offset;
+    int64_t  eventnum;
+    int64_t  timestamp;
+    int64_t  maxts;
+    int64_t  chanmaxts;
+    uint32_t channel;
+} index_entry_t;
+
+typedef struct
+{
+    char*    name;
+    int32_t  len;
+    uint32_t hash;
+
+    /* when writing */
+    uint32_t since;      /* events on the channel since its last entry */
+    int64_t  maxts;
+
+    /* when reading */
+    size_t*  entries;    /* the entries of events on the channel */
+    size_t   nentries;
+} index_channel_t;
+
+struct _zcm_eventlog_index_t
+{
+    FILE*    f;          /* the index being written, NULL when reading */
+    uint32_t stride;
+
+    index_channel_t* channels;
+    uint32_t nchannels;
+
+    /* when writing */
+    uint64_t offset;     /* of the next event */
+    uint32_t since;      /* events since the last entry */
+    int64_t  maxts;
+
+    /* when reading */
+    index_entry_t* entries;
+    size_t nentries;
+};
+
+static uint32_t hash_channel(const char *name, int32_t len)
+{
+    uint32_t hash = 2166136261u;
+    int32_t i;
+    for (i = 0; i < len; ++i) hash = (hash ^ (uint8_t) name[i]) * 16777619u;
+    return hash;
+}
+
+static int64_t find_channel(const zcm_eventlog_index_t *idx,
+                            const char *name, int32_t len, uint32_t hash)
+{
+    uint32_t i;
+    for (i = 0; i < idx->nchannels; ++i) {
+        const index_channel_t *ch = &idx->channels[i];
+        if (ch->hash == hash && ch->len == len && memcmp(ch->name, name, len) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static int64_t add_channel(zcm_eventlog_index_t *idx, const char *name, int32_t len)
+{
+    if (grow((void**) &idx->channels, idx->nchannels, sizeof(index_channel_t)) != 0)
+        return -1;
+    index_channel_t *ch = &idx->channels[idx->nchannels];
+    memset(ch, 0, sizeof(*ch));
+    ch->name = (char*) malloc(len);
+    if (!ch->name) return -1;
+    memcpy(ch->name, name, len);
+    ch->len = len;
+    ch->hash = hash_channel(name, len);
+    ch->since = idx->stride;
+    ch->maxts = INT64_MIN;
+    return idx->nchannels++;
+}
+
+static void index_free(zcm_eventlog_index_t *idx)
+{
+    uint32_t i;
+    if (idx->f) fclose(idx->f);
+    for (i = 0; i < idx->nchannels; ++i) {
+        free(idx->channels[i].name);
+        free(idx->channels[i].entries);
+    }
+    free(idx->channels);
+    free(idx->entries);
+    free(idx);
+}
+
+static zcm_eventlog_index_t *index_create(const char *path, uint32_t stride)
+{
+    if (stride == 0 || stride > INT32_MAX) return NULL;
+
+    FILE *f = fopen(path, "wb");
+    if (!f) return NULL;
+    if (0 != fwrite32(f, INDEX_MAGIC) ||
+        0 != fwrite32(f, INDEX_VERSION) ||
+        0 != fwrite32(f, (int32_t) stride)) {
+        fclose(f);
+        return NULL;
+    }
+
+    zcm_eventlog_index_t *idx =
+        (zcm_eventlog_index_t*) calloc(1, sizeof(zcm_eventlog_index_t));
+    idx->f = f;
+    idx->stride = stride;
+    idx->since = stride;
+    idx->maxts = INT64_MIN;
+    return idx;
+}
+
+// Records an event written at offset, adding an entry for it when it's due
+static int index_add(zcm_eventlog_index_t *idx, uint64_t offset, int64_t eventnum,
+                     const zcm_eventlog_event_t *le)
+{
+    uint32_t hash = hash_channel(le->channel, le->channellen);
+    int64_t id = find_channel(idx, le->channel, le->channellen, hash);
+    if (id < 0) {
+        id = add_channel(idx, le->channel, le->channellen);
+        if (id < 0) return -1;
+        if (EOF == fputc('C', idx->f) ||
+            0 != fwrite32(idx->f, (int32_t) id) ||
+            0 != fwrite32(idx->f, le->channellen) ||
+            (size_t) le->channellen != fwrite(le->channel, 1, le->channellen, idx->f))
+            return -1;
+    }
+
+    index_channel_t *ch = &idx->channels[id];
+    if (idx->since >= idx->stride || ch->since >= idx->stride) {
+        if (EOF == fputc('E', idx->f) ||
+            0 != fwrite64(idx->f, (int64_t) offset) ||
+            0 != fwrite64(idx->f, eventnum) ||
+            0 != fwrite64(idx->f, le->timestamp) ||
+            0 != fwrite64(idx->f, idx->maxts) ||
+            0 != fwrite64(idx->f, ch->maxts) ||
+            0 != fwrite32(idx->f, (int32_t) id))
+            return -1;
+        idx->since = 0;
+        ch->since = 0;
+    }
+
+    idx->since++;
+    ch->since++;
+    if (le->timestamp > idx->maxts) idx->maxts = le->timestamp;
+    if (le->timestamp > ch->maxts) ch->maxts = le->timestamp;
+    return 0;
+}
+
+int zcm_eventlog_write_index(zcm_eventlog_t *l, const char *path, uint32_t stride)
+{
+    // Events already in the log would be missing from the index
+    if (l->index || l->eventcount != 0 ||
+        (!l->blocks && (fseeko(l->f, 0, SEEK_END) != 0 || ftello(l->f) != 0)))
+        return -1;
+
+    l->index = index_create(path, stride);
+    return l->index ? 0 : -1;
+}
+
+int zcm_eventlog_build_index(zcm_eventlog_t *l, const char *path, uint32_t stride)
+{
+    zcm_eventlog_index_t *idx = index_create(path, stride);
+    if (!idx) return -1;
+
+    off_t start = zcm_eventlog_tell(l);
+    zcm_eventlog_seek(l, 0);
+
+    int ret = 0;
+    zcm_eventlog_event_t le;
+    while (zcm_eventlog_read_next_event_view(l, &le) == 0) {
+        uint64_t offset = (uint64_t) zcm_eventlog_tell(l) - EVENT_SIZE(&le);
+        if (index_add(idx, offset, le.eventnum, &le) != 0) {
+            ret = -1;
+            break;
+        }
+    }
+    zcm_eventlog_seek(l, start);
+
+    if (fclose(idx->f) != 0) ret = -1;
+    idx->f = NULL;
+    index_free(idx);
+    return ret;
+}
+
+// Reads the event an entry points at. Returns 0 if it's the event the entry describes
+static int read_indexed(zcm_eventlog_t *l, const zcm_eventlog_index_t *idx,
+                        const index_entry_t *e, zcm_eventlog_event_t *le)
+{
+    const index_channel_t *ch = &idx->channels[e->channel];
+    if (zcm_eventlog_read_event_at_offset_view(l, (off_t) e->offset, le) != 0 ||
+        (uint64_t) zcm_eventlog_tell(l) != e->offset + EVENT_SIZE(le) ||
+        le->eventnum != e->eventnum || le->timestamp != e->timestamp ||
+        le->channellen != ch->len || memcmp(le->channel, ch->name, ch->len) != 0)
+        return -1;
+    return 0;
+}
+
+static int index_read(zcm_eventlog_index_t *idx, FILE *f, off_t loglen)
+{
+    int32_t magic, version, stride;
+    if (0 != fread32(f, &magic) || magic != INDEX_MAGIC ||
+        0 != fread32(f, &version) || version != INDEX_VERSION ||
+        0 != fread32(f, &stride) || stride <= 0)
+        return -1;
+    idx->stride = (uint32_t) stride;
+
+    // Stop at the first record that is cut short or doesn't make sense
+    int tag;
+    while ((tag = fgetc(f)) != EOF) {
+        if (tag == 'C') {
+            int32_t id, len;
+            char name[1000];
+            if (0 != fread32(f, &id) || id < 0 || (uint32_t) id != idx->nchannels ||
+                0 != fread32(f, &len) || len <= 0 || len >= (int32_t) sizeof(name) ||
+                fread(name, 1, len, f) != (size_t) len ||
+                add_channel(idx, name, len) < 0)
+                break;
+        } else if (tag == 'E') {
+            index_entry_t e;
+            int32_t channel;
+            if (0 != fread64(f, (int64_t*) &e.offset) ||
+                0 != fread64(f, &e.eventnum) ||
+                0 != fread64(f, &e.timestamp) ||
+                0 != fread64(f, &e.maxts) ||
+                0 != fread64(f, &e.chanmaxts) ||
+                0 != fread32(f, &channel))
+                break;
+            e.channel = (uint32_t) channel;
+            if (e.channel >= idx->nchannels || e.offset >= (uint64_t) loglen ||
+                (idx->nentries && e.offset <= idx->entries[idx->nentries - 1].offset))
+                break;
+            if (grow((void**) &idx->entries, idx->nentries, sizeof(index_entry_t)) != 0)
+                return -1;
+            idx->entries[idx->nentries++] = e;
+        } else {
+            break;
+        }
+    }
+    if (idx->nentries == 0) return -1;
+
+    size_t i;
+    for (i = 0; i < idx->nentries; ++i) {
+        index_channel_t *ch = &idx->channels[idx->entries[i].channel];
+        if (grow((void**) &ch->entries, ch->nentries, sizeof(size_t)) != 0) return -1;
+        ch->entries[ch->nentries++] = i;
+    }
+    return 0;
+}
+
+int zcm_eventlog_load_index(zcm_eventlog_t *l, const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+
+    zcm_eventlog_index_t *idx =
+        (zcm_eventlog_index_t*) calloc(1, sizeof(zcm_eventlog_index_t));
+    int ret = index_read(idx, f, zcm_eventlog_length(l));
+    fclose(f);
+
+    // Catch an index left behind by a different log at the same path
+    if (ret == 0) {
+        zcm_eventlog_event_t le;
+        off_t start = zcm_eventlog_tell(l);
+        ret = read_indexed(l, idx, &idx->entries[0], &le);
+        zcm_eventlog_seek(l, start);
+    }
+
+    if (ret != 0) {
+        index_free(idx);
+        return -1;
+    }
+    if (l->index) index_free(l->index);
+    l->index = idx;
+    return 0;
+}
+
+enum { BY_TIMESTAMP, BY_EVENTNUM, BY_CHANNEL };
+
+// The entry to scan from: every event before it is before the target
+static const index_entry_t *index_find(const zcm_eventlog_index_t *idx, int by,
+                                       int64_t target, const index_channel_t *ch)
+{
+    size_t lo = 0, hi = ch ? ch->nentries : idx->nentries;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const index_entry_t *e = &idx->entries[ch ? ch->entries[mid] : mid];
+        int64_t key = by == BY_EVENTNUM ? e->eventnum :
+                      by == BY_CHANNEL  ? e->chanmaxts : e->maxts;
+        if (key < target) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo > 0) lo--;
+    return &idx->entries[ch ? ch->entries[lo] : lo];
+}
+
+// Leaves the log at the first event at or after the target. Returns 0 if there is one,
+// -1 if there isn't and -2 if the index turns out not to match the log.
+static int index_seek(zcm_eventlog_t *l, int by, int64_t target, const char *channel)
+{
+    zcm_eventlog_index_t *idx = l->index;
+    if (!idx || idx->f) return -2;
+
+    int32_t chanlen = channel ? (int32_t) strlen(channel) : 0;
+    const index_entry_t *e;
+    if (channel) {
+        int64_t id = find_channel(idx, channel, chanlen, hash_channel(channel, chanlen));
+        // The channel can only be in the part of the log after the index ends
+        e = id < 0 ? &idx->entries[idx->nentries - 1] :
+                     index_find(idx, by, target, &idx->channels[id]);
+    } else {
+        e = index_find(idx, by, target, NULL);
+    }
+
+    off_t start = zcm_eventlog_tell(l);
+    zcm_eventlog_event_t le;
+    if (read_indexed(l, idx, e, &le) != 0) {
+        fprintf(stderr, "Event log index doesn't match the log, ignoring it\n");
+        index_free(idx);
+        l->index = NULL;
+        zcm_eventlog_seek(l, start);
+        return -2;
+    }
+
+    off_t pos = (off_t) e->offset;
+    while (1) {
+        int found;
+        if (by == BY_EVENTNUM) {
+            found = le.eventnum >= target;
+        } else {
+            found = le.timestamp >= target;
+            if (channel)
+                found = found && le.channellen == chanlen &&
+                        memcmp(le.channel, channel, chanlen) == 0;
+        }
+        if (found) return zcm_eventlog_seek(l, pos);
+
+        pos = zcm_eventlog_tell(l);
+        if (zcm_eventlog_read_next_event_view(l, &le) != 0) {
+            zcm_eventlog_seek(l, start);
+            return -1;
+        }
+    }
+}
+
+// Seeks without the sidecar index
+static int seek_unindexed(zcm_eventlog_t *l, int64_t target, int byEventnum)
+{
+    return l->blocks ? blocks_seek(l, target, byEventnum) : bisect(l, target, byEventnum);
+}
+
+int zcm_eventlog_seek_to_timestamp(zcm_eventlog_t *l, int64_t timestamp)
+{
+    int ret = index_seek(l, BY_TIMESTAMP, timestamp, NULL);
+    return ret == -2 ? seek_unindexed(l, timestamp, 0) : ret;
+}
+
+int zcm_eventlog_seek_to_eventnum(zcm_eventlog_t *l, int64_t eventnum)
+{
+    int ret = index_seek(l, BY_EVENTNUM, eventnum, NULL);
+    return ret == -2 ? seek_unindexed(l, eventnum, 1) : ret;
+}
+
+int zcm_eventlog_seek_to_channel(zcm_eventlog_t *l, const char *channel, int64_t timestamp)
+{
+    int ret = index_seek(l, BY_CHANNEL, timestamp, channel);
+    if (ret != -2) return ret;
+
+    if (seek_unindexed(l, timestamp, 0) != 0) return -1;
+    int32_t chanlen = (int32_t) strlen(channel);
+    zcm_eventlog_event_t le;
+    off_t pos = zcm_eventlog_tell(l);
+    while (zcm_eventlog_read_next_event_view(l, &le) == 0) {
+        if (le.timestamp >= timestamp && le.channellen == chanlen &&
+            memcmp(le.channel, channel, chanlen) == 0)
+            return zcm_eventlog_seek(l, pos);
+        pos = zcm_eventlog_tell(l);
+    }
+    return -1;
 }
 
 void zcm_eventlog_free_event(zcm_eventlog_event_t *le)
@@ -213,7 +1491,7 @@ void zcm_eventlog_free_event(zcm_eventlog_event_t *le)
     free(le);
 }
 
-int zcm_eventlog_write_event(zcm_eventlog_t *l, const zcm_eventlog_event_t *le)
+static int write_event_stdio(zcm_eventlog_t *l, const zcm_eventlog_event_t *le)
 {
     if (0 != fwrite32(l->f, MAGIC)) return -1;
 
@@ -228,7 +1506,71 @@ int zcm_eventlog_write_event(zcm_eventlog_t *l, const zcm_eventlog_event_t *le)
     if (le->datalen != fwrite(le->data, 1, le->datalen, l->f))
         return -1;
 
+    return 0;
+}
+
+static int write_event_async(zcm_eventlog_t *l, const zcm_eventlog_event_t *le)
+{
+    uint8_t header[sizeof(int32_t) + HEADER_SIZE];
+    put_event_header(header, l->eventcount, le);
+
+    if (0 != zcm_aio_writer_write(l->aio, header, sizeof(header)) ||
+        0 != zcm_aio_writer_write(l->aio, le->channel, le->channellen) ||
+        0 != zcm_aio_writer_write(l->aio, le->data, le->datalen))
+        return -1;
+    return 0;
+}
+
+int zcm_eventlog_write_event(zcm_eventlog_t *l, const zcm_eventlog_event_t *le)
+{
+    if (0 != (l->blocks ? write_event_blocks(l, le) :
+              l->aio    ? write_event_async(l, le) : write_event_stdio(l, le)))
+        return -1;
+
+    zcm_eventlog_index_t *idx = l->index;
+    if (idx && idx->f) {
+        if (0 != index_add(idx, idx->offset, l->eventcount, le)) {
+            fprintf(stderr, "Failed to write event log index, no longer indexing\n");
+            index_free(idx);
+            l->index = NULL;
+        } else {
+            idx->offset += EVENT_SIZE(le);
+        }
+    }
+
     l->eventcount++;
 
     return 0;
 }
+
+int zcm_eventlog_flush(zcm_eventlog_t *l, int sync)
+{
+    if (l->blocks && 0 != blocks_emit(l)) return -1;
+    if (l->index && l->index->f) fflush(l->index->f);
+    if (l->aio) return zcm_aio_writer_flush(l->aio, sync);
+
+    if (0 != fflush(l->f)) return -1;
+#ifndef WIN32
+    if (sync && 0 != fdatasync(fileno(l->f))) return -1;
+#endif
+    return 0;
+}
+
+int zcm_eventlog_write_async(zcm_eventlog_t *l, const zcm_eventlog_async_opts_t *opts)
+{
+#ifndef WIN32
+    zcm_eventlog_async_opts_t defaults;
+    memset(&defaults, 0, sizeof(defaults));
+    if (!opts) opts = &defaults;
+
+    if (l->aio || 0 != fflush(l->f)) return -1;
+    l->aio = zcm_aio_writer_create(fileno(l->f),
+                                   opts->buffer_size ? opts->buffer_size : (size_t) 4 << 20,
+                                   opts->num_buffers ? opts->num_buffers : 4,
+                                   opts->num_threads ? opts->num_threads : 1,
+                                   opts->direct, !opts->no_io_uring, opts->sync_bytes);
+    return l->aio ? 0 : -1;
+#else
+    return -1;
+#endif
+}
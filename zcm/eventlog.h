@@ -24,21 +24,72 @@ struct _zcm_eventlog_event_t
     uint8_t* data;
 };
 
+typedef struct _zcm_eventlog_index_t zcm_eventlog_index_t;
+typedef struct _zcm_eventlog_blocks_t zcm_eventlog_blocks_t;
+
 typedef struct _zcm_eventlog_t zcm_eventlog_t;
 struct _zcm_eventlog_t
 {
     FILE* f;
     int64_t eventcount;
+
+    /* Private mapping of the file, see zcm_eventlog_map() */
+    const uint8_t* map;
+    size_t maplen;
+    size_t mapoff;      /* read position, unless the FILE* currently owns it */
+    int fileowned;
+    size_t readahead;   /* end of the region last advised for readahead */
+
+    /* Backs the events returned as views when the log isn't mapped */
+    uint8_t* viewbuf;
+    size_t viewbuflen;
+
+    /* Sidecar seek index being written or read, see zcm_eventlog_write_index() */
+    zcm_eventlog_index_t* index;
+
+    /* Background writer, see zcm_eventlog_write_async() */
+    struct zcm_aio_writer_t* aio;
+
+    /* Blocks being written or read, see zcm_eventlog_write_compressed() */
+    zcm_eventlog_blocks_t* blocks;
 };
 
+typedef struct _zcm_eventlog_async_opts_t zcm_eventlog_async_opts_t;
+struct _zcm_eventlog_async_opts_t
+{
+    size_t   buffer_size;   /* bytes per buffer, 0 for 4 MiB */
+    uint32_t num_buffers;   /* buffers being filled or written at once, 0 for 4 */
+    uint32_t num_threads;   /* threads writing buffers when io_uring isn't used, 0 for 1 */
+    int      direct;        /* bypass the page cache with O_DIRECT where possible */
+    int      no_io_uring;   /* write through the threads even if io_uring is available */
+    uint64_t sync_bytes;    /* fdatasync every time this many bytes are written, 0 never */
+};
+
+/* Where tools look for the sidecar index of a log: the log's path with this appended */
+#define ZCM_EVENTLOG_INDEX_SUFFIX ".idx"
+#define ZCM_EVENTLOG_INDEX_DEFAULT_STRIDE 64
+
 /**** Methods for creation/deletion ****/
 zcm_eventlog_t* zcm_eventlog_create(const char* path, const char* mode);
 void zcm_eventlog_destroy(zcm_eventlog_t* eventlog);
 
 
 /**** Methods for general operations ****/
+// NOTE: The FILE* of a block compressed log is the file as stored, whose positions
+//       have nothing to do with the offsets below
 FILE* zcm_eventlog_get_fileptr(zcm_eventlog_t* eventlog);
+// NOTE: With an index loaded, the seeks below leave the log at exactly the first event
+//       at or after the target. Without one they bisect the file, which is only close
+//       and requires the target to increase monotonically through the log.
+//       All return 0 on success, -1 on failure.
 int zcm_eventlog_seek_to_timestamp(zcm_eventlog_t* eventlog, int64_t ts);
+int zcm_eventlog_seek_to_eventnum(zcm_eventlog_t* eventlog, int64_t eventnum);
+// The first event on the channel with a timestamp at or after ts
+int zcm_eventlog_seek_to_channel(zcm_eventlog_t* eventlog, const char* channel, int64_t ts);
+off_t zcm_eventlog_tell(zcm_eventlog_t* eventlog);
+int zcm_eventlog_seek(zcm_eventlog_t* eventlog, off_t offset);
+// The offset just past the end of the log, or -1 on failure
+off_t zcm_eventlog_length(zcm_eventlog_t* eventlog);
 
 
 /**** Methods for read/write ****/
@@ -48,6 +99,72 @@ zcm_eventlog_event_t* zcm_eventlog_read_prev_event(zcm_eventlog_t* eventlog);
 zcm_eventlog_event_t* zcm_eventlog_read_event_at_offset(zcm_eventlog_t* eventlog, off_t offset);
 void zcm_eventlog_free_event(zcm_eventlog_event_t* event);
 int zcm_eventlog_write_event(zcm_eventlog_t* eventlog, const zcm_eventlog_event_t* event);
+// Pushes events written so far out to the file, and to disk with sync.
+// Returns 0 on success, -1 on failure.
+int zcm_eventlog_flush(zcm_eventlog_t* eventlog, int sync);
+
+
+/**** Methods for asynchronous writes ****/
+// Switches a log opened with "w" or "a" to serializing events into large buffers that
+// are written out in the background, through io_uring where the kernel offers it and
+// pwrite on a pool of threads otherwise. Pass NULL for the defaults.
+// Returns 0 on success, -1 on failure, in which case writes keep going through stdio.
+// NOTE: A write error may only be reported by a later write or flush. The FILE* of an
+//       asynchronous log must not be written to.
+int zcm_eventlog_write_async(zcm_eventlog_t* eventlog, const zcm_eventlog_async_opts_t* opts);
+
+
+/**** Methods for block compressed logs ****/
+// Switches a log opened with "w", or with "a" on an empty file, to a container that
+// groups events into blocks of about block_size bytes (0 for the default of 256 KiB),
+// each compressed with the named codec from zcm/transport/codec.h, and that ends with an
+// index of the blocks once the log is destroyed. Must be called before any event is
+// written. Returns 0 on success, -1 on failure.
+//
+// Logs opened with "r" are read and seeked through the same functions whichever format
+// they are in. Offsets within a block compressed log are the offsets its events would
+// have in an uncompressed one, so they can be exchanged with the sidecar index, and a
+// log that was never finished is read up to its last complete block. They can't be
+// appended to, nor mapped, but views of their events are still zero-copy, pointing into
+// the decompressed block.
+int zcm_eventlog_write_compressed(zcm_eventlog_t* eventlog, const char* codec,
+                                  size_t block_size);
+
+
+/**** Methods for zero-copy reads ****/
+// Maps a log opened with mode "r" into memory so that the view functions below return
+// events pointing straight into the file, with the kernel reading ahead of them.
+// Returns 0 on success and -1 if the log can't be mapped, in which case it keeps reading
+// through its FILE*. Appends to the file after it was mapped are still picked up.
+//
+// The FILE* returned by zcm_eventlog_get_fileptr() stays usable: the read position is
+// handed to it when it is requested and taken back on the next read. Prefer
+// zcm_eventlog_tell() and zcm_eventlog_seek() in hot loops to avoid the syscalls.
+int zcm_eventlog_map(zcm_eventlog_t* eventlog);
+
+// Fill in a caller owned event without allocating. Return 0 on success, -1 on failure.
+// NOTE: The channel and data of a view are only valid until the next read or until the
+//       log is destroyed. The channel is NOT null terminated. They may be modified in
+//       place, which never changes the file.
+int zcm_eventlog_read_next_event_view(zcm_eventlog_t* eventlog, zcm_eventlog_event_t* event);
+int zcm_eventlog_read_prev_event_view(zcm_eventlog_t* eventlog, zcm_eventlog_event_t* event);
+int zcm_eventlog_read_event_at_offset_view(zcm_eventlog_t* eventlog, off_t offset,
+                                           zcm_eventlog_event_t* event);
+
+
+/**** Methods for the sidecar seek index ****/
+// The index records the offset, eventnum, timestamp and channel of every Nth event in the
+// log, and of every Nth event on each channel, which turns seeks into a binary search
+// followed by a scan over fewer than N events. Return 0 on success, -1 on failure.
+
+// Writes an index at path while events are written to a log opened with "w", or with
+// "a" on an empty file. Stride is N above.
+int zcm_eventlog_write_index(zcm_eventlog_t* eventlog, const char* path, uint32_t stride);
+// Writes an index at path for the events already in a log opened with "r"
+int zcm_eventlog_build_index(zcm_eventlog_t* eventlog, const char* path, uint32_t stride);
+// Loads the index at path for a log opened with "r". Indexes that don't match the log
+// are rejected, here or when a seek finds them to be out of date.
+int zcm_eventlog_load_index(zcm_eventlog_t* eventlog, const char* path);
 
 
 #ifdef __cplusplus
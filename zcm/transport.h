@@ -106,6 +106,34 @@
  *      --------------------------------------------------------------------
  *         Close the transport and cleanup any resources used.
  *
+ *   Optional methods (zcm_trans_ext_methods_t):
+ *
+ *      Methods added after the layout of zcm_trans_methods_t was fixed. They
+ *      live in a table of their own, so that transports built against an older
+ *      copy of this header keep working: a transport that implements any of
+ *      them registers the table for its vtbl with zcm_transport_register_ext()
+ *      (see transport_registrar.h) and sets its 'size' field to
+ *      sizeof(zcm_trans_ext_methods_t). Methods past 'size', or left NULL, are
+ *      treated as not implemented.
+ *
+ *      int flush(zcm_trans_t* zt)
+ *      --------------------------------------------------------------------
+ *         Sends anything the transport held back from earlier calls to sendmsg()
+ *         (e.g. to batch several messages together). Called by zcm_flush() once
+ *         every message queued by zcm has been passed to sendmsg(). This method
+ *         may be called concurrently with sendmsg(). On success, this method
+ *         should return ZCM_EOK.
+ *
+ *      int set_receiving(zcm_trans_t* zt, bool receiving)
+ *      --------------------------------------------------------------------
+ *         Tells the transport whether zcm is taking messages from it: false as
+ *         soon as zcm is handed the transport, true from zcm_start() (or the
+ *         first zcm_handle()) and false again from zcm_stop() or zcm_pause().
+ *         A transport that makes senders wait for slow receivers should not
+ *         wait for one that isn't receiving, and may drop its messages instead.
+ *         This method may be called concurrently with recvmsg(). On success,
+ *         this method should return ZCM_EOK.
+ *
  *******************************************************************************
  * Non-Blocking Transport API:
  *
@@ -197,6 +225,7 @@ extern "C" {
 
 typedef struct zcm_msg_t zcm_msg_t;
 typedef struct zcm_trans_methods_t zcm_trans_methods_t;
+typedef struct zcm_trans_ext_methods_t zcm_trans_ext_methods_t;
 
 
 /* TODO: Discuss the semantics of this datastruct depending on the context (send vs. recv) */
@@ -225,6 +254,14 @@ struct zcm_trans_methods_t
     void    (*destroy)(zcm_trans_t* zt);
 };
 
+/* Appended to as the API grows; never reorder or remove fields */
+struct zcm_trans_ext_methods_t
+{
+    size_t  size;  /* sizeof(zcm_trans_ext_methods_t) */
+    int     (*flush)(zcm_trans_t* zt);
+    int     (*set_receiving)(zcm_trans_t* zt, bool receiving);
+};
+
 /* Helper functions to make the VTbl dispatch cleaner */
 static INLINE size_t zcm_trans_get_mtu(zcm_trans_t* zt)
 { return zt->vtbl->get_mtu(zt); }
@@ -0,0 +1,52 @@
+#include "zcm/transport/codec.h"
+#include "zcm/util/lz4.hpp"
+
+#include <cstring>
+#include <mutex>
+
+#define ZCM_CODECS_MAX 32
+
+static const zcm_codec_t lz4Codec = {
+    "lz4", 1, &lz4Bound, &lz4Compress, &lz4Decompress,
+};
+
+// Note: built in codecs are in the table from the start, so that transports created
+//       during static initialization find them
+static std::mutex mut;
+static const zcm_codec_t* codecs[ZCM_CODECS_MAX] = { &lz4Codec };
+static size_t ncodecs = 1;
+
+bool zcm_codec_register(const zcm_codec_t* codec)
+{
+    if (codec->id == 0)
+        return false;
+
+    std::unique_lock<std::mutex> lk(mut);
+    if (ncodecs >= ZCM_CODECS_MAX)
+        return false;
+
+    for (size_t i = 0; i < ncodecs; i++)
+        if (codecs[i]->id == codec->id || strcmp(codecs[i]->name, codec->name) == 0)
+            return false;
+
+    codecs[ncodecs++] = codec;
+    return true;
+}
+
+const zcm_codec_t* zcm_codec_find(const char* name)
+{
+    std::unique_lock<std::mutex> lk(mut);
+    for (size_t i = 0; i < ncodecs; i++)
+        if (strcmp(codecs[i]->name, name) == 0)
+            return codecs[i];
+    return NULL;
+}
+
+const zcm_codec_t* zcm_codec_find_id(uint8_t id)
+{
+    std::unique_lock<std::mutex> lk(mut);
+    for (size_t i = 0; i < ncodecs; i++)
+        if (codecs[i]->id == id)
+            return codecs[i];
+    return NULL;
+}
@@ -0,0 +1,43 @@
+#ifndef _ZCM_TRANS_CODEC_H
+#define _ZCM_TRANS_CODEC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* A compression codec that transports can apply to message payloads (e.g. udpm's
+ * "compress" url option). Transports tag each compressed message with the codec's id,
+ * so a receiver must have registered the same codec under the same id to read them.
+ * The "lz4" codec (id 1, the LZ4 block format) is always registered. */
+typedef struct zcm_codec_t zcm_codec_t;
+struct zcm_codec_t
+{
+    const char* name;  /* as given in transport urls */
+    uint8_t     id;    /* identifies the codec on the wire, non-zero */
+
+    /* Returns the most bytes compress() can turn 'len' bytes into */
+    size_t (*bound)(size_t len);
+
+    /* Both return ZCM_EOK and set '*dstlen', the room in 'dst' on entry, to the bytes
+     * written. Or ZCM_EINVALID if 'dst' is too small, or 'src' is malformed.
+     * Note: they are called from several threads at once, and decompress() is handed
+     *       whatever arrived off the wire */
+    int (*compress)(const uint8_t* src, size_t len, uint8_t* dst, size_t* dstlen);
+    int (*decompress)(const uint8_t* src, size_t len, uint8_t* dst, size_t* dstlen);
+};
+
+/* Returns false if a codec with the same name or id is already registered.
+ * Note: 'codec' must outlive every transport that uses it */
+bool zcm_codec_register(const zcm_codec_t* codec);
+const zcm_codec_t* zcm_codec_find(const char* name);
+const zcm_codec_t* zcm_codec_find_id(uint8_t id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ZCM_TRANS_CODEC_H */
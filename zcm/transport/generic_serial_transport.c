@@ -160,22 +160,112 @@ size_t cb_flush_in(circBuffer_t* cb, size_t bytes,
     cb->back += n;
     return bytesRead;
 }
+
+// NOTE: This function should never be called w/ num > cb_room(cb)
+void cb_push_n(circBuffer_t* cb, const uint8_t* data, size_t num)
+{
+    ASSERT((cb_room(cb) >= num) && "cb_push_n 1");
+    size_t contiguous = MIN(cb->capacity - cb->back, num);
+    memcpy(cb->data + cb->back, data, contiguous);
+    memcpy(cb->data, data + contiguous, num - contiguous);
+    cb->back += num;
+    if (cb->back >= cb->capacity) cb->back -= cb->capacity;
+}
+
+// Pushes 'data', doubling every escape char in it. Whole runs between escape chars
+// are copied at once. Returns false if 'cb' ran out of room part way, in which case
+// the caller should restore cb->back to what it was
+bool cb_push_escaped(circBuffer_t* cb, const uint8_t* data, size_t num)
+{
+    const uint8_t* end = data + num;
+    while (data < end) {
+        // escape chars one after the other don't each pay for a search
+        if (*data == ZCM_GENERIC_SERIAL_ESCAPE_CHAR) {
+            if (cb_room(cb) < 2) return false;
+            cb_push(cb, ZCM_GENERIC_SERIAL_ESCAPE_CHAR);
+            cb_push(cb, ZCM_GENERIC_SERIAL_ESCAPE_CHAR);
+            ++data;
+            continue;
+        }
+        const uint8_t* esc = memchr(data, ZCM_GENERIC_SERIAL_ESCAPE_CHAR, end - data);
+        size_t run = (esc ? esc : end) - data;
+        if (cb_room(cb) < run) return false;
+        cb_push_n(cb, data, run);
+        data += run;
+    }
+    return true;
+}
+
+// Copies 'num' bytes out of 'cb', starting '*consumed' bytes in, undoing the doubling
+// of escape chars, and advances '*consumed' past them. Returns 1 on success, 0 if
+// 'cb' doesn't hold all of them yet, and -1 if an escape char is followed by
+// anything else, with '*consumed' left on that escape char
+int cb_read_escaped(circBuffer_t* cb, size_t* consumed, uint8_t* out, size_t num)
+{
+    size_t avail = cb_size(cb);
+    size_t pos = *consumed;
+    size_t n = 0;
+
+    while (n < num) {
+        if (pos >= avail) return 0;
+
+        size_t idx = cb->front + pos;
+        if (idx >= cb->capacity) idx -= cb->capacity;
+        const uint8_t* src = cb->data + idx;
+
+        if (*src == ZCM_GENERIC_SERIAL_ESCAPE_CHAR) {
+            if (pos + 1 >= avail) return 0;
+            if (cb_top(cb, pos + 1) != ZCM_GENERIC_SERIAL_ESCAPE_CHAR) {
+                *consumed = pos;
+                return -1;
+            }
+            out[n++] = ZCM_GENERIC_SERIAL_ESCAPE_CHAR;
+            pos += 2;
+            continue;
+        }
+
+        // copy up to the end of the data, the wrap around, or the next escape char
+        size_t run = MIN(MIN(cb->capacity - idx, avail - pos), num - n);
+        const uint8_t* esc = memchr(src, ZCM_GENERIC_SERIAL_ESCAPE_CHAR, run);
+        if (esc) run = esc - src;
+
+        memcpy(out + n, src, run);
+        n += run;
+        pos += run;
+    }
+
+    *consumed = pos;
+    return 1;
+}
 #undef MIN
 
-static uint16_t fletcherUpdate(uint8_t b, uint16_t prevSum)
+// Bytes summed between reductions: the high sum stays below 2^32 for this many
+#define FLETCHER_BLOCK 4096
+
+// Fletcher-16 over 'data', as if each byte was added with an end-around carry: the sums
+// are kept in 1..255 (255 standing for 0), which is what the wire format expects.
+// Summing in 32 bits and reducing once per block gives the same result.
+static uint16_t fletcherUpdate(const uint8_t* data, size_t num, uint16_t prevSum)
 {
-    uint16_t sumHigh = (prevSum >> 8) & 0xff;
-    uint16_t sumLow  =  prevSum       & 0xff;
-    sumHigh += sumLow += b;
+    uint32_t sumHigh = ((prevSum >> 8) & 0xff) % 255;
+    uint32_t sumLow  =  (prevSum       & 0xff) % 255;
 
-    sumLow  = (sumLow  & 0xff) + (sumLow  >> 8);
-    sumHigh = (sumHigh & 0xff) + (sumHigh >> 8);
+    if (num == 0) return prevSum;
 
-    // Note: double reduction to ensure no overflow after first
-    sumLow  = (sumLow  & 0xff) + (sumLow  >> 8);
-    sumHigh = (sumHigh & 0xff) + (sumHigh >> 8);
+    while (num > 0) {
+        size_t block = num < FLETCHER_BLOCK ? num : FLETCHER_BLOCK;
+        num -= block;
+        while (block--) {
+            sumLow  += *data++;
+            sumHigh += sumLow;
+        }
+        sumLow  %= 255;
+        sumHigh %= 255;
+    }
 
-    return (sumHigh << 8) | sumLow;
+    if (sumLow  == 0) sumLow  = 255;
+    if (sumHigh == 0) sumHigh = 255;
+    return (uint16_t)((sumHigh << 8) | sumLow);
 }
 
 typedef struct zcm_trans_generic_serial_t zcm_trans_generic_serial_t;
@@ -205,64 +295,38 @@ size_t serial_get_mtu(zcm_trans_generic_serial_t *zt)
 int serial_sendmsg(zcm_trans_generic_serial_t *zt, zcm_msg_t msg)
 {
     size_t chan_len = strlen(msg.channel);
-    size_t nPushed = 0;
+    const uint8_t* chan = (const uint8_t*) msg.channel;
 
     if (chan_len > ZCM_CHANNEL_MAXLEN)                               return ZCM_EINVALID;
     if (msg.len > zt->mtu)                                           return ZCM_EINVALID;
     if (FRAME_BYTES + chan_len + msg.len > cb_room(&zt->sendBuffer)) return ZCM_EAGAIN;
 
-    cb_push(&zt->sendBuffer, ZCM_GENERIC_SERIAL_ESCAPE_CHAR); ++nPushed;
-    cb_push(&zt->sendBuffer, 0x00);                           ++nPushed;
-    cb_push(&zt->sendBuffer, chan_len);                       ++nPushed;
+    // Escape chars are sent twice, so the frame may still not fit. Then everything
+    // pushed is taken back off
+    size_t back = zt->sendBuffer.back;
 
-    uint32_t len = (uint32_t)msg.len;
-    cb_push(&zt->sendBuffer, (len>>24)&0xff); ++nPushed;
-    cb_push(&zt->sendBuffer, (len>>16)&0xff); ++nPushed;
-    cb_push(&zt->sendBuffer, (len>> 8)&0xff); ++nPushed;
-    cb_push(&zt->sendBuffer, (len>> 0)&0xff); ++nPushed;
-
-    uint16_t checksum = 0xffff;
-    size_t i;
-    for (i = 0; i < chan_len; ++i) {
-        uint8_t c = (uint8_t) msg.channel[i];
-
-        cb_push(&zt->sendBuffer, c); ++nPushed;
-
-        if (c == ZCM_GENERIC_SERIAL_ESCAPE_CHAR) {
-        	// the escape character doesn't count, so we have chan_len - i characters
-        	// remaining in channel + the msg + the checksum.
-            if (cb_room(&zt->sendBuffer) > chan_len - i + msg.len + 1) {
-                cb_push(&zt->sendBuffer, c); ++nPushed;
-            } else {
-                cb_pop(&zt->sendBuffer, nPushed);
-                return ZCM_EAGAIN;
-            }
-        }
+    cb_push(&zt->sendBuffer, ZCM_GENERIC_SERIAL_ESCAPE_CHAR);
+    cb_push(&zt->sendBuffer, 0x00);
+    cb_push(&zt->sendBuffer, chan_len);
 
-        checksum = fletcherUpdate(c, checksum);
+    uint32_t len = (uint32_t)msg.len;
+    cb_push(&zt->sendBuffer, (len>>24)&0xff);
+    cb_push(&zt->sendBuffer, (len>>16)&0xff);
+    cb_push(&zt->sendBuffer, (len>> 8)&0xff);
+    cb_push(&zt->sendBuffer, (len>> 0)&0xff);
+
+    if (!cb_push_escaped(&zt->sendBuffer, chan, chan_len) ||
+        !cb_push_escaped(&zt->sendBuffer, msg.buf, msg.len) ||
+        cb_room(&zt->sendBuffer) < 2) {
+        zt->sendBuffer.back = back;
+        return ZCM_EAGAIN;
     }
 
-    for (i = 0; i < msg.len; ++i) {
-        uint8_t c = (uint8_t) msg.buf[i];
-
-        cb_push(&zt->sendBuffer, c); ++nPushed;
-
-        if (c == ZCM_GENERIC_SERIAL_ESCAPE_CHAR) {
-        	// the escape character doesn't count, so we have msg.len - i characters
-        	// remaining in the msg + the checksum.
-            if (cb_room(&zt->sendBuffer) > msg.len - i + 1) {
-                cb_push(&zt->sendBuffer, c); ++nPushed;
-            } else {
-                cb_pop(&zt->sendBuffer, nPushed);
-                return ZCM_EAGAIN;
-            }
-        }
-
-        checksum = fletcherUpdate(c, checksum);
-    }
+    uint16_t checksum = fletcherUpdate(chan, chan_len, 0xffff);
+    checksum = fletcherUpdate(msg.buf, msg.len, checksum);
 
-    cb_push(&zt->sendBuffer, (checksum >> 8) & 0xff); ++nPushed;
-    cb_push(&zt->sendBuffer,  checksum       & 0xff); ++nPushed;
+    cb_push(&zt->sendBuffer, (checksum >> 8) & 0xff);
+    cb_push(&zt->sendBuffer,  checksum       & 0xff);
 
     return ZCM_EOK;
 }
@@ -288,6 +352,7 @@ int serial_recvmsg(zcm_trans_generic_serial_t *zt, zcm_msg_t *msg, int timeout)
     uint8_t expectedHighCS = 0;
     uint8_t expectedLowCS  = 0;
     uint16_t receivedCS = 0;
+    int ret;
 
     // Sync
     if (cb_top(&zt->recvBuffer, consumed++) != ZCM_GENERIC_SERIAL_ESCAPE_CHAR) goto fail;
@@ -307,52 +372,20 @@ int serial_recvmsg(zcm_trans_generic_serial_t *zt, zcm_msg_t *msg, int timeout)
 
     memset(&zt->recvChanName, '\0', ZCM_CHANNEL_MAXLEN);
 
-    checksum = 0xffff;
-    int i;
-    for (i = 0; i < chan_len; ++i) {
-
-        uint8_t c = cb_top(&zt->recvBuffer, consumed++);
-
-        if (c == ZCM_GENERIC_SERIAL_ESCAPE_CHAR) {
-        	// the escape character doesn't count, so we have chan_len - i characters
-        	// remaining in channel + the msg + the checksum.
-            if (consumed + chan_len - i + msg->len + 2 > incomingSize) return ZCM_EAGAIN;
-
-            c = cb_top(&zt->recvBuffer, consumed++);
-
-            if (c != ZCM_GENERIC_SERIAL_ESCAPE_CHAR) {
-                consumed-=2;
-                goto fail;
-            }
-        }
-
-        zt->recvChanName[i] = c;
-        checksum = fletcherUpdate(c, checksum);
-    }
-
+    // Note: a bad escape leaves 'consumed' on it, it may be the start of the next frame
+    ret = cb_read_escaped(&zt->recvBuffer, &consumed, zt->recvChanName, chan_len);
+    if (ret == 0) return ZCM_EAGAIN;
+    if (ret < 0)  goto fail;
     zt->recvChanName[chan_len] = '\0';
 
-    for (i = 0; i < msg->len; ++i) {
-        if (consumed > incomingSize) return ZCM_EAGAIN;
-
-        uint8_t c = cb_top(&zt->recvBuffer, consumed++);
+    ret = cb_read_escaped(&zt->recvBuffer, &consumed, zt->recvMsgData, msg->len);
+    if (ret == 0) return ZCM_EAGAIN;
+    if (ret < 0)  goto fail;
 
-        if (c == ZCM_GENERIC_SERIAL_ESCAPE_CHAR) {
-        	// the escape character doesn't count, so we have msg.len - i characters
-        	// remaining in the msg + the checksum.
-            if (consumed + msg->len - i + 2 > incomingSize) return ZCM_EAGAIN;
+    if (consumed + 2 > incomingSize) return ZCM_EAGAIN;
 
-            c = cb_top(&zt->recvBuffer, consumed++);
-
-            if (c != ZCM_GENERIC_SERIAL_ESCAPE_CHAR) {
-                consumed-=2;
-                goto fail;
-            }
-        }
-
-        zt->recvMsgData[i] = c;
-        checksum = fletcherUpdate(c, checksum);
-    }
+    checksum = fletcherUpdate(zt->recvChanName, chan_len, 0xffff);
+    checksum = fletcherUpdate(zt->recvMsgData, msg->len, checksum);
 
     expectedHighCS = cb_top(&zt->recvBuffer, consumed++);
     expectedLowCS  = cb_top(&zt->recvBuffer, consumed++);
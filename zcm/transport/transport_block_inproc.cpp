@@ -0,0 +1,548 @@
+#include "zcm/transport.h"
+#include "zcm/transport_registrar.h"
+#include "zcm/transport_register.hpp"
+
+#include "zcm/util/debug.h"
+#include "util/TimeUtil.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#define ZCM_TRANS_CLASSNAME TransportBlockInproc
+#define MTU (1<<28)
+#define DEFAULT_QUEUE_SIZE 1024
+#define MAX_QUEUE_SIZE (1<<20)
+#define DEFAULT_RETAIN_MAX (64 << 20)
+
+using namespace std;
+
+static constexpr size_t CACHE_LINE = 64;
+
+// One published message, shared by every subscriber of the bus.
+// Allocated with malloc() with room for 'capacity' bytes of data after it
+struct Payload
+{
+    atomic<int> refs;      // the slot's reference plus one per subscriber holding it
+    size_t capacity;
+    size_t len;
+    uint64_t utime;
+    char channel[ZCM_CHANNEL_MAXLEN + 1];
+
+    uint8_t *data() { return (uint8_t*)(this + 1); }
+
+    static Payload *create(size_t len)
+    {
+        size_t capacity = 256;
+        while (capacity < len) capacity <<= 1;
+        Payload *p = (Payload*) malloc(sizeof(Payload) + capacity);
+        if (!p) return nullptr;
+        new (&p->refs) atomic<int>(1);
+        p->capacity = capacity;
+        return p;
+    }
+
+    void release()
+    {
+        if (refs.fetch_sub(1, memory_order_acq_rel) == 1)
+            free(this);
+    }
+};
+
+// A slot of the ring. 'state' says which position the slot holds:
+//   2*pos+1 while a publisher fills it in for 'pos'
+//   2*pos+2 once the message for 'pos' can be read
+// The slot lock is only held across a few loads and stores: it keeps a
+// subscriber from taking a reference to a payload just as a publisher lets go of it
+struct Slot
+{
+    atomic<uint64_t> state {0};
+    Payload *payload = nullptr;
+    atomic<bool> locked {false};
+    char pad[CACHE_LINE - sizeof(atomic<uint64_t>) - sizeof(Payload*) - sizeof(atomic<bool>)];
+
+    void lock()
+    {
+        while (locked.exchange(true, memory_order_acquire))
+            this_thread::yield();
+    }
+
+    void unlock() { locked.store(false, memory_order_release); }
+};
+static_assert(sizeof(Slot) == CACHE_LINE, "slots must not share cache lines");
+
+static uint64_t writing(uint64_t pos) { return 2 * pos + 1; }
+static uint64_t ready(uint64_t pos)   { return 2 * pos + 2; }
+
+// What publishers need to know about a subscriber's progress
+struct Cursor
+{
+    char pad0[CACHE_LINE];
+    atomic<uint64_t> pos {0};          // next position it will read
+    atomic<bool> receiving {false};    // whether publishers wait for it
+    char pad1[CACHE_LINE];
+};
+
+// A broadcast ring shared by every transport on the same bus. Publishers claim
+// positions with a single atomic increment. Each subscriber walks the ring with
+// its own cursor; a publisher about to overwrite a message some receiving
+// subscriber has yet to read waits for it. Subscribers that aren't receiving
+// (their zcm_t is stopped or paused, or only ever publishes) hold nobody back:
+// they are lapped and skip ahead when they next read
+class Bus
+{
+    Slot *slots;
+    uint64_t capacity;
+    uint64_t mask;
+
+    // Payloads stay in their slot once every subscriber is done with them, so the
+    // next publish into the slot can reuse them, as long as the ring holds no more
+    // than 'retainMax' bytes of payloads in total. Past that, trim() frees them
+    // from 'trimPos' on, up to the lowest cursor of the receiving subscribers
+    size_t retainMax;
+    atomic<size_t> retained {0};
+    mutex trimMut;
+    uint64_t trimPos = 0;
+
+    char pad0[CACHE_LINE];
+    atomic<uint64_t> head {0};
+
+    // Lowest cursor of the receiving subscribers, as last computed
+    char pad1[CACHE_LINE];
+    atomic<uint64_t> gate {0};
+
+    char pad2[CACHE_LINE];
+    mutex subsMut;
+    vector<Cursor*> subs;
+    atomic<int> numSleepers {0};
+    mutex sleepMut;
+    condition_variable sleepCond;
+
+  public:
+    Bus(uint64_t capacity, size_t retainMax)
+        : capacity(capacity), mask(capacity - 1), retainMax(retainMax)
+    {
+        void *mem = nullptr;
+        if (posix_memalign(&mem, CACHE_LINE, capacity * sizeof(Slot)) != 0)
+            throw bad_alloc();
+        slots = (Slot*) mem;
+        for (uint64_t i = 0; i < capacity; ++i)
+            new (&slots[i]) Slot();
+    }
+
+    ~Bus()
+    {
+        for (uint64_t i = 0; i < capacity; ++i) {
+            if (slots[i].payload) slots[i].payload->release();
+            slots[i].~Slot();
+        }
+        free(slots);
+    }
+
+    uint64_t getCapacity() const { return capacity; }
+
+    // Sets the cursor to the first message the new subscriber will receive
+    void subscribe(Cursor *c)
+    {
+        unique_lock<mutex> lk(subsMut);
+        c->pos.store(head.load(memory_order_seq_cst), memory_order_relaxed);
+        subs.push_back(c);
+    }
+
+    void unsubscribe(Cursor *c)
+    {
+        unique_lock<mutex> lk(subsMut);
+        subs.erase(find(subs.begin(), subs.end(), c));
+    }
+
+    // Lowest position the receiving subscribers have yet to read, 'dflt' if none
+    uint64_t lowestReceiving(uint64_t dflt)
+    {
+        uint64_t lowest = UINT64_MAX;
+        unique_lock<mutex> lk(subsMut);
+        for (Cursor *c : subs)
+            if (c->receiving.load(memory_order_seq_cst))
+                lowest = min(lowest, c->pos.load(memory_order_acquire));
+        return lowest == UINT64_MAX ? dflt : lowest;
+    }
+
+    // Waits until no receiving subscriber still needs the message a lap before 'pos'
+    void waitForSubscribers(uint64_t pos)
+    {
+        if (pos < capacity || pos - capacity < gate.load(memory_order_acquire))
+            return;
+
+        for (int iter = 0;; ++iter) {
+            uint64_t lowest = lowestReceiving(pos);
+            gate.store(lowest, memory_order_release);
+            if (pos - capacity < lowest) return;
+
+            if (iter < 64) this_thread::yield();
+            else           this_thread::sleep_for(chrono::microseconds(100));
+        }
+    }
+
+    int publish(const char *channel, size_t chanLen, const uint8_t *data, size_t len)
+    {
+        uint64_t utime = TimeUtil::utime();
+        uint64_t pos = head.fetch_add(1, memory_order_seq_cst);
+        waitForSubscribers(pos);
+
+        Slot& slot = slots[pos & mask];
+
+        // Wait for the publisher a lap ahead of us to be done with the slot
+        if (pos >= capacity) {
+            while (slot.state.load(memory_order_acquire) < ready(pos - capacity))
+                this_thread::yield();
+        }
+
+        slot.lock();
+        Payload *p = slot.payload;
+        bool reuse = p && p->capacity >= len && p->refs.load(memory_order_acquire) == 1;
+        if (!reuse) slot.payload = nullptr;
+        slot.state.store(writing(pos), memory_order_release);
+        slot.unlock();
+
+        if (!reuse) {
+            if (p) {
+                retained.fetch_sub(p->capacity, memory_order_relaxed);
+                p->release();
+            }
+            p = Payload::create(len);
+            if (!p) {
+                ZCM_DEBUG("block_inproc_send failed: out of memory");
+                // Leave the slot empty so the position is skipped, not waited on
+                slot.state.store(ready(pos), memory_order_release);
+                return ZCM_EMEMORY;
+            }
+            retained.fetch_add(p->capacity, memory_order_relaxed);
+        }
+        memcpy(p->channel, channel, chanLen);
+        p->channel[chanLen] = '\0';
+        memcpy(p->data(), data, len);
+        p->len = len;
+        p->utime = utime;
+
+        slot.lock();
+        slot.payload = p;
+        slot.state.store(ready(pos), memory_order_seq_cst);
+        slot.unlock();
+        trim();
+
+        if (numSleepers.load(memory_order_seq_cst) > 0) {
+            { unique_lock<mutex> lk(sleepMut); }
+            sleepCond.notify_all();
+        }
+        return ZCM_EOK;
+    }
+
+    enum Result { RECEIVED, EMPTY, LAPPED };
+
+    // Takes a reference to the message at 'pos', if it has been published and
+    // not yet overwritten
+    Result take(uint64_t pos, Payload **out)
+    {
+        Slot& slot = slots[pos & mask];
+        slot.lock();
+        uint64_t state = slot.state.load(memory_order_acquire);
+        if (state != ready(pos)) {
+            slot.unlock();
+            return state > ready(pos) ? LAPPED : EMPTY;
+        }
+        Payload *p = slot.payload;
+        if (p) p->refs.fetch_add(1, memory_order_relaxed);
+        slot.unlock();
+        *out = p;
+        return RECEIVED;
+    }
+
+    // Frees the payloads no receiving subscriber needs anymore, oldest first, rather
+    // than leaving them in the ring while it holds more than it should. A subscriber
+    // that isn't receiving may find the message gone, as if it had been lapped
+    void trim()
+    {
+        if (retained.load(memory_order_relaxed) <= retainMax) return;
+        unique_lock<mutex> lk(trimMut, try_to_lock);
+        if (!lk.owns_lock()) return;
+
+        uint64_t h = head.load(memory_order_acquire);
+        uint64_t lowest = lowestReceiving(h);
+        uint64_t pos = max(trimPos, h > capacity ? h - capacity : 0);
+        for (; pos < lowest && retained.load(memory_order_relaxed) > retainMax; ++pos) {
+            Slot& slot = slots[pos & mask];
+            slot.lock();
+            Payload *p = nullptr;
+            // A position still being written is left to its publisher's own trim()
+            if (slot.state.load(memory_order_relaxed) == ready(pos)) {
+                p = slot.payload;
+                slot.payload = nullptr;
+            }
+            slot.unlock();
+            if (p) {
+                retained.fetch_sub(p->capacity, memory_order_relaxed);
+                p->release();
+            }
+        }
+        trimPos = pos;
+    }
+
+    // Oldest position a lapped subscriber can still hope to read
+    uint64_t oldest()
+    {
+        uint64_t h = head.load(memory_order_acquire);
+        return h > capacity ? h - capacity : 0;
+    }
+
+    bool published(uint64_t pos)
+    {
+        return slots[pos & mask].state.load(memory_order_seq_cst) >= ready(pos);
+    }
+
+    // Waits until the message at 'pos' is published or the timeout expires
+    bool wait(uint64_t pos, int timeoutMs)
+    {
+        if (published(pos)) return true;
+        numSleepers.fetch_add(1, memory_order_seq_cst);
+        bool ret;
+        {
+            unique_lock<mutex> lk(sleepMut);
+            ret = sleepCond.wait_for(lk, chrono::milliseconds(timeoutMs),
+                                     [&](){ return published(pos); });
+        }
+        numSleepers.fetch_sub(1, memory_order_seq_cst);
+        return ret;
+    }
+
+    // Every transport created with the same name shares one bus
+    static shared_ptr<Bus> get(const string& name, uint64_t capacity, size_t retainMax)
+    {
+        static mutex busesMut;
+        static unordered_map<string, weak_ptr<Bus>> buses;
+
+        if (name.empty()) return make_shared<Bus>(capacity, retainMax);
+
+        unique_lock<mutex> lk(busesMut);
+        auto bus = buses[name].lock();
+        if (!bus) {
+            bus = make_shared<Bus>(capacity, retainMax);
+            buses[name] = bus;
+        } else if (bus->getCapacity() != capacity) {
+            ZCM_DEBUG("block-inproc bus '%s' already exists with %zu slots",
+                      name.c_str(), (size_t)bus->getCapacity());
+        }
+        return bus;
+    }
+};
+
+struct ZCM_TRANS_CLASSNAME : public zcm_trans_t
+{
+    shared_ptr<Bus> bus;
+    Cursor cursor;
+    uint64_t readPos = 0;
+    uint64_t numLapped = 0;
+    uint64_t numDropped = 0;
+
+    // Whether zcm told us if it is receiving. Until it does, the first
+    // recvmsg() is what makes this subscriber hold publishers back
+    atomic<bool> receivingSet {false};
+
+    // The last message handed out by recvmsg(), kept alive until the next call
+    Payload *inFlight = nullptr;
+
+    ZCM_TRANS_CLASSNAME(zcm_url_t *url)
+    {
+        trans_type = ZCM_BLOCKING;
+        vtbl = &methods;
+
+        size_t queueSize = DEFAULT_QUEUE_SIZE;
+        size_t retainMax = DEFAULT_RETAIN_MAX;
+        auto *opts = zcm_url_opts(url);
+        for (size_t i = 0; i < opts->numopts; ++i) {
+            if (string(opts->name[i]) == "queue_size") {
+                queueSize = strtoul(opts->value[i], NULL, 10);
+                if (queueSize == 0 || queueSize > MAX_QUEUE_SIZE) {
+                    ZCM_DEBUG("expected a 'queue_size' between 1 and %d", MAX_QUEUE_SIZE);
+                    return;
+                }
+            } else if (string(opts->name[i]) == "retain_max") {
+                retainMax = strtoull(opts->value[i], NULL, 10);
+            }
+        }
+        uint64_t capacity = 1;
+        while (capacity < queueSize) capacity <<= 1;
+
+        bus = Bus::get(zcm_url_address(url), capacity, retainMax);
+        bus->subscribe(&cursor);
+        readPos = cursor.pos.load(memory_order_relaxed);
+    }
+
+    ~ZCM_TRANS_CLASSNAME()
+    {
+        if (inFlight) inFlight->release();
+        if (bus) bus->unsubscribe(&cursor);
+    }
+
+    bool good() { return bus != nullptr; }
+
+    /********************** METHODS **********************/
+    size_t get_mtu() { return MTU; }
+
+    int sendmsg(zcm_msg_t msg)
+    {
+        size_t chanLen = strnlen(msg.channel, ZCM_CHANNEL_MAXLEN + 1);
+        if (chanLen > ZCM_CHANNEL_MAXLEN) {
+            ZCM_DEBUG("block_inproc_send failed: invalid channel length");
+            return ZCM_EINVALID;
+        }
+        if (msg.len > MTU) {
+            ZCM_DEBUG("block_inproc_send failed: msg larger than MTU");
+            return ZCM_EINVALID;
+        }
+        return bus->publish(msg.channel, chanLen, msg.buf, msg.len);
+    }
+
+    int recvmsg_enable(const char *channel, bool enable) { return ZCM_EOK; }
+
+    int set_receiving(bool receiving)
+    {
+        receivingSet.store(true, memory_order_relaxed);
+        cursor.receiving.store(receiving, memory_order_seq_cst);
+        return ZCM_EOK;
+    }
+
+    int recvmsg(zcm_msg_t *msg, int timeout)
+    {
+        if (inFlight) {
+            inFlight->release();
+            inFlight = nullptr;
+        }
+
+        if (!receivingSet.load(memory_order_relaxed) &&
+            !cursor.receiving.load(memory_order_relaxed))
+            cursor.receiving.store(true, memory_order_seq_cst);
+
+        uint64_t now = TimeUtil::utime();
+        uint64_t deadline = now + (uint64_t)timeout * 1000;
+        while (true) {
+            Payload *p = nullptr;
+            switch (bus->take(readPos, &p)) {
+                case Bus::RECEIVED:
+                    readPos++;
+                    cursor.pos.store(readPos, memory_order_release);
+                    bus->trim();
+                    if (!p) {
+                        // The publisher ran out of memory, or the payload was
+                        // trimmed while we weren't receiving
+                        numDropped++;
+                        ZCM_DEBUG("block-inproc subscriber dropped a message (%zu so far)",
+                                  (size_t)numDropped);
+                        continue;
+                    }
+                    inFlight = p;
+                    msg->utime = p->utime;
+                    msg->channel = p->channel;
+                    msg->len = p->len;
+                    msg->buf = p->data();
+                    return ZCM_EOK;
+
+                case Bus::LAPPED: {
+                    uint64_t oldest = bus->oldest();
+                    if (oldest <= readPos) oldest = readPos + 1;
+                    numLapped++;
+                    ZCM_DEBUG("block-inproc subscriber lapped (%zu times), skipping %zu messages",
+                              (size_t)numLapped, (size_t)(oldest - readPos));
+                    readPos = oldest;
+                    cursor.pos.store(readPos, memory_order_release);
+                    continue;
+                }
+
+                case Bus::EMPTY: {
+                    now = TimeUtil::utime();
+                    if (now >= deadline) return ZCM_EAGAIN;
+                    bus->wait(readPos, (deadline - now + 999) / 1000);
+                    continue;
+                }
+            }
+        }
+    }
+
+    int update() { return ZCM_EOK; }
+
+    /********************** STATICS **********************/
+    static zcm_trans_methods_t methods;
+    static ZCM_TRANS_CLASSNAME *cast(zcm_trans_t *zt)
+    {
+        assert(zt->vtbl == &methods);
+        return (ZCM_TRANS_CLASSNAME*)zt;
+    }
+
+    static size_t _get_mtu(zcm_trans_t *zt)
+    { return cast(zt)->get_mtu(); }
+
+    static int _sendmsg(zcm_trans_t *zt, zcm_msg_t msg)
+    { return cast(zt)->sendmsg(msg); }
+
+    static int _recvmsg_enable(zcm_trans_t *zt, const char *channel, bool enable)
+    { return cast(zt)->recvmsg_enable(channel, enable); }
+
+    static int _recvmsg(zcm_trans_t *zt, zcm_msg_t *msg, int timeout)
+    { return cast(zt)->recvmsg(msg, timeout); }
+
+    static int _set_receiving(zcm_trans_t *zt, bool receiving)
+    { return cast(zt)->set_receiving(receiving); }
+
+    static int _update(zcm_trans_t *zt)
+    { return cast(zt)->update(); }
+
+    static void _destroy(zcm_trans_t *zt)
+    { delete cast(zt); }
+
+    static zcm_trans_ext_methods_t extMethods;
+    static const TransportRegister regBlocking;
+    static const TransportExtRegister regBlockingExt;
+};
+
+zcm_trans_methods_t ZCM_TRANS_CLASSNAME::methods = {
+    &ZCM_TRANS_CLASSNAME::_get_mtu,
+    &ZCM_TRANS_CLASSNAME::_sendmsg,
+    &ZCM_TRANS_CLASSNAME::_recvmsg_enable,
+    &ZCM_TRANS_CLASSNAME::_recvmsg,
+    &ZCM_TRANS_CLASSNAME::_update,
+    &ZCM_TRANS_CLASSNAME::_destroy,
+};
+
+zcm_trans_ext_methods_t ZCM_TRANS_CLASSNAME::extMethods = {
+    sizeof(zcm_trans_ext_methods_t),
+    NULL, // flush
+    &ZCM_TRANS_CLASSNAME::_set_receiving,
+};
+
+static zcm_trans_t *create_blocking(zcm_url_t *url)
+{
+    auto *trans = new ZCM_TRANS_CLASSNAME(url);
+    if (trans->good())
+        return trans;
+
+    delete trans;
+    return nullptr;
+}
+
+const TransportRegister ZCM_TRANS_CLASSNAME::regBlocking(
+    "block-inproc",
+    "Blocking in-process transport. Every instance created with the same "
+    "'block-inproc://<name>' shares messages; without a name, an instance only hears itself",
+    create_blocking);
+const TransportExtRegister ZCM_TRANS_CLASSNAME::regBlockingExt(
+    &ZCM_TRANS_CLASSNAME::methods, &ZCM_TRANS_CLASSNAME::extMethods);
@@ -8,8 +8,6 @@
 #include <algorithm>
 #include <cstring>
 #include <deque>
-#include <mutex>
-#include <condition_variable>
 
 #define ZCM_TRANS_CLASSNAME TransportNonblockInproc
 #define MTU (1<<28)
@@ -25,12 +23,9 @@ struct ZCM_TRANS_CLASSNAME : public zcm_trans_t
     const char*    inFlightChanMem = nullptr;
           uint8_t* inFlightDataMem = nullptr;
 
-    condition_variable msgCond;
-    mutex msgLock;
-
-    ZCM_TRANS_CLASSNAME(zcm_url_t *url, bool blocking)
+    ZCM_TRANS_CLASSNAME(zcm_url_t *url)
     {
-        trans_type = blocking ? ZCM_BLOCKING : ZCM_NONBLOCKING;
+        trans_type = ZCM_NONBLOCKING;
         vtbl = &methods;
     }
 
@@ -74,13 +69,7 @@ struct ZCM_TRANS_CLASSNAME : public zcm_trans_t
         newMsg->buf = new uint8_t[msg.len];
         std::copy_n(msg.buf, msg.len, newMsg->buf);
 
-        std::unique_lock<mutex> lk(msgLock, defer_lock);
-        if (trans_type == ZCM_BLOCKING) lk.lock();
         msgs.push_back(newMsg);
-        if (trans_type == ZCM_BLOCKING) {
-            lk.unlock();
-            msgCond.notify_all();
-        }
 
         return ZCM_EOK;
     }
@@ -89,16 +78,7 @@ struct ZCM_TRANS_CLASSNAME : public zcm_trans_t
 
     int recvmsg(zcm_msg_t *msg, int timeout)
     {
-        std::unique_lock<mutex> lk(msgLock, defer_lock);
-
-        if (trans_type == ZCM_BLOCKING) {
-            lk.lock();
-            bool available = msgCond.wait_for(lk, chrono::milliseconds(timeout),
-                                              [&](){ return !msgs.empty(); });
-            if (!available) return ZCM_EAGAIN;
-        } else {
-            if (msgs.empty()) return ZCM_EAGAIN;
-        }
+        if (msgs.empty()) return ZCM_EAGAIN;
 
         // Clean up memory from last message
         free((void*) inFlightChanMem);
@@ -145,7 +125,6 @@ struct ZCM_TRANS_CLASSNAME : public zcm_trans_t
     static void _destroy(zcm_trans_t *zt)
     { delete cast(zt); }
 
-    static const TransportRegister regBlocking;
     static const TransportRegister regNonblocking;
 };
 
@@ -158,16 +137,8 @@ zcm_trans_methods_t ZCM_TRANS_CLASSNAME::methods = {
     &ZCM_TRANS_CLASSNAME::_destroy,
 };
 
-static zcm_trans_t *create_blocking(zcm_url_t *url)
-{ return new ZCM_TRANS_CLASSNAME(url, true); }
-
 static zcm_trans_t *create_nonblocking(zcm_url_t *url)
-{ return new ZCM_TRANS_CLASSNAME(url, false); }
-
-const TransportRegister ZCM_TRANS_CLASSNAME::regBlocking(
-    "block-inproc",
-    "Blocking in-process deterministic transport",
-    create_blocking);
+{ return new ZCM_TRANS_CLASSNAME(url); }
 
 const TransportRegister ZCM_TRANS_CLASSNAME::regNonblocking(
     "nonblock-inproc",
@@ -0,0 +1,554 @@
+#ifdef __linux__
+
+#include "zcm/transport.h"
+#include "zcm/transport_registrar.h"
+#include "zcm/transport_register.hpp"
+#include "zcm/util/debug.h"
+
+#include "util/TimeUtil.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cinttypes>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+using namespace std;
+
+// Define this the class name you want
+#define ZCM_TRANS_CLASSNAME TransportShm
+#define SHM_DIR "/dev/shm/"
+#define SHM_NAME_PREFIX "zcm-shm-"
+#define SHM_MAGIC 0x5a434d53  // "ZCMS"
+#define SHM_VERSION 2
+#define DEFAULT_RING_SIZE (16 << 20)
+#define MIN_RING_SIZE (1 << 16)
+#define MAX_RING_SIZE ((size_t)1 << 32)
+#define CACHELINE 64
+
+// Every record starts on a RECORD_ALIGN boundary, so whatever is left before the
+// end of the ring always has room for at least a padding record header
+#define RECORD_ALIGN 16
+
+// A PAD record fills the rest of the ring, a SKIP record stands in for whatever a
+// dead publisher left half-written
+enum RecordType : uint16_t { RECORD_MSG = 1, RECORD_PAD = 2, RECORD_SKIP = 3 };
+
+struct RecordHeader
+{
+    uint32_t datalen;
+    uint16_t chanlen;   // not including the NULL that follows the channel
+    uint16_t type;
+    uint64_t utime;     // publish time
+};
+static_assert(sizeof(RecordHeader) == RECORD_ALIGN, "record header must be one alignment unit");
+
+// Lives at the start of the shared mapping, followed by the ring data.
+// Positions are byte offsets that only ever grow; a position maps to the ring
+// at (pos & (capacity-1))
+struct ShmHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+
+    // Serializes publishers (from any process). Robust, so a publisher dying
+    // mid-write doesn't wedge everyone else
+    pthread_mutex_t writeMut;
+    char pad0[CACHELINE];
+
+    // Bytes claimed by publishers. Anything older than writePos - capacity may
+    // already be overwritten
+    std::atomic<uint64_t> writePos;
+    // Start of the oldest record that is still intact. Lapped readers resume here
+    std::atomic<uint64_t> tailPos;
+    char pad1[CACHELINE - 2 * sizeof(std::atomic<uint64_t>)];
+
+    // Bytes fully written. Readers never read past this
+    std::atomic<uint64_t> commitPos;
+    char pad2[CACHELINE - sizeof(std::atomic<uint64_t>)];
+
+    // Futex word bumped on every commit, and how many readers sleep on it
+    std::atomic<uint32_t> futexSeq;
+    std::atomic<uint32_t> waiters;
+    char pad3[CACHELINE - 2 * sizeof(std::atomic<uint32_t>)];
+};
+
+static size_t headerSize()
+{
+    return (sizeof(ShmHeader) + CACHELINE - 1) & ~(size_t)(CACHELINE - 1);
+}
+
+static size_t alignRecord(size_t sz)
+{
+    return (sz + RECORD_ALIGN - 1) & ~(size_t)(RECORD_ALIGN - 1);
+}
+
+static size_t recordSize(const RecordHeader& r)
+{
+    return alignRecord(sizeof(RecordHeader) + r.chanlen + 1 + r.datalen);
+}
+
+static int futexWait(std::atomic<uint32_t> *addr, uint32_t val, int timeoutMs)
+{
+    struct timespec ts;
+    struct timespec *tsp = NULL;
+    if (timeoutMs >= 0) {
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = (timeoutMs % 1000) * 1000000;
+        tsp = &ts;
+    }
+    // Note: not FUTEX_PRIVATE_FLAG, the word is shared between processes
+    return syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAIT, val, tsp, NULL, 0);
+}
+
+static void futexWakeAll(std::atomic<uint32_t> *addr)
+{
+    syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+struct ZCM_TRANS_CLASSNAME : public zcm_trans_t
+{
+    string path;
+    int fd = -1;
+    void *mapping = MAP_FAILED;
+    size_t mappingSize = 0;
+    ShmHeader *hdr = nullptr;
+    char *ring = nullptr;
+    uint64_t capacity = 0;
+    size_t mtu = 0;
+
+    // Reader state (only touched by recvmsg())
+    uint64_t readPos = 0;
+    vector<char> recvBuf;
+    uint64_t numLapped = 0;
+
+    // The channels recvmsg() must deliver. Protected by 'mut' so that
+    // recvmsgEnable() can be called concurrently with recvmsg(). Every change
+    // bumps 'channelsVersion'
+    mutex mut;
+    unordered_set<string> channels;
+    std::atomic<uint64_t> channelsVersion {0};
+    std::atomic<bool> recvAllChannels {false};
+
+    // recvmsg()'s copy of 'channels', only refreshed when channelsVersion moves,
+    // and a key reused for every lookup so filtering needn't lock or allocate
+    unordered_set<string> readerChannels;
+    uint64_t readerVersion = 0;
+    string lookupKey;
+
+    ZCM_TRANS_CLASSNAME(zcm_url_t *url)
+    {
+        trans_type = ZCM_BLOCKING;
+        vtbl = &methods;
+
+        string name = zcm_url_address(url);
+        if (name.empty()) name = "default";
+        if (name.find('/') != string::npos) {
+            ZCM_DEBUG("shm name may not contain '/': %s", name.c_str());
+            return;
+        }
+        path = SHM_DIR SHM_NAME_PREFIX + name;
+
+        size_t requested = DEFAULT_RING_SIZE;
+        auto *opts = zcm_url_opts(url);
+        for (size_t i = 0; i < opts->numopts; ++i) {
+            if (string(opts->name[i]) == "size") {
+                requested = strtoull(opts->value[i], NULL, 10);
+                if (requested < MIN_RING_SIZE || requested > MAX_RING_SIZE) {
+                    ZCM_DEBUG("expected a 'size' between %d and %zu bytes",
+                              MIN_RING_SIZE, MAX_RING_SIZE);
+                    return;
+                }
+            }
+        }
+        // round up to a power of two
+        size_t ringSize = MIN_RING_SIZE;
+        while (ringSize < requested) ringSize <<= 1;
+
+        if (!open(ringSize)) {
+            close();
+            return;
+        }
+
+        // Messages have to fit in the ring with room to spare for a padding
+        // record and for the record readers are still copying out
+        mtu = capacity / 4 - sizeof(RecordHeader) - ZCM_CHANNEL_MAXLEN - 1;
+        readPos = hdr->commitPos.load(std::memory_order_acquire);
+        ZCM_DEBUG("shm: mapped %s with a %zu byte ring", path.c_str(), (size_t)capacity);
+    }
+
+    ~ZCM_TRANS_CLASSNAME()
+    {
+        close();
+    }
+
+    bool good() { return hdr != nullptr; }
+
+    // Opens (or creates and initializes) the shared ring. An existing ring keeps
+    // whatever size it was created with
+    bool open(size_t ringSize)
+    {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+        if (fd < 0) {
+            ZCM_DEBUG("shm: failed to open %s: %s", path.c_str(), strerror(errno));
+            return false;
+        }
+
+        // Creating processes race on the initialization, the file lock settles it
+        if (flock(fd, LOCK_EX) < 0) {
+            ZCM_DEBUG("shm: failed to lock %s: %s", path.c_str(), strerror(errno));
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) < 0) {
+            flock(fd, LOCK_UN);
+            return false;
+        }
+
+        bool create = st.st_size == 0;
+        if (create) {
+            mappingSize = headerSize() + ringSize;
+            if (ftruncate(fd, mappingSize) < 0) {
+                ZCM_DEBUG("shm: failed to size %s: %s", path.c_str(), strerror(errno));
+                flock(fd, LOCK_UN);
+                return false;
+            }
+        } else {
+            mappingSize = st.st_size;
+        }
+
+        mapping = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapping == MAP_FAILED) {
+            ZCM_DEBUG("shm: failed to map %s: %s", path.c_str(), strerror(errno));
+            flock(fd, LOCK_UN);
+            return false;
+        }
+        hdr = (ShmHeader*) mapping;
+        ring = (char*) mapping + headerSize();
+
+        if (create) {
+            hdr->version = SHM_VERSION;
+            hdr->capacity = ringSize;
+            pthread_mutexattr_t attr;
+            pthread_mutexattr_init(&attr);
+            pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+            pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+            pthread_mutex_init(&hdr->writeMut, &attr);
+            pthread_mutexattr_destroy(&attr);
+            new (&hdr->writePos) std::atomic<uint64_t>(0);
+            new (&hdr->tailPos) std::atomic<uint64_t>(0);
+            new (&hdr->commitPos) std::atomic<uint64_t>(0);
+            new (&hdr->futexSeq) std::atomic<uint32_t>(0);
+            new (&hdr->waiters) std::atomic<uint32_t>(0);
+            std::atomic_thread_fence(std::memory_order_release);
+            hdr->magic = SHM_MAGIC;
+        }
+        flock(fd, LOCK_UN);
+
+        if (hdr->magic != SHM_MAGIC || hdr->version != SHM_VERSION ||
+            headerSize() + hdr->capacity != mappingSize) {
+            ZCM_DEBUG("shm: %s is not a compatible zcm ring", path.c_str());
+            hdr = nullptr;
+            return false;
+        }
+        capacity = hdr->capacity;
+        if (!create && capacity != ringSize)
+            ZCM_DEBUG("shm: using the existing %zu byte ring", (size_t)capacity);
+        return true;
+    }
+
+    void close()
+    {
+        if (mapping != MAP_FAILED) munmap(mapping, mappingSize);
+        mapping = MAP_FAILED;
+        hdr = nullptr;
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+
+    void lockWriter()
+    {
+        int rc = pthread_mutex_lock(&hdr->writeMut);
+        if (rc == EOWNERDEAD) {
+            // A publisher died while holding the lock. It may have stepped the tail
+            // and half-written over older records, and readers judge whether they
+            // were lapped by its claim, so the claim can't be given back. Instead
+            // it is committed as a single record that readers skip
+            ZCM_DEBUG("shm: recovering from a publisher that died mid-write");
+            uint64_t commit = hdr->commitPos.load(std::memory_order_relaxed);
+            uint64_t claimed = hdr->writePos.load(std::memory_order_relaxed);
+            if (claimed != commit) {
+                // Claims are whole records, so always have room for this header
+                RecordHeader *r = (RecordHeader*)(ring + (commit & (capacity - 1)));
+                r->datalen = claimed - commit - sizeof(RecordHeader) - 1;
+                r->chanlen = 0;
+                r->type = RECORD_SKIP;
+                r->utime = 0;
+                hdr->commitPos.store(claimed, std::memory_order_release);
+                hdr->futexSeq.fetch_add(1, std::memory_order_seq_cst);
+                if (hdr->waiters.load(std::memory_order_seq_cst) > 0)
+                    futexWakeAll(&hdr->futexSeq);
+            }
+            pthread_mutex_consistent(&hdr->writeMut);
+        }
+    }
+
+    /********************** METHODS **********************/
+    size_t getMtu() { return mtu; }
+
+    int sendmsg(zcm_msg_t msg)
+    {
+        size_t chanlen = strnlen(msg.channel, ZCM_CHANNEL_MAXLEN + 1);
+        if (chanlen > ZCM_CHANNEL_MAXLEN)
+            return ZCM_EINVALID;
+        if (msg.len > mtu)
+            return ZCM_EINVALID;
+
+        RecordHeader rec;
+        rec.datalen = msg.len;
+        rec.chanlen = chanlen;
+        rec.type = RECORD_MSG;
+        rec.utime = msg.utime;
+        size_t need = recordSize(rec);
+
+        lockWriter();
+
+        uint64_t pos = hdr->writePos.load(std::memory_order_relaxed);
+        uint64_t off = pos & (capacity - 1);
+        uint64_t pad = capacity - off < need ? capacity - off : 0;
+        uint64_t end = pos + pad + need;
+
+        // Step the tail over every record this write is about to clobber
+        uint64_t tail = hdr->tailPos.load(std::memory_order_relaxed);
+        while (end - tail > capacity) {
+            uint64_t toff = tail & (capacity - 1);
+            const RecordHeader *t = (const RecordHeader*)(ring + toff);
+            tail += t->type == RECORD_PAD ? capacity - toff : recordSize(*t);
+        }
+        hdr->tailPos.store(tail, std::memory_order_relaxed);
+
+        // Claim the space before touching it: readers check writePos after
+        // copying a record to learn whether it was overwritten underneath them
+        hdr->writePos.store(end, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        if (pad) {
+            RecordHeader *p = (RecordHeader*)(ring + off);
+            p->datalen = 0;
+            p->chanlen = 0;
+            p->type = RECORD_PAD;
+            p->utime = 0;
+            off = 0;
+        }
+
+        RecordHeader *r = (RecordHeader*)(ring + off);
+        *r = rec;
+        char *chan = (char*)(r + 1);
+        memcpy(chan, msg.channel, chanlen);
+        chan[chanlen] = '\0';
+        memcpy(chan + chanlen + 1, msg.buf, msg.len);
+
+        hdr->commitPos.store(end, std::memory_order_release);
+        pthread_mutex_unlock(&hdr->writeMut);
+
+        hdr->futexSeq.fetch_add(1, std::memory_order_seq_cst);
+        if (hdr->waiters.load(std::memory_order_seq_cst) > 0)
+            futexWakeAll(&hdr->futexSeq);
+
+        return ZCM_EOK;
+    }
+
+    int recvmsgEnable(const char *channel, bool enable)
+    {
+        unique_lock<mutex> lk(mut);
+        if (channel == NULL) {
+            recvAllChannels.store(enable, std::memory_order_release);
+        } else if (enable) {
+            channels.insert(channel);
+        } else {
+            channels.erase(channel);
+        }
+        channelsVersion.fetch_add(1, std::memory_order_release);
+        return ZCM_EOK;
+    }
+
+    bool wanted(const char *channel, size_t chanlen)
+    {
+        if (recvAllChannels.load(std::memory_order_acquire))
+            return true;
+        if (channelsVersion.load(std::memory_order_acquire) != readerVersion) {
+            unique_lock<mutex> lk(mut);
+            readerChannels = channels;
+            readerVersion = channelsVersion.load(std::memory_order_relaxed);
+        }
+        lookupKey.assign(channel, chanlen);
+        return readerChannels.count(lookupKey) > 0;
+    }
+
+    // True if the bytes at readPos may have been overwritten by now
+    bool lapped()
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return hdr->writePos.load(std::memory_order_relaxed) - readPos > capacity;
+    }
+
+    // Resumes from the oldest message the publishers haven't overwritten yet
+    void skipLapped()
+    {
+        uint64_t tail = hdr->tailPos.load(std::memory_order_acquire);
+        numLapped++;
+        ZCM_DEBUG("shm: reader lapped (%" PRIu64 " times), skipping %" PRIu64 " bytes",
+                  numLapped, tail - readPos);
+        readPos = tail;
+    }
+
+    int recvmsg(zcm_msg_t *msg, int timeout)
+    {
+        uint64_t deadline = timeout >= 0 ? TimeUtil::utime() + (uint64_t)timeout * 1000 : 0;
+
+        while (true) {
+            uint32_t seq = hdr->futexSeq.load(std::memory_order_seq_cst);
+            uint64_t commit = hdr->commitPos.load(std::memory_order_acquire);
+
+            if (readPos == commit) {
+                int wait = -1;
+                if (timeout >= 0) {
+                    uint64_t now = TimeUtil::utime();
+                    if (now >= deadline) return ZCM_EAGAIN;
+                    wait = (deadline - now + 999) / 1000;
+                }
+                hdr->waiters.fetch_add(1, std::memory_order_seq_cst);
+                if (hdr->commitPos.load(std::memory_order_seq_cst) == readPos)
+                    futexWait(&hdr->futexSeq, seq, wait);
+                hdr->waiters.fetch_sub(1, std::memory_order_seq_cst);
+                continue;
+            }
+
+            if (commit - readPos > capacity) {
+                skipLapped();
+                continue;
+            }
+
+            RecordHeader r = *(RecordHeader*)(ring + (readPos & (capacity - 1)));
+            if (lapped()) {
+                skipLapped();
+                continue;
+            }
+
+            if (r.type == RECORD_PAD) {
+                readPos += capacity - (readPos & (capacity - 1));
+                continue;
+            }
+
+            size_t size = recordSize(r);
+            if ((r.type != RECORD_MSG && r.type != RECORD_SKIP) ||
+                r.chanlen > ZCM_CHANNEL_MAXLEN || size > commit - readPos) {
+                ZCM_DEBUG("shm: corrupt record, resynchronizing");
+                readPos = commit;
+                continue;
+            }
+
+            if (r.type == RECORD_SKIP) {
+                readPos += size;
+                continue;
+            }
+
+            const char *src = ring + (readPos & (capacity - 1)) + sizeof(RecordHeader);
+            if (!wanted(src, r.chanlen)) {
+                // the channel may have been overwritten while we looked at it, but
+                // either way the record is of no use to us
+                readPos += size;
+                continue;
+            }
+
+            // Copy the record out; the publisher never waits for readers, so the
+            // ring can't lend us the bytes until our next recvmsg()
+            size_t len = r.chanlen + 1 + r.datalen;
+            if (recvBuf.size() < len) recvBuf.resize(len);
+            memcpy(recvBuf.data(), src, len);
+            if (lapped()) {
+                skipLapped();
+                continue;
+            }
+            readPos += size;
+
+            recvBuf[r.chanlen] = '\0';
+            msg->utime = r.utime;
+            msg->channel = recvBuf.data();
+            msg->len = r.datalen;
+            msg->buf = (uint8_t*)recvBuf.data() + r.chanlen + 1;
+            return ZCM_EOK;
+        }
+    }
+
+    /********************** STATICS **********************/
+    static zcm_trans_methods_t methods;
+    static ZCM_TRANS_CLASSNAME *cast(zcm_trans_t *zt)
+    {
+        assert(zt->vtbl == &methods);
+        return (ZCM_TRANS_CLASSNAME*)zt;
+    }
+
+    static size_t _getMtu(zcm_trans_t *zt)
+    { return cast(zt)->getMtu(); }
+
+    static int _sendmsg(zcm_trans_t *zt, zcm_msg_t msg)
+    { return cast(zt)->sendmsg(msg); }
+
+    static int _recvmsgEnable(zcm_trans_t *zt, const char *channel, bool enable)
+    { return cast(zt)->recvmsgEnable(channel, enable); }
+
+    static int _recvmsg(zcm_trans_t *zt, zcm_msg_t *msg, int timeout)
+    { return cast(zt)->recvmsg(msg, timeout); }
+
+    static void _destroy(zcm_trans_t *zt)
+    { delete cast(zt); }
+
+    static const TransportRegister regShm;
+};
+
+zcm_trans_methods_t ZCM_TRANS_CLASSNAME::methods = {
+    &ZCM_TRANS_CLASSNAME::_getMtu,
+    &ZCM_TRANS_CLASSNAME::_sendmsg,
+    &ZCM_TRANS_CLASSNAME::_recvmsgEnable,
+    &ZCM_TRANS_CLASSNAME::_recvmsg,
+    NULL, // update
+    &ZCM_TRANS_CLASSNAME::_destroy,
+};
+
+static zcm_trans_t *createShm(zcm_url_t *url)
+{
+    auto *trans = new ZCM_TRANS_CLASSNAME(url);
+    if (trans->good())
+        return trans;
+
+    delete trans;
+    return nullptr;
+}
+
+#ifdef USING_TRANS_SHM
+// Register this transport with ZCM
+const TransportRegister ZCM_TRANS_CLASSNAME::regShm(
+    "shm", "Transfer data via a shared memory ring (e.g. 'shm://<name>?size=<bytes>')",
+    createShm);
+#endif
+
+#endif
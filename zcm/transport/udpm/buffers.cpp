@@ -1,17 +1,5 @@
 #include "buffers.hpp"
 
-static bool sockaddrEqual(struct sockaddr_in *a, struct sockaddr_in *b)
-{
-    return a->sin_addr.s_addr == b->sin_addr.s_addr &&
-           a->sin_port        == b->sin_port &&
-           a->sin_family      == b->sin_family;
-}
-
-bool FragBuf::matchesSockaddr(struct sockaddr_in *addr)
-{
-    return sockaddrEqual(&from, addr);
-}
-
 MessagePool::MessagePool(size_t maxSize, size_t maxBuffers)
     : maxSize(maxSize), maxBuffers(maxBuffers)
 {
@@ -19,6 +7,8 @@ MessagePool::MessagePool(size_t maxSize, size_t maxBuffers)
 
 MessagePool::~MessagePool()
 {
+    while (lruHead)
+        removeFragBuf(lruHead);
 }
 
 Buffer MessagePool::allocBuffer(size_t sz)
@@ -82,69 +72,121 @@ void MessagePool::freeMessage(Message *b)
 }
 
 
-FragBuf *MessagePool::addFragBuf(u32 data_size)
+FragKey makeFragKey(struct sockaddr_in *from, u32 msg_seqno)
 {
-    FragBuf *fbuf = new (mempool.alloc<FragBuf>()) FragBuf{};
-    fbuf->buf = this->allocBuffer(data_size);
+    FragKey k;
+    k.addr = from->sin_addr.s_addr;
+    k.port = from->sin_port;
+    k.msg_seqno = msg_seqno;
+    return k;
+}
+
+static u64 senderKey(u32 addr, u16 port)
+{
+    return ((u64)addr << 16) | port;
+}
+
+void MessagePool::_lruUnlink(FragBuf *fbuf)
+{
+    if (fbuf->lruPrev) fbuf->lruPrev->lruNext = fbuf->lruNext;
+    else               lruHead = fbuf->lruNext;
+    if (fbuf->lruNext) fbuf->lruNext->lruPrev = fbuf->lruPrev;
+    else               lruTail = fbuf->lruPrev;
+    fbuf->lruPrev = fbuf->lruNext = nullptr;
+}
+
+void MessagePool::_lruPushFront(FragBuf *fbuf)
+{
+    fbuf->lruPrev = nullptr;
+    fbuf->lruNext = lruHead;
+    if (lruHead) lruHead->lruPrev = fbuf;
+    lruHead = fbuf;
+    if (!lruTail) lruTail = fbuf;
+}
 
-    while (totalSize > maxSize || fragbufs.size() > maxBuffers) {
-        // find and remove the least recently updated fragment buffer
-        int idx = -1;
-        FragBuf *eldest = nullptr;
-        for (size_t i = 0; i < fragbufs.size(); i++) {
-            FragBuf *f = fragbufs[i];
-            if (idx == -1 || f->last_packet_utime < eldest->last_packet_utime) {
-                idx = (int)i;
-                eldest = f;
-            }
-        }
-        if (eldest) {
-            _removeFragBuf((size_t)idx);
-            // XXX Need to free the removed FragBuf*
-        }
+FragBuf *MessagePool::addFragBuf(struct sockaddr_in *from, u32 msg_seqno,
+                                 u32 data_size, u16 fragments_in_msg)
+{
+    // make room by evicting the least recently updated fragment buffers
+    while (lruTail && (totalSize + data_size > maxSize || fragbufs.size() >= maxBuffers)) {
+        ZCM_DEBUG("Evicting partial message (missing %d fragments)",
+                  lruTail->fragments_remaining);
+        fragStats.evicted++;
+        removeFragBuf(lruTail);
     }
 
-    fragbufs.push_back(fbuf);
+    FragBuf *fbuf = new (mempool.alloc<FragBuf>()) FragBuf{};
+    fbuf->buf = this->allocBuffer(data_size);
+    fbuf->msg_seqno = msg_seqno;
+    fbuf->fragments_in_msg = fragments_in_msg;
+    fbuf->fragments_remaining = fragments_in_msg;
+    fbuf->from = *from;
+    fbuf->received.assign((fragments_in_msg + 63) / 64, 0);
+    fbuf->key = makeFragKey(from, msg_seqno);
+
+    fragbufs[fbuf->key] = fbuf;
+    newestBySender[senderKey(fbuf->key.addr, fbuf->key.port)] = fbuf;
+    _lruPushFront(fbuf);
     totalSize += data_size;
 
     return fbuf;
 }
 
-FragBuf *MessagePool::lookupFragBuf(struct sockaddr_in *key)
+FragBuf *MessagePool::lookupFragBuf(struct sockaddr_in *from, u32 msg_seqno)
 {
-    for (auto& elt : fragbufs)
-        if (elt->matchesSockaddr(key))
-            return elt;
-    return nullptr;
+    auto it = fragbufs.find(makeFragKey(from, msg_seqno));
+    if (it == fragbufs.end())
+        return nullptr;
+
+    FragBuf *fbuf = it->second;
+    if (fbuf != lruHead) {
+        _lruUnlink(fbuf);
+        _lruPushFront(fbuf);
+    }
+    return fbuf;
 }
 
-void MessagePool::_removeFragBuf(size_t index)
+FragBuf *MessagePool::lookupNewestFragBuf(struct sockaddr_in *from)
 {
-    assert(index < fragbufs.size());
+    auto it = newestBySender.find(senderKey(from->sin_addr.s_addr, from->sin_port));
+    return it == newestBySender.end() ? nullptr : it->second;
+}
+
+bool MessagePool::markFragment(FragBuf *fbuf, u16 fragment_no)
+{
+    assert(fragment_no < fbuf->fragments_in_msg);
+    u64& word = fbuf->received[fragment_no / 64];
+    u64 bit = (u64)1 << (fragment_no % 64);
+    if (word & bit) {
+        fragStats.duplicates++;
+        return false;
+    }
+    word |= bit;
+    return true;
+}
+
+void MessagePool::removeFragBuf(FragBuf *fbuf)
+{
+    size_t erased = fragbufs.erase(fbuf->key);
+    assert(erased == 1 && "Tried to remove invalid fragbuf");
+    (void)erased;
+    auto it = newestBySender.find(senderKey(fbuf->key.addr, fbuf->key.port));
+    if (it != newestBySender.end() && it->second == fbuf)
+        newestBySender.erase(it);
+    _lruUnlink(fbuf);
 
     // Update the total_size of the fragment buffers
-    FragBuf *fbuf = fragbufs[index];
     totalSize -= fbuf->buf.size;
 
-    // delete old element, move last element to this slot, and shrink by 1
-    size_t lastIdx = fragbufs.size()-1;
-    fragbufs[index] = fragbufs[lastIdx];
-    fragbufs.pop_back();
-
     this->freeBuffer(fbuf->buf);
+    fbuf->~FragBuf();
     mempool.free(fbuf);
 }
 
-void MessagePool::removeFragBuf(FragBuf *fbuf)
+void MessagePool::dropFragBuf(FragBuf *fbuf)
 {
-    // NOTE: this is kinda slow...
-    // Search for the fragbuf index
-    for (size_t idx = 0; idx < fragbufs.size(); idx++)
-        if (fragbufs[idx] == fbuf)
-            return this->_removeFragBuf(idx);
-
-    // Did not find
-    assert(0 && "Tried to remove invalid fragbuf");
+    fragStats.incomplete++;
+    removeFragBuf(fbuf);
 }
 
 void MessagePool::transferBufffer(Message *to, FragBuf *from)
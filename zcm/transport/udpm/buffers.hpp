@@ -60,10 +60,57 @@ struct MsgHeaderLong
     char *getDataPtr() { return (char*)(this+1); }
 };
 
+// A batch of short messages (ZCM_MAGIC_BATCH) starts with a MsgHeaderShort holding the
+// seqno of its first message. Each message then follows as its length (u16, network
+// order), its NULL-terminated channel and its data, and takes the next seqno
+
 // if fragment_no == 0, then header is immediately followed by NULL-terminated
 // ASCII-encoded channel name, followed by the payload data
 // if fragment_no > 0, then header is immediately followed by the payload data
 
+// The data of a compressed message (ZCM_MAGIC_COMPRESSED) starts with this header,
+// followed by what the codec made of the original data. The channel isn't compressed.
+// Note: no alignment can be assumed, copy it in and out of the packet
+struct MsgHeaderCompressed
+{
+  private:
+    u8  codec;
+    u8  reserved[3];
+    u32 raw_size;
+
+  public:
+    MsgHeaderCompressed() {}
+    MsgHeaderCompressed(u8 codec, u32 rawSize) : codec(codec), raw_size(htonl(rawSize))
+    { memset(reserved, 0, sizeof(reserved)); }
+
+    u8  getCodec()   { return codec; }
+    u32 getRawSize() { return ntohl(raw_size); }
+};
+
+// Sent by receivers in reliable mode, unicast to the socket a fragmented message came
+// from, to ask for some of its fragments again
+struct MsgHeaderNack
+{
+  private:
+    u32 magic;
+    u32 msg_seqno;
+    u16 nfragments;
+    u16 reserved;
+
+  public:
+    u32  getMagic()            { return ntohl(magic); }
+    void setMagic(u32 v)       { magic = htonl(v); }
+    u32  getMsgSeqno()         { return ntohl(msg_seqno); }
+    void setMsgSeqno(u32 v)    { msg_seqno = htonl(v); }
+    u16  getNumFragments()     { return ntohs(nfragments); }
+    void setNumFragments(u16 v) { nfragments = htons(v); reserved = 0; }
+
+    // Note: the fragment numbers (u16, network order) follow the header
+    u16 getFragmentNo(size_t i)           { return ntohs(((u16*)(this+1))[i]); }
+    void setFragmentNo(size_t i, u16 v)   { ((u16*)(this+1))[i] = htons(v); }
+    static size_t getSize(size_t nfrags)  { return sizeof(MsgHeaderNack) + nfrags * sizeof(u16); }
+};
+
 /******************** message buffer **********************/
 struct Buffer
 {
@@ -112,6 +159,7 @@ struct Packet
 {
     i64             utime;      // timestamp of first datagram receipt
     size_t          sz;         // size received
+    u32             kernel_drops; // socket's SO_RXQ_OVFL count at receipt (0 if unknown)
 
     struct sockaddr from;       // sender
     socklen_t       fromlen;
@@ -125,21 +173,66 @@ struct Packet
 };
 
 /******************** fragment buffer **********************/
+// Identifies one fragmented message: its sender and its sequence number
+struct FragKey
+{
+    u32 addr;
+    u16 port;
+    u32 msg_seqno;
+
+    bool operator==(const FragKey& o) const
+    { return addr == o.addr && port == o.port && msg_seqno == o.msg_seqno; }
+};
+
+FragKey makeFragKey(struct sockaddr_in *from, u32 msg_seqno);
+
+struct FragKeyHash
+{
+    size_t operator()(const FragKey& k) const
+    {
+        u64 v = ((u64)k.addr << 32) ^ ((u64)k.port << 16) ^ ((u64)k.msg_seqno * 0x9e3779b97f4a7c15ULL);
+        return std::hash<u64>()(v ^ (v >> 29));
+    }
+};
+
 struct FragBuf
 {
     i64     last_packet_utime;
     u32     msg_seqno;
+    u16     fragments_in_msg;
     u16     fragments_remaining;
 
-    // The channel starts at the beginning of the buffer. The data
-    // follows immediately after the channel and its NULL
+    // The data starts 'data_offset' bytes into the buffer, right after the channel
+    // and its NULL. A message started by a later fragment (reliable mode only)
+    // doesn't know its channel yet, so it leaves room for the longest one
+    size_t  data_offset;
     size_t  channellen;
+    bool    has_channel;
     struct sockaddr_in from;
 
+    // Reliable mode: the highest fragment seen, and the NACKs sent since the last
+    // fragment that was new
+    u16     highest_fragment;
+    u16     nacks_sent;
+    i64     last_nack_utime;
+
+    // One bit per fragment already copied into 'buf'
+    vector<u64> received;
+
     // Fields set by the allocator object
     Buffer buf;
+    FragKey key;
+    FragBuf *lruPrev;  // towards the most recently used
+    FragBuf *lruNext;  // towards the least recently used
+};
 
-    bool matchesSockaddr(struct sockaddr_in *addr);
+// Counters for fragmented messages that never made it out of the pool
+// Note: updated by the receiving thread only, but may be read from any thread
+struct FragStats
+{
+    std::atomic<u64> evicted    {0}; // partial messages evicted to make room for new ones
+    std::atomic<u64> incomplete {0}; // partial messages dropped because of an invalid fragment
+    std::atomic<u64> duplicates {0}; // fragments ignored because they were already received
 };
 
 /************** A pool to handle every alloc/dealloc operation on Message objects ******/
@@ -162,20 +255,51 @@ struct MessagePool
     void freeMessage(Message *b);
 
     // FragBuf
-    FragBuf *addFragBuf(u32 data_size);
-    FragBuf *lookupFragBuf(struct sockaddr_in *key);
+    // Starts reassembling message 'msg_seqno' from 'from', evicting the least
+    // recently updated partial messages if the pool is over its limits
+    FragBuf *addFragBuf(struct sockaddr_in *from, u32 msg_seqno,
+                        u32 data_size, u16 fragments_in_msg);
+    // Returns the partial message (and marks it as most recently used) or NULL
+    FragBuf *lookupFragBuf(struct sockaddr_in *from, u32 msg_seqno);
+    // Returns the partial message 'from' started last, or NULL
+    FragBuf *lookupNewestFragBuf(struct sockaddr_in *from);
+    // Records the arrival of a fragment. Returns false if it was a duplicate
+    bool markFragment(FragBuf *fbuf, u16 fragment_no);
+    // Releases a completed message's fragment buffer
     void removeFragBuf(FragBuf *fbuf);
+    // Releases a fragment buffer whose message can no longer be completed
+    void dropFragBuf(FragBuf *fbuf);
+    size_t numFragBufs() const { return fragbufs.size(); }
+    // Calls 'f' on every partial message, most recently used first. 'f' may
+    // remove or drop the one it is given
+    template <typename F> void forEachFragBuf(F f)
+    {
+        for (FragBuf *fbuf = lruHead; fbuf;) {
+            FragBuf *next = fbuf->lruNext;
+            f(fbuf);
+            fbuf = next;
+        }
+    }
+    const FragStats& getFragStats() const { return fragStats; }
+
+    // The allocator backing every buffer and object handed out above
+    MemPool& getMemPool() { return mempool; }
 
     void transferBufffer(Message *to, FragBuf *from);
     void moveBuffer(Buffer& to, Buffer& from);
 
   private:
     void _freeMessageBuffer(Message *b);
-    void _removeFragBuf(size_t index);
+    void _lruUnlink(FragBuf *fbuf);
+    void _lruPushFront(FragBuf *fbuf);
 
   private:
     MemPool mempool;
-    vector<FragBuf*> fragbufs;
+    unordered_map<FragKey, FragBuf*, FragKeyHash> fragbufs;
+    unordered_map<u64, FragBuf*> newestBySender; // keyed by address and port
+    FragBuf *lruHead = nullptr; // most recently used
+    FragBuf *lruTail = nullptr; // least recently used
+    FragStats fragStats;
     size_t maxSize;
     size_t maxBuffers;
     size_t totalSize = 0;
@@ -0,0 +1,64 @@
+#include "channelrules.hpp"
+
+string ChannelRules::trim(const string& s)
+{
+    size_t b = s.find_first_not_of(" \t\r");
+    if (b == string::npos) return "";
+    size_t e = s.find_last_not_of(" \t\r");
+    return s.substr(b, e - b + 1);
+}
+
+bool ChannelRules::forEach(const string& list, const std::function<bool(const string&)>& fn)
+{
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == string::npos) end = list.size();
+        string rule = trim(list.substr(start, end - start));
+        start = end + 1;
+        if (!rule.empty() && !fn(rule))
+            return false;
+    }
+    return true;
+}
+
+bool ChannelRules::split(const string& rule, const char *seps, string& pattern, string& value)
+{
+    size_t sep = rule.find_last_of(seps);
+    if (sep == string::npos) {
+        pattern = trim(rule);
+        value.clear();
+        return false;
+    }
+    pattern = trim(rule.substr(0, sep));
+    value = trim(rule.substr(sep + 1));
+    return true;
+}
+
+bool ChannelRules::add(const string& pattern, int value)
+{
+    Rule rule;
+    rule.pattern = pattern;
+    rule.prefix = !pattern.empty() && pattern.back() == '*';
+    if (rule.prefix) rule.pattern.pop_back();
+    if (rule.pattern.empty() && !rule.prefix)
+        return false;
+    rule.value = value;
+    rules.push_back(std::move(rule));
+    return true;
+}
+
+const ChannelRules::Rule *ChannelRules::match(const char *channel) const
+{
+    size_t len = strlen(channel);
+    const Rule *best = nullptr;
+    for (auto& r : rules) {
+        bool match = r.prefix ? len >= r.pattern.size() &&
+                                strncmp(channel, r.pattern.c_str(), r.pattern.size()) == 0
+                              : r.pattern == channel;
+        if (match && (!best || r.pattern.size() > best->pattern.size() ||
+                      (!r.prefix && best->prefix && r.pattern.size() == best->pattern.size())))
+            best = &r;
+    }
+    return best;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "udpm.hpp"
+#include <functional>
+
+// Rules that attach a value to channels by pattern, where a pattern is a channel name,
+// or a prefix when it ends with '*'. When several rules match a channel, the longest
+// pattern wins, and a name beats a prefix of the same length.
+// Shared by the udpm options that take per-channel rules (group_map, drop_policy)
+class ChannelRules
+{
+  public:
+    struct Rule
+    {
+        string pattern; // without the trailing '*'
+        bool   prefix;
+        int    value;
+    };
+
+    // Adds a rule for 'pattern'. Returns false if it names no channel
+    bool add(const string& pattern, int value);
+
+    // Returns the rule that best matches 'channel', or null if none does
+    const Rule *match(const char *channel) const;
+
+    // Splits the comma separated 'list' and calls 'fn' on each trimmed, non-empty
+    // rule. Returns false as soon as 'fn' does
+    static bool forEach(const string& list, const std::function<bool(const string&)>& fn);
+    // Splits 'rule' at the last of 'seps' into a pattern and a value, each trimmed.
+    // Returns false, with all of 'rule' as the pattern, when it holds none of 'seps'
+    static bool split(const string& rule, const char *seps, string& pattern, string& value);
+    static string trim(const string& s);
+
+  private:
+    vector<Rule> rules;
+};
@@ -0,0 +1,122 @@
+#include "drainqueue.hpp"
+
+DrainQueue::~DrainQueue()
+{
+    for (Message *msg : queue)
+        pool.freeMessage(msg);
+}
+
+void DrainQueue::configure(size_t maxMessages, size_t maxBytes)
+{
+    this->maxMessages = maxMessages;
+    this->maxBytes = maxBytes;
+}
+
+static bool parsePolicy(const string& str, DrainQueue::Policy& policy)
+{
+    if (str == "newest") policy = DrainQueue::DROP_NEWEST;
+    else if (str == "oldest") policy = DrainQueue::DROP_OLDEST;
+    else return false;
+    return true;
+}
+
+bool DrainQueue::addPolicies(const string& str)
+{
+    return ChannelRules::forEach(str, [&](const string& rule) {
+        string pattern, value;
+        bool hasPattern = ChannelRules::split(rule, ":", pattern, value);
+        Policy policy;
+        if (!parsePolicy(hasPattern ? value : pattern, policy)) {
+            ZCM_DEBUG("udpm drop policy '%s' should be 'newest' or 'oldest'", rule.c_str());
+            return false;
+        }
+        if (!hasPattern) {
+            defaultPolicy = policy;
+            return true;
+        }
+        if (!rules.add(pattern, policy)) {
+            ZCM_DEBUG("udpm drop policy without a channel");
+            return false;
+        }
+        return true;
+    });
+}
+
+DrainQueue::Policy DrainQueue::policyFor(const char *channel) const
+{
+    const ChannelRules::Rule *best = rules.match(channel);
+    return best ? (Policy)best->value : defaultPolicy;
+}
+
+// Note: caller must hold mut
+void DrainQueue::drop(Message *msg)
+{
+    dropped++;
+    drops[string(msg->channel, msg->channellen)]++;
+    pool.freeMessage(msg);
+}
+
+void DrainQueue::push(Message *msg)
+{
+    std::unique_lock<std::mutex> lk(mut);
+
+    // a single message bigger than the byte limit still gets through an empty queue
+    while (!queue.empty() &&
+           (queue.size() >= maxMessages || bytes + msg->buf.size > maxBytes)) {
+        auto victim = queue.end();
+        if (policyFor(msg->channel) == DROP_OLDEST) {
+            victim = std::find_if(queue.begin(), queue.end(), [&](Message *m) {
+                return m->channellen == msg->channellen &&
+                       memcmp(m->channel, msg->channel, msg->channellen) == 0;
+            });
+        }
+        if (victim == queue.end()) {
+            drop(msg);
+            return;
+        }
+        bytes -= (*victim)->buf.size;
+        drop(*victim);
+        queue.erase(victim);
+    }
+
+    queue.push_back(msg);
+    bytes += msg->buf.size;
+    highWater = std::max(highWater, queue.size());
+    lk.unlock();
+    cond.notify_one();
+}
+
+Message *DrainQueue::pop(int timeout)
+{
+    std::unique_lock<std::mutex> lk(mut);
+    if (!cond.wait_for(lk, std::chrono::milliseconds(timeout),
+                       [&]() { return !queue.empty(); }))
+        return nullptr;
+
+    Message *msg = queue.front();
+    queue.pop_front();
+    bytes -= msg->buf.size;
+    return msg;
+}
+
+void DrainQueue::getStats(zcm_udpm_stats_t *stats)
+{
+    std::unique_lock<std::mutex> lk(mut);
+    stats->drain_dropped = dropped;
+    stats->drain_queued = queue.size();
+    stats->drain_queued_max = highWater;
+}
+
+int DrainQueue::getDropStats(zcm_udpm_drop_stats_t *out, size_t max)
+{
+    std::unique_lock<std::mutex> lk(mut);
+    size_t i = 0;
+    for (auto& elt : drops) {
+        if (i == max) break;
+        zcm_udpm_drop_stats_t& o = out[i++];
+        strncpy(o.channel, elt.first.c_str(), sizeof(o.channel) - 1);
+        o.channel[sizeof(o.channel) - 1] = '\0';
+        o.dropped = elt.second;
+    }
+    return (int)drops.size();
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "udpm.hpp"
+#include "buffers.hpp"
+#include "udpm_stats.h"
+#include "channelrules.hpp"
+#include <chrono>
+
+// The bounded queue between the udpm drain thread, which empties the socket, and
+// zcm's receive thread. When it is full, the channel of an arriving message decides
+// what goes: the message itself (drop-newest), or the oldest message queued on the
+// same channel (drop-oldest, which drops the newest when none is queued).
+// Policies are rules of the form
+//   <newest|oldest>            the policy of channels no other rule matches
+//   <pattern>:<newest|oldest>  the policy of the channels matching the pattern
+// where patterns match as described in ChannelRules.
+// Note: all methods are thread-safe
+class DrainQueue
+{
+  public:
+    enum Policy { DROP_NEWEST, DROP_OLDEST };
+
+    DrainQueue(MessagePool& pool) : pool(pool) {}
+    ~DrainQueue();
+
+    void configure(size_t maxMessages, size_t maxBytes);
+    // Adds the comma separated rules in 'rules'. Returns false on a malformed rule
+    bool addPolicies(const string& rules);
+    Policy policyFor(const char *channel) const;
+
+    // Takes ownership of 'msg', dropping it or an older message if full
+    void push(Message *msg);
+    // Waits up to 'timeout' ms for a message, and hands over its ownership
+    Message *pop(int timeout);
+
+    void getStats(zcm_udpm_stats_t *stats);
+    // See zcm_trans_udpm_get_drop_stats()
+    int getDropStats(zcm_udpm_drop_stats_t *out, size_t max);
+
+  private:
+    MessagePool& pool;
+    size_t maxMessages = 0;
+    size_t maxBytes = 0;
+    Policy defaultPolicy = DROP_NEWEST;
+    ChannelRules rules; // valued by Policy
+
+    std::mutex mut;
+    std::condition_variable cond;
+    std::deque<Message*> queue;
+    size_t bytes = 0;
+    size_t highWater = 0;
+    u64 dropped = 0;
+    unordered_map<string, u64> drops; // per channel
+
+    void drop(Message *msg);
+};
@@ -0,0 +1,73 @@
+#include "groupmap.hpp"
+#include <fstream>
+
+// FNV-1a: cheap, and identical on every host, which is all we need
+u32 GroupMap::hash(const char *str, size_t len)
+{
+    u32 h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (u8)str[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+bool GroupMap::addRule(const string& ruleStr)
+{
+    string str = ChannelRules::trim(ruleStr);
+    if (str.empty()) return true;
+
+    string pattern, idx;
+    int index = -1;
+    if (ChannelRules::split(str, ": \t", pattern, idx)) {
+        char *end;
+        long v = strtol(idx.c_str(), &end, 10);
+        if (idx.empty() || *end != '\0' || v < 0 || (size_t)v >= numGroups) {
+            ZCM_DEBUG("udpm group rule '%s' needs a group index below %zu",
+                      str.c_str(), numGroups);
+            return false;
+        }
+        index = (int)v;
+    }
+
+    if (!rules.add(pattern, index)) {
+        ZCM_DEBUG("udpm group rule without a channel");
+        return false;
+    }
+    return true;
+}
+
+bool GroupMap::addRules(const string& str)
+{
+    return ChannelRules::forEach(str, [&](const string& rule) { return addRule(rule); });
+}
+
+bool GroupMap::addRulesFromFile(const string& path)
+{
+    std::ifstream f(path);
+    if (!f) {
+        ZCM_DEBUG("unable to open udpm group map '%s'", path.c_str());
+        return false;
+    }
+    string line;
+    while (getline(f, line)) {
+        size_t comment = line.find('#');
+        if (comment != string::npos) line.resize(comment);
+        if (!addRule(line))
+            return false;
+    }
+    return true;
+}
+
+size_t GroupMap::groupFor(const char *channel) const
+{
+    if (numGroups == 1)
+        return 0;
+
+    const ChannelRules::Rule *best = rules.match(channel);
+    if (!best)
+        return hash(channel, strlen(channel)) % numGroups;
+    if (best->value >= 0)
+        return best->value;
+    return hash(best->pattern.c_str(), best->pattern.size()) % numGroups;
+}
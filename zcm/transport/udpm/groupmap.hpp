@@ -0,0 +1,36 @@
+#pragma once
+#include "udpm.hpp"
+#include "channelrules.hpp"
+
+// Decides which of a range of multicast groups each channel travels on.
+// Channels are hashed onto the range unless a rule says otherwise. A rule is either
+//   <pattern>          channels matching it are hashed by the pattern, so they share a group
+//   <pattern>:<index>  channels matching it go to the given group
+// where patterns match as described in ChannelRules.
+// Note: every publisher and subscriber of a channel must use the same group count and rules
+class GroupMap
+{
+  public:
+    static const size_t MAX_GROUPS = 256;
+
+    GroupMap(size_t numGroups = 1) : numGroups(numGroups) {}
+
+    size_t size() const { return numGroups; }
+
+    // Adds the comma separated rules in 'rules'. Returns false on a malformed rule
+    bool addRules(const string& rules);
+    // Adds one rule per line of the file ('#' starts a comment, and a space may
+    // separate a pattern from its index). Returns false if the file is unreadable
+    // or holds a malformed rule
+    bool addRulesFromFile(const string& path);
+
+    size_t groupFor(const char *channel) const;
+
+    static u32 hash(const char *str, size_t len);
+
+  private:
+    size_t numGroups;
+    ChannelRules rules; // valued by group index, or -1 to hash by the pattern
+
+    bool addRule(const string& rule);
+};
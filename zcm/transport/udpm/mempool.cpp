@@ -1,21 +1,26 @@
 #include "mempool.hpp"
 #include "udpm.hpp"
+#include <cerrno>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <climits>
 
+#ifdef __linux__
+# include <sys/mman.h>
+#endif
+
 MemPool::MemPool()
 {
-    memset(sizelists, 0, sizeof(sizelists));
 }
 
 MemPool::~MemPool()
 {
     for (size_t i = 0; i < NUMLISTS; i++) {
-        Block *blk = sizelists[i];
+        Block *blk = sizelists[i].head;
         while (blk) {
             auto *next = blk->next;
-            std::free(blk);
+            osFree((char*)blk, i);
             blk = next;
         }
     }
@@ -31,63 +36,168 @@ static int computeSlot(size_t v)
     // Note: Only works on 32-bit and 64-bit systems
     assert(sizeof(unsigned) == 4 && CHAR_BIT == 8);
     assert(fitsInU32(v));
-    size_t bits = 31 - __builtin_clz((u32)v);
-    if ((size_t)(1<<bits) != v)
-        bits += 1;
+    if (v <= ((size_t)1 << MemPool::MIN_SHIFT))
+        return 0;
+    // round up to the next power of two
+    size_t bits = 32 - __builtin_clz((u32)(v - 1));
     assert((size_t)(1<<(bits-1)) < v && v <= (size_t)(1<<bits));
-    bits = std::max(bits, (size_t)16);
-    return bits - 16;
+    return bits - MemPool::MIN_SHIFT;
 }
 
 static size_t slotToSize(int slot)
 {
-    return 1 << (slot+16);
+    return (size_t)1 << (slot + MemPool::MIN_SHIFT);
+}
+
+char *MemPool::osAlloc(int slot)
+{
+    size_t sz = slotToSize(slot);
+#ifdef __linux__
+    if (sz >= HUGE_PAGE_SIZE) {
+        void *mem = MAP_FAILED;
+        if (hugePages) {
+            mem = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (mem == MAP_FAILED)
+                ZCM_DEBUG("ZCM: no huge pages available for a %zu byte block", sz);
+        }
+        if (mem == MAP_FAILED) {
+            mem = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mem == MAP_FAILED)
+                return nullptr;
+# ifdef MADV_HUGEPAGE
+            // at least ask for transparent huge pages
+            if (hugePages) madvise(mem, sz, MADV_HUGEPAGE);
+# endif
+        }
+        return (char*)mem;
+    }
+#endif
+    return (char*)malloc(sz);
+}
+
+void MemPool::osFree(char *mem, int slot)
+{
+#ifdef __linux__
+    size_t sz = slotToSize(slot);
+    if (sz >= HUGE_PAGE_SIZE) {
+        munmap(mem, sz);
+        return;
+    }
+#endif
+    std::free(mem);
 }
 
 char *MemPool::alloc(size_t sz)
 {
     // This allocator only goes up to 2^28
-    assert(sz <= (1<<28));
+    assert(sz <= (1<<MAX_SHIFT));
     assert(fitsInU32(sz));
     int slot = computeSlot(sz);
     assert(0 <= slot && slot < (int)NUMLISTS);
 
-    Block *mem = sizelists[slot];
-    if (mem) {
-        sizelists[slot] = mem->next;
-        return (char*)mem;
-    } else {
-        return (char*)malloc(slotToSize(slot));
+    {
+        std::unique_lock<std::mutex> lk(mut);
+        SizeList& list = sizelists[slot];
+        Block *mem = list.head;
+        if (mem) {
+            list.head = mem->next;
+            list.cached--;
+            list.hits++;
+            bytesCached -= slotToSize(slot);
+            return (char*)mem;
+        }
+        list.misses++;
     }
+
+    // Every user of the pool writes straight into what it gets, and there's no
+    // dropping a fragment halfway through reassembly, so running out is fatal
+    char *mem = osAlloc(slot);
+    if (!mem) {
+        fprintf(stderr, "ZCM Error: udpm could not allocate a %zu byte buffer: %s\n",
+                slotToSize(slot), strerror(errno));
+        abort();
+    }
+    return mem;
 }
 
 void MemPool::free(char *mem, size_t sz)
 {
     // This allocator only goes up to 2^28
-    assert(sz <= (1<<28));
+    assert(sz <= (1<<MAX_SHIFT));
     assert(fitsInU32(sz));
     int slot = computeSlot(sz);
     assert(0 <= slot && slot < (int)NUMLISTS);
 
-    Block *newblock = (Block*)mem;
-    newblock->next = sizelists[slot];
-    sizelists[slot] = newblock;
+    {
+        std::unique_lock<std::mutex> lk(mut);
+        SizeList& list = sizelists[slot];
+        if (bytesCached + slotToSize(slot) <= highWatermark) {
+            Block *newblock = (Block*)mem;
+            newblock->next = list.head;
+            list.head = newblock;
+            list.cached++;
+            bytesCached += slotToSize(slot);
+            return;
+        }
+        list.trimmed++;
+    }
+
+    osFree(mem, slot);
+}
+
+void MemPool::setHighWatermark(size_t bytes)
+{
+    Block *release[NUMLISTS] = {};
+    {
+        std::unique_lock<std::mutex> lk(mut);
+        highWatermark = bytes;
+        for (int slot = NUMLISTS-1; slot >= 0 && bytesCached > highWatermark; slot--) {
+            SizeList& list = sizelists[slot];
+            while (list.head && bytesCached > highWatermark) {
+                Block *blk = list.head;
+                list.head = blk->next;
+                list.cached--;
+                list.trimmed++;
+                bytesCached -= slotToSize(slot);
+
+                blk->next = release[slot];
+                release[slot] = blk;
+            }
+        }
+    }
+
+    for (size_t slot = 0; slot < NUMLISTS; slot++) {
+        Block *blk = release[slot];
+        while (blk) {
+            auto *next = blk->next;
+            osFree((char*)blk, slot);
+            blk = next;
+        }
+    }
+}
+
+void MemPool::setHugePages(bool enable)
+{
+    std::unique_lock<std::mutex> lk(mut);
+    hugePages = enable;
 }
 
-void MemPool::test()
+MemPool::Stats MemPool::getStats()
 {
-    MemPool pool;
-
-    char *buf = pool.alloc(70000);
-    assert(buf);
-    pool.free(buf, 70000);
-    char *buf2 = pool.alloc(1<<17);
-    assert(buf == buf2);
-    pool.free(buf2, 1<<17);
-    char *buf3 =pool.alloc(1<<18);
-    assert(buf3 && buf3 != buf);
-    pool.free(buf3, 1<<18);
-    char *buf4 = pool.alloc(1<<28);
-    assert(buf4);
-    pool.free(buf4, 1<<28);
+    std::unique_lock<std::mutex> lk(mut);
+    Stats stats;
+    stats.bytesCached = bytesCached;
+    stats.highWatermark = highWatermark;
+    stats.hugePages = hugePages;
+    for (size_t i = 0; i < NUMLISTS; i++) {
+        MemPoolClassStats& c = stats.classes[i];
+        c.size = slotToSize(i);
+        c.cached = sizelists[i].cached;
+        c.hits = sizelists[i].hits;
+        c.misses = sizelists[i].misses;
+        c.trimmed = sizelists[i].trimmed;
+    }
+    return stats;
 }
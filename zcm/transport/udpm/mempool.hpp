@@ -1,13 +1,46 @@
 #pragma once
 #include <cstdlib>
+#include <cstdint>
+#include <mutex>
+
+// Usage counters for one of the pool's size classes
+struct MemPoolClassStats
+{
+    size_t   size;    // bytes per block in this class
+    size_t   cached;  // blocks sitting in the free list
+    uint64_t hits;    // allocations served from the free list
+    uint64_t misses;  // allocations that went to the OS
+    uint64_t trimmed; // frees handed back to the OS because of the high watermark
+};
 
 // A memory pool for the UDPM fragment buffering
+// Note: all methods are thread-safe
 class MemPool
 {
   public:
+    // Pow2 size classes from 2^8 (256 B) to 2^28 (256 MB)
+    static const size_t MIN_SHIFT = 8;
+    static const size_t MAX_SHIFT = 28;
+    static const size_t NUMLISTS = MAX_SHIFT - MIN_SHIFT + 1;
+
+    // Classes at least this large are mapped directly, and backed by huge
+    // pages when enabled
+    static const size_t HUGE_PAGE_SIZE = 1 << 21;
+
+    static const size_t DEFAULT_HIGH_WATERMARK = 64 << 20;
+
+    struct Stats
+    {
+        size_t bytesCached;    // total size of every cached block
+        size_t highWatermark;  // most bytes the free lists may hold
+        bool   hugePages;
+        MemPoolClassStats classes[NUMLISTS];
+    };
+
     MemPool();
     ~MemPool();
 
+    // Aborts if the OS is out of memory, so this never returns null
     char *alloc(size_t sz);
     void free(char *mem, size_t sz);
 
@@ -17,12 +50,35 @@ class MemPool
     template<class T>
     void free(T *ptr);
 
-    static void test();
+    // Limits the total size of the free lists. Blocks freed beyond it are
+    // returned to the OS. Lowering it trims the largest classes first
+    void setHighWatermark(size_t bytes);
+
+    // Backs new blocks of HUGE_PAGE_SIZE and up with huge pages when the OS
+    // has them available (falls back to regular pages otherwise)
+    void setHugePages(bool enable);
+
+    Stats getStats();
 
   private:
     struct Block { Block *next; };
-    static const size_t NUMLISTS = 13;
-    Block* sizelists[NUMLISTS]; // Pow2 blocks from 2^16 to 2^28
+    struct SizeList
+    {
+        Block   *head = nullptr;
+        size_t   cached = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t trimmed = 0;
+    };
+
+    std::mutex mut;
+    SizeList sizelists[NUMLISTS];
+    size_t bytesCached = 0;
+    size_t highWatermark = DEFAULT_HIGH_WATERMARK;
+    bool hugePages = false;
+
+    char *osAlloc(int slot);
+    void osFree(char *mem, int slot);
 
   private:
     // Disallow copies and moves
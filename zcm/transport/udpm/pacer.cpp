@@ -0,0 +1,55 @@
+#include "pacer.hpp"
+
+// Sleeping is far too coarse for short waits, spin through those instead
+static const std::chrono::microseconds SPIN_THRESHOLD {50};
+
+void Pacer::configure(u64 rate, u64 burst)
+{
+    this->rate = rate;
+    this->burst = burst;
+    tokens = burst;
+    last = Clock::now();
+}
+
+void Pacer::refill(Clock::time_point now)
+{
+    double elapsed = std::chrono::duration<double>(now - last).count();
+    last = now;
+    tokens = std::min(tokens + elapsed * rate, (double)burst);
+}
+
+void Pacer::pace(size_t bytes)
+{
+    if (!enabled())
+        return;
+
+    // Take the bytes right away and wait out whatever debt was there before them,
+    // so threads sharing the bucket queue up rather than sleeping under the lock.
+    // A send may run the bucket into debt rather than waiting for it to fill up to
+    // 'bytes', so datagrams bigger than the burst don't stall forever
+    Clock::time_point start;
+    double debt;
+    {
+        std::unique_lock<std::mutex> lk(mut);
+        start = Clock::now();
+        refill(start);
+        debt = -tokens;
+        tokens -= bytes;
+    }
+    if (debt <= 0)
+        return;
+
+    auto until = start + std::chrono::nanoseconds((u64)(debt * 1e9 / rate));
+    auto now = start;
+    while (now < until) {
+        if (until - now > SPIN_THRESHOLD)
+            std::this_thread::sleep_for(until - now - SPIN_THRESHOLD);
+        now = Clock::now();
+    }
+
+    u64 delay = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+    delayedSends++;
+    totalDelayNs += delay;
+    u64 prevMax = maxDelayNs;
+    while (delay > prevMax && !maxDelayNs.compare_exchange_weak(prevMax, delay)) {}
+}
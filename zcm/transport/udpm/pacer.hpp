@@ -0,0 +1,39 @@
+#pragma once
+#include "udpm.hpp"
+#include <chrono>
+#include <mutex>
+
+// A token bucket that spaces out the datagrams a transport sends: on average no more
+// than 'rate' bytes per second leave, in bursts of at most 'burst' bytes (plus the
+// datagram that crosses it).
+// Note: all methods but configure() are thread-safe, and threads that pace() through
+// the same bucket share its rate
+class Pacer
+{
+  public:
+    Pacer() {}
+
+    // A rate of 0 disables pacing
+    void configure(u64 rate, u64 burst);
+    bool enabled() const { return rate > 0; }
+    u64 getRate() const { return rate; }
+    u64 getBurst() const { return burst; }
+
+    // Blocks until 'bytes' more may be sent, then takes them from the bucket
+    void pace(size_t bytes);
+
+    std::atomic<u64> delayedSends {0}; // calls to pace() that had to wait
+    std::atomic<u64> totalDelayNs {0};
+    std::atomic<u64> maxDelayNs {0};
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    u64 rate = 0;
+    u64 burst = 0;
+    std::mutex mut;     // guards the two below
+    double tokens = 0;  // bytes that may be sent right now; negative while in debt
+    Clock::time_point last;
+
+    void refill(Clock::time_point now);
+};
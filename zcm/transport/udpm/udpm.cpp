@@ -2,13 +2,72 @@
 #include "buffers.hpp"
 #include "udpmsocket.hpp"
 #include "mempool.hpp"
+#include "groupmap.hpp"
+#include "pacer.hpp"
+#include "drainqueue.hpp"
+#include "udpm_stats.h"
 
 #include "zcm/transport.h"
 #include "zcm/transport_registrar.h"
 #include "zcm/transport_register.hpp"
+#include "zcm/transport/codec.h"
+
+#ifdef __linux__
+# include <pthread.h>
+# include <sched.h>
+#endif
 
 #define MTU (1<<28)
 
+// Default number of datagrams moved per recvmmsg()/sendmmsg() call
+#define DEFAULT_BATCH_SIZE 32
+#define MAX_BATCH_SIZE 1024
+
+// Default bytes the pacer lets out back-to-back (only used with pace_rate)
+#define DEFAULT_PACE_BURST (256 * 1024)
+
+// Most senders whose sequence numbers are tracked at once
+#define MAX_TRACKED_SENDERS 1024
+// A sender that jumps back further than this is assumed to have restarted
+#define SEQNO_RESTART_WINDOW 1024
+
+// Reliable mode: a partial message must go quiet this long before the fragments it
+// is missing are NACKed, and NACKs are repeated no faster than the retry delay.
+// Fragments past the highest one seen may simply not have been sent yet, so they
+// are only asked for after the longer tail delay. A message is given up on after
+// MAX_NACKS NACKs that brought nothing new
+#define NACK_DELAY_US (10 * 1000)
+#define NACK_RETRY_US (50 * 1000)
+#define NACK_TAIL_DELAY_US (100 * 1000)
+#define MAX_NACKS 5
+// How often the receive path looks for partial messages to NACK
+#define NACK_CHECK_MS 5
+// Most fragments asked for by a single NACK
+#define MAX_NACK_FRAGMENTS 4096
+// Finished messages remembered so late retransmissions don't deliver them twice
+#define MAX_FINISHED_MESSAGES 1024
+// How often the NACK thread checks whether it should stop
+#define NACK_THREAD_WAKEUP_MS 50
+// Default bytes of large messages kept for retransmission
+#define DEFAULT_RELIABLE_WINDOW (64 * 1024 * 1024)
+
+// Coalescing: by default batches fill one ethernet frame, and wait no longer than
+// this for more messages
+#define DEFAULT_COALESCE_SIZE 1472
+#define MIN_COALESCE_SIZE 64
+#define MAX_COALESCE_SIZE (sizeof(MsgHeaderShort) + ZCM_SHORT_MESSAGE_MAX_SIZE)
+#define DEFAULT_COALESCE_DELAY_US 200
+
+// By default only messages at least this big are compressed: for smaller ones it
+// rarely pays for the time it takes
+#define DEFAULT_COMPRESS_THRESHOLD 4096
+
+// Default limits of the drain thread's queue
+#define DEFAULT_DRAIN_QUEUE 1024
+#define DEFAULT_DRAIN_QUEUE_BYTES (64 * 1024 * 1024)
+// How often the drain thread checks whether it should stop
+#define DRAIN_THREAD_WAKEUP_MS 50
+
 static i32 utimeInSeconds()
 {
     struct timeval tv;
@@ -16,6 +75,13 @@ static i32 utimeInSeconds()
     return (i32)tv.tv_sec;
 }
 
+static i64 utimeNow()
+{
+    struct timeval tv;
+    gettimeofday (&tv, NULL);
+    return (i64)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
 /**
  * udpm_params_t:
  * @mc_addr:        multicast address
@@ -26,6 +92,10 @@ static i32 utimeInSeconds()
  *                  don't use > 1.  that's just rude.
  * @recv_buf_size:  requested size of the kernel receive buffer, set with
  *                  SO_RCVBUF.  0 indicates to use the default settings.
+ * @send_buf_size:  requested size of the kernel send buffer, set with
+ *                  SO_SNDBUF.  0 indicates to use the default settings.
+ * @batch:          max number of datagrams received or sent per syscall.
+ *                  1 disables batching.
  *
  */
 struct Params
@@ -35,25 +105,74 @@ struct Params
     u16            port;
     u8             ttl;
     size_t         recv_buf_size;
+    size_t         send_buf_size;
+    size_t         batch;
 
-    Params(const string& ip, u16 port, size_t recv_buf_size, u8 ttl)
+    Params(const string& ip, u16 port, size_t recv_buf_size, size_t send_buf_size,
+           u8 ttl, size_t batch)
     {
         // TODO verify that the IP and PORT are vaild
         this->ip = ip;
         inet_aton(ip.c_str(), (struct in_addr*) &this->addr);
         this->port = port;
         this->recv_buf_size = recv_buf_size;
+        this->send_buf_size = send_buf_size;
         this->ttl = ttl;
+        this->batch = batch;
     }
 };
 
+// Sequence number tracking for one sender
+struct SenderSeq
+{
+    u32 last_seqno;
+    i64 last_utime;
+    u64 packets = 0;
+    u64 gaps = 0;
+    u64 reorders = 0;
+};
+
+// One of the multicast groups channels are spread over (see GroupMap)
+struct Group
+{
+    struct in_addr addr;
+    UDPMAddress destAddr;
+    UDPMSocket  sendfd;        // opened by the first message sent to the group
+    u32         msg_seqno = 0; // rolling counter of how many messages transmitted
+
+    // Explicitly enabled channels that map to this group, and whether the
+    // receive socket is currently a member
+    size_t      recvChannels = 0;
+    bool        joined = false;
+
+    // Short messages waiting to go out in a single datagram (see UDPM::coalesce):
+    // the header, then the messages, each behind its u16 length
+    vector<char> batch;
+    u32          batch_msgs = 0;
+    std::chrono::steady_clock::time_point batch_deadline;
+
+    Group(struct in_addr addr, u16 port) : addr(addr), destAddr(inet_ntoa(addr), port) {}
+};
+
+// A large message kept for retransmission in reliable mode
+struct SentMessage
+{
+    size_t group;
+    u32    seqno;
+    u32    magic;      // with ZCM_MAGIC_COMPRESSED if the payload is compressed
+    size_t channellen;
+    Buffer payload;    // the channel and its NULL, then the data
+};
+
 struct UDPM
 {
     Params params;
-    UDPMAddress destAddr;
+    GroupMap groupMap;
 
     UDPMSocket recvfd;
-    UDPMSocket sendfd;
+    // Each group has its own send socket, so receivers see one sequence of
+    // messages (and fragments) per group from every sender
+    vector<Group> groups;
 
     /* size of the kernel UDP receive buffer */
     size_t kernel_rbuf_sz = 0;
@@ -62,37 +181,222 @@ struct UDPM
 
     MessagePool pool {MAX_FRAG_BUF_TOTAL_SIZE, MAX_NUM_FRAG_BUFS};
 
-    /* other variables */
-    u32          udp_rx = 0;            // packets received and processed
-    u32          udp_discarded_bad = 0; // packets discarded because they were bad
-                                    // somehow
-    double       udp_low_watermark = 1.0; // least buffer available
-    i32          udp_last_report_secs = 0;
+    /* receive statistics (see zcm_udpm_stats_t), readable from any thread */
+    std::atomic<u64> udp_packets {0};       // datagrams received
+    std::atomic<u64> udp_rx {0};            // messages received and processed
+    std::atomic<u64> udp_discarded_bad {0}; // packets discarded because they were bad
+                                            // somehow
+    std::atomic<u64> udp_seq_gaps {0};
+    std::atomic<u64> udp_seq_reorders {0};
+    std::atomic<u64> udp_kernel_drops {0};
+    std::atomic<u64> udp_filtered {0};      // messages no one had enabled the channel of
 
-    u32          msg_seqno = 0; // rolling counter of how many messages transmitted
+    std::mutex   senders_mut;
+    unordered_map<u64, SenderSeq> senders; // keyed by address and port
+
+    i32          udp_last_report_secs = 0;
+    u64          udp_last_report_lost = 0;
+
+    /* channels enabled through recvmsgEnable(), following the zmq transports:
+     * a NULL channel enables every channel, and disabling it leaves the explicitly
+     * enabled ones alone. The receive path works from its own copy, refreshed
+     * whenever 'filter_version' changes, so it never takes the lock per packet */
+    std::mutex   filter_mut;
+    bool         filter_all = false;
+    unordered_set<string> filter_channels;
+    std::atomic<u32> filter_version {0};
+
+    u32          rx_filter_version = 0;
+    bool         rx_filter_all = false;
+    unordered_set<string> rx_filter_channels;
+    string       rx_filter_scratch;
+
+    /* receive ring: packets filled by one recvPackets() call, consumed in order.
+     * Only the first 'rxActive' are read into, and they are allocated on first use.
+     * That doubles, up to the batch size, each time a call fills them all, so a
+     * lightly loaded receiver doesn't hold a batch of 64 kB buffers */
+    vector<Packet*> rxPkts;
+    int          rxActive = 1;
+    int          rxCount = 0;
+    int          rxNext = 0;
+
+    /* spaces out outgoing datagrams, in user space unless the kernel does it.
+     * Retransmissions go through it as well, so they share the configured rate */
+    Pacer        pacer;
+    bool         kernel_pacing = false;
+
+    /* scratch space for batching the fragments of one message */
+    vector<MsgHeaderLong> txHdrs;
+    vector<PacketIov>     txPkts;
+
+    /* reliable mode: receivers NACK the fragments they miss, and senders keep their
+     * most recent large messages around to answer them */
+    bool         reliable = false;
+    size_t       window_max = 0;
+    std::mutex   window_mut;
+    std::deque<SentMessage> window; // oldest first
+    size_t       window_bytes = 0;
+    std::thread  nack_thread;
+    std::atomic<bool> nack_thread_running {false};
+
+    std::atomic<u64> nacks_sent {0};
+    std::atomic<u64> nacks_received {0};
+    std::atomic<u64> nacks_expired {0};     // asked for messages no longer in the window
+    std::atomic<u64> retransmits {0};       // fragments sent again
+
+    /* drain thread: empties the socket into drainQueue, so the kernel buffer doesn't
+     * overflow while zcm is slow to call recvmsg(). With it, every receive-side
+     * member above (but the stats) belongs to that thread */
+    bool         drain = false;
+    int          drain_cpu = -1;
+    int          drain_priority = 0;
+    DrainQueue   drainQueue {pool};
+    std::thread  drain_thread;
+    std::atomic<bool> drain_thread_running {false};
+
+    /* coalescing: short messages are packed into one datagram per group, sent once
+     * the next one wouldn't fit in 'coalesce_size' bytes, 'coalesce_delay' after the
+     * first, or on flush(). batch_mut serializes every send while it's on */
+    bool         coalesce = false;
+    size_t       coalesce_size = 0;
+    std::chrono::microseconds coalesce_delay {0};
+    std::mutex   batch_mut;
+    std::condition_variable batch_cond;
+    std::thread  batch_thread;
+    bool         batch_thread_running = false; // guarded by batch_mut
+
+    std::atomic<u64> coalesced_messages {0};
+    std::atomic<u64> coalesced_packets {0};
+
+    std::deque<Message*> rxBatched;  // unpacked from a batch, but not returned yet
+
+    /* compression: messages of at least 'compress_threshold' bytes are sent compressed
+     * by 'codec' when that makes them smaller. Receivers decompress any codec they know */
+    const zcm_codec_t *codec = nullptr;
+    size_t       compress_threshold = 0;
+    vector<u8>   txCompressed;        // only touched by sendmsg()
+
+    std::atomic<u64> compressed_messages {0};
+    std::atomic<u64> compressed_raw_bytes {0};
+    std::atomic<u64> compressed_bytes {0};
+    std::atomic<u64> decompress_errors {0};
+
+    i64          rx_last_nack_check = 0;
+    vector<char> rx_nack;
+    unordered_set<FragKey, FragKeyHash> rx_finished;
+    std::deque<FragKey> rx_finished_order;
 
     /***** Methods ******/
-    UDPM(const string& ip, u16 port, size_t recv_buf_size, u8 ttl);
+    UDPM(const string& ip, u16 port, size_t recv_buf_size, size_t send_buf_size,
+         u8 ttl, size_t batch, const GroupMap& groupMap);
+    // Must be called before init()
+    void setPacing(u64 rate, u64 burst, bool kernel);
+    // Must be called before init(). 'window' is the most bytes of large messages
+    // kept for retransmission
+    void setReliable(bool enable, size_t window);
+    // Must be called before init(). A 'size' of 0 disables coalescing
+    void setCoalescing(size_t size, u64 delayUs);
+    // Must be called before init(). A NULL 'codec' disables compression
+    void setCompression(const zcm_codec_t *codec, size_t threshold);
+    // Must be called before init(). A 'cpu' of -1 leaves the thread's affinity
+    // alone, and a 'priority' of 0 its scheduling policy
+    void setDrainThread(bool enable, int cpu, int priority);
     bool init();
     ~UDPM();
 
     int handle();
 
     int sendmsg(zcm_msg_t msg);
+    int flush();
+    int recvmsgEnable(const char *channel, bool enable);
     int recvmsg(zcm_msg_t *msg, int timeout);
 
+    void getStats(zcm_udpm_stats_t *stats);
+    int getSenderStats(zcm_udpm_sender_stats_t *out, size_t max);
+    int getMemPoolStats(zcm_udpm_mempool_stats_t *out, size_t max);
+    int getDropStats(zcm_udpm_drop_stats_t *out, size_t max)
+    { return drainQueue.getDropStats(out, max); }
+
   private:
     // These returns non-null when a full message has been received
     Message *recvShort(Packet *pkt, u32 sz);
     Message *recvFragment(Packet *pkt, u32 sz);
+    Message *recvBatch(Packet *pkt, u32 sz);
     Message *readMessage(int timeout);
+    Message *decompress(Message *msg);
+    bool compress(zcm_msg_t& msg, size_t channel_size);
 
     Message *m = nullptr;
 
     bool selftest();
+    bool channelEnabled(const char *channel, size_t len);
+    bool openSendSocket(Group& g);
+    void updateMemberships();
+    // 'count' consecutive seqnos, from 'seqno', arrived in 'pkt'
+    void trackSequence(Packet *pkt, u32 seqno, bool newMsg, u32 count = 1);
     void checkForMessageLoss();
+
+    void keepForRetransmit(Group& g, const zcm_msg_t& msg, size_t channel_size, u32 magic);
+    void serveNacks();
+    void retransmit(size_t group, MsgHeaderNack *nack,
+                    vector<MsgHeaderLong>& hdrs, vector<PacketIov>& pkts);
+    void sendNacks();
+    void finishMessage(const FragKey& key);
+
+    void drainSocket();
+
+    void appendToBatch(Group& g, const zcm_msg_t& msg, size_t channel_size);
+    void flushBatch(Group& g);
+    void flushBatches();
 };
 
+static int numFragments(size_t payload_size)
+{
+    return payload_size / ZCM_FRAGMENT_MAX_PAYLOAD + !!(payload_size % ZCM_FRAGMENT_MAX_PAYLOAD);
+}
+
+static MsgHeaderLong makeHeaderLong(u32 magic, u32 msg_seqno, size_t datalen,
+                                    u16 nfragments)
+{
+    MsgHeaderLong hdr;
+    hdr.magic = htonl(magic);
+    hdr.msg_seqno = htonl(msg_seqno);
+    hdr.msg_size = htonl(datalen);
+    hdr.fragment_offset = 0;
+    hdr.fragment_no = 0;
+    hdr.fragments_in_msg = htons(nfragments);
+    return hdr;
+}
+
+// Points 'pkt' at fragment 'frag_no' of a message, behind 'fhdr', its own copy of
+// 'hdr'. The first fragment holds the channel and its NULL ahead of the data
+static void buildFragment(MsgHeaderLong& fhdr, PacketIov& pkt, const MsgHeaderLong& hdr,
+                          u16 frag_no, const char *channel, size_t channel_size,
+                          const char *data, size_t datalen)
+{
+    size_t fragment_size = ZCM_FRAGMENT_MAX_PAYLOAD;
+    size_t firstfrag_datasize = fragment_size - (channel_size + 1);
+
+    fhdr = hdr;
+    fhdr.fragment_no = htons(frag_no);
+    pkt.iov[0].iov_base = (char*)&fhdr;
+    pkt.iov[0].iov_len = sizeof(fhdr);
+    if (frag_no == 0) {
+        fhdr.fragment_offset = 0;
+        pkt.iov[1].iov_base = (char*)channel;
+        pkt.iov[1].iov_len = channel_size+1;
+        pkt.iov[2].iov_base = (char*)data;
+        pkt.iov[2].iov_len = firstfrag_datasize;
+        pkt.iovlen = 3;
+    } else {
+        size_t offset = firstfrag_datasize + (frag_no - 1) * fragment_size;
+        fhdr.fragment_offset = htonl(offset);
+        pkt.iov[1].iov_base = (char*)(data + offset);
+        pkt.iov[1].iov_len = std::min(fragment_size, datalen - offset);
+        pkt.iovlen = 2;
+    }
+}
+
 Message *UDPM::recvShort(Packet *pkt, u32 sz)
 {
     MsgHeaderShort *hdr = pkt->asHeaderShort();
@@ -104,7 +408,12 @@ Message *UDPM::recvShort(Packet *pkt, u32 sz)
         return NULL;
     }
 
-    udp_rx++;
+    trackSequence(pkt, hdr->getMsgSeqno(), true);
+
+    if (!channelEnabled(hdr->getChannelPtr(), clen)) {
+        udp_filtered++;
+        return NULL;
+    }
 
     Message *msg = pool.allocMessageEmpty();
     msg->utime = pkt->utime;
@@ -117,12 +426,68 @@ Message *UDPM::recvShort(Packet *pkt, u32 sz)
     return msg;
 }
 
+// Unpacks every message of a batch, returning the first and keeping the rest
+// in 'rxBatched'
+Message *UDPM::recvBatch(Packet *pkt, u32 sz)
+{
+    u32 seqno = pkt->asHeaderShort()->getMsgSeqno();
+    char *p = pkt->buf.data + sizeof(MsgHeaderShort);
+    char *end = pkt->buf.data + sz;
+    u32 nmsgs = 0;
+
+    while (p < end) {
+        u16 reclen;
+        if (end - p < (ssize_t)sizeof(reclen)) {
+            udp_discarded_bad++;
+            break;
+        }
+        memcpy(&reclen, p, sizeof(reclen));
+        reclen = ntohs(reclen);
+        p += sizeof(reclen);
+
+        size_t clen = strnlen(p, std::min((ssize_t)reclen, end - p));
+        if (reclen > end - p || clen >= reclen || clen > ZCM_CHANNEL_MAXLEN) {
+            ZCM_DEBUG("bad message in batch");
+            udp_discarded_bad++;
+            break;
+        }
+
+        nmsgs++;
+        if (channelEnabled(p, clen)) {
+            Message *msg = pool.allocMessageEmpty();
+            msg->buf = pool.allocBuffer(reclen);
+            memcpy(msg->buf.data, p, reclen);
+            msg->utime = pkt->utime;
+            msg->channel = msg->buf.data;
+            msg->channellen = clen;
+            msg->data = msg->buf.data + clen + 1;
+            msg->datalen = reclen - (clen + 1);
+            rxBatched.push_back(msg);
+        } else {
+            udp_filtered++;
+        }
+        p += reclen;
+    }
+
+    // the batch took one seqno per message
+    if (nmsgs > 0)
+        trackSequence(pkt, seqno, true, nmsgs);
+
+    if (rxBatched.empty())
+        return NULL;
+    Message *msg = rxBatched.front();
+    rxBatched.pop_front();
+    return msg;
+}
+
 Message *UDPM::recvFragment(Packet *pkt, u32 sz)
 {
-    MsgHeaderLong *hdr = pkt->asHeaderLong();
+    if (sz < sizeof(MsgHeaderLong)) {
+        udp_discarded_bad++;
+        return NULL;
+    }
 
-    // any existing fragment buffer for this message source?
-    FragBuf *fbuf = pool.lookupFragBuf((struct sockaddr_in*)&pkt->from);
+    MsgHeaderLong *hdr = pkt->asHeaderLong();
 
     u32 msg_seqno = hdr->getMsgSeqno();
     u32 data_size = hdr->getMsgSize();
@@ -132,125 +497,526 @@ Message *UDPM::recvFragment(Packet *pkt, u32 sz)
     u32 frag_size = hdr->getFragmentSize(sz);
     char *data_start = hdr->getDataPtr();
 
-    // discard any stale fragments from previous messages
-    if (fbuf && ((fbuf->msg_seqno != msg_seqno) ||
-                 (fbuf->buf.size != data_size + fbuf->channellen+1))) {
-        pool.removeFragBuf(fbuf);
+    if (data_size > MTU) {
+        ZCM_DEBUG("rejecting huge message (%d bytes)", data_size);
+        udp_discarded_bad++;
+        return NULL;
+    }
+
+    if (fragment_no >= fragments_in_msg) {
+        ZCM_DEBUG("bad fragment number (%d / %d)", fragment_no, fragments_in_msg);
+        udp_discarded_bad++;
+        return NULL;
+    }
+
+    trackSequence(pkt, msg_seqno, fragment_no == 0);
+
+    // any existing fragment buffer for this message?
+    struct sockaddr_in *from = (struct sockaddr_in*)&pkt->from;
+    FragBuf *fbuf = pool.lookupFragBuf(from, msg_seqno);
+
+    // discard the partial message if this fragment disagrees about its shape
+    if (fbuf && ((fbuf->fragments_in_msg != fragments_in_msg) ||
+                 (fbuf->buf.size != data_size + fbuf->data_offset))) {
         ZCM_DEBUG("Dropping message (missing %d fragments)", fbuf->fragments_remaining);
+        pool.dropFragBuf(fbuf);
         fbuf = NULL;
     }
 
-    if (data_size > MTU) {
-        ZCM_DEBUG("rejecting huge message (%d bytes)", data_size);
-        return NULL;
+    // Without NACKs nothing will ever complete a sender's partial message once it
+    // has moved on to a newer one, and a fragment of an older one is just late
+    if (!fbuf && !reliable) {
+        FragBuf *older = pool.lookupNewestFragBuf(from);
+        if (older) {
+            if ((i32)(msg_seqno - older->msg_seqno) < 0) return NULL;
+            ZCM_DEBUG("Dropping message (missing %d fragments)", older->fragments_remaining);
+            pool.dropFragBuf(older);
+        }
     }
 
-    // create a new fragment buffer if necessary
-    if (!fbuf && fragment_no == 0) {
+    // a retransmission of a message that was already delivered or given up on
+    if (!fbuf && reliable && rx_finished.count(makeFragKey(from, msg_seqno)))
+        return NULL;
+
+    // the first fragment carries the channel
+    int channel_sz = 0;
+    if (fragment_no == 0) {
         char *channel = (char*) (hdr + 1);
-        int channel_sz = strlen(channel);
+        channel_sz = strnlen(channel, frag_size);
         if (channel_sz > ZCM_CHANNEL_MAXLEN) {
             ZCM_DEBUG("bad channel name length");
             udp_discarded_bad++;
             return NULL;
         }
 
-        fbuf = pool.addFragBuf(channel_sz + 1 + data_size);
-        fbuf->last_packet_utime = pkt->utime;
-        fbuf->msg_seqno = msg_seqno;
-        fbuf->fragments_remaining = fragments_in_msg;
-        fbuf->channellen = channel_sz;
-        fbuf->from = *(struct sockaddr_in*)&pkt->from;
-        memcpy(fbuf->buf.data, data_start, frag_size);
+        if (!channelEnabled(channel, channel_sz)) {
+            udp_filtered++;
+            if (fbuf) pool.removeFragBuf(fbuf);
+            if (reliable) finishMessage(makeFragKey(from, msg_seqno));
+            return NULL;
+        }
+    }
 
-        --fbuf->fragments_remaining;
-        return NULL;
+    // create a new fragment buffer if necessary
+    if (!fbuf) {
+        // we can't start without the channel unless it can be asked for again.
+        // This also drops the rest of a message whose channel is filtered out
+        if (fragment_no != 0 && !reliable) return NULL;
+
+        size_t data_offset = fragment_no == 0 ? channel_sz + 1 : ZCM_CHANNEL_MAXLEN + 1;
+        fbuf = pool.addFragBuf(from, msg_seqno, data_offset + data_size, fragments_in_msg);
+        fbuf->data_offset = data_offset;
+        fbuf->highest_fragment = fragment_no;
+    }
+    if (fragment_no == 0 && !fbuf->has_channel) {
+        fbuf->channellen = channel_sz;
+        fbuf->has_channel = true;
     }
 
-    if (!fbuf) return NULL;
     recvfd.checkAndWarnAboutSmallBuffer(data_size, kernel_rbuf_sz);
 
-    if (fbuf->channellen+1 + fragment_offset + frag_size > fbuf->buf.size) {
+    // the first fragment holds the channel and its NULL right ahead of the data
+    size_t dest_offset = fragment_no == 0 ? fbuf->data_offset - (channel_sz + 1)
+                                          : fbuf->data_offset + fragment_offset;
+    if (dest_offset + frag_size > fbuf->buf.size) {
         ZCM_DEBUG("dropping invalid fragment (off: %d, %d / %zu)",
                 fragment_offset, frag_size, fbuf->buf.size);
-        pool.removeFragBuf(fbuf);
+        pool.dropFragBuf(fbuf);
         return NULL;
     }
 
+    if (!pool.markFragment(fbuf, fragment_no))
+        return NULL;
+
     // copy data
-    memcpy(fbuf->buf.data + fbuf->channellen+1 + fragment_offset, data_start, frag_size);
+    memcpy(fbuf->buf.data + dest_offset, data_start, frag_size);
 
     fbuf->last_packet_utime = pkt->utime;
+    fbuf->highest_fragment = std::max(fbuf->highest_fragment, fragment_no);
+    fbuf->nacks_sent = 0;
     if (--fbuf->fragments_remaining > 0)
         return NULL;
 
     // we've received all the fragments, return a new Message
     Message *msg = pool.allocMessageEmpty();
     msg->utime = fbuf->last_packet_utime;
-    msg->channel = fbuf->buf.data;
+    msg->channel = fbuf->buf.data + fbuf->data_offset - (fbuf->channellen + 1);
     msg->channellen = fbuf->channellen;
-    msg->data = fbuf->buf.data + fbuf->channellen + 1;
-    msg->datalen = fbuf->buf.size - (fbuf->channellen + 1);
+    msg->data = fbuf->buf.data + fbuf->data_offset;
+    msg->datalen = fbuf->buf.size - fbuf->data_offset;
     pool.moveBuffer(msg->buf, fbuf->buf);
 
     // don't need the fragment buffer anymore
+    if (reliable) finishMessage(fbuf->key);
     pool.removeFragBuf(fbuf);
 
     return msg;
 }
 
+// Remembers that a message needs no more fragments (reliable mode only)
+void UDPM::finishMessage(const FragKey& key)
+{
+    if (!rx_finished.insert(key).second)
+        return;
+    rx_finished_order.push_back(key);
+    if (rx_finished_order.size() > MAX_FINISHED_MESSAGES) {
+        rx_finished.erase(rx_finished_order.front());
+        rx_finished_order.pop_front();
+    }
+}
+
+// NACKs the missing fragments of every partial message that has gone quiet, and
+// gives up on those that stopped getting answers
+// Note: only called from the receive path
+void UDPM::sendNacks()
+{
+    i64 now = utimeNow();
+    if (now - rx_last_nack_check < NACK_CHECK_MS * 1000)
+        return;
+    rx_last_nack_check = now;
+
+    pool.forEachFragBuf([&](FragBuf *fbuf) {
+        i64 quiet = now - fbuf->last_packet_utime;
+        if (quiet < NACK_DELAY_US || now - fbuf->last_nack_utime < NACK_RETRY_US)
+            return;
+        bool tail = quiet >= NACK_TAIL_DELAY_US;
+
+        if (fbuf->nacks_sent >= MAX_NACKS) {
+            ZCM_DEBUG("Giving up on message %u (missing %d fragments)",
+                      fbuf->msg_seqno, fbuf->fragments_remaining);
+            finishMessage(fbuf->key);
+            pool.dropFragBuf(fbuf);
+            return;
+        }
+
+        u16 last = tail ? fbuf->fragments_in_msg - 1 : fbuf->highest_fragment;
+        rx_nack.resize(MsgHeaderNack::getSize(MAX_NACK_FRAGMENTS));
+        MsgHeaderNack *nack = (MsgHeaderNack*)rx_nack.data();
+        size_t n = 0;
+        for (size_t f = 0; f <= last && n < MAX_NACK_FRAGMENTS; f++)
+            if (!(fbuf->received[f / 64] & ((u64)1 << (f % 64))))
+                nack->setFragmentNo(n++, (u16)f);
+        if (n == 0)
+            return;
+
+        nack->setMagic(ZCM_MAGIC_NACK);
+        nack->setMsgSeqno(fbuf->msg_seqno);
+        nack->setNumFragments((u16)n);
+        ZCM_DEBUG("NACKing %zu fragments of message %u", n, fbuf->msg_seqno);
+        recvfd.sendBuffers(UDPMAddress(fbuf->from), rx_nack.data(), MsgHeaderNack::getSize(n));
+        fbuf->nacks_sent++;
+        fbuf->last_nack_utime = now;
+        nacks_sent++;
+    });
+}
+
+// Note: only called from the receive path
+bool UDPM::channelEnabled(const char *channel, size_t len)
+{
+    u32 version = filter_version.load(std::memory_order_acquire);
+    if (version != rx_filter_version) {
+        std::unique_lock<std::mutex> lk(filter_mut);
+        rx_filter_all = filter_all;
+        rx_filter_channels = filter_channels;
+        rx_filter_version = filter_version.load(std::memory_order_relaxed);
+    }
+
+    if (rx_filter_all) return true;
+    if (rx_filter_channels.empty()) return false;
+    rx_filter_scratch.assign(channel, len);
+    return rx_filter_channels.count(rx_filter_scratch) > 0;
+}
+
+int UDPM::recvmsgEnable(const char *channel, bool enable)
+{
+    std::unique_lock<std::mutex> lk(filter_mut);
+    if (channel == NULL) {
+        filter_all = enable;
+    } else if (enable) {
+        if (filter_channels.insert(channel).second)
+            groups[groupMap.groupFor(channel)].recvChannels++;
+    } else {
+        if (filter_channels.erase(channel))
+            groups[groupMap.groupFor(channel)].recvChannels--;
+    }
+    filter_version++;
+    updateMemberships();
+    return ZCM_EOK;
+}
+
+// Joins the groups of every enabled channel (all of them while every channel is
+// enabled) and leaves the rest. Only ever changes anything with several groups:
+// a single group is joined for good when the receive socket is created
+// Note: caller must hold filter_mut
+void UDPM::updateMemberships()
+{
+    if (groups.size() == 1)
+        return;
+
+    for (auto& g : groups) {
+        bool want = filter_all || g.recvChannels > 0;
+        if (want == g.joined)
+            continue;
+        if (want) {
+            if (!recvfd.addMembership(g.addr)) {
+                ZCM_DEBUG("unable to join %s, hosts limit how many groups a socket may "
+                          "join (see net.ipv4.igmp_max_memberships)", g.destAddr.getIP().c_str());
+                continue;
+            }
+        } else {
+            recvfd.dropMembership(g.addr);
+        }
+        g.joined = want;
+    }
+}
+
+bool UDPM::openSendSocket(Group& g)
+{
+    g.sendfd = UDPMSocket::createSendSocket(g.addr, params.ttl, params.send_buf_size);
+    if (!g.sendfd.isOpen())
+        return false;
+    if (kernel_pacing && !g.sendfd.setMaxPacingRate(pacer.getRate())) {
+        ZCM_DEBUG("kernel pacing unavailable, pacing in user space instead");
+        kernel_pacing = false;
+    }
+    return true;
+}
+
+void UDPM::setPacing(u64 rate, u64 burst, bool kernel)
+{
+    pacer.configure(rate, burst);
+    kernel_pacing = rate > 0 && kernel;
+}
+
+void UDPM::setReliable(bool enable, size_t window)
+{
+    reliable = enable;
+    window_max = window;
+}
+
+void UDPM::setCompression(const zcm_codec_t *codec, size_t threshold)
+{
+    this->codec = codec;
+    compress_threshold = threshold;
+}
+
+void UDPM::setCoalescing(size_t size, u64 delayUs)
+{
+    coalesce = size > 0;
+    coalesce_size = size;
+    coalesce_delay = std::chrono::microseconds(delayUs);
+}
+
+void UDPM::setDrainThread(bool enable, int cpu, int priority)
+{
+    drain = enable;
+    drain_cpu = cpu;
+    drain_priority = priority;
+}
+
+// Body of the drain thread
+void UDPM::drainSocket()
+{
+#ifdef __linux__
+    if (drain_cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(drain_cpu, &cpus);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (err)
+            fprintf(stderr,
+                    "==== ZCM Warning ===\n"
+                    "Unable to pin the udpm drain thread to cpu %d: %s\n",
+                    drain_cpu, strerror(err));
+    }
+    if (drain_priority > 0) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = drain_priority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err)
+            fprintf(stderr,
+                    "==== ZCM Warning ===\n"
+                    "Unable to run the udpm drain thread at SCHED_FIFO priority %d: %s\n"
+                    "It needs CAP_SYS_NICE, or a high enough rtprio limit (ulimit -r).\n",
+                    drain_priority, strerror(err));
+    }
+#else
+    if (drain_cpu >= 0 || drain_priority > 0)
+        ZCM_DEBUG("drain thread affinity and priority are only supported on linux");
+#endif
+
+    while (drain_thread_running) {
+        Message *msg = readMessage(DRAIN_THREAD_WAKEUP_MS);
+        if (msg) drainQueue.push(msg);
+    }
+}
+
+// Counts the messages a sender skipped or sent out of order. 'newMsg' is false for
+// every fragment but the first, which repeat the seqno of a message already counted
+void UDPM::trackSequence(Packet *pkt, u32 seqno, bool newMsg, u32 count)
+{
+    struct sockaddr_in *from = (struct sockaddr_in*)&pkt->from;
+    u64 key = ((u64)from->sin_addr.s_addr << 16) | from->sin_port;
+
+    std::unique_lock<std::mutex> lk(senders_mut);
+    auto it = senders.find(key);
+    if (it == senders.end()) {
+        if (senders.size() >= MAX_TRACKED_SENDERS) {
+            // forget whoever we heard from least recently
+            auto eldest = senders.begin();
+            for (auto s = senders.begin(); s != senders.end(); ++s)
+                if (s->second.last_utime < eldest->second.last_utime)
+                    eldest = s;
+            senders.erase(eldest);
+        }
+        SenderSeq& s = senders[key];
+        s.last_seqno = seqno + count - 1;
+        s.last_utime = pkt->utime;
+        s.packets = 1;
+        return;
+    }
+
+    SenderSeq& s = it->second;
+    s.packets++;
+    s.last_utime = pkt->utime;
+
+    i32 diff = (i32)(seqno - s.last_seqno);
+    if (diff > 0) {
+        s.gaps += diff - 1;
+        udp_seq_gaps += diff - 1;
+        s.last_seqno = seqno + count - 1;
+    } else if (diff < -SEQNO_RESTART_WINDOW) {
+        s.last_seqno = seqno + count - 1;
+    } else if (diff < 0 && newMsg) {
+        s.reorders++;
+        udp_seq_reorders++;
+        // it wasn't lost after all
+        if (s.gaps > 0) {
+            s.gaps--;
+            udp_seq_gaps--;
+        }
+    }
+}
+
 void UDPM::checkForMessageLoss()
 {
-    // ISSUE-101 TODO: add this back
-    // TODO warn about message loss somewhere else.
-    // u32 ring_capacity = ringbuf->get_capacity();
-    // u32 ring_used = ringbuf->get_used();
-
-    // double buf_avail = ((double)(ring_capacity - ring_used)) / ring_capacity;
-    // if (buf_avail < udp_low_watermark)
-    //     udp_low_watermark = buf_avail;
-
-    // i32 tm = utimeInSeconds();
-    // int elapsedsecs = tm - udp_last_report_secs;
-    // if (elapsedsecs > 2) {
-    //    if (udp_discarded_bad > 0 || udp_low_watermark < 0.5) {
-    //        fprintf(stderr,
-    //                "%d ZCM loss %4.1f%% : %5d err, "
-    //                "buf avail %4.1f%%\n",
-    //                (int) tm,
-    //                udp_discarded_bad * 100.0 / (udp_rx + udp_discarded_bad),
-    //                udp_discarded_bad,
-    //                100.0 * udp_low_watermark);
-
-    //        udp_rx = 0;
-    //        udp_discarded_bad = 0;
-    //        udp_last_report_secs = tm;
-    //        udp_low_watermark = HUGE;
-    //    }
-    // }
+    i32 tm = utimeInSeconds();
+    int elapsedsecs = tm - udp_last_report_secs;
+    if (elapsedsecs <= 2)
+        return;
+
+    const FragStats& frag = pool.getFragStats();
+    u64 lost = udp_discarded_bad + udp_seq_gaps + udp_kernel_drops +
+               frag.evicted + frag.incomplete;
+    if (lost != udp_last_report_lost) {
+        ZCM_DEBUG("ZCM udpm loss: %" PRIu64 " bad, %" PRIu64 " seq gaps, "
+                  "%" PRIu64 " kernel drops, %" PRIu64 " evicted, %" PRIu64 " incomplete "
+                  "(of %" PRIu64 " packets)",
+                  udp_discarded_bad.load(), udp_seq_gaps.load(), udp_kernel_drops.load(),
+                  frag.evicted.load(), frag.incomplete.load(), udp_packets.load());
+        udp_last_report_lost = lost;
+    }
+    udp_last_report_secs = tm;
+}
+
+void UDPM::getStats(zcm_udpm_stats_t *stats)
+{
+    const FragStats& frag = pool.getFragStats();
+    stats->packets = udp_packets;
+    stats->messages = udp_rx;
+    stats->bad_packets = udp_discarded_bad;
+    stats->seq_gaps = udp_seq_gaps;
+    stats->seq_reorders = udp_seq_reorders;
+    stats->frag_evicted = frag.evicted;
+    stats->frag_incomplete = frag.incomplete;
+    stats->frag_duplicates = frag.duplicates;
+    stats->kernel_drops = udp_kernel_drops;
+    MemPool::Stats mem = pool.getMemPool().getStats();
+    stats->mempool_hits = 0;
+    stats->mempool_misses = 0;
+    for (auto& c : mem.classes) {
+        stats->mempool_hits += c.hits;
+        stats->mempool_misses += c.misses;
+    }
+    stats->mempool_bytes_cached = mem.bytesCached;
+    stats->mempool_high_watermark = mem.highWatermark;
+    stats->filtered = udp_filtered;
+    stats->paced_sends = pacer.delayedSends;
+    stats->pacing_delay_ns = pacer.totalDelayNs;
+    stats->pacing_delay_max_ns = pacer.maxDelayNs;
+    stats->nacks_sent = nacks_sent;
+    stats->nacks_received = nacks_received;
+    stats->nacks_expired = nacks_expired;
+    stats->retransmits = retransmits;
+    stats->coalesced_messages = coalesced_messages;
+    stats->coalesced_packets = coalesced_packets;
+    stats->compressed_messages = compressed_messages;
+    stats->compressed_raw_bytes = compressed_raw_bytes;
+    stats->compressed_bytes = compressed_bytes;
+    stats->decompress_errors = decompress_errors;
+    drainQueue.getStats(stats);
+
+    std::unique_lock<std::mutex> lk(senders_mut);
+    stats->num_senders = senders.size();
+}
+
+int UDPM::getMemPoolStats(zcm_udpm_mempool_stats_t *out, size_t max)
+{
+    MemPool::Stats mem = pool.getMemPool().getStats();
+    for (size_t i = 0; i < MemPool::NUMLISTS && i < max; i++) {
+        const MemPoolClassStats& c = mem.classes[i];
+        out[i].size = c.size;
+        out[i].cached = c.cached;
+        out[i].hits = c.hits;
+        out[i].misses = c.misses;
+        out[i].trimmed = c.trimmed;
+    }
+    return MemPool::NUMLISTS;
+}
+
+int UDPM::getSenderStats(zcm_udpm_sender_stats_t *out, size_t max)
+{
+    std::unique_lock<std::mutex> lk(senders_mut);
+    size_t i = 0;
+    for (auto& elt : senders) {
+        if (i == max) break;
+        zcm_udpm_sender_stats_t& o = out[i++];
+        o.addr = (u32)(elt.first >> 16);
+        o.port = (u16)(elt.first & 0xffff);
+        o.last_seqno = elt.second.last_seqno;
+        o.packets = elt.second.packets;
+        o.seq_gaps = elt.second.gaps;
+        o.seq_reorders = elt.second.reorders;
+    }
+    return (int)senders.size();
 }
 
 // read continuously until a complete message arrives
 Message *UDPM::readMessage(int timeout)
 {
-    Packet *pkt = pool.allocPacket(ZCM_MAX_UNFRAGMENTED_PACKET_SIZE);
     UDPM::checkForMessageLoss();
 
     Message *msg = NULL;
+    int remaining = timeout;
     while (!msg) {
-        // // wait for either incoming UDP data, or for an abort message
-        if (!recvfd.waitUntilData(timeout))
+        if (!rxBatched.empty()) {
+            msg = rxBatched.front();
+            rxBatched.pop_front();
             break;
+        }
 
-        int sz = recvfd.recvPacket(pkt);
-        if (sz < 0) {
-            ZCM_DEBUG("udp_read_packet -- recvmsg");
-            udp_discarded_bad++;
+        if (rxNext == rxCount) {
+            // once the socket has been drained, the fragments partial messages
+            // are missing aren't just queued up behind the ones read
+            if (reliable && rxCount < rxActive)
+                sendNacks();
+
+            // partial messages need NACKing even while nothing arrives, so
+            // reliable mode never waits long
+            int wait = reliable ? std::min(remaining, NACK_CHECK_MS) : remaining;
+
+            // // wait for either incoming UDP data, or for an abort message
+            if (!recvfd.waitUntilData(wait)) {
+                rxNext = rxCount = 0;
+                remaining -= wait;
+                if (remaining > 0)
+                    continue;
+                break;
+            }
+
+            if (rxCount == rxActive)
+                rxActive = std::min(rxActive * 2, (int)rxPkts.size());
+            // recvShort() steals the buffers of the packets it consumes
+            for (int i = 0; i < rxActive; i++) {
+                Packet *&p = rxPkts[i];
+                if (!p)
+                    p = pool.allocPacket(ZCM_MAX_UNFRAGMENTED_PACKET_SIZE);
+                else if (!p->buf.data)
+                    p->buf = pool.allocBuffer(ZCM_MAX_UNFRAGMENTED_PACKET_SIZE);
+            }
+
+            rxNext = rxCount = 0;
+            int n = recvfd.recvPackets(rxPkts.data(), rxActive);
+            if (n < 0) {
+                ZCM_DEBUG("udp_read_packet -- recvmsg");
+                udp_discarded_bad++;
+                continue;
+            }
+            rxCount = n;
             continue;
         }
 
+        Packet *pkt = rxPkts[rxNext++];
+        int sz = (int)pkt->sz;
+
         ZCM_DEBUG("Got packet of size %d", sz);
 
+        udp_packets++;
+        // the kernel reports a running total for the socket
+        if (pkt->kernel_drops > udp_kernel_drops)
+            udp_kernel_drops = pkt->kernel_drops;
+
         if (sz < (int)sizeof(MsgHeaderShort)) {
             // packet too short to be ZCM
             udp_discarded_bad++;
@@ -258,18 +1024,93 @@ Message *UDPM::readMessage(int timeout)
         }
 
         u32 magic = pkt->asHeaderShort()->getMagic();
+        bool compressed = magic & ZCM_MAGIC_COMPRESSED;
+        magic &= ~ZCM_MAGIC_COMPRESSED;
         if (magic == ZCM_MAGIC_SHORT)
             msg = recvShort(pkt, sz);
         else if (magic == ZCM_MAGIC_LONG)
             msg = recvFragment(pkt, sz);
+        else if (magic == ZCM_MAGIC_BATCH && !compressed)
+            msg = recvBatch(pkt, sz);
         else {
             ZCM_DEBUG("ZCM: bad magic");
             udp_discarded_bad++;
             continue;
         }
+
+        // every fragment is flagged, so this is also true of the one completing a message
+        if (msg && compressed)
+            msg = decompress(msg);
     }
 
-    pool.freePacket(pkt);
+    if (msg) udp_rx++;
+    return msg;
+}
+
+// Replaces the data of 'msg' by its compressed form, behind a MsgHeaderCompressed.
+// Returns false, leaving 'msg' alone, when that wouldn't make it any smaller
+bool UDPM::compress(zcm_msg_t& msg, size_t channel_size)
+{
+    size_t max = std::min(codec->bound(msg.len), msg.len - 1);
+    txCompressed.resize(sizeof(MsgHeaderCompressed) + max);
+
+    size_t len = max;
+    u8 *out = txCompressed.data() + sizeof(MsgHeaderCompressed);
+    if (codec->compress(msg.buf, msg.len, out, &len) != ZCM_EOK ||
+        sizeof(MsgHeaderCompressed) + len >= msg.len) {
+        ZCM_DEBUG("[%s] doesn't compress, sending it as is", msg.channel);
+        return false;
+    }
+
+    MsgHeaderCompressed hdr(codec->id, msg.len);
+    memcpy(txCompressed.data(), &hdr, sizeof(hdr));
+
+    compressed_messages++;
+    compressed_raw_bytes += msg.len;
+    compressed_bytes += sizeof(hdr) + len;
+
+    msg.buf = txCompressed.data();
+    msg.len = sizeof(hdr) + len;
+    return true;
+}
+
+// Swaps the compressed data of 'msg' for the original. Returns NULL, having freed
+// 'msg', if it can't be decompressed
+Message *UDPM::decompress(Message *msg)
+{
+    MsgHeaderCompressed hdr;
+    const zcm_codec_t *c = nullptr;
+    if (msg->datalen >= sizeof(hdr)) {
+        memcpy(&hdr, msg->data, sizeof(hdr));
+        c = zcm_codec_find_id(hdr.getCodec());
+    }
+    if (!c || hdr.getRawSize() > MTU) {
+        ZCM_DEBUG("can't decompress a message on [%.*s]", (int)msg->channellen, msg->channel);
+        decompress_errors++;
+        pool.freeMessage(msg);
+        return nullptr;
+    }
+
+    size_t rawlen = hdr.getRawSize();
+    Buffer buf = pool.allocBuffer(msg->channellen + 1 + rawlen);
+    memcpy(buf.data, msg->channel, msg->channellen + 1);
+    char *data = buf.data + msg->channellen + 1;
+
+    size_t len = rawlen;
+    if (c->decompress((u8*)msg->data + sizeof(hdr), msg->datalen - sizeof(hdr),
+                      (u8*)data, &len) != ZCM_EOK || len != rawlen) {
+        ZCM_DEBUG("corrupt compressed message on [%.*s]", (int)msg->channellen, msg->channel);
+        decompress_errors++;
+        pool.freeBuffer(buf);
+        pool.freeMessage(msg);
+        return nullptr;
+    }
+
+    pool.freeBuffer(msg->buf);
+    msg->buf = std::move(buf);
+    msg->channel = msg->buf.data;
+    msg->data = data;
+    msg->datalen = rawlen;
     return msg;
 }
 
@@ -281,23 +1122,50 @@ int UDPM::sendmsg(zcm_msg_t msg)
         return ZCM_EINVALID;
     }
 
+    // a compressed message is sent like any other, flagged in its magic
+    u32 flags = 0;
+    if (codec && msg.len >= compress_threshold && compress(msg, channel_size))
+        flags = ZCM_MAGIC_COMPRESSED;
+
+    Group& g = groups[groupMap.groupFor(msg.channel)];
+
+    // while coalescing, the flush thread sends too
+    std::unique_lock<std::mutex> lk(batch_mut, std::defer_lock);
+    if (coalesce) lk.lock();
+
+    if (!g.sendfd.isOpen() && !openSendSocket(g)) {
+        ZCM_DEBUG("unable to open a socket to send to %s", g.destAddr.getIP().c_str());
+        return ZCM_ECONNECT;
+    }
+
     int payload_size = channel_size + 1 + msg.len;
+    if (coalesce) {
+        if (!flags && sizeof(MsgHeaderShort) + sizeof(u16) + payload_size <= coalesce_size) {
+            appendToBatch(g, msg, channel_size);
+            return ZCM_EOK;
+        }
+        // the batch goes first, to keep the group's messages in order
+        flushBatch(g);
+    }
+
     if (payload_size <= ZCM_SHORT_MESSAGE_MAX_SIZE) {
         // message is short.  send in a single packet
 
         MsgHeaderShort hdr;
-        hdr.setMagic(ZCM_MAGIC_SHORT);
-        hdr.setMsgSeqno(msg_seqno);
+        hdr.setMagic(ZCM_MAGIC_SHORT | flags);
+        hdr.setMsgSeqno(g.msg_seqno);
+
+        int packet_size = sizeof(hdr) + payload_size;
+        if (!kernel_pacing) pacer.pace(packet_size);
 
-        ssize_t status = sendfd.sendBuffers(destAddr,
+        ssize_t status = g.sendfd.sendBuffers(g.destAddr,
                               (char*)&hdr, sizeof(hdr),
                               (char*)msg.channel, channel_size+1,
                               (char*)msg.buf, msg.len);
 
-        int packet_size = sizeof(hdr) + payload_size;
         ZCM_DEBUG("transmitting %zu byte [%s] payload (%d byte pkt)",
                   msg.len, msg.channel, packet_size);
-        msg_seqno++;
+        g.msg_seqno++;
 
         return (status == packet_size) ? 0 : status;
     }
@@ -305,10 +1173,7 @@ int UDPM::sendmsg(zcm_msg_t msg)
 
     else {
         // message is large.  fragment into multiple packets
-        int fragment_size = ZCM_FRAGMENT_MAX_PAYLOAD;
-        int nfragments = payload_size / fragment_size +
-            !!(payload_size % fragment_size);
-
+        int nfragments = numFragments(payload_size);
         if (nfragments > 65535) {
             fprintf(stderr, "ZCM error: too much data for a single message\n");
             return -1;
@@ -321,51 +1186,229 @@ int UDPM::sendmsg(zcm_msg_t msg)
         ZCM_DEBUG("transmitting %d byte [%s] payload in %d fragments",
                   payload_size, msg.channel, nfragments);
 
-        u32 fragment_offset = 0;
-
-        MsgHeaderLong hdr;
-        hdr.magic = htonl(ZCM_MAGIC_LONG);
-        hdr.msg_seqno = htonl(msg_seqno);
-        hdr.msg_size = htonl(msg.len);
-        hdr.fragment_offset = 0;
-        hdr.fragment_no = 0;
-        hdr.fragments_in_msg = htons(nfragments);
+        MsgHeaderLong hdr = makeHeaderLong(ZCM_MAGIC_LONG | flags, g.msg_seqno,
+                                           msg.len, nfragments);
 
         // first fragment is special.  insert channel before data
-        size_t firstfrag_datasize = fragment_size - (channel_size + 1);
-        assert(firstfrag_datasize <= msg.len);
+        assert((size_t)(ZCM_FRAGMENT_MAX_PAYLOAD - (channel_size + 1)) <= msg.len);
+
+        // kept before sending, a NACK may come back before the last fragment is out
+        if (reliable) keepForRetransmit(g, msg, channel_size, ZCM_MAGIC_LONG | flags);
+
+        // fragments are queued up (each with its own copy of the header) and
+        // transmitted 'batch' at a time, or a pacer's burst at a time if smaller
+        bool pacing = pacer.enabled() && !kernel_pacing;
+        size_t max_packet_size = sizeof(MsgHeaderLong) + ZCM_FRAGMENT_MAX_PAYLOAD;
+        int nqueued = 0;
+        size_t queued_bytes = 0;
+        bool ok = true;
+        for (u16 frag_no = 0; ok && frag_no < nfragments; frag_no++) {
+            PacketIov& pkt = txPkts[nqueued];
+            buildFragment(txHdrs[nqueued], pkt, hdr, frag_no,
+                          msg.channel, channel_size, (char*)msg.buf, msg.len);
+
+            for (size_t i = 0; i < pkt.iovlen; i++)
+                queued_bytes += pkt.iov[i].iov_len;
+
+            if (++nqueued == (int)txPkts.size() || frag_no + 1 == nfragments ||
+                (pacing && queued_bytes + max_packet_size > pacer.getBurst())) {
+                if (pacing) pacer.pace(queued_bytes);
+                ok = g.sendfd.sendPackets(g.destAddr, txPkts.data(), nqueued) == nqueued;
+                nqueued = 0;
+                queued_bytes = 0;
+            }
+        }
 
-        int packet_size = sizeof(hdr) + (channel_size + 1) + firstfrag_datasize;
-        fragment_offset += firstfrag_datasize;
+        g.msg_seqno++;
+    }
+
+    return 0;
+}
+
+// Note: caller must hold batch_mut
+void UDPM::appendToBatch(Group& g, const zcm_msg_t& msg, size_t channel_size)
+{
+    size_t reclen = channel_size + 1 + msg.len;
+    if (g.batch.size() + sizeof(u16) + reclen > coalesce_size)
+        flushBatch(g);
+
+    if (g.batch.empty()) {
+        g.batch.resize(sizeof(MsgHeaderShort));
+        MsgHeaderShort *hdr = (MsgHeaderShort*)g.batch.data();
+        hdr->setMagic(ZCM_MAGIC_BATCH);
+        hdr->setMsgSeqno(g.msg_seqno);
+        g.batch_deadline = std::chrono::steady_clock::now() + coalesce_delay;
+        batch_cond.notify_one();
+    }
 
-        ssize_t status = sendfd.sendBuffers(destAddr,
-                                            (char*)&hdr, sizeof(hdr),
-                                            (char*)msg.channel, channel_size+1,
-                                            (char*)msg.buf, firstfrag_datasize);
+    u16 len = htons((u16)reclen);
+    const char *lenp = (const char*)&len;
+    g.batch.insert(g.batch.end(), lenp, lenp + sizeof(len));
+    g.batch.insert(g.batch.end(), msg.channel, msg.channel + channel_size + 1);
+    g.batch.insert(g.batch.end(), (const char*)msg.buf, (const char*)msg.buf + msg.len);
+    g.batch_msgs++;
+    g.msg_seqno++;
+}
+
+// Note: caller must hold batch_mut
+void UDPM::flushBatch(Group& g)
+{
+    if (g.batch.empty())
+        return;
+
+    if (!kernel_pacing) pacer.pace(g.batch.size());
+    ssize_t status = g.sendfd.sendBuffers(g.destAddr, g.batch.data(), g.batch.size());
+    if (status != (ssize_t)g.batch.size())
+        ZCM_DEBUG("failed to send a batch of %u messages", g.batch_msgs);
+    ZCM_DEBUG("transmitting a batch of %u messages (%zu byte pkt)", g.batch_msgs, g.batch.size());
+
+    coalesced_packets++;
+    coalesced_messages += g.batch_msgs;
+    g.batch.clear();
+    g.batch_msgs = 0;
+}
 
-        // transmit the rest of the fragments
-        for (u16 frag_no = 1; packet_size == status && frag_no < nfragments; frag_no++) {
-            hdr.fragment_offset = htonl(fragment_offset);
-            hdr.fragment_no = htons(frag_no);
+int UDPM::flush()
+{
+    if (!coalesce)
+        return ZCM_EOK;
 
-            int fraglen = std::min(fragment_size, (int)msg.len - (int)fragment_offset);
-            status = sendfd.sendBuffers(destAddr,
-                                        (char*)&hdr, sizeof(hdr),
-                                        (char*)(msg.buf + fragment_offset), fraglen);
+    std::unique_lock<std::mutex> lk(batch_mut);
+    for (auto& g : groups)
+        flushBatch(g);
+    return ZCM_EOK;
+}
 
-            fragment_offset += fraglen;
-            packet_size = sizeof(hdr) + fraglen;
+// Body of the flush thread: sends every batch that has waited for long enough
+void UDPM::flushBatches()
+{
+    typedef std::chrono::steady_clock Clock;
+
+    std::unique_lock<std::mutex> lk(batch_mut);
+    while (batch_thread_running) {
+        auto now = Clock::now();
+        auto next = Clock::time_point::max();
+        for (auto& g : groups) {
+            if (g.batch.empty())
+                continue;
+            if (g.batch_deadline <= now)
+                flushBatch(g);
+            else
+                next = std::min(next, g.batch_deadline);
         }
 
-        // sanity check
-        if (0 == status) {
-            assert(fragment_offset == msg.len);
+        if (next == Clock::time_point::max())
+            batch_cond.wait(lk);
+        else
+            batch_cond.wait_until(lk, next);
+    }
+}
+
+// Copies a large message into the retransmit window, evicting the oldest ones
+// beyond its size (but always keeping the newest)
+void UDPM::keepForRetransmit(Group& g, const zcm_msg_t& msg, size_t channel_size, u32 magic)
+{
+    SentMessage sent;
+    sent.group = &g - groups.data();
+    sent.seqno = g.msg_seqno;
+    sent.magic = magic;
+    sent.channellen = channel_size;
+    sent.payload = pool.allocBuffer(channel_size + 1 + msg.len);
+    memcpy(sent.payload.data, msg.channel, channel_size + 1);
+    memcpy(sent.payload.data + channel_size + 1, msg.buf, msg.len);
+
+    std::unique_lock<std::mutex> lk(window_mut);
+    window_bytes += sent.payload.size;
+    window.push_back(std::move(sent));
+    while (window_bytes > window_max && window.size() > 1) {
+        window_bytes -= window.front().payload.size;
+        pool.freeBuffer(window.front().payload);
+        window.pop_front();
+    }
+}
+
+// Body of the NACK thread: answers the NACKs that receivers send back to any of
+// the send sockets
+void UDPM::serveNacks()
+{
+    vector<UDPMSocket*> socks;
+    for (auto& g : groups)
+        socks.push_back(&g.sendfd);
+
+    Packet *pkt = pool.allocPacket(ZCM_MAX_UNFRAGMENTED_PACKET_SIZE);
+    vector<MsgHeaderLong> hdrs(params.batch);
+    vector<PacketIov> pkts(params.batch);
+
+    while (nack_thread_running) {
+        int i = UDPMSocket::waitUntilAnyData(socks.data(), socks.size(), NACK_THREAD_WAKEUP_MS);
+        if (i < 0)
+            continue;
+
+        int sz = socks[i]->recvPacket(pkt);
+        MsgHeaderNack *nack = (MsgHeaderNack*)pkt->buf.data;
+        if (sz < (int)sizeof(MsgHeaderNack) || nack->getMagic() != ZCM_MAGIC_NACK ||
+            sz < (int)MsgHeaderNack::getSize(nack->getNumFragments())) {
+            ZCM_DEBUG("ignoring bad NACK");
+            continue;
         }
 
-        msg_seqno++;
+        nacks_received++;
+        retransmit(i, nack, hdrs, pkts);
     }
 
-    return 0;
+    pool.freePacket(pkt);
+}
+
+// Resends the fragments a NACK asks for, if their message is still in the window
+void UDPM::retransmit(size_t group, MsgHeaderNack *nack,
+                      vector<MsgHeaderLong>& hdrs, vector<PacketIov>& pkts)
+{
+    u32 seqno = nack->getMsgSeqno();
+
+    std::unique_lock<std::mutex> lk(window_mut);
+    auto it = std::find_if(window.rbegin(), window.rend(), [&](const SentMessage& m) {
+        return m.group == group && m.seqno == seqno;
+    });
+    if (it == window.rend()) {
+        ZCM_DEBUG("NACK for message %u, which is no longer in the window", seqno);
+        nacks_expired++;
+        return;
+    }
+
+    Group& g = groups[group];
+    const char *data = it->payload.data + it->channellen + 1;
+    size_t datalen = it->payload.size - (it->channellen + 1);
+    u16 nfragments = numFragments(it->payload.size);
+    MsgHeaderLong hdr = makeHeaderLong(it->magic, seqno, datalen, nfragments);
+
+    // paced like any other send, or the answer to a NACK is lost the same way
+    bool pacing = pacer.enabled() && !kernel_pacing;
+    size_t max_packet_size = sizeof(MsgHeaderLong) + ZCM_FRAGMENT_MAX_PAYLOAD;
+    int nqueued = 0;
+    size_t queued_bytes = 0;
+    u16 n = nack->getNumFragments();
+    for (u16 i = 0; i < n; i++) {
+        u16 frag_no = nack->getFragmentNo(i);
+        if (frag_no >= nfragments)
+            continue;
+        PacketIov& pkt = pkts[nqueued];
+        buildFragment(hdrs[nqueued], pkt, hdr, frag_no,
+                      it->payload.data, it->channellen, data, datalen);
+        for (size_t j = 0; j < pkt.iovlen; j++)
+            queued_bytes += pkt.iov[j].iov_len;
+
+        if (++nqueued == (int)pkts.size() ||
+            (pacing && queued_bytes + max_packet_size > pacer.getBurst())) {
+            if (pacing) pacer.pace(queued_bytes);
+            retransmits += std::max(g.sendfd.sendPackets(g.destAddr, pkts.data(), nqueued), 0);
+            nqueued = 0;
+            queued_bytes = 0;
+        }
+    }
+    if (nqueued > 0) {
+        if (pacing) pacer.pace(queued_bytes);
+        retransmits += std::max(g.sendfd.sendPackets(g.destAddr, pkts.data(), nqueued), 0);
+    }
 }
 
 int UDPM::recvmsg(zcm_msg_t *msg, int timeout)
@@ -373,7 +1416,7 @@ int UDPM::recvmsg(zcm_msg_t *msg, int timeout)
     if (m)
         pool.freeMessage(m);
 
-    m = readMessage(timeout);
+    m = drain ? drainQueue.pop(timeout) : readMessage(timeout);
     if (m == nullptr)
         return ZCM_EAGAIN;
 
@@ -388,12 +1431,45 @@ int UDPM::recvmsg(zcm_msg_t *msg, int timeout)
 UDPM::~UDPM()
 {
     ZCM_DEBUG("closing zcm context");
+    if (drain_thread.joinable()) {
+        drain_thread_running = false;
+        drain_thread.join();
+    }
+    if (batch_thread.joinable()) {
+        {
+            std::unique_lock<std::mutex> lk(batch_mut);
+            batch_thread_running = false;
+        }
+        batch_cond.notify_all();
+        batch_thread.join();
+    }
+    flush();
+    if (nack_thread.joinable()) {
+        nack_thread_running = false;
+        nack_thread.join();
+    }
+    for (auto& sent : window)
+        pool.freeBuffer(sent.payload);
+    for (Packet *p : rxPkts)
+        if (p) pool.freePacket(p);
 }
 
-UDPM::UDPM(const string& ip, u16 port, size_t recv_buf_size, u8 ttl)
-    : params(ip, port, recv_buf_size, ttl),
-      destAddr(ip, port)
+UDPM::UDPM(const string& ip, u16 port, size_t recv_buf_size, size_t send_buf_size,
+           u8 ttl, size_t batch, const GroupMap& groupMap)
+    : params(ip, port, recv_buf_size, send_buf_size, ttl, batch),
+      groupMap(groupMap)
 {
+    // the groups are consecutive addresses starting at the url's
+    groups.reserve(groupMap.size());
+    for (size_t i = 0; i < groupMap.size(); i++) {
+        struct in_addr addr;
+        addr.s_addr = htonl(ntohl(params.addr.s_addr) + i);
+        groups.emplace_back(addr, port);
+    }
+
+    rxPkts.resize(batch, nullptr);
+    txHdrs.resize(batch);
+    txPkts.resize(batch);
 }
 
 bool UDPM::init()
@@ -402,14 +1478,43 @@ bool UDPM::init()
     ZCM_DEBUG("Multicast %s:%d", params.ip.c_str(), params.port);
     UDPMSocket::checkConnection(params.ip, params.port);
 
-    sendfd = UDPMSocket::createSendSocket(params.addr, params.ttl);
-    if (!sendfd.isOpen()) return false;
-    kernel_sbuf_sz = sendfd.getSendBufSize();
+    if (!openSendSocket(groups[0])) return false;
+    kernel_sbuf_sz = groups[0].sendfd.getSendBufSize();
 
-    recvfd = UDPMSocket::createRecvSocket(params.addr, params.port);
+    recvfd = UDPMSocket::createRecvSocket(params.addr, params.port, params.recv_buf_size);
     if (!recvfd.isOpen()) return false;
     kernel_rbuf_sz = recvfd.getRecvBufSize();
 
+    if (groups.size() == 1) {
+        groups[0].joined = true;
+    } else {
+        // Only hear the groups of enabled channels, which recvmsgEnable() joins,
+        // rather than every group some socket on this host is a member of
+        ZCM_DEBUG("Spreading channels over %zu groups", groups.size());
+        recvfd.setMulticastAll(false);
+        recvfd.dropMembership(params.addr);
+    }
+
+    if (reliable) {
+        // NACKs come back to the send sockets, so they all have to be open
+        // before anything is sent
+        for (auto& g : groups)
+            if (!g.sendfd.isOpen() && !openSendSocket(g))
+                return false;
+        nack_thread_running = true;
+        nack_thread = std::thread(&UDPM::serveNacks, this);
+    }
+
+    if (coalesce) {
+        batch_thread_running = true;
+        batch_thread = std::thread(&UDPM::flushBatches, this);
+    }
+
+    if (drain) {
+        drain_thread_running = true;
+        drain_thread = std::thread(&UDPM::drainSocket, this);
+    }
+
     if (!this->selftest()) {
         // self test failed.  destroy the read thread
         fprintf(stderr, "ZCM self test failed!!\n"
@@ -436,8 +1541,9 @@ struct ZCM_TRANS_CLASSNAME : public zcm_trans_t
 {
     UDPM udpm;
 
-    ZCM_TRANS_CLASSNAME(const string& ip, u16 port, size_t recv_buf_size, u8 ttl)
-        : udpm(ip, port, recv_buf_size, ttl)
+    ZCM_TRANS_CLASSNAME(const string& ip, u16 port, size_t recv_buf_size,
+                        size_t send_buf_size, u8 ttl, size_t batch, const GroupMap& groupMap)
+        : udpm(ip, port, recv_buf_size, send_buf_size, ttl, batch, groupMap)
     {
         trans_type = ZCM_BLOCKING;
         vtbl = &methods;
@@ -460,7 +1566,7 @@ struct ZCM_TRANS_CLASSNAME : public zcm_trans_t
     { return cast(zt)->udpm.sendmsg(msg); }
 
     static int _recvmsgEnable(zcm_trans_t *zt, const char *channel, bool enable)
-    { return ZCM_EOK; }
+    { return cast(zt)->udpm.recvmsgEnable(channel, enable); }
 
     static int _recvmsg(zcm_trans_t *zt, zcm_msg_t *msg, int timeout)
     { return cast(zt)->udpm.recvmsg(msg, timeout); }
@@ -468,7 +1574,12 @@ struct ZCM_TRANS_CLASSNAME : public zcm_trans_t
     static void _destroy(zcm_trans_t *zt)
     { delete cast(zt); }
 
+    static int _flush(zcm_trans_t *zt)
+    { return cast(zt)->udpm.flush(); }
+
+    static zcm_trans_ext_methods_t extMethods;
     static const TransportRegister regUdpm;
+    static const TransportExtRegister regUdpmExt;
 };
 
 zcm_trans_methods_t ZCM_TRANS_CLASSNAME::methods = {
@@ -480,6 +1591,11 @@ zcm_trans_methods_t ZCM_TRANS_CLASSNAME::methods = {
     &ZCM_TRANS_CLASSNAME::_destroy,
 };
 
+zcm_trans_ext_methods_t ZCM_TRANS_CLASSNAME::extMethods = {
+    sizeof(zcm_trans_ext_methods_t),
+    &ZCM_TRANS_CLASSNAME::_flush,
+};
+
 static const char *optFind(zcm_url_opts_t *opts, const string& key)
 {
     for (size_t i = 0; i < opts->numopts; i++)
@@ -523,8 +1639,206 @@ static zcm_trans_t *createUdpm(zcm_url_t *url)
         ZCM_DEBUG("No ttl specified. Using default ttl=0");
         ttl = "0";
     }
-    size_t recv_buf_size = 1024;
-    auto *trans = new ZCM_TRANS_CLASSNAME(address, atoi(port.c_str()), recv_buf_size, atoi(ttl));
+    size_t batch = DEFAULT_BATCH_SIZE;
+    auto *batchOpt = optFind(opts, "batch");
+    if (batchOpt) {
+        int n = atoi(batchOpt);
+        if (n < 1 || n > MAX_BATCH_SIZE) {
+            ZCM_DEBUG("ERROR: batch must be between 1 and %d", MAX_BATCH_SIZE);
+            return nullptr;
+        }
+        batch = n;
+    }
+    auto *mempoolMax = optFind(opts, "mempool_max");
+    bool hugePages = false;
+    auto *hugePagesOpt = optFind(opts, "huge_pages");
+    if (hugePagesOpt) {
+        if (string(hugePagesOpt) == "true") {
+            hugePages = true;
+        } else if (string(hugePagesOpt) != "false") {
+            ZCM_DEBUG("expected boolean argument for 'huge_pages'");
+            return nullptr;
+        }
+    }
+    // The kernel takes these as an int
+    size_t recv_buf_size = 0;
+    auto *recvBufOpt = optFind(opts, "recv_buf_size");
+    if (recvBufOpt) {
+        recv_buf_size = strtoull(recvBufOpt, NULL, 10);
+        if (recv_buf_size > INT_MAX) {
+            ZCM_DEBUG("ERROR: recv_buf_size must be at most %d", INT_MAX);
+            return nullptr;
+        }
+    }
+    size_t send_buf_size = 0;
+    auto *sendBufOpt = optFind(opts, "send_buf_size");
+    if (sendBufOpt) {
+        send_buf_size = strtoull(sendBufOpt, NULL, 10);
+        if (send_buf_size > INT_MAX) {
+            ZCM_DEBUG("ERROR: send_buf_size must be at most %d", INT_MAX);
+            return nullptr;
+        }
+    }
+
+    size_t numGroups = 1;
+    auto *groupsOpt = optFind(opts, "groups");
+    if (groupsOpt) {
+        int n = atoi(groupsOpt);
+        if (n < 1 || n > (int)GroupMap::MAX_GROUPS) {
+            ZCM_DEBUG("ERROR: groups must be between 1 and %zu", GroupMap::MAX_GROUPS);
+            return nullptr;
+        }
+        numGroups = n;
+    }
+    struct in_addr base;
+    if (numGroups > 1 && (!inet_aton(address.c_str(), &base) ||
+                          !IN_MULTICAST(ntohl(base.s_addr)) ||
+                          !IN_MULTICAST(ntohl(base.s_addr) + numGroups - 1))) {
+        ZCM_DEBUG("ERROR: %s doesn't start a range of %zu multicast groups",
+                  address.c_str(), numGroups);
+        return nullptr;
+    }
+    GroupMap groupMap(numGroups);
+    auto *groupMapOpt = optFind(opts, "group_map");
+    if (groupMapOpt && !groupMap.addRules(groupMapOpt)) return nullptr;
+    auto *groupMapFileOpt = optFind(opts, "group_map_file");
+    if (groupMapFileOpt && !groupMap.addRulesFromFile(groupMapFileOpt)) return nullptr;
+
+    u64 paceRate = 0;
+    auto *paceRateOpt = optFind(opts, "pace_rate");
+    if (paceRateOpt) paceRate = strtoull(paceRateOpt, NULL, 10);
+    u64 paceBurst = DEFAULT_PACE_BURST;
+    auto *paceBurstOpt = optFind(opts, "pace_burst");
+    if (paceBurstOpt) {
+        paceBurst = strtoull(paceBurstOpt, NULL, 10);
+        if (paceBurst < ZCM_MAX_UNFRAGMENTED_PACKET_SIZE) {
+            ZCM_DEBUG("ERROR: pace_burst must hold at least one datagram (%d bytes)",
+                      ZCM_MAX_UNFRAGMENTED_PACKET_SIZE);
+            return nullptr;
+        }
+    }
+    bool kernelPacing = false;
+    auto *paceKernelOpt = optFind(opts, "pace_kernel");
+    if (paceKernelOpt) {
+        if (string(paceKernelOpt) == "true") {
+            kernelPacing = true;
+        } else if (string(paceKernelOpt) != "false") {
+            ZCM_DEBUG("expected boolean argument for 'pace_kernel'");
+            return nullptr;
+        }
+    }
+
+    bool reliable = false;
+    auto *reliableOpt = optFind(opts, "reliable");
+    if (reliableOpt) {
+        if (string(reliableOpt) == "true") {
+            reliable = true;
+        } else if (string(reliableOpt) != "false") {
+            ZCM_DEBUG("expected boolean argument for 'reliable'");
+            return nullptr;
+        }
+    }
+    size_t reliableWindow = DEFAULT_RELIABLE_WINDOW;
+    auto *reliableWindowOpt = optFind(opts, "reliable_window");
+    if (reliableWindowOpt) reliableWindow = strtoull(reliableWindowOpt, NULL, 10);
+
+    size_t coalesceSize = 0;
+    auto *coalesceOpt = optFind(opts, "coalesce");
+    if (coalesceOpt) {
+        if (string(coalesceOpt) == "true") {
+            coalesceSize = DEFAULT_COALESCE_SIZE;
+        } else if (string(coalesceOpt) != "false") {
+            ZCM_DEBUG("expected boolean argument for 'coalesce'");
+            return nullptr;
+        }
+    }
+    auto *coalesceSizeOpt = optFind(opts, "coalesce_size");
+    if (coalesceSize && coalesceSizeOpt) {
+        coalesceSize = strtoull(coalesceSizeOpt, NULL, 10);
+        if (coalesceSize < MIN_COALESCE_SIZE || coalesceSize > MAX_COALESCE_SIZE) {
+            ZCM_DEBUG("ERROR: coalesce_size must be between %d and %zu",
+                      MIN_COALESCE_SIZE, MAX_COALESCE_SIZE);
+            return nullptr;
+        }
+    }
+    u64 coalesceDelay = DEFAULT_COALESCE_DELAY_US;
+    auto *coalesceDelayOpt = optFind(opts, "coalesce_delay_us");
+    if (coalesceDelayOpt) coalesceDelay = strtoull(coalesceDelayOpt, NULL, 10);
+
+    const zcm_codec_t *codec = nullptr;
+    auto *compressOpt = optFind(opts, "compress");
+    if (compressOpt && string(compressOpt) != "none") {
+        codec = zcm_codec_find(compressOpt);
+        if (!codec) {
+            ZCM_DEBUG("ERROR: unknown compression codec '%s'", compressOpt);
+            return nullptr;
+        }
+    }
+    size_t compressThreshold = DEFAULT_COMPRESS_THRESHOLD;
+    auto *compressThresholdOpt = optFind(opts, "compress_threshold");
+    if (compressThresholdOpt) {
+        compressThreshold = strtoull(compressThresholdOpt, NULL, 10);
+        // an empty message can't get any smaller
+        if (compressThreshold < 1) compressThreshold = 1;
+    }
+
+    bool drain = false;
+    auto *drainOpt = optFind(opts, "drain_thread");
+    if (drainOpt) {
+        if (string(drainOpt) == "true") {
+            drain = true;
+        } else if (string(drainOpt) != "false") {
+            ZCM_DEBUG("expected boolean argument for 'drain_thread'");
+            return nullptr;
+        }
+    }
+    int drainCpu = -1;
+    auto *drainCpuOpt = optFind(opts, "drain_cpu");
+    if (drainCpuOpt) {
+        drainCpu = atoi(drainCpuOpt);
+        if (drainCpu < 0) {
+            ZCM_DEBUG("ERROR: drain_cpu must be a cpu number");
+            return nullptr;
+        }
+    }
+    int drainPriority = 0;
+    auto *drainPriorityOpt = optFind(opts, "drain_priority");
+    if (drainPriorityOpt) {
+        drainPriority = atoi(drainPriorityOpt);
+        if (drainPriority < 1 || drainPriority > 99) {
+            ZCM_DEBUG("ERROR: drain_priority must be between 1 and 99");
+            return nullptr;
+        }
+    }
+    size_t drainQueue = DEFAULT_DRAIN_QUEUE;
+    auto *drainQueueOpt = optFind(opts, "drain_queue");
+    if (drainQueueOpt) {
+        drainQueue = strtoull(drainQueueOpt, NULL, 10);
+        if (drainQueue < 1) {
+            ZCM_DEBUG("ERROR: drain_queue must hold at least one message");
+            return nullptr;
+        }
+    }
+    size_t drainQueueBytes = DEFAULT_DRAIN_QUEUE_BYTES;
+    auto *drainQueueBytesOpt = optFind(opts, "drain_queue_bytes");
+    if (drainQueueBytesOpt) drainQueueBytes = strtoull(drainQueueBytesOpt, NULL, 10);
+    auto *dropPolicyOpt = optFind(opts, "drop_policy");
+
+    auto *trans = new ZCM_TRANS_CLASSNAME(address, atoi(port.c_str()), recv_buf_size,
+                                          send_buf_size, atoi(ttl), batch, groupMap);
+    trans->udpm.setPacing(paceRate, paceBurst, kernelPacing);
+    trans->udpm.setReliable(reliable, reliableWindow);
+    trans->udpm.setCoalescing(coalesceSize, coalesceDelay);
+    trans->udpm.setCompression(codec, compressThreshold);
+    trans->udpm.setDrainThread(drain, drainCpu, drainPriority);
+    trans->udpm.drainQueue.configure(drainQueue, drainQueueBytes);
+    if (dropPolicyOpt && !trans->udpm.drainQueue.addPolicies(dropPolicyOpt)) {
+        delete trans;
+        return nullptr;
+    }
+    MemPool& mempool = trans->udpm.pool.getMemPool();
+    if (mempoolMax) mempool.setHighWatermark(strtoull(mempoolMax, NULL, 10));
+    mempool.setHugePages(hugePages);
     if (!trans->init()) {
         delete trans;
         return nullptr;
@@ -537,4 +1851,38 @@ static zcm_trans_t *createUdpm(zcm_url_t *url)
 // Register this transport with ZCM
 const TransportRegister ZCM_TRANS_CLASSNAME::regUdpm(
     "udpm", "Transfer data via UDP Multicast (e.g. 'udpm')", createUdpm);
+const TransportExtRegister ZCM_TRANS_CLASSNAME::regUdpmExt(
+    &ZCM_TRANS_CLASSNAME::methods, &ZCM_TRANS_CLASSNAME::extMethods);
 #endif
+
+/************************* Stats API *******************/
+int zcm_trans_udpm_get_stats(zcm_trans_t *zt, zcm_udpm_stats_t *stats)
+{
+    if (zt->vtbl != &ZCM_TRANS_CLASSNAME::methods)
+        return ZCM_EINVALID;
+    ZCM_TRANS_CLASSNAME::cast(zt)->udpm.getStats(stats);
+    return ZCM_EOK;
+}
+
+int zcm_trans_udpm_get_sender_stats(zcm_trans_t *zt, zcm_udpm_sender_stats_t *senders,
+                                    size_t max)
+{
+    if (zt->vtbl != &ZCM_TRANS_CLASSNAME::methods)
+        return -1;
+    return ZCM_TRANS_CLASSNAME::cast(zt)->udpm.getSenderStats(senders, max);
+}
+
+int zcm_trans_udpm_get_mempool_stats(zcm_trans_t *zt, zcm_udpm_mempool_stats_t *classes,
+                                     size_t max)
+{
+    if (zt->vtbl != &ZCM_TRANS_CLASSNAME::methods)
+        return -1;
+    return ZCM_TRANS_CLASSNAME::cast(zt)->udpm.getMemPoolStats(classes, max);
+}
+
+int zcm_trans_udpm_get_drop_stats(zcm_trans_t *zt, zcm_udpm_drop_stats_t *drops, size_t max)
+{
+    if (zt->vtbl != &ZCM_TRANS_CLASSNAME::methods)
+        return -1;
+    return ZCM_TRANS_CLASSNAME::cast(zt)->udpm.getDropStats(drops, max);
+}
@@ -5,11 +5,13 @@
 #include <cstdio>
 #include <cstddef>
 #include <cstdint>
+#include <cinttypes>
 #include <cmath>
 #include <cstring>
 #include <cerrno>
 #include <ctime>
 #include <cassert>
+#include <climits>
 
 // TODO: get rid of these
 #include <thread>
@@ -19,8 +21,11 @@
 // Headers for C++ library
 #include <algorithm>
 #include <vector>
+#include <deque>
 #include <stack>
 #include <unordered_map>
+#include <unordered_set>
+#include <atomic>
 #include <string>
 using namespace std;
 
@@ -87,6 +92,11 @@ typedef int64_t  i64;
 /************************* Important Defines *******************/
 #define ZCM_MAGIC_SHORT 0x4c433032   // hex repr of ascii "LC02"
 #define ZCM_MAGIC_LONG  0x4c433033   // hex repr of ascii "LC03"
+#define ZCM_MAGIC_NACK  0x4c43304e   // hex repr of ascii "LC0N"
+#define ZCM_MAGIC_BATCH 0x4c433042   // hex repr of ascii "LC0B"
+// Set in the magic of short messages and of every fragment of large ones when their
+// data is compressed (see MsgHeaderCompressed). Never set in an ascii magic
+#define ZCM_MAGIC_COMPRESSED 0x00000080
 
 #ifdef __APPLE__
 # define ZCM_SHORT_MESSAGE_MAX_SIZE 1435
@@ -0,0 +1,110 @@
+#ifndef _ZCM_TRANS_UDPM_STATS_H
+#define _ZCM_TRANS_UDPM_STATS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "zcm/zcm.h"
+#include "zcm/transport.h"
+
+/* Counters of a udpm transport, mostly receive-side. Every counter starts at zero when
+ * the transport is created and only ever grows (but for the max). */
+typedef struct zcm_udpm_stats_t zcm_udpm_stats_t;
+struct zcm_udpm_stats_t
+{
+    uint64_t packets;          /* datagrams received */
+    uint64_t messages;         /* complete messages handed to zcm */
+    uint64_t bad_packets;      /* datagrams discarded as malformed (size, magic, header) */
+    uint64_t seq_gaps;         /* messages skipped in some sender's sequence */
+    uint64_t seq_reorders;     /* messages that arrived after a newer one from their sender */
+    uint64_t frag_evicted;     /* partial messages evicted to make room for others */
+    uint64_t frag_incomplete;  /* partial messages dropped because of an invalid fragment */
+    uint64_t frag_duplicates;  /* fragments ignored because they had already arrived */
+    uint64_t kernel_drops;     /* datagrams the kernel dropped on a full socket (SO_RXQ_OVFL) */
+    uint64_t mempool_hits;     /* buffer allocations served from the pool (see mempool_max) */
+    uint64_t mempool_misses;   /* ... and those that went to the OS */
+    uint64_t mempool_bytes_cached;   /* memory the pool holds for reuse right now */
+    uint64_t mempool_high_watermark; /* the most it may hold */
+    uint64_t filtered;         /* messages dropped early because their channel wasn't enabled */
+    uint64_t paced_sends;      /* sends the pacer held back (see the pace_rate url option) */
+    uint64_t pacing_delay_ns;  /* total time they were held back for */
+    uint64_t pacing_delay_max_ns;
+    uint64_t nacks_sent;       /* requests for missing fragments (see the reliable url option) */
+    uint64_t nacks_received;
+    uint64_t nacks_expired;    /* received for messages no longer in the retransmit window */
+    uint64_t retransmits;      /* fragments sent again in answer to a NACK */
+    uint64_t coalesced_messages; /* messages sent packed with others (see coalesce) */
+    uint64_t coalesced_packets;  /* datagrams they were packed into */
+    uint64_t compressed_messages;  /* messages sent compressed (see compress) */
+    uint64_t compressed_raw_bytes; /* their size before compression */
+    uint64_t compressed_bytes;     /* ... and after */
+    uint64_t decompress_errors;    /* messages dropped for an unknown codec or corrupt data */
+    uint64_t drain_dropped;    /* messages the drain thread's queue dropped (see drain_thread) */
+    uint32_t drain_queued;     /* messages waiting in that queue */
+    uint32_t drain_queued_max; /* the most that ever waited */
+    uint32_t num_senders;      /* senders currently tracked */
+};
+
+/* Sequence tracking for a single sender, identified by its address and port */
+typedef struct zcm_udpm_sender_stats_t zcm_udpm_sender_stats_t;
+struct zcm_udpm_sender_stats_t
+{
+    uint32_t addr;             /* IPv4 address, network byte order */
+    uint16_t port;             /* network byte order */
+    uint32_t last_seqno;       /* newest message sequence number seen */
+    uint64_t packets;
+    uint64_t seq_gaps;
+    uint64_t seq_reorders;
+};
+
+/* Usage of one of the buffer pool's power of two size classes */
+typedef struct zcm_udpm_mempool_stats_t zcm_udpm_mempool_stats_t;
+struct zcm_udpm_mempool_stats_t
+{
+    uint64_t size;             /* bytes per block in this class */
+    uint64_t cached;           /* blocks held for reuse */
+    uint64_t hits;             /* allocations served from them */
+    uint64_t misses;           /* allocations that went to the OS */
+    uint64_t trimmed;          /* frees handed back to the OS because of mempool_max */
+};
+
+/* Messages the drain thread's queue dropped on a single channel */
+typedef struct zcm_udpm_drop_stats_t zcm_udpm_drop_stats_t;
+struct zcm_udpm_drop_stats_t
+{
+    char     channel[ZCM_CHANNEL_MAXLEN + 1];
+    uint64_t dropped;
+};
+
+/* Fills in 'stats' for a transport created with the "udpm" url scheme (e.g. through
+ * zcm_transport_find("udpm") and zcm_create_from_trans()).
+ * Returns ZCM_EOK, or ZCM_EINVALID if 'zt' is not a udpm transport.
+ * Safe to call from any thread while the transport is running. */
+int zcm_trans_udpm_get_stats(zcm_trans_t* zt, zcm_udpm_stats_t* stats);
+
+/* Copies the stats of up to 'max' senders into 'senders'.
+ * Returns the number of senders tracked (which may be more than 'max'),
+ * or -1 if 'zt' is not a udpm transport. */
+int zcm_trans_udpm_get_sender_stats(zcm_trans_t* zt, zcm_udpm_sender_stats_t* senders,
+                                    size_t max);
+
+/* Copies the stats of up to 'max' of the buffer pool's size classes, smallest first,
+ * into 'classes'. Returns the number of size classes (which may be more than 'max'),
+ * or -1 if 'zt' is not a udpm transport. */
+int zcm_trans_udpm_get_mempool_stats(zcm_trans_t* zt, zcm_udpm_mempool_stats_t* classes,
+                                     size_t max);
+
+/* Copies the drop counts of up to 'max' channels into 'drops'.
+ * Returns the number of channels that lost messages (which may be more than 'max'),
+ * or -1 if 'zt' is not a udpm transport. */
+int zcm_trans_udpm_get_drop_stats(zcm_trans_t* zt, zcm_udpm_drop_stats_t* drops, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ZCM_TRANS_UDPM_STATS_H */
@@ -60,6 +60,48 @@ struct Platform
 };
 #endif
 
+// Fill in pkt->utime from the kernel's SO_TIMESTAMP, or from the current time,
+// and pkt->kernel_drops from SO_RXQ_OVFL
+static void readControl(struct msghdr *msg, Packet *pkt)
+{
+    bool got_utime = false;
+    pkt->kernel_drops = 0;
+#ifdef MSG_EXT_HDR
+    struct cmsghdr *cmsg = msg->msg_controllen ? CMSG_FIRSTHDR(msg) : NULL;
+    /* Get the receive timestamp out of the packet headers if possible */
+    while (cmsg) {
+# ifdef SO_TIMESTAMPNS
+        if (cmsg->cmsg_level == SOL_SOCKET &&
+            cmsg->cmsg_type == SCM_TIMESTAMPNS && !pkt->utime) {
+            struct timespec t;
+            memcpy(&t, CMSG_DATA(cmsg), sizeof(t));
+            pkt->utime = (int64_t) t.tv_sec * 1000000 + t.tv_nsec / 1000;
+            got_utime = true;
+        }
+# endif
+        if (cmsg->cmsg_level == SOL_SOCKET &&
+            cmsg->cmsg_type == SCM_TIMESTAMP && !pkt->utime) {
+            struct timeval *t = (struct timeval*) CMSG_DATA (cmsg);
+            pkt->utime = (int64_t) t->tv_sec * 1000000 + t->tv_usec;
+            got_utime = true;
+        }
+# ifdef SO_RXQ_OVFL
+        if (cmsg->cmsg_level == SOL_SOCKET &&
+            cmsg->cmsg_type == SO_RXQ_OVFL) {
+            memcpy(&pkt->kernel_drops, CMSG_DATA(cmsg), sizeof(u32));
+        }
+# endif
+        cmsg = CMSG_NXTHDR(msg, cmsg);
+    }
+#endif
+
+    if (!got_utime) {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        pkt->utime = (i64)tv.tv_sec * 1000000 + tv.tv_usec;
+    }
+}
+
 UDPMSocket::UDPMSocket()
 {
 }
@@ -105,6 +147,44 @@ bool UDPMSocket::joinMulticastGroup(struct in_addr multiaddr)
     return true;
 }
 
+bool UDPMSocket::addMembership(struct in_addr multiaddr)
+{
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr = multiaddr;
+    mreq.imr_interface.s_addr = INADDR_ANY;
+    ZCM_DEBUG("ZCM: joining multicast group %s", inet_ntoa(multiaddr));
+    if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, (char*)&mreq, sizeof(mreq)) < 0) {
+        perror("setsockopt (IPPROTO_IP, IP_ADD_MEMBERSHIP)");
+        return false;
+    }
+    return true;
+}
+
+bool UDPMSocket::dropMembership(struct in_addr multiaddr)
+{
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr = multiaddr;
+    mreq.imr_interface.s_addr = INADDR_ANY;
+    ZCM_DEBUG("ZCM: leaving multicast group %s", inet_ntoa(multiaddr));
+    if (setsockopt(fd, IPPROTO_IP, IP_DROP_MEMBERSHIP, (char*)&mreq, sizeof(mreq)) < 0) {
+        perror("setsockopt (IPPROTO_IP, IP_DROP_MEMBERSHIP)");
+        return false;
+    }
+    return true;
+}
+
+bool UDPMSocket::setMulticastAll(bool enable)
+{
+#ifdef IP_MULTICAST_ALL
+    int opt = enable;
+    if (setsockopt(fd, IPPROTO_IP, IP_MULTICAST_ALL, (char*)&opt, sizeof(opt)) < 0) {
+        perror("setsockopt (IPPROTO_IP, IP_MULTICAST_ALL)");
+        return false;
+    }
+#endif
+    return true;
+}
+
 bool UDPMSocket::setTTL(u8 ttl)
 {
     if (ttl == 0)
@@ -168,9 +248,25 @@ bool UDPMSocket::setReusePort()
 bool UDPMSocket::enablePacketTimestamp()
 {
     /* Enable per-packet timestamping by the kernel, if available */
+#if defined(SO_TIMESTAMPNS)
+    int opt = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &opt, sizeof(opt)) == 0)
+        return true;
+#endif
 #ifdef SO_TIMESTAMP
+    int opt2 = 1;
+    setsockopt(fd, SOL_SOCKET, SO_TIMESTAMP, &opt2, sizeof(opt2));
+#endif
+    return true;
+}
+
+bool UDPMSocket::enableDropCounter()
+{
+    /* Have the kernel report how many packets it dropped on this socket, if available */
+#ifdef SO_RXQ_OVFL
     int opt = 1;
-    setsockopt(fd, SOL_SOCKET, SO_TIMESTAMP, &opt, sizeof(opt));
+    if (setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &opt, sizeof(opt)) < 0)
+        ZCM_DEBUG("ZCM: SO_RXQ_OVFL unavailable, kernel drops won't be counted");
 #endif
     return true;
 }
@@ -201,10 +297,77 @@ size_t UDPMSocket::getSendBufSize()
     int size;
     uint retsize = sizeof(int);
     getsockopt(fd, SOL_SOCKET, SO_SNDBUF, (char*)&size, (socklen_t *)&retsize);
-    ZCM_DEBUG("ZCM: receive buffer is %d bytes", size);
+    ZCM_DEBUG("ZCM: send buffer is %d bytes", size);
     return size;
 }
 
+// Requests a kernel buffer of 'sz' bytes with 'opt', falling back to 'forceOpt'
+// (which ignores the system wide limit, but needs CAP_NET_ADMIN) when the kernel
+// clamps the request. Warns if the socket still ends up with less than asked for
+static void setKernelBufSize(SOCKET fd, int opt, int forceOpt, const char *name,
+                             const char *sysctl, size_t sz)
+{
+    int size = (int)sz;
+    ZCM_DEBUG("ZCM: requesting a %d byte %s buffer", size, name);
+    setsockopt(fd, SOL_SOCKET, opt, (char*)&size, sizeof(size));
+
+    int actual = 0;
+    uint retsize = sizeof(int);
+    // Note: linux reports double the requested size to account for its bookkeeping
+    auto granted = [&]() {
+        getsockopt(fd, SOL_SOCKET, opt, (char*)&actual, (socklen_t *)&retsize);
+#ifdef __linux__
+        actual /= 2;
+#endif
+        return (size_t)actual >= sz;
+    };
+    if (granted())
+        return;
+
+    if (forceOpt != -1) {
+        setsockopt(fd, SOL_SOCKET, forceOpt, (char*)&size, sizeof(size));
+        if (granted())
+            return;
+    }
+
+    fprintf(stderr,
+            "==== ZCM Warning ===\n"
+            "ZCM requested a %zu byte kernel %s buffer, but the kernel limited it to\n"
+            "%d bytes. Raise %s to allow bigger buffers.\n",
+            sz, name, actual, sysctl);
+}
+
+void UDPMSocket::setRecvBufSize(size_t sz)
+{
+#ifdef SO_RCVBUFFORCE
+    setKernelBufSize(fd, SO_RCVBUF, SO_RCVBUFFORCE, "receive", "net.core.rmem_max", sz);
+#else
+    setKernelBufSize(fd, SO_RCVBUF, -1, "receive", "kern.ipc.maxsockbuf", sz);
+#endif
+}
+
+void UDPMSocket::setSendBufSize(size_t sz)
+{
+#ifdef SO_SNDBUFFORCE
+    setKernelBufSize(fd, SO_SNDBUF, SO_SNDBUFFORCE, "send", "net.core.wmem_max", sz);
+#else
+    setKernelBufSize(fd, SO_SNDBUF, -1, "send", "kern.ipc.maxsockbuf", sz);
+#endif
+}
+
+bool UDPMSocket::setMaxPacingRate(u64 rate)
+{
+#ifdef SO_MAX_PACING_RATE
+    // Note: older kernels only accept 32 bits
+    u32 rate32 = (u32)std::min(rate, (u64)UINT32_MAX);
+    if (setsockopt(fd, SOL_SOCKET, SO_MAX_PACING_RATE, (char*)&rate, sizeof(rate)) == 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_MAX_PACING_RATE, (char*)&rate32, sizeof(rate32)) == 0)
+        return true;
+    perror("setsockopt(SOL_SOCKET, SO_MAX_PACING_RATE)");
+#endif
+    return false;
+}
+
 bool UDPMSocket::waitUntilData(int timeout)
 {
     assert(isOpen());
@@ -231,6 +394,33 @@ bool UDPMSocket::waitUntilData(int timeout)
     }
 }
 
+int UDPMSocket::waitUntilAnyData(UDPMSocket *const *socks, size_t n, int timeout)
+{
+    fd_set fds;
+    FD_ZERO(&fds);
+    SOCKET maxfd = -1;
+    for (size_t i = 0; i < n; i++) {
+        assert(socks[i]->isOpen());
+        FD_SET(socks[i]->fd, &fds);
+        maxfd = std::max(maxfd, socks[i]->fd);
+    }
+
+    struct timeval tm = {
+        timeout / 1000,            /* seconds */
+        (timeout % 1000) * 1000    /* micros */
+    };
+
+    int status = select(maxfd + 1, &fds, 0, 0, &tm);
+    if (status < 0) {
+        perror("udp_read_packet -- select:");
+        return -1;
+    }
+    for (size_t i = 0; status > 0 && i < n; i++)
+        if (FD_ISSET(socks[i]->fd, &fds))
+            return (int)i;
+    return -1;
+}
+
 int UDPMSocket::recvPacket(Packet *pkt)
 {
     struct iovec vec;
@@ -254,32 +444,57 @@ int UDPMSocket::recvPacket(Packet *pkt)
     msg.msg_flags = 0;
 #endif
 
+    pkt->utime = 0;
     int ret = ::recvmsg(fd, &msg, 0);
     pkt->fromlen = msg.msg_namelen;
+    readControl(&msg, pkt);
 
-    bool got_utime = false;
-#ifdef SO_TIMESTAMP
-    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
-    /* Get the receive timestamp out of the packet headers if possible */
-    while (!pkt->utime && cmsg) {
-        if (cmsg->cmsg_level == SOL_SOCKET &&
-            cmsg->cmsg_type == SCM_TIMESTAMP) {
-            struct timeval *t = (struct timeval*) CMSG_DATA (cmsg);
-            pkt->utime = (int64_t) t->tv_sec * 1000000 + t->tv_usec;
-            got_utime = true;
-            break;
+    return ret;
+}
+
+int UDPMSocket::recvPackets(Packet **pkts, int n)
+{
+#ifdef __linux__
+    if (n > 1) {
+        recvHdrs.resize(n);
+        recvIovs.resize(n);
+        recvControl.resize(n * CONTROL_SIZE);
+
+        for (int i = 0; i < n; ++i) {
+            Packet *pkt = pkts[i];
+            pkt->utime = 0;
+
+            recvIovs[i].iov_base = pkt->buf.data;
+            recvIovs[i].iov_len = pkt->buf.size;
+
+            struct msghdr& msg = recvHdrs[i].msg_hdr;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_name = &pkt->from;
+            msg.msg_namelen = sizeof(struct sockaddr);
+            msg.msg_iov = &recvIovs[i];
+            msg.msg_iovlen = 1;
+            msg.msg_control = &recvControl[i * CONTROL_SIZE];
+            msg.msg_controllen = CONTROL_SIZE;
+            recvHdrs[i].msg_len = 0;
         }
-        cmsg = CMSG_NXTHDR(&msg, cmsg);
-    }
-#endif
 
-    if (!got_utime) {
-        struct timeval tv;
-        gettimeofday(&tv, NULL);
-        pkt->utime = (i64)tv.tv_sec * 1000000 + tv.tv_usec;
+        // Only take what is already queued: the caller does the waiting
+        int ret = ::recvmmsg(fd, recvHdrs.data(), n, MSG_DONTWAIT, NULL);
+        if (ret < 0) return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+
+        for (int i = 0; i < ret; ++i) {
+            pkts[i]->fromlen = recvHdrs[i].msg_hdr.msg_namelen;
+            pkts[i]->sz = recvHdrs[i].msg_len;
+            readControl(&recvHdrs[i].msg_hdr, pkts[i]);
+        }
+        return ret;
     }
+#endif
 
-    return ret;
+    int ret = recvPacket(pkts[0]);
+    if (ret < 0) return -1;
+    pkts[0]->sz = ret;
+    return 1;
 }
 
 ssize_t UDPMSocket::sendBuffers(const UDPMAddress& dest, const char *a, size_t alen)
@@ -344,6 +559,48 @@ ssize_t UDPMSocket::sendBuffers(const UDPMAddress& dest, const char *a, size_t a
     return::sendmsg(fd, &mhdr, 0);
 }
 
+int UDPMSocket::sendPackets(const UDPMAddress& dest, const PacketIov *pkts, int n)
+{
+    int sent = 0;
+#ifdef __linux__
+    sendHdrs.resize(n);
+    for (int i = 0; i < n; ++i) {
+        struct msghdr& mhdr = sendHdrs[i].msg_hdr;
+        mhdr.msg_name = dest.getAddrPtr();
+        mhdr.msg_namelen = dest.getAddrSize();
+        mhdr.msg_iov = (struct iovec*)pkts[i].iov;
+        mhdr.msg_iovlen = pkts[i].iovlen;
+        mhdr.msg_control = NULL;
+        mhdr.msg_controllen = 0;
+        mhdr.msg_flags = 0;
+        sendHdrs[i].msg_len = 0;
+    }
+
+    // sendmmsg() may stop short (e.g. when interrupted); pick up where it left off
+    while (sent < n) {
+        int ret = ::sendmmsg(fd, &sendHdrs[sent], n - sent, 0);
+        if (ret <= 0) {
+            if (ret < 0 && errno == EINTR) continue;
+            break;
+        }
+        sent += ret;
+    }
+#else
+    for (; sent < n; ++sent) {
+        struct msghdr mhdr;
+        mhdr.msg_name = dest.getAddrPtr();
+        mhdr.msg_namelen = dest.getAddrSize();
+        mhdr.msg_iov = (struct iovec*)pkts[sent].iov;
+        mhdr.msg_iovlen = pkts[sent].iovlen;
+        mhdr.msg_control = NULL;
+        mhdr.msg_controllen = 0;
+        mhdr.msg_flags = 0;
+        if (::sendmsg(fd, &mhdr, 0) < 0) break;
+    }
+#endif
+    return sent;
+}
+
 bool UDPMSocket::checkConnection(const string& ip, u16 port)
 {
     UDPMAddress addr{ip, port};
@@ -376,7 +633,7 @@ void UDPMSocket::checkAndWarnAboutSmallBuffer(size_t datalen, size_t kbufsize)
 #endif
 }
 
-UDPMSocket UDPMSocket::createSendSocket(struct in_addr multiaddr, u8 ttl)
+UDPMSocket UDPMSocket::createSendSocket(struct in_addr multiaddr, u8 ttl, size_t bufsize)
 {
     // don't use connect() on the actual transmit socket, because linux then
     // has problems multicasting to localhost
@@ -385,17 +642,20 @@ UDPMSocket UDPMSocket::createSendSocket(struct in_addr multiaddr, u8 ttl)
     if (!sock.setTTL(ttl))                   { sock.close(); return sock; }
     if (!sock.enableLoopback())              { sock.close(); return sock; }
     if (!sock.joinMulticastGroup(multiaddr)) { sock.close(); return sock; }
+    if (bufsize) sock.setSendBufSize(bufsize);
     return sock;
 }
 
-UDPMSocket UDPMSocket::createRecvSocket(struct in_addr multiaddr, u16 port)
+UDPMSocket UDPMSocket::createRecvSocket(struct in_addr multiaddr, u16 port, size_t bufsize)
 {
     UDPMSocket sock;
     if (!sock.init())                        { sock.close(); return sock; }
     if (!sock.setReuseAddr())                { sock.close(); return sock; }
     if (!sock.setReusePort())                { sock.close(); return sock; }
     if (!sock.enablePacketTimestamp())       { sock.close(); return sock; }
+    if (!sock.enableDropCounter())           { sock.close(); return sock; }
     if (!sock.bindPort(port))                { sock.close(); return sock; }
     if (!sock.joinMulticastGroup(multiaddr)) { sock.close(); return sock; }
+    if (bufsize) sock.setRecvBufSize(bufsize);
     return sock;
 }
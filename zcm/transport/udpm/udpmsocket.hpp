@@ -16,6 +16,13 @@ class UDPMAddress
         this->addr.sin_port = htons(port);
     }
 
+    UDPMAddress(const struct sockaddr_in& addr)
+    {
+        this->ip = inet_ntoa(addr.sin_addr);
+        this->port = ntohs(addr.sin_port);
+        this->addr = addr;
+    }
+
     const string& getIP() const { return ip; }
     u16 getPort() const { return port; }
     struct sockaddr* getAddrPtr() const { return (struct sockaddr*)&addr; }
@@ -27,6 +34,13 @@ class UDPMAddress
     struct sockaddr_in addr;
 };
 
+// Scatter list for a single datagram, as passed to UDPMSocket::sendPackets()
+struct PacketIov
+{
+    struct iovec iov[3];
+    size_t iovlen;
+};
+
 class UDPMSocket
 {
   public:
@@ -37,37 +51,71 @@ class UDPMSocket
 
     bool init();
     bool joinMulticastGroup(struct in_addr multiaddr);
+    // Join or leave further groups on an open socket. Unlike joinMulticastGroup(),
+    // failing leaves the socket open
+    bool addMembership(struct in_addr multiaddr);
+    bool dropMembership(struct in_addr multiaddr);
+    // Whether to receive traffic for groups joined by other sockets bound to the
+    // same port (linux only; everywhere else a socket only hears its own groups)
+    bool setMulticastAll(bool enable);
     bool setTTL(u8 ttl);
     bool bindPort(u16 port);
     bool setReuseAddr();
     bool setReusePort();
     bool enablePacketTimestamp();
+    bool enableDropCounter();
     bool enableLoopback();
     bool setDestination(const string& ip, u16 port);
 
     size_t getRecvBufSize();
     size_t getSendBufSize();
+    void setRecvBufSize(size_t sz);
+    void setSendBufSize(size_t sz);
+    // Asks the kernel to pace this socket's traffic to 'rate' bytes per second
+    // (SO_MAX_PACING_RATE, which needs the fq qdisc on the egress interface).
+    // Returns false where that isn't supported
+    bool setMaxPacingRate(u64 rate);
 
     // Returns true when there is a packet available for receiving
     bool waitUntilData(int timeout);
+    // Like waitUntilData(), for several sockets at once. Returns the index of one
+    // with a packet available, or -1 on timeout
+    static int waitUntilAnyData(UDPMSocket *const *socks, size_t n, int timeout);
     int recvPacket(Packet *pkt);
+    // Receives up to 'n' packets that are already waiting (i.e. after waitUntilData())
+    // in as few syscalls as the platform allows, setting each packet's 'sz'.
+    // Returns the number of packets received, or -1 on error
+    int recvPackets(Packet **pkts, int n);
 
     ssize_t sendBuffers(const UDPMAddress& dest, const char *a, size_t alen);
     ssize_t sendBuffers(const UDPMAddress& dest, const char *a, size_t alen,
                             const char *b, size_t blen);
     ssize_t sendBuffers(const UDPMAddress& dest, const char *a, size_t alen,
                         const char *b, size_t blen, const char *c, size_t clen);
+    // Sends 'n' datagrams in as few syscalls as the platform allows.
+    // Returns the number of datagrams sent, which is less than 'n' only on error
+    int sendPackets(const UDPMAddress& dest, const PacketIov *pkts, int n);
 
     static bool checkConnection(const string& ip, u16 port);
     void checkAndWarnAboutSmallBuffer(size_t datalen, size_t kbufsize);
 
-    static UDPMSocket createSendSocket(struct in_addr multiaddr, u8 ttl);
-    static UDPMSocket createRecvSocket(struct in_addr multiaddr, u16 port);
+    // A 'bufsize' of 0 keeps the system's default kernel buffer size
+    static UDPMSocket createSendSocket(struct in_addr multiaddr, u8 ttl, size_t bufsize);
+    static UDPMSocket createRecvSocket(struct in_addr multiaddr, u16 port, size_t bufsize);
 
   private:
     SOCKET fd = -1;
     bool warnedAboutSmallBuffer = false;
 
+#ifdef __linux__
+    // Scratch space for recvmmsg() / sendmmsg(), reused between calls
+    static const size_t CONTROL_SIZE = 64;
+    vector<struct mmsghdr> recvHdrs;
+    vector<struct iovec> recvIovs;
+    vector<char> recvControl;
+    vector<struct mmsghdr> sendHdrs;
+#endif
+
   private:
     // Disallow copies
     UDPMSocket(const UDPMSocket&) = delete;
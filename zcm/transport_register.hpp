@@ -10,4 +10,11 @@ struct TransportRegister {
     }
 };
 
+struct TransportExtRegister {
+    TransportExtRegister(const zcm_trans_methods_t *vtbl, const zcm_trans_ext_methods_t *ext)
+    {
+        zcm_transport_register_ext(vtbl, ext);
+    }
+};
+
 #endif  /* _ZCM_TRANS_REGISTER_H */
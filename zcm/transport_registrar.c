@@ -25,6 +25,35 @@ bool zcm_transport_register(const char *name, const char *desc, zcm_trans_create
     return true;
 }
 
+static const zcm_trans_methods_t *e_vtbl[ZCM_TRANSPORTS_MAX];
+static const zcm_trans_ext_methods_t *e_ext[ZCM_TRANSPORTS_MAX];
+static size_t e_index = 0;
+
+bool zcm_transport_register_ext(const zcm_trans_methods_t *vtbl, const zcm_trans_ext_methods_t *ext)
+{
+    // Is this vtbl already registered?
+    for (size_t i = 0; i < e_index; i++)
+        if (e_vtbl[i] == vtbl)
+            return false;
+
+    if (e_index >= ZCM_TRANSPORTS_MAX)
+        return false;
+
+    e_vtbl[e_index] = vtbl;
+    e_ext[e_index] = ext;
+    e_index++;
+
+    return true;
+}
+
+const zcm_trans_ext_methods_t *zcm_transport_find_ext(const zcm_trans_t *zt)
+{
+    for (size_t i = 0; i < e_index; i++)
+        if (e_vtbl[i] == zt->vtbl)
+            return e_ext[i];
+    return NULL;
+}
+
 zcm_trans_create_func *zcm_transport_find(const char *name)
 {
     for (size_t i = 0; i < t_index; i++)
@@ -3,6 +3,7 @@
 
 #include "zcm/transport.h"
 #include "zcm/url.h"
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -14,6 +15,28 @@ bool zcm_transport_register(const char *name, const char *desc, zcm_trans_create
 zcm_trans_create_func *zcm_transport_find(const char *name);
 void zcm_transport_help(FILE *f);
 
+/* Registers the optional methods of every transport whose vtbl is 'vtbl' (see transport.h).
+ * Both tables must outlive the transports using them */
+bool zcm_transport_register_ext(const zcm_trans_methods_t *vtbl, const zcm_trans_ext_methods_t *ext);
+const zcm_trans_ext_methods_t *zcm_transport_find_ext(const zcm_trans_t *zt);
+
+/* True if 'ext' is long enough to hold 'method' and has it set */
+#define ZCM_TRANS_HAS_EXT(ext, method) \
+    ((ext) && (ext)->size >= offsetof(zcm_trans_ext_methods_t, method) + sizeof((ext)->method) && \
+     (ext)->method)
+
+static INLINE int zcm_trans_flush(zcm_trans_t *zt)
+{
+    const zcm_trans_ext_methods_t *ext = zcm_transport_find_ext(zt);
+    return ZCM_TRANS_HAS_EXT(ext, flush) ? ext->flush(zt) : ZCM_EOK;
+}
+
+static INLINE int zcm_trans_set_receiving(zcm_trans_t *zt, bool receiving)
+{
+    const zcm_trans_ext_methods_t *ext = zcm_transport_find_ext(zt);
+    return ZCM_TRANS_HAS_EXT(ext, set_receiving) ? ext->set_receiving(zt, receiving) : ZCM_EOK;
+}
+
 /* TODO: consider adding function that returns the names of all registered transports */
 /* TODO: consider adding another file that forces static registration when this is used in a
  *       static library. Some design issues with C++ static object factory style code are
@@ -0,0 +1,502 @@
+#include "zcm/util/aio_writer.h"
+#include "zcm/util/debug.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define HAVE_IO_URING
+#endif
+#endif
+#endif
+
+using namespace std;
+
+// Alignment of buffers, and of file offsets and lengths under O_DIRECT
+static const size_t ALIGN = 4096;
+
+struct Buffer
+{
+    uint8_t* data      = nullptr;
+    size_t   len       = 0;      // bytes filled
+    off_t    off       = 0;      // where data[0] goes in the file
+
+    // while in flight
+    size_t   submitLen = 0;      // len padded out to whole blocks under O_DIRECT
+    size_t   done      = 0;
+    bool     sync      = false;  // fdatasync once written
+    int      err       = 0;
+    unsigned pending   = 0;      // io_uring completions still to come
+    struct iovec iov;
+};
+
+// Writes buffers out in the background. submit() hands a buffer over and reap() blocks
+// until it can hand back one that has been written, with err set if that failed.
+struct Backend
+{
+    virtual ~Backend() {}
+    virtual const char* name() const = 0;
+    virtual void submit(Buffer* b) = 0;
+    virtual Buffer* reap() = 0;
+};
+
+static void writeOut(int fd, Buffer* b)
+{
+    while (b->done < b->submitLen) {
+        ssize_t n = pwrite(fd, b->data + b->done, b->submitLen - b->done, b->off + b->done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            b->err = n < 0 ? errno : EIO;
+            return;
+        }
+        b->done += n;
+    }
+    if (b->sync && fdatasync(fd) != 0) b->err = errno;
+}
+
+struct ThreadsBackend : public Backend
+{
+    int fd;
+    mutex mut;
+    condition_variable pendingCond, completedCond;
+    deque<Buffer*> pending, completed;
+    vector<thread> threads;
+    bool stop = false;
+
+    ThreadsBackend(int fd, unsigned nthreads) : fd(fd)
+    {
+        for (unsigned i = 0; i < nthreads; ++i)
+            threads.emplace_back(&ThreadsBackend::run, this);
+    }
+
+    ~ThreadsBackend()
+    {
+        {
+            unique_lock<mutex> lk(mut);
+            stop = true;
+        }
+        pendingCond.notify_all();
+        for (auto& t : threads) t.join();
+    }
+
+    const char* name() const override { return "threads"; }
+
+    void submit(Buffer* b) override
+    {
+        {
+            unique_lock<mutex> lk(mut);
+            pending.push_back(b);
+        }
+        pendingCond.notify_one();
+    }
+
+    Buffer* reap() override
+    {
+        unique_lock<mutex> lk(mut);
+        completedCond.wait(lk, [&](){ return !completed.empty(); });
+        Buffer* b = completed.front();
+        completed.pop_front();
+        return b;
+    }
+
+    void run()
+    {
+        while (true) {
+            Buffer* b;
+            {
+                unique_lock<mutex> lk(mut);
+                pendingCond.wait(lk, [&](){ return stop || !pending.empty(); });
+                if (pending.empty()) return;
+                b = pending.front();
+                pending.pop_front();
+            }
+            writeOut(fd, b);
+            {
+                unique_lock<mutex> lk(mut);
+                completed.push_back(b);
+            }
+            completedCond.notify_one();
+        }
+    }
+};
+
+#ifdef HAVE_IO_URING
+// Talks to the kernel through the raw syscalls and ring layout of <linux/io_uring.h>,
+// so there is no dependency on liburing
+struct IoUringBackend : public Backend
+{
+    int fd;
+    int ringfd = -1;
+
+    void*  sqMap = MAP_FAILED;
+    size_t sqMapLen = 0;
+    void*  cqMap = MAP_FAILED;
+    size_t cqMapLen = 0;
+    struct io_uring_sqe* sqes = (struct io_uring_sqe*) MAP_FAILED;
+    size_t sqesLen = 0;
+
+    unsigned *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_cqe* cqes;
+    unsigned queued = 0;       // filled in, but not yet visible to the kernel
+    unsigned unsubmitted = 0;  // visible, but not yet passed to io_uring_enter
+
+    ~IoUringBackend()
+    {
+        if (sqes != MAP_FAILED) munmap(sqes, sqesLen);
+        if (cqMap != MAP_FAILED && cqMap != sqMap) munmap(cqMap, cqMapLen);
+        if (sqMap != MAP_FAILED) munmap(sqMap, sqMapLen);
+        if (ringfd >= 0) close(ringfd);
+    }
+
+    // Returns nullptr if the kernel doesn't support io_uring or won't let us use it
+    static IoUringBackend* create(int fd, unsigned nbufs)
+    {
+        // Each buffer in flight needs a write and maybe an fsync
+        unsigned entries = 1;
+        while (entries < 2 * nbufs) entries *= 2;
+
+        unique_ptr<IoUringBackend> ret(new IoUringBackend());
+        ret->fd = fd;
+
+        struct io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        ret->ringfd = (int) syscall(__NR_io_uring_setup, entries, &p);
+        if (ret->ringfd < 0) {
+            ZCM_DEBUG("io_uring unavailable: %s", strerror(errno));
+            return nullptr;
+        }
+
+        ret->sqMapLen = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        ret->cqMapLen = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        bool singleMap = false;
+#ifdef IORING_FEAT_SINGLE_MMAP
+        singleMap = p.features & IORING_FEAT_SINGLE_MMAP;
+#endif
+        if (singleMap) ret->sqMapLen = ret->cqMapLen = max(ret->sqMapLen, ret->cqMapLen);
+
+        ret->sqMap = mmap(nullptr, ret->sqMapLen, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ret->ringfd, IORING_OFF_SQ_RING);
+        if (ret->sqMap == MAP_FAILED) return nullptr;
+        ret->cqMap = singleMap ? ret->sqMap :
+                     mmap(nullptr, ret->cqMapLen, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ret->ringfd, IORING_OFF_CQ_RING);
+        if (ret->cqMap == MAP_FAILED) return nullptr;
+        ret->sqesLen = p.sq_entries * sizeof(struct io_uring_sqe);
+        ret->sqes = (struct io_uring_sqe*) mmap(nullptr, ret->sqesLen,
+                                                PROT_READ | PROT_WRITE,
+                                                MAP_SHARED | MAP_POPULATE,
+                                                ret->ringfd, IORING_OFF_SQES);
+        if (ret->sqes == MAP_FAILED) return nullptr;
+
+        char* sq = (char*) ret->sqMap;
+        ret->sqTail  = (unsigned*) (sq + p.sq_off.tail);
+        ret->sqMask  = (unsigned*) (sq + p.sq_off.ring_mask);
+        ret->sqArray = (unsigned*) (sq + p.sq_off.array);
+        char* cq = (char*) ret->cqMap;
+        ret->cqHead  = (unsigned*) (cq + p.cq_off.head);
+        ret->cqTail  = (unsigned*) (cq + p.cq_off.tail);
+        ret->cqMask  = (unsigned*) (cq + p.cq_off.ring_mask);
+        ret->cqes    = (struct io_uring_cqe*) (cq + p.cq_off.cqes);
+
+        return ret.release();
+    }
+
+    const char* name() const override { return "io_uring"; }
+
+    struct io_uring_sqe* nextSqe()
+    {
+        // Only this thread moves the tail, and the ring has room for every request
+        // that can be in flight, so there's always an entry free
+        unsigned idx = (*sqTail + queued++) & *sqMask;
+        sqArray[idx] = idx;
+        memset(&sqes[idx], 0, sizeof(sqes[idx]));
+        return &sqes[idx];
+    }
+
+    void publish()
+    {
+        __atomic_store_n(sqTail, *sqTail + queued, __ATOMIC_RELEASE);
+        unsubmitted += queued;
+        queued = 0;
+    }
+
+    void enter(unsigned minComplete)
+    {
+        unsigned flags = minComplete ? IORING_ENTER_GETEVENTS : 0;
+        while (true) {
+            int ret = (int) syscall(__NR_io_uring_enter, ringfd, unsubmitted, minComplete,
+                                    flags, nullptr, 0);
+            if (ret >= 0) {
+                unsubmitted -= min((unsigned) ret, unsubmitted);
+                return;
+            }
+            // Nothing is lost, whatever wasn't submitted goes with the next call
+            if (errno != EINTR || minComplete == 0) return;
+        }
+    }
+
+    void queue(Buffer* b)
+    {
+        // The fsync is linked to the write so that it only runs once the write is done
+        b->iov.iov_base = b->data + b->done;
+        b->iov.iov_len = b->submitLen - b->done;
+        struct io_uring_sqe* sqe = nextSqe();
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t) (uintptr_t) &b->iov;
+        sqe->len = 1;
+        sqe->off = b->off + b->done;
+        sqe->user_data = (uint64_t) (uintptr_t) b;
+        b->pending++;
+
+        if (b->sync) {
+            sqe->flags |= IOSQE_IO_LINK;
+            sqe = nextSqe();
+            sqe->opcode = IORING_OP_FSYNC;
+            sqe->fd = fd;
+            sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+            // Buffers are aligned, which frees the low bit to mark the fsync
+            sqe->user_data = (uint64_t) (uintptr_t) b | 1;
+            b->pending++;
+        }
+        publish();
+    }
+
+    void submit(Buffer* b) override
+    {
+        queue(b);
+        enter(0);
+    }
+
+    Buffer* reap() override
+    {
+        while (true) {
+            unsigned head = *cqHead;
+            if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                enter(1);
+                continue;
+            }
+
+            struct io_uring_cqe cqe = cqes[head & *cqMask];
+            __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+
+            Buffer* b = (Buffer*) (uintptr_t) (cqe.user_data & ~(uint64_t) 1);
+            if (cqe.user_data & 1) {
+                // A short write cancels its fsync, which is queued again with the rest
+                if (cqe.res < 0 && cqe.res != -ECANCELED && !b->err) b->err = -cqe.res;
+            } else if (cqe.res <= 0) {
+                if (!b->err) b->err = cqe.res < 0 ? -cqe.res : EIO;
+            } else {
+                b->done += cqe.res;
+                if (b->done < b->submitLen && !b->err) {
+                    queue(b);
+                    enter(0);
+                }
+            }
+
+            if (--b->pending == 0) return b;
+        }
+    }
+};
+#endif
+
+struct zcm_aio_writer_t
+{
+    int fd;
+    int fdFlags;
+    bool direct = false;
+    size_t bufsize;
+    uint64_t syncBytes;
+    uint64_t unsynced = 0;
+
+    vector<Buffer> bufs;
+    vector<Buffer*> freeBufs;
+    Buffer* cur = nullptr;
+    unsigned inflight = 0;
+    int err = 0;
+    unique_ptr<Backend> backend;
+
+    ~zcm_aio_writer_t()
+    {
+        backend.reset();
+        for (auto& b : bufs) free(b.data);
+    }
+
+    void reapOne()
+    {
+        Buffer* b = backend->reap();
+        inflight--;
+        if (b->err && !err) err = b->err;
+        freeBufs.push_back(b);
+    }
+
+    int fail()
+    {
+        errno = err;
+        return -1;
+    }
+
+    // Hands the filled buffer to the backend, and continues in a free one
+    int submitCurrent()
+    {
+        Buffer* b = cur;
+        b->submitLen = b->len;
+        if (direct) {
+            b->submitLen = (b->len + ALIGN - 1) & ~(ALIGN - 1);
+            memset(b->data + b->len, 0, b->submitLen - b->len);
+        }
+        b->done = 0;
+        b->err = 0;
+        unsynced += b->len;
+        b->sync = syncBytes && unsynced >= syncBytes;
+        if (b->sync) unsynced = 0;
+        backend->submit(b);
+        inflight++;
+
+        if (freeBufs.empty()) reapOne();
+        cur = freeBufs.back();
+        freeBufs.pop_back();
+        cur->off = b->off + b->len;
+        cur->len = 0;
+        return err ? fail() : 0;
+    }
+};
+
+zcm_aio_writer_t* zcm_aio_writer_create(int fd, size_t bufsize, unsigned nbufs,
+                                        unsigned nthreads, bool direct, bool useIoUring,
+                                        uint64_t syncBytes)
+{
+    off_t end = lseek(fd, 0, SEEK_END);
+    int flags = fcntl(fd, F_GETFL);
+    if (end < 0 || flags < 0) return nullptr;
+
+    unique_ptr<zcm_aio_writer_t> w(new zcm_aio_writer_t());
+    w->fd = fd;
+    w->fdFlags = flags;
+    w->bufsize = (max(bufsize, ALIGN) + ALIGN - 1) & ~(ALIGN - 1);
+    w->syncBytes = syncBytes;
+
+    w->bufs.resize(max(nbufs, 2u));
+    for (auto& b : w->bufs) {
+        if (posix_memalign((void**) &b.data, ALIGN, w->bufsize) != 0) {
+            b.data = nullptr;
+            return nullptr;
+        }
+        w->freeBufs.push_back(&b);
+    }
+    w->cur = w->freeBufs.back();
+    w->freeBufs.pop_back();
+    w->cur->off = end;
+
+    // Linux ignores pwrite's offset on an O_APPEND fd, which would put the rewrite of
+    // a partial block after its padding, so appending is turned off until destroy
+    if ((flags & O_APPEND) && fcntl(fd, F_SETFL, flags & ~O_APPEND) != 0) return nullptr;
+    flags &= ~O_APPEND;
+
+#ifdef O_DIRECT
+    // O_DIRECT only takes whole blocks, and there's no reading back what's already in
+    // a partial last one from a write only fd
+    if (direct) {
+        if ((end & (ALIGN - 1)) != 0)
+            ZCM_DEBUG("Not using O_DIRECT: file doesn't end on a %zu byte boundary", ALIGN);
+        else if (fcntl(fd, F_SETFL, flags | O_DIRECT) != 0)
+            ZCM_DEBUG("Not using O_DIRECT: %s", strerror(errno));
+        else
+            w->direct = true;
+    }
+#endif
+
+#ifdef HAVE_IO_URING
+    if (useIoUring) w->backend.reset(IoUringBackend::create(fd, w->bufs.size()));
+#endif
+    if (!w->backend) w->backend.reset(new ThreadsBackend(fd, max(nthreads, 1u)));
+    ZCM_DEBUG("Writing through %s with %zu buffers of %zu bytes%s", w->backend->name(),
+              w->bufs.size(), w->bufsize, w->direct ? " and O_DIRECT" : "");
+
+    return w.release();
+}
+
+int zcm_aio_writer_write(zcm_aio_writer_t* w, const void* data, size_t len)
+{
+    if (w->err) return w->fail();
+
+    const uint8_t* p = (const uint8_t*) data;
+    while (len > 0) {
+        Buffer* b = w->cur;
+        size_t n = min(len, w->bufsize - b->len);
+        memcpy(b->data + b->len, p, n);
+        b->len += n;
+        p += n;
+        len -= n;
+        if (b->len == w->bufsize && w->submitCurrent() != 0) return -1;
+    }
+    return 0;
+}
+
+int zcm_aio_writer_flush(zcm_aio_writer_t* w, bool sync)
+{
+    if (w->err) return w->fail();
+
+    Buffer* b = w->cur;
+    if (b->len > 0) {
+        size_t len = b->len;
+        size_t tail = w->direct ? len % ALIGN : 0;
+        if (w->submitCurrent() != 0) return -1;
+        // The partial block just written, padded out, is written again from the next
+        // buffer along with whatever follows it. That can't race the padded write, as
+        // nothing else is submitted until it is done below. The next buffer may be this
+        // one again if it was written already.
+        if (tail) {
+            memmove(w->cur->data, b->data + len - tail, tail);
+            w->cur->off -= tail;
+            w->cur->len = tail;
+        }
+    }
+
+    while (w->inflight > 0) w->reapOne();
+    if (sync && !w->err && fdatasync(w->fd) != 0) w->err = errno;
+    return w->err ? w->fail() : 0;
+}
+
+int zcm_aio_writer_destroy(zcm_aio_writer_t* w)
+{
+    int ret = zcm_aio_writer_flush(w, false);
+    int err = errno;
+
+    off_t end = w->cur->off + w->cur->len;
+    if (w->direct && ftruncate(w->fd, end) != 0 && ret == 0) {
+        ret = -1;
+        err = errno;
+    }
+    fcntl(w->fd, F_SETFL, w->fdFlags);
+    lseek(w->fd, end, SEEK_SET);
+
+    delete w;
+    errno = err;
+    return ret;
+}
+
+const char* zcm_aio_writer_backend(const zcm_aio_writer_t* w)
+{
+    return w->backend->name();
+}
@@ -0,0 +1,43 @@
+#ifndef ZCM_AIO_WRITER
+#define ZCM_AIO_WRITER
+
+// This is an API for appending to a file through a few large, aligned buffers that
+// are written out in the background while the next one fills up. Buffers go out
+// through io_uring where the kernel offers it, and through a pool of threads calling
+// pwrite otherwise. The event log's asynchronous write mode is built on it.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct zcm_aio_writer_t zcm_aio_writer_t;
+
+// Appends to the end of 'fd', which must stay open until the writer is destroyed and
+// must not be written to by anything else meanwhile. 'bufsize' is rounded up to a
+// multiple of 4 KiB. With 'direct', fd is switched to O_DIRECT if the file system
+// allows it. With 'syncBytes', fdatasync is called each time that many bytes have
+// been written. O_APPEND, if set, is cleared until the writer is destroyed, as it
+// would make pwrite ignore its offset. Returns NULL on failure.
+zcm_aio_writer_t* zcm_aio_writer_create(int fd, size_t bufsize, unsigned nbufs,
+                                        unsigned nthreads, bool direct, bool useIoUring,
+                                        uint64_t syncBytes);
+
+// These return 0 on success, or -1 with errno set if they or any earlier write failed
+int zcm_aio_writer_write(zcm_aio_writer_t* w, const void* data, size_t len);
+// Waits until everything written so far is in the file, and on disk with 'sync'
+int zcm_aio_writer_flush(zcm_aio_writer_t* w, bool sync);
+// Flushes, trims the padding O_DIRECT needed off the end of the file and frees 'w'
+int zcm_aio_writer_destroy(zcm_aio_writer_t* w);
+
+// "io_uring" or "threads"
+const char* zcm_aio_writer_backend(const zcm_aio_writer_t* w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <condition_variable>
+
+#include "zcm/zcm.h"
+
+// A preallocated ring of variable length records, filled by any number of threads and
+// drained by one. A producer claims space with a single compare-and-swap, copies its
+// record straight into the ring and commits it; when there isn't room it gets nothing
+// back instead of waiting, so it can drop the record. The consumer is handed records
+// in place, a run that is contiguous in memory at a time, and frees the run at once.
+// Note: records become visible in the order their space was claimed, so a producer
+//       commits only after every producer that claimed space before it. With a
+//       single producer that never waits.
+// Note: a record may take up at most half the ring, so one always fits once the
+//       consumer has caught up
+class ByteRing
+{
+    static constexpr size_t   CACHE_LINE = 64;
+    static constexpr size_t   ALIGN      = 8;
+    static constexpr uint32_t PADDING    = 0xffffffff;
+    static constexpr int      SPIN_ITERS = 256;
+
+    // Precedes every record. A length of PADDING marks the unused end of the buffer
+    // left by a record that didn't fit there and was placed at the start instead.
+    struct Header
+    {
+        uint32_t len;
+        uint32_t unused;
+    };
+
+    uint8_t* buf;
+    size_t   capacity;
+
+    // Byte positions only ever increase; they are taken modulo capacity to index buf
+
+    // Producer-owned
+    char pad0[CACHE_LINE];
+    std::atomic<uint64_t> head {0};       // end of the space claimed so far
+    char pad1[CACHE_LINE];
+    std::atomic<uint64_t> committed {0};  // end of the records the consumer may read
+
+    // Consumer-owned
+    char pad2[CACHE_LINE];
+    std::atomic<uint64_t> tail {0};       // start of the records not yet drained
+
+    // Parking (slow path only)
+    char pad3[CACHE_LINE];
+    std::mutex mut;
+    std::condition_variable cond;
+    std::atomic<bool> consumerParked {false};
+    bool woken = false;
+
+    static size_t recordSize(size_t len)
+    {
+        return (sizeof(Header) + len + ALIGN - 1) & ~(ALIGN - 1);
+    }
+
+    bool canDrain() const
+    {
+        return tail.load(std::memory_order_relaxed) !=
+               committed.load(std::memory_order_acquire);
+    }
+
+  public:
+    struct Reservation
+    {
+        uint8_t* data = nullptr;  // where to write the record, null if there was no room
+        uint64_t start = 0, end = 0;
+    };
+
+    // 'capacity' is rounded up to a multiple of 8 bytes
+    ByteRing(size_t capacity) : capacity((capacity + ALIGN - 1) & ~(ALIGN - 1))
+    {
+        buf = new uint8_t[this->capacity];
+        ZCM_ASSERT(buf);
+    }
+
+    ~ByteRing() { delete[] buf; }
+
+    size_t getCapacity() const { return capacity; }
+
+    // The longest record that can ever be reserved
+    size_t maxRecordLen() const { return ((capacity / 2) & ~(ALIGN - 1)) - sizeof(Header); }
+
+    // Bytes claimed by producers and not yet freed by the consumer
+    size_t bytesUsed() const
+    {
+        return head.load(std::memory_order_relaxed) - tail.load(std::memory_order_relaxed);
+    }
+
+    // Claims room for a record of 'len' bytes. Every reservation with non-null data
+    // must be committed, and soon: later records wait for it.
+    Reservation reserve(size_t len)
+    {
+        Reservation r;
+        size_t need = recordSize(len);
+        if (need > capacity / 2) return r;
+
+        uint64_t h = head.load(std::memory_order_relaxed);
+        uint64_t total;
+        do {
+            size_t pos = h % capacity;
+            total = pos + need > capacity ? capacity - pos + need : need;
+            if (h + total - tail.load(std::memory_order_acquire) > capacity) return r;
+        } while (!head.compare_exchange_weak(h, h + total, std::memory_order_relaxed));
+
+        size_t pos = h % capacity;
+        if (pos + need > capacity) {
+            ((Header*) (buf + pos))->len = PADDING;
+            pos = 0;
+        }
+        ((Header*) (buf + pos))->len = (uint32_t) len;
+
+        r.data = buf + pos + sizeof(Header);
+        r.start = h;
+        r.end = h + total;
+        return r;
+    }
+
+    // Hands a reserved record to the consumer
+    void commit(const Reservation& r)
+    {
+        for (int i = 0; committed.load(std::memory_order_acquire) != r.start; ++i)
+            if (i >= SPIN_ITERS) std::this_thread::yield();
+        committed.store(r.end, std::memory_order_release);
+
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!consumerParked.load(std::memory_order_relaxed)) return;
+        { std::unique_lock<std::mutex> lk(mut); }
+        cond.notify_all();
+    }
+
+    // Calls f(data, len) on the committed records from the read position onwards, in
+    // order, stopping at the end of the buffer or once 'maxBytes' have been passed over,
+    // and then frees all of them. Returns the number of records.
+    template<class F>
+    size_t drain(F f, size_t maxBytes = SIZE_MAX)
+    {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        uint64_t start = t;
+        uint64_t end = committed.load(std::memory_order_acquire);
+        size_t n = 0;
+        while (t < end && t - start < maxBytes) {
+            size_t pos = t % capacity;
+            const Header* hdr = (const Header*) (buf + pos);
+            if (hdr->len == PADDING) {
+                t += capacity - pos;
+                if (n) break;
+                start = t;
+                continue;
+            }
+            f(buf + pos + sizeof(Header), (size_t) hdr->len);
+            t += recordSize(hdr->len);
+            n++;
+            if (t % capacity == 0) break;
+        }
+        tail.store(t, std::memory_order_release);
+        return n;
+    }
+
+    // Waits, spinning briefly before parking, until there is something to drain or
+    // wakeup() is called
+    void wait()
+    {
+        for (int i = 0; i < SPIN_ITERS; ++i) {
+            if (canDrain()) return;
+            if (i >= SPIN_ITERS / 2) std::this_thread::yield();
+        }
+
+        std::unique_lock<std::mutex> lk(mut);
+        consumerParked.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cond.wait(lk, [&](){ return woken || canDrain(); });
+        consumerParked.store(false, std::memory_order_relaxed);
+        woken = false;
+    }
+
+    // Forcefully wakes up wait()
+    void wakeup()
+    {
+        std::unique_lock<std::mutex> lk(mut);
+        woken = true;
+        cond.notify_all();
+    }
+
+  private:
+    ByteRing(const ByteRing& other) = delete;
+    ByteRing(ByteRing&& other) = delete;
+    ByteRing& operator=(const ByteRing& other) = delete;
+    ByteRing& operator=(ByteRing&& other) = delete;
+};
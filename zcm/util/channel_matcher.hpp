@@ -0,0 +1,239 @@
+#pragma once
+
+#include <regex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+#include "zcm/zcm.h"
+#include "zcm/zcm_private.h"
+
+// Resolves a channel name to the subscriptions that want it.
+// Subscriptions are split by kind when they are added:
+//   - exact channels go into a hash map
+//   - "PREFIX.*" patterns (the overwhelmingly common regex) go into a prefix trie
+//   - anything else falls back to the std::regex stored in zcm_sub_t::regexobj
+// Exact subscriptions are reported first, followed by every pattern subscription
+// in the order it was added, which matches the historical dispatch order.
+// Note: nothing in here is thread-safe. Pair it with a ChannelMatchCache per
+//       reading thread so steady-state lookups never reach match()
+class ChannelMatcher
+{
+  public:
+    using SubList = std::vector<zcm_sub_t*>;
+
+    static bool isRegexChannel(const std::string& channel)
+    {
+        // These chars are considered regex
+        auto isRegexChar = [](char c) {
+            return c == '(' || c == ')' || c == '|' ||
+            c == '.' || c == '*' || c == '+';
+        };
+
+        for (auto& c : channel)
+            if (isRegexChar(c))
+                return true;
+
+        return false;
+    }
+
+    // Returns true and fills 'prefix' if the regex is exactly "<literal>.*"
+    static bool isPrefixRegex(const std::string& channel, std::string& prefix)
+    {
+        auto isSpecial = [](char c) {
+            return c == '.' || c == '*' || c == '+' || c == '?' || c == '(' || c == ')' ||
+                   c == '[' || c == ']' || c == '{' || c == '}' || c == '|' || c == '^' ||
+                   c == '$' || c == '\\';
+        };
+
+        size_t len = channel.size();
+        if (len < 2 || channel[len - 2] != '.' || channel[len - 1] != '*') return false;
+        for (size_t i = 0; i < len - 2; ++i)
+            if (isSpecial(channel[i])) return false;
+
+        prefix = channel.substr(0, len - 2);
+        return true;
+    }
+
+  private:
+    struct Pattern
+    {
+        zcm_sub_t* sub;
+        uint64_t   seq;
+    };
+
+    struct TrieNode
+    {
+        std::vector<std::pair<char, size_t>> children;
+        std::vector<Pattern> subs;
+    };
+
+    std::unordered_map<std::string, SubList> exact;
+    std::vector<TrieNode> trie {1}; // node 0 is the root (the ".*" prefix)
+    std::vector<Pattern> regexes;
+    size_t numPatterns = 0;
+    uint64_t nextSeq = 0;
+    uint64_t gen = 0;
+
+    size_t findChild(size_t node, char c) const
+    {
+        for (auto& child : trie[node].children)
+            if (child.first == c) return child.second;
+        return 0;
+    }
+
+    static bool removePattern(std::vector<Pattern>& v, zcm_sub_t* sub)
+    {
+        for (size_t i = 0; i < v.size(); ++i) {
+            if (v[i].sub == sub) {
+                v.erase(v.begin() + i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+  public:
+    // Bumped on every add() and remove() so caches know when to flush
+    uint64_t generation() const { return gen; }
+
+    // Number of regex (prefix or general) subscriptions
+    size_t numRegex() const { return numPatterns; }
+
+    void add(zcm_sub_t* sub)
+    {
+        ++gen;
+        if (!sub->regex) {
+            exact[sub->channel].push_back(sub);
+            return;
+        }
+
+        ++numPatterns;
+        Pattern p {sub, nextSeq++};
+
+        std::string prefix;
+        if (!isPrefixRegex(sub->channel, prefix)) {
+            regexes.push_back(p);
+            return;
+        }
+
+        size_t node = 0;
+        for (char c : prefix) {
+            size_t next = findChild(node, c);
+            if (next == 0) {
+                next = trie.size();
+                trie[node].children.emplace_back(c, next);
+                trie.emplace_back();
+            }
+            node = next;
+        }
+        trie[node].subs.push_back(p);
+    }
+
+    // Returns false if the subscription was not found. On success 'nleft' holds the
+    // number of remaining subscriptions of the same kind (same exact channel, or any regex)
+    bool remove(zcm_sub_t* sub, size_t& nleft)
+    {
+        if (!sub->regex) {
+            auto it = exact.find(sub->channel);
+            if (it == exact.end()) return false;
+            SubList& slist = it->second;
+            auto sit = std::find(slist.begin(), slist.end(), sub);
+            if (sit == slist.end()) return false;
+            slist.erase(sit);
+            nleft = slist.size();
+            if (slist.empty()) exact.erase(it);
+            ++gen;
+            return true;
+        }
+
+        std::string prefix;
+        bool found = false;
+        if (isPrefixRegex(sub->channel, prefix)) {
+            size_t node = 0;
+            for (char c : prefix) {
+                node = findChild(node, c);
+                if (node == 0) return false;
+            }
+            found = removePattern(trie[node].subs, sub);
+        } else {
+            found = removePattern(regexes, sub);
+        }
+        if (!found) return false;
+
+        nleft = --numPatterns;
+        ++gen;
+        return true;
+    }
+
+    // Appends every subscription whose channel matches to 'out'
+    void match(const char* channel, SubList& out) const
+    {
+        auto it = exact.find(channel);
+        if (it != exact.end()) out.insert(out.end(), it->second.begin(), it->second.end());
+
+        if (numPatterns == 0) return;
+
+        std::vector<Pattern> matched;
+
+        // Walk the trie collecting every prefix that this channel starts with.
+        // ".*" cannot match across a line terminator, so neither can we.
+        bool hasNewline = strpbrk(channel, "\r\n") != nullptr;
+        size_t node = 0;
+        const char* c = channel;
+        while (true) {
+            if (!hasNewline)
+                matched.insert(matched.end(), trie[node].subs.begin(), trie[node].subs.end());
+            if (*c == '\0') break;
+            node = findChild(node, *c++);
+            if (node == 0) break;
+        }
+        if (hasNewline && node != 0 && *c == '\0') {
+            // The whole channel was consumed, so ".*" only has to match the empty string
+            matched.insert(matched.end(), trie[node].subs.begin(), trie[node].subs.end());
+        }
+
+        for (auto& p : regexes)
+            if (std::regex_match(channel, *(std::regex*)p.sub->regexobj))
+                matched.push_back(p);
+
+        std::sort(matched.begin(), matched.end(),
+                  [](const Pattern& a, const Pattern& b) { return a.seq < b.seq; });
+        for (auto& p : matched) out.push_back(p.sub);
+    }
+};
+
+// Memoizes ChannelMatcher::match() per channel. Flushed automatically whenever the
+// matcher's generation changes, and bounded so that a flood of distinct channel
+// names cannot grow it forever.
+class ChannelMatchCache
+{
+    static constexpr size_t MAX_ENTRIES = 1024;
+
+    std::unordered_map<std::string, ChannelMatcher::SubList> cache;
+    uint64_t gen = UINT64_MAX;
+    std::string key; // reused to avoid allocating on every lookup
+
+  public:
+    // The returned reference is valid until the next call to lookup()
+    const ChannelMatcher::SubList& lookup(const ChannelMatcher& matcher, const char* channel)
+    {
+        if (gen != matcher.generation()) {
+            cache.clear();
+            gen = matcher.generation();
+        }
+
+        key.assign(channel);
+        auto it = cache.find(key);
+        if (it != cache.end()) return it->second;
+
+        if (cache.size() >= MAX_ENTRIES) cache.clear();
+
+        auto& subs = cache[key];
+        matcher.match(channel, subs);
+        return subs;
+    }
+};
@@ -0,0 +1,181 @@
+#include "zcm/util/lz4.hpp"
+#include "zcm/zcm.h"
+
+#include <cstring>
+
+using u8  = uint8_t;
+using u16 = uint16_t;
+using u32 = uint32_t;
+
+// Limits of the block format
+#define MIN_MATCH     4
+#define LAST_LITERALS 5     // a block always ends with at least this many literals
+#define MF_LIMIT      12    // ... and no match starts closer than this to its end
+#define MAX_DISTANCE  65535
+
+#define HASH_LOG      12
+// Every this many bytes without a match, the search skips one more byte at a time
+#define SKIP_TRIGGER  6
+
+static inline u32 read32(const u8* p)
+{
+    u32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline u32 hash(u32 seq)
+{ return (seq * 2654435761u) >> (32 - HASH_LOG); }
+
+// The bytes a length past the 4 bits of the token takes
+static inline size_t lengthBytes(size_t len)
+{ return len < 15 ? 0 : (len - 15) / 255 + 1; }
+
+static inline void writeLength(u8*& op, size_t len)
+{
+    for (len -= 15; len >= 255; len -= 255)
+        *op++ = 255;
+    *op++ = (u8)len;
+}
+
+// Note: on success, 'len' has the rest of the length added to it
+static inline bool readLength(const u8*& ip, const u8* iend, size_t& len)
+{
+    u8 b;
+    do {
+        if (ip == iend) return false;
+        b = *ip++;
+        len += b;
+    } while (b == 255);
+    return true;
+}
+
+size_t lz4Bound(size_t len)
+{ return len + len / 255 + 16; }
+
+int lz4Compress(const uint8_t* src, size_t len, uint8_t* dst, size_t* dstlen)
+{
+    const u8* ip = src;
+    const u8* anchor = src;
+    const u8* iend = src + len;
+    u8* op = dst;
+    u8* oend = dst + *dstlen;
+
+    // positions in 'src' of the last 4-byte sequences seen, by hash
+    u32 table[1 << HASH_LOG];
+    memset(table, 0, sizeof(table));
+
+    if (len > MF_LIMIT) {
+        const u8* mflimit = iend - MF_LIMIT;
+        const u8* matchlimit = iend - LAST_LITERALS;
+
+        ip++;
+        while (ip < mflimit) {
+            u32 seq = read32(ip);
+            u32 h = hash(seq);
+            const u8* ref = src + table[h];
+            table[h] = (u32)(ip - src);
+            if (ref >= ip || ip - ref > MAX_DISTANCE || read32(ref) != seq) {
+                ip += 1 + ((ip - anchor) >> SKIP_TRIGGER);
+                continue;
+            }
+
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+            const u8* mend = ip + MIN_MATCH;
+            const u8* rend = ref + MIN_MATCH;
+            while (mend < matchlimit && *mend == *rend) {
+                mend++;
+                rend++;
+            }
+
+            size_t litlen = ip - anchor;
+            size_t matchlen = mend - ip - MIN_MATCH;
+            if ((size_t)(oend - op) < 1 + lengthBytes(litlen) + litlen +
+                                      2 + lengthBytes(matchlen))
+                return ZCM_EINVALID;
+
+            u8* token = op++;
+            *token = (u8)((litlen < 15 ? litlen : 15) << 4);
+            if (litlen >= 15) writeLength(op, litlen);
+            memcpy(op, anchor, litlen);
+            op += litlen;
+
+            u16 offset = (u16)(ip - ref);
+            *op++ = (u8)offset;
+            *op++ = (u8)(offset >> 8);
+            *token |= (u8)(matchlen < 15 ? matchlen : 15);
+            if (matchlen >= 15) writeLength(op, matchlen);
+
+            ip = anchor = mend;
+            // remembering the end of the match finds runs sooner
+            if (ip < mflimit)
+                table[hash(read32(ip - 2))] = (u32)(ip - 2 - src);
+        }
+    }
+
+    size_t litlen = iend - anchor;
+    if ((size_t)(oend - op) < 1 + lengthBytes(litlen) + litlen)
+        return ZCM_EINVALID;
+    *op++ = (u8)((litlen < 15 ? litlen : 15) << 4);
+    if (litlen >= 15) writeLength(op, litlen);
+    memcpy(op, anchor, litlen);
+    op += litlen;
+
+    *dstlen = op - dst;
+    return ZCM_EOK;
+}
+
+int lz4Decompress(const uint8_t* src, size_t len, uint8_t* dst, size_t* dstlen)
+{
+    const u8* ip = src;
+    const u8* iend = src + len;
+    u8* op = dst;
+    u8* oend = dst + *dstlen;
+
+    while (ip < iend) {
+        u8 token = *ip++;
+
+        size_t litlen = token >> 4;
+        if (litlen == 15 && !readLength(ip, iend, litlen))
+            return ZCM_EINVALID;
+        if (litlen > (size_t)(iend - ip) || litlen > (size_t)(oend - op))
+            return ZCM_EINVALID;
+        memcpy(op, ip, litlen);
+        op += litlen;
+        ip += litlen;
+
+        // the last sequence has no match
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return ZCM_EINVALID;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - dst))
+            return ZCM_EINVALID;
+
+        size_t matchlen = token & 15;
+        if (matchlen == 15 && !readLength(ip, iend, matchlen))
+            return ZCM_EINVALID;
+        matchlen += MIN_MATCH;
+        if (matchlen > (size_t)(oend - op))
+            return ZCM_EINVALID;
+
+        const u8* ref = op - offset;
+        if (offset >= matchlen) {
+            memcpy(op, ref, matchlen);
+            op += matchlen;
+        } else {
+            // the match overlaps what it writes: a repeating pattern
+            for (size_t i = 0; i < matchlen; i++)
+                *op++ = ref[i];
+        }
+    }
+
+    *dstlen = op - dst;
+    return ZCM_EOK;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Compression in the LZ4 block format (the raw blocks, without LZ4's frame around
+// them), written to be cheap enough for a transport's send and receive paths.
+// Both functions return ZCM_EOK and set '*dstlen' to the bytes written, or return
+// ZCM_EINVALID if '*dstlen', the room in 'dst', is too small (or 'src' is malformed).
+
+// The most bytes lz4Compress() can turn 'len' bytes into
+size_t lz4Bound(size_t len);
+
+int lz4Compress(const uint8_t* src, size_t len, uint8_t* dst, size_t* dstlen);
+// Note: safe to call on untrusted input, it never reads or writes out of bounds
+int lz4Decompress(const uint8_t* src, size_t len, uint8_t* dst, size_t* dstlen);
@@ -5,6 +5,8 @@
 #include <cstring>
 #include <cassert>
 
+#include "zcm/zcm.h"
+
 // A C++ queue implementation designed for efficiency.
 // No unneeded copies or initializations.
 // Note: Nothing about this queue is thread-safe
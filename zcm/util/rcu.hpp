@@ -0,0 +1,141 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "zcm/zcm.h"
+
+// Read-copy-update publication of an immutable T.
+// Writers build a new T from a copy of load(), then publish() it. Readers go
+// through a Reader, which keeps its own reference to the last snapshot it saw,
+// so the steady-state read is a single atomic load of the version counter.
+// Old snapshots are reclaimed by shared_ptr once the last Reader lets go of them.
+//
+// Readers that run user code (callbacks) bracket it with enter()/exit(); a writer
+// may then ask quiescent(version) to learn when every such section that could
+// still be looking at an older snapshot has finished.
+// Note: publish() must be serialized by the caller
+template<class T>
+class Rcu
+{
+    // Marks a reader that is entering but has not yet read the version
+    static constexpr uint64_t ENTERING = 1;
+
+  public:
+    class Reader
+    {
+        friend class Rcu;
+
+        Rcu& rcu;
+        std::shared_ptr<const T> snap;
+        uint64_t snapVer = 0;
+
+        // 0 while idle, otherwise the version this reader entered at
+        std::atomic<uint64_t> active {0};
+        std::atomic<std::thread::id> owner {std::thread::id()};
+
+        const T& refresh(uint64_t ver)
+        {
+            if (ver != snapVer) {
+                snap = std::atomic_load(&rcu.current);
+                snapVer = ver;
+            }
+            return *snap;
+        }
+
+      public:
+        Reader(Rcu& rcu) : rcu(rcu)
+        {
+            std::unique_lock<std::mutex> lk(rcu.readersMut);
+            rcu.readers.push_back(this);
+        }
+
+        ~Reader()
+        {
+            std::unique_lock<std::mutex> lk(rcu.readersMut);
+            rcu.readers.erase(std::find(rcu.readers.begin(), rcu.readers.end(), this));
+        }
+
+        // Begins a tracked read section. The returned snapshot stays valid until exit()
+        // Note: a Reader may move between threads, but may only be used by one at a time
+        const T& enter()
+        {
+            owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+            active.store(ENTERING);
+            uint64_t ver = rcu.ver.load();
+            active.store(ver);
+            return refresh(ver);
+        }
+
+        void exit()
+        {
+            active.store(0, std::memory_order_release);
+        }
+
+        // Untracked read, for readers that never hand snapshot contents to user code.
+        // The returned snapshot stays valid until the next call on this Reader
+        const T& peek()
+        {
+            return refresh(rcu.ver.load(std::memory_order_acquire));
+        }
+
+        // The version the current (or last) enter() saw
+        uint64_t version() const { return snapVer; }
+
+      private:
+        Reader(const Reader& other) = delete;
+        Reader(Reader&& other) = delete;
+        Reader& operator=(const Reader& other) = delete;
+        Reader& operator=(Reader&& other) = delete;
+    };
+
+  private:
+    std::shared_ptr<const T> current;
+    std::atomic<uint64_t> ver {ENTERING};
+
+    std::mutex readersMut;
+    std::vector<Reader*> readers;
+
+  public:
+    Rcu(std::shared_ptr<const T> initial) : current(std::move(initial)) {}
+
+    std::shared_ptr<const T> load() const { return std::atomic_load(&current); }
+
+    uint64_t version() const { return ver.load(std::memory_order_acquire); }
+
+    // Makes 'next' visible to readers and returns its version
+    uint64_t publish(std::shared_ptr<const T> next)
+    {
+        std::atomic_store(&current, std::move(next));
+        return ver.fetch_add(1) + 1;
+    }
+
+    // Returns true once no tracked read section can still be using a snapshot older
+    // than 'version'. Sections on the calling thread are ignored (and if the caller
+    // is itself inside one, so is everyone else: waiting on them could deadlock).
+    bool quiescent(uint64_t version)
+    {
+        std::thread::id self = std::this_thread::get_id();
+        std::unique_lock<std::mutex> lk(readersMut);
+
+        bool busy = false;
+        for (auto* r : readers) {
+            uint64_t a = r->active.load();
+            if (a == 0) continue;
+            if (r->owner.load(std::memory_order_relaxed) == self) return true;
+            if (a < version) busy = true;
+        }
+        return !busy;
+    }
+
+  private:
+    Rcu(const Rcu& other) = delete;
+    Rcu(Rcu&& other) = delete;
+    Rcu& operator=(const Rcu& other) = delete;
+    Rcu& operator=(Rcu&& other) = delete;
+};
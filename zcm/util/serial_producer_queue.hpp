@@ -0,0 +1,255 @@
+#pragma once
+
+#include <new>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <condition_variable>
+
+#include "zcm/zcm.h"
+
+// A ring-buffer queue that hands elements from producers to a consumer without the
+// consumer taking a lock on the fast path. Producers are serialized by a mutex that
+// is uncontended when there is only one. Behaves like ThreadsafeQueue
+// (including the disable()/enable() wakeup semantics), but:
+//   - head and tail are padded onto separate cache lines and each side keeps a cached
+//     copy of the other's index, so the common case touches no shared lines
+//   - a side that has to wait spins briefly before parking on a condition
+//     variable, and the other side only pays for a notify when someone is parked
+// Note: only one thread may consume at a time (top()/pop()). Any number of threads
+//       may push, one at a time.
+// Note: setCapacity() must not race with top()/pop(), and should follow a disable()
+//       so that a producer waiting on a full queue lets go of the push lock
+template<class Element>
+class SerialProducerQueue
+{
+    static constexpr size_t CACHE_LINE = 64;
+    static constexpr int    SPIN_ITERS = 256;
+
+    Element* queue;
+    // Only written under pushMut, but readable without it: a producer waiting for
+    // room holds pushMut for as long as the queue stays full
+    std::atomic<size_t> capacity;
+
+    // Note: padding rather than alignas() keeps this usable as a member of objects
+    //       created with plain operator new, which ignores over-alignment in C++11
+
+    // Consumer-owned
+    char pad0[CACHE_LINE];
+    std::atomic<size_t> front {0};
+    size_t cachedBack = 0;
+
+    // Producer-owned
+    char pad1[CACHE_LINE];
+    std::atomic<size_t> back {0};
+    size_t cachedFront = 0;
+    std::mutex pushMut;
+
+    // Parking (slow path only)
+    char pad2[CACHE_LINE];
+    std::mutex mut;
+    std::condition_variable cond;
+    std::atomic<bool> consumerParked {false};
+    std::atomic<bool> producerParked {false};
+    std::atomic<bool> disabled {false};
+
+    size_t incIdx(size_t i) const
+    {
+        size_t nextIdx = i + 1;
+        if (nextIdx == capacity.load(std::memory_order_relaxed)) return 0;
+        return nextIdx;
+    }
+
+    bool canPush()
+    {
+        size_t nextBack = incIdx(back.load(std::memory_order_relaxed));
+        if (nextBack != cachedFront) return true;
+        cachedFront = front.load(std::memory_order_acquire);
+        return nextBack != cachedFront;
+    }
+
+    bool canPop()
+    {
+        size_t f = front.load(std::memory_order_relaxed);
+        if (f != cachedBack) return true;
+        cachedBack = back.load(std::memory_order_acquire);
+        return f != cachedBack;
+    }
+
+    // Wake the other side if (and only if) it is parked
+    void wake(std::atomic<bool>& parked)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!parked.load(std::memory_order_relaxed)) return;
+        { std::unique_lock<std::mutex> lk(mut); }
+        cond.notify_all();
+    }
+
+    // Spin, then park until 'ready()' or the queue is disabled
+    template<class Ready>
+    void waitFor(std::atomic<bool>& parked, Ready ready)
+    {
+        for (int i = 0; i < SPIN_ITERS; ++i) {
+            if (ready() || disabled.load(std::memory_order_acquire)) return;
+            if (i >= SPIN_ITERS / 2) std::this_thread::yield();
+        }
+
+        std::unique_lock<std::mutex> lk(mut);
+        parked.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cond.wait(lk, [&](){ return disabled.load(std::memory_order_acquire) || ready(); });
+        parked.store(false, std::memory_order_relaxed);
+    }
+
+    template<class... Args>
+    void doPush(Args&&... args)
+    {
+        size_t b = back.load(std::memory_order_relaxed);
+        new (&queue[b]) Element(std::forward<Args>(args)...);
+        back.store(incIdx(b), std::memory_order_release);
+        wake(consumerParked);
+    }
+
+  public:
+    SerialProducerQueue(size_t capacity) : capacity(capacity)
+    {
+        // We are avoiding initializing the structs here
+        queue = (Element*) new uint8_t[capacity * sizeof(Element)];
+        ZCM_ASSERT(queue);
+    }
+
+    ~SerialProducerQueue()
+    {
+        // We need to deconstruct any elements still in the queue
+        while (hasMessage()) pop();
+        delete[] ((uint8_t*) queue);
+    }
+
+    size_t getCapacity()
+    {
+        return capacity.load(std::memory_order_acquire);
+    }
+
+    // Returns false, leaving the queue alone, if !block and a producer is pushing
+    bool setCapacity(size_t capacity, bool block = true)
+    {
+        std::unique_lock<std::mutex> lk(pushMut, std::defer_lock);
+        if (block) lk.lock();
+        else if (!lk.try_lock()) return false;
+
+        uint8_t* newQueue = new uint8_t[capacity * sizeof(Element)];
+        ZCM_ASSERT(newQueue);
+
+        size_t f = front.load(std::memory_order_relaxed);
+        size_t b = back.load(std::memory_order_relaxed);
+        size_t newBack = 0;
+        while (f != b && newBack < capacity) {
+            uint8_t* msg = (uint8_t*) &queue[f];
+            std::uninitialized_copy_n(msg, sizeof(Element), newQueue + newBack * sizeof(Element));
+            f = incIdx(f);
+            ++newBack;
+        }
+
+        delete[] ((uint8_t*) queue);
+        queue = (Element*) newQueue;
+        this->capacity.store(capacity, std::memory_order_release);
+        cachedFront = cachedBack = 0;
+        front.store(0, std::memory_order_relaxed);
+        back.store(newBack, std::memory_order_release);
+        return true;
+    }
+
+    bool hasFreeSpace()
+    {
+        std::unique_lock<std::mutex> lk(pushMut);
+        return canPush();
+    }
+
+    bool hasMessage()
+    {
+        return front.load(std::memory_order_relaxed) != back.load(std::memory_order_acquire);
+    }
+
+    size_t numMessages()
+    {
+        size_t f = front.load(std::memory_order_acquire);
+        size_t b = back.load(std::memory_order_acquire);
+        if (b >= f) {
+            return b - f;
+        } else {
+            return capacity.load(std::memory_order_relaxed) - (f - b);
+        }
+    }
+
+    // Wait for hasFreeSpace() and then push the new element
+    // Returns true if the value was pushed, otherwise it
+    // was forcibly awoken by disable()
+    template<class... Args>
+    bool push(Args&&... args)
+    {
+        std::unique_lock<std::mutex> lk(pushMut);
+        if (!canPush()) {
+            waitFor(producerParked, [&](){ return canPush(); });
+            if (!canPush()) return false;
+        }
+
+        doPush(std::forward<Args>(args)...);
+        return true;
+    }
+
+    // Check for hasFreeSpace() and if so, push the new element
+    // Returns true if the value was pushed, returns false if no room
+    template<class... Args>
+    bool pushIfRoom(Args&&... args)
+    {
+        std::unique_lock<std::mutex> lk(pushMut);
+        if (!canPush()) return false;
+
+        doPush(std::forward<Args>(args)...);
+        return true;
+    }
+
+    // Wait for hasMessage() and then return the top element
+    // Always returns a valid Element* except when is was
+    // forcibly awoken by disable(). In such a case
+    // nullptr is returned to the user
+    Element* top()
+    {
+        if (!canPop()) waitFor(consumerParked, [&](){ return canPop(); });
+        if (disabled.load(std::memory_order_acquire)) return nullptr;
+
+        return &queue[front.load(std::memory_order_relaxed)];
+    }
+
+    // Requires that hasMessage() == true
+    void pop()
+    {
+        size_t f = front.load(std::memory_order_relaxed);
+        queue[f].~Element();
+        front.store(incIdx(f), std::memory_order_release);
+        wake(producerParked);
+    }
+
+    // Forcefully wakes up top() and push(). top() *will not* return a message from
+    // the queue, even if one exists. push() *will* push the message if there is room.
+    void disable()
+    {
+        std::unique_lock<std::mutex> lk(mut);
+        disabled.store(true, std::memory_order_release);
+        cond.notify_all();
+    }
+
+    void enable()
+    {
+        std::unique_lock<std::mutex> lk(mut);
+        disabled.store(false, std::memory_order_release);
+    }
+
+  private:
+    SerialProducerQueue(const SerialProducerQueue& other) = delete;
+    SerialProducerQueue(SerialProducerQueue&& other) = delete;
+    SerialProducerQueue& operator=(const SerialProducerQueue& other) = delete;
+    SerialProducerQueue& operator=(SerialProducerQueue&& other) = delete;
+};
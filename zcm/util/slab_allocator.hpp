@@ -0,0 +1,141 @@
+#pragma once
+
+#include <mutex>
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+
+#include "zcm/zcm.h"
+
+// A thread-safe, size-classed slab allocator for message payloads.
+// Blocks are power-of-two sized from 2^MIN_SLAB_BITS to 2^MAX_SLAB_BITS and are
+// parked on a per-class free list when released, so steady-state traffic never
+// touches malloc(). Requests above the largest class bypass the free lists.
+// Note: every block carries a small header recording its size class, so free()
+//       and capacity() only need the pointer that alloc() handed out
+class SlabAllocator
+{
+  public:
+    static constexpr size_t MIN_SLAB_BITS = 8;  // 256 B
+    static constexpr size_t MAX_SLAB_BITS = 20; // 1 MB
+    static constexpr size_t NUM_CLASSES = MAX_SLAB_BITS - MIN_SLAB_BITS + 1;
+
+  private:
+    struct alignas(16) Block
+    {
+        Block* next;
+        size_t slot;     // NUM_CLASSES for blocks that are not pooled
+        size_t capacity; // usable bytes following this header
+    };
+
+    struct SizeClass
+    {
+        Block* freelist = nullptr;
+        size_t numFree = 0;
+    };
+
+    std::mutex mut;
+    SizeClass classes[NUM_CLASSES];
+    size_t maxFreePerClass;
+
+    static size_t computeSlot(size_t sz)
+    {
+        if (sz <= ((size_t)1 << MIN_SLAB_BITS)) return 0;
+        size_t bits = 64 - __builtin_clzll((unsigned long long)(sz - 1));
+        if (bits > MAX_SLAB_BITS) return NUM_CLASSES;
+        return bits - MIN_SLAB_BITS;
+    }
+
+    static Block* toBlock(const uint8_t* data)
+    {
+        return ((Block*) data) - 1;
+    }
+
+    static uint8_t* toData(Block* blk)
+    {
+        return (uint8_t*) (blk + 1);
+    }
+
+  public:
+    SlabAllocator(size_t maxFreePerClass) : maxFreePerClass(maxFreePerClass) {}
+
+    ~SlabAllocator()
+    {
+        for (auto& c : classes) {
+            while (c.freelist) {
+                Block* next = c.freelist->next;
+                std::free(c.freelist);
+                c.freelist = next;
+            }
+        }
+    }
+
+    // Limits how many released blocks each size class will hold on to
+    void setMaxFreePerClass(size_t n)
+    {
+        std::unique_lock<std::mutex> lk(mut);
+        maxFreePerClass = n;
+        for (auto& c : classes) {
+            while (c.numFree > maxFreePerClass) {
+                Block* blk = c.freelist;
+                c.freelist = blk->next;
+                --c.numFree;
+                std::free(blk);
+            }
+        }
+    }
+
+    // Returns a buffer of at least 'sz' bytes, or nullptr if out of memory
+    uint8_t* alloc(size_t sz)
+    {
+        size_t slot = computeSlot(sz);
+        if (slot < NUM_CLASSES) {
+            std::unique_lock<std::mutex> lk(mut);
+            SizeClass& c = classes[slot];
+            if (c.freelist) {
+                Block* blk = c.freelist;
+                c.freelist = blk->next;
+                --c.numFree;
+                return toData(blk);
+            }
+        }
+
+        size_t capacity = slot < NUM_CLASSES ? (size_t)1 << (slot + MIN_SLAB_BITS) : sz;
+        Block* blk = (Block*) std::malloc(sizeof(Block) + capacity);
+        if (!blk) return nullptr;
+        blk->next = nullptr;
+        blk->slot = slot;
+        blk->capacity = capacity;
+        return toData(blk);
+    }
+
+    // Requires that 'data' was returned by alloc() on this allocator
+    void free(uint8_t* data)
+    {
+        if (!data) return;
+        Block* blk = toBlock(data);
+        if (blk->slot < NUM_CLASSES) {
+            std::unique_lock<std::mutex> lk(mut);
+            SizeClass& c = classes[blk->slot];
+            if (c.numFree < maxFreePerClass) {
+                blk->next = c.freelist;
+                c.freelist = blk;
+                ++c.numFree;
+                return;
+            }
+        }
+        std::free(blk);
+    }
+
+    // Number of usable bytes in a buffer returned by alloc()
+    static size_t capacity(const uint8_t* data)
+    {
+        return toBlock(data)->capacity;
+    }
+
+  private:
+    SlabAllocator(const SlabAllocator& other) = delete;
+    SlabAllocator(SlabAllocator&& other) = delete;
+    SlabAllocator& operator=(const SlabAllocator& other) = delete;
+    SlabAllocator& operator=(SlabAllocator&& other) = delete;
+};
@@ -0,0 +1,256 @@
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+#include "zcm/zcm.h"
+
+// A pool of worker threads that run tasks queued on "strands". Tasks on the same
+// strand run one at a time in the order they were pushed; different strands run in
+// parallel. Each strand has a home worker (picked by hash) whose deque it is queued
+// on whenever it has work, and idle workers steal strands from the back of other
+// workers' deques. A worker runs a single task each time it picks up a strand and
+// then requeues it, so one slow strand cannot starve the others sharing its worker.
+// Note: push() must only be called from one thread at a time
+template<class Context, class Task>
+class StrandPool
+{
+  public:
+    class Strand
+    {
+        friend class StrandPool;
+
+        std::mutex mut;
+        std::deque<Task> tasks;
+        std::atomic<size_t> numTasks {0};
+        bool scheduled = false; // queued on a deque or being run (guarded by mut)
+        size_t home;
+
+      public:
+        Context ctx;
+
+        Strand(Context ctx, size_t home) : home(home), ctx(std::move(ctx)) {}
+    };
+
+    // Called as runner(worker, ctx, task). 'worker' is the index of the calling worker
+    // thread, or getNumWorkers() when called from drain()
+    using Runner = std::function<void(size_t, Context&, Task&)>;
+
+  private:
+    struct Worker
+    {
+        std::mutex mut;
+        std::deque<std::shared_ptr<Strand>> ready;
+        std::thread thread;
+    };
+
+    Runner runner;
+    std::vector<std::unique_ptr<Worker>> workers;
+    size_t capacity;
+    bool started = false;
+
+    std::atomic<size_t> queued  {0}; // strands sitting in a deque
+    std::atomic<size_t> pending {0}; // tasks pushed but not yet completed
+    std::atomic<bool>   paused  {false};
+    std::atomic<bool>   stopping {false};
+
+    // Parking (slow path only)
+    std::mutex mut;
+    std::condition_variable cond;
+    std::atomic<size_t> sleepers {0};
+
+    void wake()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) == 0) return;
+        { std::unique_lock<std::mutex> lk(mut); }
+        cond.notify_all();
+    }
+
+    template<class Ready>
+    void waitFor(Ready ready)
+    {
+        std::unique_lock<std::mutex> lk(mut);
+        sleepers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cond.wait(lk, ready);
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void enqueue(const std::shared_ptr<Strand>& s)
+    {
+        Worker& w = *workers[s->home];
+        {
+            std::unique_lock<std::mutex> lk(w.mut);
+            w.ready.push_back(s);
+        }
+        queued.fetch_add(1);
+        wake();
+    }
+
+    // Own deque first (oldest strand), otherwise steal the newest from someone else
+    std::shared_ptr<Strand> take(size_t self)
+    {
+        std::shared_ptr<Strand> s;
+        size_t n = workers.size();
+        for (size_t i = 0; i < n && !s; ++i) {
+            size_t idx = (self + i) % n;
+            Worker& w = *workers[idx];
+            std::unique_lock<std::mutex> lk(w.mut);
+            if (w.ready.empty()) continue;
+            if (idx == self) {
+                s = std::move(w.ready.front());
+                w.ready.pop_front();
+            } else {
+                s = std::move(w.ready.back());
+                w.ready.pop_back();
+            }
+        }
+        if (s) queued.fetch_sub(1);
+        return s;
+    }
+
+    bool runOne(size_t self)
+    {
+        std::shared_ptr<Strand> s = take(self);
+        if (!s) return false;
+
+        Task t;
+        {
+            std::unique_lock<std::mutex> lk(s->mut);
+            t = std::move(s->tasks.front());
+            s->tasks.pop_front();
+            s->numTasks.fetch_sub(1);
+        }
+
+        runner(self, s->ctx, t);
+        t = Task();
+
+        bool more;
+        {
+            std::unique_lock<std::mutex> lk(s->mut);
+            more = !s->tasks.empty();
+            if (!more) s->scheduled = false;
+        }
+        if (more) enqueue(s);
+
+        pending.fetch_sub(1);
+        wake();
+        return true;
+    }
+
+    void workerFunc(size_t self, std::function<void(size_t)> init)
+    {
+        if (init) init(self);
+        while (true) {
+            waitFor([&](){
+                return stopping.load() || (!paused.load() && queued.load() > 0);
+            });
+            if (stopping.load()) break;
+            runOne(self);
+        }
+    }
+
+  public:
+    StrandPool(Runner runner, size_t capacity) : runner(runner), capacity(capacity) {}
+
+    ~StrandPool() { stop(); }
+
+    size_t getNumWorkers() const { return workers.size(); }
+
+    // Changes the number of workers (0 disables the pool). Fails if the workers are
+    // running or there are still tasks queued. Existing strands must be discarded.
+    bool setNumWorkers(size_t n)
+    {
+        if (started || pending.load() != 0) return false;
+        workers.clear();
+        for (size_t i = 0; i < n; ++i) workers.emplace_back(new Worker());
+        return true;
+    }
+
+    // The most tasks a single strand may have queued before push() waits for it
+    void setCapacity(size_t capacity) { this->capacity = capacity; }
+
+    std::shared_ptr<Strand> makeStrand(Context ctx, size_t hash)
+    {
+        ZCM_ASSERT(!workers.empty());
+        return std::make_shared<Strand>(std::move(ctx), hash % workers.size());
+    }
+
+    // Queues 'task' on 's'. Waits while the strand is full, unless the pool is paused
+    // or stopped (in which case nothing would ever drain it).
+    void push(const std::shared_ptr<Strand>& s, Task task)
+    {
+        if (s->numTasks.load() >= capacity) {
+            waitFor([&](){
+                return s->numTasks.load() < capacity || paused.load() || stopping.load();
+            });
+        }
+
+        bool schedule = false;
+        {
+            std::unique_lock<std::mutex> lk(s->mut);
+            s->tasks.push_back(std::move(task));
+            s->numTasks.fetch_add(1);
+            pending.fetch_add(1);
+            if (!s->scheduled) {
+                s->scheduled = true;
+                schedule = true;
+            }
+        }
+        if (schedule) enqueue(s);
+    }
+
+    // Starts the worker threads, calling init(index) first thing in each of them.
+    // Does nothing if the pool has no workers
+    void start(std::function<void(size_t)> init = nullptr)
+    {
+        if (started || workers.empty()) return;
+        started = true;
+        stopping.store(false);
+        for (size_t i = 0; i < workers.size(); ++i)
+            workers[i]->thread = std::thread(&StrandPool::workerFunc, this, i, init);
+    }
+
+    // Stops the workers once they finish their current task. Anything still queued
+    // stays queued until the next start() or drain()
+    void stop()
+    {
+        if (!started) return;
+        stopping.store(true);
+        { std::unique_lock<std::mutex> lk(mut); }
+        cond.notify_all();
+        for (auto& w : workers) w->thread.join();
+        started = false;
+    }
+
+    bool isRunning() const { return started; }
+
+    // Workers finish their current task and then wait for resume(). drain() still runs.
+    void pause() { paused.store(true); wake(); }
+    void resume() { paused.store(false); wake(); }
+
+    // Runs queued tasks on the calling thread (helping any running workers) until
+    // every task pushed so far has completed
+    void drain()
+    {
+        size_t self = workers.size();
+        while (true) {
+            if (runOne(self)) continue;
+            if (pending.load() == 0) break;
+            waitFor([&](){ return queued.load() > 0 || pending.load() == 0; });
+        }
+    }
+
+  private:
+    StrandPool(const StrandPool& other) = delete;
+    StrandPool(StrandPool&& other) = delete;
+    StrandPool& operator=(const StrandPool& other) = delete;
+    StrandPool& operator=(StrandPool&& other) = delete;
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "cxxtest/TestSuite.h"
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "zcm/util/byte_ring.hpp"
+
+class ByteRingTest : public CxxTest::TestSuite
+{
+    static bool put(ByteRing& ring, const std::vector<uint8_t>& rec)
+    {
+        ByteRing::Reservation r = ring.reserve(rec.size());
+        if (!r.data) return false;
+        memcpy(r.data, rec.data(), rec.size());
+        ring.commit(r);
+        return true;
+    }
+
+    static size_t take(ByteRing& ring, std::vector<std::vector<uint8_t>>& out)
+    {
+        return ring.drain([&](const uint8_t* data, size_t len) {
+            out.emplace_back(data, data + len);
+        });
+    }
+
+  public:
+    void setUp() override {}
+    void tearDown() override {}
+
+    void testWrapsAndDrops()
+    {
+        ByteRing ring(100);
+        TS_ASSERT_EQUALS(ring.getCapacity(), 104u);
+        TS_ASSERT_EQUALS(ring.maxRecordLen(), 40u);
+        TS_ASSERT(!ring.reserve(41).data);
+
+        std::vector<uint8_t> a(30, 'a'), b(30, 'b'), c(20, 'c');
+        TS_ASSERT(put(ring, a));
+        TS_ASSERT(put(ring, b));
+        TS_ASSERT(!put(ring, c));  // 80 of 104 bytes used
+        TS_ASSERT_EQUALS(ring.bytesUsed(), 80u);
+
+        std::vector<std::vector<uint8_t>> out;
+        TS_ASSERT_EQUALS(take(ring, out), 2u);
+        TS_ASSERT_EQUALS(ring.bytesUsed(), 0u);
+
+        // doesn't fit the 24 bytes left at the end, so goes to the start
+        TS_ASSERT(put(ring, c));
+        TS_ASSERT(put(ring, a));
+        TS_ASSERT_EQUALS(take(ring, out), 2u);
+        TS_ASSERT_EQUALS(take(ring, out), 0u);
+
+        std::vector<std::vector<uint8_t>> expected = { a, b, c, a };
+        TS_ASSERT(out == expected);
+    }
+
+    void testDrainsContiguousRuns()
+    {
+        ByteRing ring(64);
+        std::vector<uint8_t> rec(8, 'x');
+        std::vector<std::vector<uint8_t>> out;
+
+        // 3 records of 16 bytes, then one that straddles the end of the buffer
+        for (int i = 0; i < 3; ++i) TS_ASSERT(put(ring, rec));
+        TS_ASSERT_EQUALS(take(ring, out), 3u);
+        for (int i = 0; i < 3; ++i) TS_ASSERT(put(ring, rec));
+
+        const uint8_t* prev = nullptr;
+        TS_ASSERT_EQUALS(ring.drain([&](const uint8_t* data, size_t len) {
+            TS_ASSERT_EQUALS(len, 8u);
+            prev = data;
+        }), 1u);
+        TS_ASSERT_EQUALS(ring.drain([&](const uint8_t* data, size_t len) {
+            if (prev) TS_ASSERT(data < prev);
+            prev = nullptr;
+        }, 16), 1u);
+        TS_ASSERT_EQUALS(take(ring, out), 1u);
+    }
+
+    void testManyProducers()
+    {
+        static constexpr int PRODUCERS = 4;
+        static constexpr uint32_t PER_PRODUCER = 100000;
+        ByteRing ring(4096);
+
+        std::vector<std::thread> producers;
+        for (int p = 0; p < PRODUCERS; ++p) {
+            producers.emplace_back([&ring, p]() {
+                for (uint32_t i = 0; i < PER_PRODUCER; ) {
+                    // records of varying length carrying who sent them and in what order
+                    size_t len = 8 + i % 50;
+                    ByteRing::Reservation r = ring.reserve(len);
+                    if (!r.data) { std::this_thread::yield(); continue; }
+                    memset(r.data, p, len);
+                    memcpy(r.data, &i, sizeof(i));
+                    ring.commit(r);
+                    ++i;
+                }
+            });
+        }
+
+        uint32_t next[PRODUCERS] = {};
+        size_t received = 0, bad = 0;
+        while (received < PRODUCERS * PER_PRODUCER) {
+            size_t n = ring.drain([&](const uint8_t* data, size_t len) {
+                uint8_t p = data[len - 1];
+                uint32_t i;
+                memcpy(&i, data, sizeof(i));
+                if (p >= PRODUCERS || i != next[p] || len != 8 + i % 50) { ++bad; return; }
+                for (size_t j = sizeof(i); j < len; ++j)
+                    if (data[j] != p) { ++bad; return; }
+                ++next[p];
+            });
+            received += n;
+            if (n == 0) ring.wait();
+        }
+        for (auto& t : producers) t.join();
+
+        TS_ASSERT_EQUALS(bad, 0u);
+        TS_ASSERT_EQUALS(ring.bytesUsed(), 0u);
+    }
+};
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "cxxtest/TestSuite.h"
+
+#include "zcm/util/channel_matcher.hpp"
+
+class ChannelMatcherTest : public CxxTest::TestSuite
+{
+    std::vector<zcm_sub_t*> allSubs;
+
+    zcm_sub_t* makeSub(const std::string& channel)
+    {
+        zcm_sub_t* sub = new zcm_sub_t();
+        strncpy(sub->channel, channel.c_str(), ZCM_CHANNEL_MAXLEN);
+        sub->channel[ZCM_CHANNEL_MAXLEN] = '\0';
+        sub->regex = ChannelMatcher::isRegexChannel(channel);
+        sub->regexobj = sub->regex ? (void*) new std::regex(sub->channel) : nullptr;
+        sub->callback = nullptr;
+        sub->usr = nullptr;
+        allSubs.push_back(sub);
+        return sub;
+    }
+
+  public:
+    void setUp() override {}
+    void tearDown() override
+    {
+        for (auto* sub : allSubs) {
+            if (sub->regex) delete (std::regex*) sub->regexobj;
+            delete sub;
+        }
+        allSubs.clear();
+    }
+
+    void testPrefixDetection()
+    {
+        std::string prefix;
+        TS_ASSERT(ChannelMatcher::isPrefixRegex(".*", prefix));
+        TS_ASSERT_EQUALS(prefix, "");
+        TS_ASSERT(ChannelMatcher::isPrefixRegex("FOO_BAR.*", prefix));
+        TS_ASSERT_EQUALS(prefix, "FOO_BAR");
+        TS_ASSERT(!ChannelMatcher::isPrefixRegex("FOO", prefix));
+        TS_ASSERT(!ChannelMatcher::isPrefixRegex("F.O.*", prefix));
+        TS_ASSERT(!ChannelMatcher::isPrefixRegex("(A|B).*", prefix));
+        TS_ASSERT(!ChannelMatcher::isPrefixRegex("A+.*", prefix));
+    }
+
+    // Every pattern must agree with std::regex_match on every channel
+    void testAgreesWithRegex()
+    {
+        std::vector<std::string> patterns = {
+            ".*", "A.*", "AB.*", "ABC.*", "B.*", "(A|B)C.*", "A.C", "AB+", "ABC",
+        };
+        std::vector<std::string> channels = {
+            "", "A", "AB", "ABC", "ABCD", "AC", "BC", "BCD", "ABB", "AXC", "A\nB", "AB\n",
+        };
+
+        for (auto& pattern : patterns) {
+            ChannelMatcher m;
+            zcm_sub_t* sub = makeSub(pattern);
+            m.add(sub);
+            std::regex r(pattern);
+            for (auto& channel : channels) {
+                ChannelMatcher::SubList out;
+                m.match(channel.c_str(), out);
+                bool expected = std::regex_match(channel, r);
+                TSM_ASSERT_EQUALS(pattern + " vs " + channel, !out.empty(), expected);
+            }
+        }
+    }
+
+    void testOrder()
+    {
+        ChannelMatcher m;
+        zcm_sub_t* r0 = makeSub("A.*");
+        zcm_sub_t* r1 = makeSub("(A|B)B");
+        zcm_sub_t* e0 = makeSub("AB");
+        zcm_sub_t* r2 = makeSub(".*");
+        zcm_sub_t* e1 = makeSub("AB");
+        m.add(r0);
+        m.add(r1);
+        m.add(e0);
+        m.add(r2);
+        m.add(e1);
+
+        // Exact subscriptions first, then regexes in subscription order
+        ChannelMatcher::SubList out;
+        m.match("AB", out);
+        TS_ASSERT_EQUALS(out.size(), 5);
+        if (out.size() == 5) {
+            TS_ASSERT_EQUALS(out[0], e0);
+            TS_ASSERT_EQUALS(out[1], e1);
+            TS_ASSERT_EQUALS(out[2], r0);
+            TS_ASSERT_EQUALS(out[3], r1);
+            TS_ASSERT_EQUALS(out[4], r2);
+        }
+    }
+
+    void testRemove()
+    {
+        ChannelMatcher m;
+        zcm_sub_t* e0 = makeSub("AB");
+        zcm_sub_t* e1 = makeSub("AB");
+        zcm_sub_t* r0 = makeSub("A.*");
+        zcm_sub_t* r1 = makeSub("A.C");
+        m.add(e0);
+        m.add(e1);
+        m.add(r0);
+        m.add(r1);
+        TS_ASSERT_EQUALS(m.numRegex(), 2);
+
+        size_t nleft = 99;
+        TS_ASSERT(m.remove(e0, nleft));
+        TS_ASSERT_EQUALS(nleft, 1);
+        TS_ASSERT(!m.remove(e0, nleft));
+        TS_ASSERT(m.remove(e1, nleft));
+        TS_ASSERT_EQUALS(nleft, 0);
+
+        TS_ASSERT(m.remove(r0, nleft));
+        TS_ASSERT_EQUALS(nleft, 1);
+        TS_ASSERT(m.remove(r1, nleft));
+        TS_ASSERT_EQUALS(nleft, 0);
+        TS_ASSERT_EQUALS(m.numRegex(), 0);
+
+        ChannelMatcher::SubList out;
+        m.match("ABC", out);
+        TS_ASSERT(out.empty());
+    }
+
+    void testCacheInvalidation()
+    {
+        ChannelMatcher m;
+        ChannelMatchCache cache;
+        zcm_sub_t* r0 = makeSub("A.*");
+
+        TS_ASSERT(cache.lookup(m, "AB").empty());
+        m.add(r0);
+        TS_ASSERT_EQUALS(cache.lookup(m, "AB").size(), 1);
+        TS_ASSERT_EQUALS(cache.lookup(m, "AB").size(), 1);
+
+        size_t nleft;
+        TS_ASSERT(m.remove(r0, nleft));
+        TS_ASSERT(cache.lookup(m, "AB").empty());
+    }
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "cxxtest/TestSuite.h"
+
+#include "zcm/zcm.h"
+#include "zcm/util/lz4.hpp"
+
+#include <cstdlib>
+#include <vector>
+
+class Lz4Test : public CxxTest::TestSuite
+{
+    static std::vector<uint8_t> roundTrip(const std::vector<uint8_t>& in)
+    {
+        std::vector<uint8_t> compressed(lz4Bound(in.size()));
+        size_t len = compressed.size();
+        TS_ASSERT_EQUALS(lz4Compress(in.data(), in.size(), compressed.data(), &len), ZCM_EOK);
+        compressed.resize(len);
+
+        std::vector<uint8_t> out(in.size());
+        len = out.size();
+        TS_ASSERT_EQUALS(lz4Decompress(compressed.data(), compressed.size(),
+                                       out.data(), &len), ZCM_EOK);
+        TS_ASSERT_EQUALS(len, in.size());
+        TS_ASSERT(out == in);
+        return compressed;
+    }
+
+  public:
+    void setUp() override {}
+    void tearDown() override {}
+
+    void testRoundTrip()
+    {
+        TS_ASSERT_EQUALS(roundTrip({}).size(), 1u);
+        roundTrip({ 1, 2, 3 });
+
+        // runs, overlapping matches and long lengths
+        std::vector<uint8_t> runs(100000, 7);
+        TS_ASSERT(roundTrip(runs).size() < 1000);
+
+        std::vector<uint8_t> pattern;
+        for (int i = 0; i < 50000; i++) pattern.push_back(i % 13 == 0 ? rand() : i % 5);
+        TS_ASSERT(roundTrip(pattern).size() < pattern.size() / 2);
+
+        std::vector<uint8_t> noise;
+        for (int i = 0; i < 70000; i++) noise.push_back(rand());
+        TS_ASSERT(roundTrip(noise).size() <= lz4Bound(noise.size()));
+    }
+
+    void testRejectsSmallBuffers()
+    {
+        std::vector<uint8_t> in(1000, 3);
+        std::vector<uint8_t> out(lz4Bound(in.size()));
+        size_t len = 4;
+        TS_ASSERT_EQUALS(lz4Compress(in.data(), in.size(), out.data(), &len), ZCM_EINVALID);
+
+        len = out.size();
+        TS_ASSERT_EQUALS(lz4Compress(in.data(), in.size(), out.data(), &len), ZCM_EOK);
+        std::vector<uint8_t> back(in.size() - 1);
+        size_t backlen = back.size();
+        TS_ASSERT_EQUALS(lz4Decompress(out.data(), len, back.data(), &backlen), ZCM_EINVALID);
+    }
+
+    void testRejectsMalformedInput()
+    {
+        std::vector<uint8_t> out(1000);
+        size_t len;
+
+        // a literal run longer than the input
+        const uint8_t longLiterals[] = { 0x50, 'a', 'b' };
+        len = out.size();
+        TS_ASSERT_EQUALS(lz4Decompress(longLiterals, sizeof(longLiterals), out.data(), &len),
+                         ZCM_EINVALID);
+
+        // a match reaching back before the start
+        const uint8_t farMatch[] = { 0x10, 'a', 0x05, 0x00, 0x00 };
+        len = out.size();
+        TS_ASSERT_EQUALS(lz4Decompress(farMatch, sizeof(farMatch), out.data(), &len),
+                         ZCM_EINVALID);
+
+        // a length that never ends
+        const uint8_t endless[] = { 0xf0, 0xff, 0xff };
+        len = out.size();
+        TS_ASSERT_EQUALS(lz4Decompress(endless, sizeof(endless), out.data(), &len),
+                         ZCM_EINVALID);
+
+        // garbage never writes past the output, however it decodes
+        for (int i = 0; i < 1000; i++) {
+            std::vector<uint8_t> junk(1 + rand() % 64);
+            for (auto& b : junk) b = rand();
+            std::vector<uint8_t> small(16);
+            len = small.size();
+            if (lz4Decompress(junk.data(), junk.size(), small.data(), &len) == ZCM_EOK)
+                TS_ASSERT(len <= small.size());
+        }
+    }
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "cxxtest/TestSuite.h"
+
+#include "zcm/util/slab_allocator.hpp"
+
+class SlabAllocatorTest : public CxxTest::TestSuite
+{
+  public:
+    void setUp() override {}
+    void tearDown() override {}
+
+    void testReuse()
+    {
+        SlabAllocator slab(4);
+
+        uint8_t* a = slab.alloc(100);
+        TS_ASSERT(a);
+        TS_ASSERT_EQUALS(SlabAllocator::capacity(a), 256);
+        slab.free(a);
+
+        // Same size class should hand back the block we just released
+        uint8_t* b = slab.alloc(200);
+        TS_ASSERT_EQUALS(a, b);
+        slab.free(b);
+
+        // Different size class must not
+        uint8_t* c = slab.alloc(300);
+        TS_ASSERT_DIFFERS(a, c);
+        TS_ASSERT_EQUALS(SlabAllocator::capacity(c), 512);
+        slab.free(c);
+    }
+
+    void testUnpooled()
+    {
+        SlabAllocator slab(4);
+
+        size_t sz = (1 << SlabAllocator::MAX_SLAB_BITS) + 1;
+        uint8_t* a = slab.alloc(sz);
+        TS_ASSERT(a);
+        TS_ASSERT_EQUALS(SlabAllocator::capacity(a), sz);
+        slab.free(a);
+    }
+
+    void testMaxFree()
+    {
+        SlabAllocator slab(1);
+
+        uint8_t* a = slab.alloc(10);
+        uint8_t* b = slab.alloc(10);
+        slab.free(a);
+        slab.free(b); // class is full, goes back to the system
+
+        uint8_t* c = slab.alloc(10);
+        TS_ASSERT_EQUALS(a, c);
+        slab.free(c);
+    }
+};
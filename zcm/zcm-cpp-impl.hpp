@@ -142,6 +142,11 @@ inline void ZCM::setQueueSize(uint32_t sz)
 {
     zcm_set_queue_size(zcm, sz);
 }
+
+inline int ZCM::setDispatchThreads(uint32_t numThreads)
+{
+    return zcm_set_dispatch_threads(zcm, numThreads);
+}
 #endif
 
 inline int ZCM::handleNonblock()
@@ -159,6 +164,27 @@ inline int ZCM::publish(const std::string& channel, const uint8_t* data, uint32_
     return publishRaw(channel, data, len);
 }
 
+#ifndef ZCM_EMBEDDED
+inline int ZCM::publishLoan(uint32_t len, uint8_t** buf)
+{
+    return zcm_publish_loan(zcm, len, buf);
+}
+#endif
+
+#ifndef ZCM_EMBEDDED
+inline int ZCM::publishCommit(const std::string& channel, uint8_t* buf, uint32_t len)
+{
+    return zcm_publish_commit(zcm, channel.c_str(), buf, len);
+}
+#endif
+
+#ifndef ZCM_EMBEDDED
+inline void ZCM::publishCancel(uint8_t* buf)
+{
+    zcm_publish_cancel(zcm, buf);
+}
+#endif
+
 template <class Msg>
 inline int ZCM::publish(const std::string& channel, const Msg* msg)
 {
@@ -486,7 +512,12 @@ inline void ZCM::unsubscribeRaw(void*& rawSub)
 inline LogFile::LogFile(const std::string& path, const std::string& mode)
 {
     this->eventlog = zcm_eventlog_create(path.c_str(), mode.c_str());
-    this->lastevent = nullptr;
+    if (eventlog && mode == "r") {
+        // Falls back on reading through the FILE* if the log can't be mapped
+        zcm_eventlog_map(eventlog);
+        // and on bisecting the file to seek if it has no index
+        zcm_eventlog_load_index(eventlog, (path + ZCM_EVENTLOG_INDEX_SUFFIX).c_str());
+    }
 }
 
 inline void LogFile::close()
@@ -494,9 +525,6 @@ inline void LogFile::close()
     if (eventlog)
         zcm_eventlog_destroy(eventlog);
     eventlog = nullptr;
-    if(lastevent)
-        zcm_eventlog_free_event(lastevent);
-    lastevent = nullptr;
 }
 
 inline LogFile::~LogFile()
@@ -514,40 +542,72 @@ inline int LogFile::seekToTimestamp(int64_t timestamp)
     return zcm_eventlog_seek_to_timestamp(eventlog, timestamp);
 }
 
+inline int LogFile::seekToEventnum(int64_t eventnum)
+{
+    return zcm_eventlog_seek_to_eventnum(eventlog, eventnum);
+}
+
+inline int LogFile::seekToChannel(const std::string& channel, int64_t timestamp)
+{
+    return zcm_eventlog_seek_to_channel(eventlog, channel.c_str(), timestamp);
+}
+
+inline int LogFile::seekToOffset(off_t offset)
+{
+    return zcm_eventlog_seek(eventlog, offset);
+}
+
+inline off_t LogFile::getOffset()
+{
+    return zcm_eventlog_tell(eventlog);
+}
+
+inline off_t LogFile::getLength()
+{
+    return zcm_eventlog_length(eventlog);
+}
+
 inline FILE* LogFile::getFilePtr()
 {
     return zcm_eventlog_get_fileptr(eventlog);
 }
 
-inline const LogEvent* LogFile::cplusplusIfyEvent(zcm_eventlog_event_t* evt)
+inline int LogFile::writeIndex(const std::string& path, uint32_t stride)
+{
+    return zcm_eventlog_write_index(eventlog, path.c_str(), stride);
+}
+
+inline int LogFile::buildIndex(const std::string& path, uint32_t stride)
+{
+    return zcm_eventlog_build_index(eventlog, path.c_str(), stride);
+}
+
+inline const LogEvent* LogFile::cplusplusIfyEvent(int readErr)
 {
-    if (lastevent)
-        zcm_eventlog_free_event(lastevent);
-    lastevent = evt;
-    if (!evt) return nullptr;
-    curEvent.eventnum = evt->eventnum;
-    curEvent.channel.assign(evt->channel, evt->channellen);
-    curEvent.timestamp = evt->timestamp;
-    curEvent.datalen = evt->datalen;
-    curEvent.data = evt->data;
+    if (readErr) return nullptr;
+    curEvent.eventnum = lastevent.eventnum;
+    // Reuses the string's storage, so reading doesn't allocate once it has seen the
+    // longest channel name
+    curEvent.channel.assign(lastevent.channel, lastevent.channellen);
+    curEvent.timestamp = lastevent.timestamp;
+    curEvent.datalen = lastevent.datalen;
+    curEvent.data = lastevent.data;
     return &curEvent;
 }
 
 inline const LogEvent* LogFile::readNextEvent()
 {
-    zcm_eventlog_event_t* evt = zcm_eventlog_read_next_event(eventlog);
-    return cplusplusIfyEvent(evt);
+    return cplusplusIfyEvent(zcm_eventlog_read_next_event_view(eventlog, &lastevent));
 }
 
 inline const LogEvent* LogFile::readPrevEvent()
 {
-    zcm_eventlog_event_t* evt = zcm_eventlog_read_prev_event(eventlog);
-    return cplusplusIfyEvent(evt);
+    return cplusplusIfyEvent(zcm_eventlog_read_prev_event_view(eventlog, &lastevent));
 }
 inline const LogEvent* LogFile::readEventAtOffset(off_t offset)
 {
-    zcm_eventlog_event_t* evt = zcm_eventlog_read_event_at_offset(eventlog, offset);
-    return cplusplusIfyEvent(evt);
+    return cplusplusIfyEvent(zcm_eventlog_read_event_at_offset_view(eventlog, offset,
+                                                                    &lastevent));
 }
 
 inline int LogFile::writeEvent(const LogEvent* event)
@@ -562,4 +622,24 @@ inline int LogFile::writeEvent(const LogEvent* event)
     evt.data = event->data;
     return zcm_eventlog_write_event(eventlog, &evt);
 }
+
+inline int LogFile::writeEvent(const zcm_eventlog_event_t* event)
+{
+    return zcm_eventlog_write_event(eventlog, event);
+}
+
+inline int LogFile::flush(bool sync)
+{
+    return zcm_eventlog_flush(eventlog, sync);
+}
+
+inline int LogFile::writeAsync(const zcm_eventlog_async_opts_t* opts)
+{
+    return zcm_eventlog_write_async(eventlog, opts);
+}
+
+inline int LogFile::writeCompressed(const std::string& codec, size_t blockSize)
+{
+    return zcm_eventlog_write_compressed(eventlog, codec.c_str(), blockSize);
+}
 #endif
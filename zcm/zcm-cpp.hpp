@@ -50,6 +50,16 @@ class ZCM
   public:
     inline int publish(const std::string& channel, const uint8_t* data, uint32_t len);
 
+    #ifndef ZCM_EMBEDDED
+    // Blocking mode only, see zcm_set_dispatch_threads() in zcm.h
+    inline int  setDispatchThreads(uint32_t numThreads);
+
+    // Zero-copy publishing (blocking mode only), see zcm_publish_loan() in zcm.h
+    inline int  publishLoan(uint32_t len, uint8_t** buf);
+    inline int  publishCommit(const std::string& channel, uint8_t* buf, uint32_t len);
+    inline void publishCancel(uint8_t* buf);
+    #endif
+
     // Note: if we make a publish binding that takes a const message reference, the compiler does
     //       not select the right version between the pointer and reference versions, so when the
     //       user intended to call the pointer version, the reference version is called and causes
@@ -136,20 +146,43 @@ struct LogFile
 
     /**** Methods general operations ****/
     inline int seekToTimestamp(int64_t timestamp);
+    inline int seekToEventnum(int64_t eventnum);
+    inline int seekToChannel(const std::string& channel, int64_t timestamp);
+    inline int seekToOffset(off_t offset);
+    inline off_t getOffset();
+    inline off_t getLength();
     inline FILE* getFilePtr();
 
+    /**** Methods for the sidecar seek index ****/
+    // Logs opened for reading load the index at their path + ZCM_EVENTLOG_INDEX_SUFFIX
+    inline int writeIndex(const std::string& path,
+                          uint32_t stride = ZCM_EVENTLOG_INDEX_DEFAULT_STRIDE);
+    inline int buildIndex(const std::string& path,
+                          uint32_t stride = ZCM_EVENTLOG_INDEX_DEFAULT_STRIDE);
+
     /**** Methods for read/write ****/
-    // NOTE: user should NOT hold-onto the returned ptr across successive calls
+    // NOTE: user should NOT hold-onto the returned ptr across successive calls.
+    //       Logs opened for reading are memory mapped where possible, in which case the
+    //       event's data points into the read-only mapping of the file.
     inline const LogEvent* readNextEvent();
     inline const LogEvent* readPrevEvent();
     inline const LogEvent* readEventAtOffset(off_t offset);
     inline int             writeEvent(const LogEvent* event);
+    // Writes straight from the buffers event points to, without building a LogEvent
+    inline int             writeEvent(const zcm_eventlog_event_t* event);
+    inline int             flush(bool sync = false);
+
+    // Writes events out from large buffers in the background, see zcm/eventlog.h
+    inline int writeAsync(const zcm_eventlog_async_opts_t* opts = nullptr);
+    // Writes events in independently compressed blocks, see zcm/eventlog.h.
+    // Logs opened for reading are read the same whichever format they are in.
+    inline int writeCompressed(const std::string& codec = "lz4", size_t blockSize = 0);
 
   private:
-    inline const LogEvent* cplusplusIfyEvent(zcm_eventlog_event_t* le);
+    inline const LogEvent* cplusplusIfyEvent(int readErr);
     LogEvent curEvent;
     zcm_eventlog_t* eventlog;
-    zcm_eventlog_event_t* lastevent;
+    zcm_eventlog_event_t lastevent;
 };
 #endif
 
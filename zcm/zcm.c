@@ -306,6 +306,38 @@ void zcm_set_queue_size(zcm_t* zcm, uint32_t numMsgs)
 }
 #endif
 
+#ifndef ZCM_EMBEDDED
+int zcm_set_dispatch_threads(zcm_t* zcm, uint32_t numThreads)
+{
+    ZCM_ASSERT(zcm->type == ZCM_BLOCKING);
+    return zcm_blocking_set_dispatch_threads(zcm->impl, numThreads);
+}
+#endif
+
+#ifndef ZCM_EMBEDDED
+int zcm_publish_loan(zcm_t* zcm, uint32_t len, uint8_t** buf)
+{
+    ZCM_ASSERT(zcm->type == ZCM_BLOCKING);
+    return zcm_blocking_publish_loan(zcm->impl, len, buf);
+}
+#endif
+
+#ifndef ZCM_EMBEDDED
+int zcm_publish_commit(zcm_t* zcm, const char* channel, uint8_t* buf, uint32_t len)
+{
+    ZCM_ASSERT(zcm->type == ZCM_BLOCKING);
+    return zcm_blocking_publish_commit(zcm->impl, channel, buf, len);
+}
+#endif
+
+#ifndef ZCM_EMBEDDED
+void zcm_publish_cancel(zcm_t* zcm, uint8_t* buf)
+{
+    ZCM_ASSERT(zcm->type == ZCM_BLOCKING);
+    zcm_blocking_publish_cancel(zcm->impl, buf);
+}
+#endif
+
 int zcm_handle_nonblock(zcm_t* zcm)
 {
     ZCM_ASSERT(zcm->type == ZCM_NONBLOCKING);
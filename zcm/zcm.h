@@ -144,6 +144,26 @@ int  zcm_handle(zcm_t* zcm); /* returns ZCM_EOK normally, error code on failure.
    messages will not be read from / sent to the transport, which could cause significant
    issues depending on the transport. */
 void zcm_set_queue_size(zcm_t* zcm, uint32_t numMsgs);
+/* Dispatch messages from 'numThreads' threads instead of the single handler thread
+   (1 restores the default). Each subscription is pinned to a thread by channel and
+   receives its messages in order, never running concurrently with itself, so a slow
+   callback only delays its own subscription. Idle threads steal work from busy ones.
+   Only takes effect for zcm_run() and zcm_start(); zcm_flush() dispatches anything
+   still waiting in the calling thread as usual.
+   Must be called while not running. Returns ZCM_EOK on success, ZCM_EAGAIN if zcm is
+   running or messages from a previous run still need to be flushed */
+int  zcm_set_dispatch_threads(zcm_t* zcm, uint32_t numThreads);
+/* Zero-copy publishing. zcm_publish_loan() hands out a buffer of at least 'len' bytes
+   owned by the send queue so the caller can encode a message directly into it.
+   zcm_publish_commit() queues the first 'len' bytes of a loaned buffer for transmission
+   on 'channel'. The buffer is returned to zcm by zcm_publish_commit() (whether or not
+   it succeeds) or by zcm_publish_cancel(); it must not be touched afterwards.
+   Returns ZCM_EOK on success, error code on failure: zcm_publish_loan() returns
+   ZCM_EINVALID if 'len' is above the transport's MTU and ZCM_EMEMORY if the buffer
+   can't be allocated */
+int  zcm_publish_loan(zcm_t* zcm, uint32_t len, uint8_t** buf);
+int  zcm_publish_commit(zcm_t* zcm, const char* channel, uint8_t* buf, uint32_t len);
+void zcm_publish_cancel(zcm_t* zcm, uint8_t* buf);
 #endif
 
 /* Non-Blocking Mode Only: Functions checking and dispatching messages